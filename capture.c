@@ -0,0 +1,173 @@
+/*
+ * Binary capture of backend requests for replay
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <sys/types.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "capture.h"
+
+#define BUFSIZE	65536
+
+int capture_enabled;
+
+static pthread_mutex_t mtx=PTHREAD_MUTEX_INITIALIZER;
+static int out=-1;
+static off_t done;
+static int fill;
+static unsigned char bfr[BUFSIZE];
+static uint64_t base;
+static unsigned long long records;
+static unsigned long long bytes;
+static unsigned long long failed;
+
+unsigned long long capture_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+/* the buffer only ever holds whole records, on a failed write the file
+   is cut back to the last complete flush and capturing stops */
+static int flush(void)
+{
+	ssize_t n;
+	int pos;
+
+	for(pos=0;pos<fill;pos+=n)
+		if((n=write(out,bfr+pos,fill-pos))<=0)
+	{
+		if(n==-1&&errno==EINTR)
+		{
+			n=0;
+			continue;
+		}
+		if(ftruncate(out,done));
+		close(out);
+		out=-1;
+		fill=0;
+		capture_enabled=0;
+		return -1;
+	}
+
+	done+=fill;
+	fill=0;
+	return 0;
+}
+
+int capture_start(const char *path)
+{
+	CAPTURE_HDR hdr;
+	int fd;
+
+	pthread_mutex_lock(&mtx);
+
+	if(out!=-1)
+	{
+		errno=EBUSY;
+		goto err1;
+	}
+
+	if((fd=open(path,O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,0600))==-1)
+		goto err1;
+
+	memset(&hdr,0,sizeof(hdr));
+	memcpy(hdr.magic,CAPTURE_MAGIC,sizeof(hdr.magic));
+	hdr.version=CAPTURE_VERSION;
+	hdr.recsize=sizeof(CAPTURE_REC);
+	if(write(fd,&hdr,sizeof(hdr))!=sizeof(hdr))goto err2;
+
+	out=fd;
+	done=sizeof(hdr);
+	fill=0;
+	base=capture_clock();
+	records=0;
+	bytes=0;
+	failed=0;
+	capture_enabled=1;
+
+	pthread_mutex_unlock(&mtx);
+	return 0;
+
+err2:	close(fd);
+err1:	pthread_mutex_unlock(&mtx);
+	return -1;
+}
+
+int capture_stop(void)
+{
+	int r=0;
+
+	pthread_mutex_lock(&mtx);
+	capture_enabled=0;
+	if(out!=-1)
+	{
+		if(flush()||close(out))r=-1;
+		out=-1;
+	}
+	pthread_mutex_unlock(&mtx);
+
+	return r;
+}
+
+void capture_add(int op,int adapter,int type,int unit,
+	unsigned int sid,unsigned long long start,unsigned long long arg,
+	long long res,const void *data,int len)
+{
+	CAPTURE_REC rec;
+	uint64_t now=capture_clock();
+
+	if(!data||len<0)len=0;
+	else if(len>CAPTURE_MAXDATA)len=CAPTURE_MAXDATA;
+
+	memset(&rec,0,sizeof(rec));
+	rec.dur=now-start;
+	rec.arg=arg;
+	rec.res=res;
+	rec.sid=sid;
+	rec.len=len;
+	rec.adapter=adapter;
+	rec.op=op;
+	rec.type=type;
+	rec.unit=unit;
+
+	pthread_mutex_lock(&mtx);
+	if(out!=-1)
+	{
+		rec.ns=start>base?start-base:0;
+		if(fill+sizeof(rec)+len>BUFSIZE&&flush())failed++;
+		else
+		{
+			memcpy(bfr+fill,&rec,sizeof(rec));
+			if(len)memcpy(bfr+fill+sizeof(rec),data,len);
+			fill+=sizeof(rec)+len;
+			records++;
+			bytes+=sizeof(rec)+len;
+		}
+	}
+	pthread_mutex_unlock(&mtx);
+}
+
+void capture_dump(FILE *fp,const char *prefix)
+{
+	pthread_mutex_lock(&mtx);
+	fprintf(fp,"%s active=%d records=%llu bytes=%llu failed=%llu\n",
+		prefix,out!=-1?1:0,records,bytes,failed);
+	pthread_mutex_unlock(&mtx);
+}
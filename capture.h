@@ -0,0 +1,62 @@
+/*
+ * Binary capture of backend requests for replay
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+
+#define CAPTURE_MAGIC	"DVBCAPTR"
+#define CAPTURE_VERSION	1
+#define CAPTURE_MAXDATA	8192
+
+#define CAP_OPEN	1
+#define CAP_READ	2
+#define CAP_WRITE	3
+#define CAP_IOCTL	4
+#define CAP_RELEASE	6
+
+typedef struct
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t recsize;
+} CAPTURE_HDR;
+
+/* ns is the request start relative to the capture start, arg is the open
+   flags, the byte count or the ioctl request, res the result or -errno,
+   len bytes of ioctl input follow (the value itself for _IO requests) */
+typedef struct
+{
+	uint64_t ns;
+	uint64_t dur;
+	uint64_t arg;
+	int64_t res;
+	uint32_t sid;
+	uint32_t len;
+	uint16_t adapter;
+	uint8_t op;
+	uint8_t type;
+	uint8_t unit;
+	uint8_t pad[3];
+} CAPTURE_REC;
+
+extern int capture_enabled;
+
+extern int capture_start(const char *path);
+extern int capture_stop(void);
+extern unsigned long long capture_clock(void);
+extern void capture_add(int op,int adapter,int type,int unit,
+	unsigned int sid,unsigned long long start,unsigned long long arg,
+	long long res,const void *data,int len);
+extern void capture_dump(FILE *fp,const char *prefix);
+
+#endif
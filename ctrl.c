@@ -0,0 +1,227 @@
+/*
+ * Line based control socket
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <errno.h>
+#include <stdio.h>
+#include <poll.h>
+#include <pthread.h>
+
+#include "ctrl.h"
+
+#define LINESIZE	1024
+#define MAXCLIENTS	8
+
+typedef struct
+{
+	pthread_t th;
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	int fd;
+	int stop;
+	int clients;
+	int (*cmd)(void *user,char *line,FILE *fp);
+	void *user;
+	char path[108];
+} CTRL;
+
+typedef struct
+{
+	CTRL *c;
+	int fd;
+} CLIENT;
+
+static void session(CTRL *c,int fd)
+{
+	struct pollfd p;
+	FILE *fp;
+	char bfr[LINESIZE];
+	char *e;
+	int fill=0;
+	int len;
+	int r;
+
+	if(!(fp=fdopen(dup(fd),"w")))return;
+
+	p.fd=fd;
+	p.events=POLLIN;
+
+	while(!c->stop)
+	{
+		if(poll(&p,1,200)<1)continue;
+
+		if((len=read(fd,bfr+fill,sizeof(bfr)-fill-1))<=0)
+		{
+			if(len<0&&(errno==EINTR||errno==EAGAIN))continue;
+			break;
+		}
+		fill+=len;
+		bfr[fill]=0;
+
+		while((e=strchr(bfr,'\n')))
+		{
+			*e++=0;
+			if(e>bfr+1&&e[-2]=='\r')e[-2]=0;
+
+			if(*bfr)
+			{
+				errno=0;
+				r=c->cmd(c->user,bfr,fp);
+				if(!r)fprintf(fp,"ok\n");
+				else fprintf(fp,"error %s\n",
+					strerror(errno?errno:EINVAL));
+				if(fflush(fp))goto out;
+			}
+
+			fill-=e-bfr;
+			memmove(bfr,e,fill+1);
+		}
+
+		if(fill==sizeof(bfr)-1)
+		{
+			fprintf(fp,"error %s\n",strerror(E2BIG));
+			break;
+		}
+	}
+
+out:	fclose(fp);
+}
+
+static void *client(void *data)
+{
+	CLIENT *cl=(CLIENT *)data;
+	CTRL *c=cl->c;
+
+	session(c,cl->fd);
+	close(cl->fd);
+	free(cl);
+
+	pthread_mutex_lock(&c->mtx);
+	c->clients--;
+	pthread_cond_signal(&c->cond);
+	pthread_mutex_unlock(&c->mtx);
+
+	pthread_exit(NULL);
+}
+
+static void *server(void *data)
+{
+	CTRL *c=(CTRL *)data;
+	CLIENT *cl;
+	struct pollfd p;
+	pthread_attr_t attr;
+	pthread_t th;
+	sigset_t set;
+	int fd;
+
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK,&set,NULL);
+
+	if(pthread_attr_init(&attr))pthread_exit(NULL);
+	pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+
+	p.fd=c->fd;
+	p.events=POLLIN;
+
+	while(!c->stop)
+	{
+		if(poll(&p,1,200)<1)continue;
+		if((fd=accept4(c->fd,NULL,NULL,SOCK_CLOEXEC))==-1)continue;
+
+		pthread_mutex_lock(&c->mtx);
+		if(c->clients==MAXCLIENTS||!(cl=malloc(sizeof(CLIENT))))
+		{
+			pthread_mutex_unlock(&c->mtx);
+			close(fd);
+			continue;
+		}
+		cl->c=c;
+		cl->fd=fd;
+		if(pthread_create(&th,&attr,client,cl))
+		{
+			pthread_mutex_unlock(&c->mtx);
+			free(cl);
+			close(fd);
+			continue;
+		}
+		c->clients++;
+		pthread_mutex_unlock(&c->mtx);
+	}
+
+	pthread_attr_destroy(&attr);
+
+	pthread_exit(NULL);
+}
+
+void *ctrl_create(const char *path,
+	int (*cmd)(void *user,char *line,FILE *fp),void *user)
+{
+	CTRL *c;
+	struct sockaddr_un addr;
+
+	if(!(c=malloc(sizeof(CTRL))))goto err1;
+	memset(c,0,sizeof(CTRL));
+	c->cmd=cmd;
+	c->user=user;
+
+	if(strlen(path)>=sizeof(c->path)||
+		strlen(path)>=sizeof(addr.sun_path))goto err2;
+	if(pthread_mutex_init(&c->mtx,NULL))goto err2;
+	if(pthread_cond_init(&c->cond,NULL))goto err3;
+	strcpy(c->path,path);
+
+	memset(&addr,0,sizeof(addr));
+	addr.sun_family=AF_UNIX;
+	strcpy(addr.sun_path,path);
+
+	if((c->fd=socket(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC,0))==-1)goto err4;
+	unlink(path);
+	if(bind(c->fd,(struct sockaddr *)&addr,sizeof(addr)))goto err5;
+	if(chmod(path,0600)||listen(c->fd,4))goto err6;
+	if(pthread_create(&c->th,NULL,server,c))goto err6;
+
+	return c;
+
+err6:	unlink(path);
+err5:	close(c->fd);
+err4:	pthread_cond_destroy(&c->cond);
+err3:	pthread_mutex_destroy(&c->mtx);
+err2:	free(c);
+err1:	return NULL;
+}
+
+void ctrl_destroy(void *ctx)
+{
+	CTRL *c=(CTRL *)ctx;
+
+	if(!c)return;
+
+	c->stop=1;
+	pthread_join(c->th,NULL);
+
+	pthread_mutex_lock(&c->mtx);
+	while(c->clients)pthread_cond_wait(&c->cond,&c->mtx);
+	pthread_mutex_unlock(&c->mtx);
+
+	close(c->fd);
+	unlink(c->path);
+	pthread_cond_destroy(&c->cond);
+	pthread_mutex_destroy(&c->mtx);
+	free(c);
+}
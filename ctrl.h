@@ -0,0 +1,19 @@
+/*
+ * Line based control socket
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef CTRL_H
+#define CTRL_H
+
+extern void *ctrl_create(const char *path,
+	int (*cmd)(void *user,char *line,FILE *fp),void *user);
+extern void ctrl_destroy(void *ctx);
+
+#endif
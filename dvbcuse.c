@@ -9,6 +9,7 @@
  *
  */
 
+#define _GNU_SOURCE
 #define FUSE_USE_VERSION 29
 
 #include <linux/dvb/frontend.h>
@@ -20,6 +21,8 @@
 #include <fuse_lowlevel.h>
 #include <fuse_opt.h>
 
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <limits.h>
@@ -30,25 +33,863 @@
 #include <errno.h>
 #include <stdio.h>
 #include <poll.h>
+#include <time.h>
+#include <sched.h>
 #include <pthread.h>
 
 #include "dvbcuse.h"
+#include "ts.h"
+#include "trace.h"
+#include "capture.h"
+
+#define EVQUEUE	8
+#define SLABSIZE	64
+#define RDSIZE	131072
+#define CHUNKSIZE	(64*TS_SIZE)
+#define CHUNKS	((RDSIZE+CHUNKSIZE-1)/CHUNKSIZE)
+#define MAXTIDS	16
+
+#define DEV_FE	DVBCUSE_FE
+#define DEV_DMX	DVBCUSE_DMX
+#define DEV_DVR	DVBCUSE_DVR
+#define DEV_CA	DVBCUSE_CA
+#define DEV_NET	DVBCUSE_NET
+
+#define OP_READ		0
+#define OP_WRITE	1
+#define OP_IOCTL	2
+
+#define RQ_IDLE		0
+#define RQ_BUSY		1
+#define RQ_RETRY	2
+#define RQ_DONE		3
 
 typedef struct
 {
-	struct _stream *s;
 	pthread_mutex_t mtx;
-	pthread_t th[5];
+	struct _dvbcuse_stream *s;
+	struct _dvbcuse_stream *free;
+	struct _slab *slabs;
+} REGISTRY;
+
+typedef struct
+{
+	pthread_mutex_t mtx;
+	struct _chunk *free;
+} POOL;
+
+typedef struct
+{
+	struct _data *dev;
+	pthread_t th;
+	pthread_t evth;
+	int type;
+	int unit;
+	int evwake;
+	int evbusy;
+	struct _dvbcuse_stream *evs;
+	int tids[MAXTIDS];
+} NODE;
+
+typedef struct _data
+{
+	REGISTRY reg[5];
+	NODE node[5][DVBCUSE_UNITS];
+	POOL pool;
+	pthread_cond_t evcond;
+	int evstop;
+	int units;
 	DVBCUSE_DEVICE conf;
 } DATA;
 
-typedef struct _stream
+typedef struct _dvbcuse_stream
+{
+	struct _dvbcuse_stream *next;
+	struct _dvbcuse_stream *prev;
+	int type;
+	int unit;
+	int refs;
+	int flags;
+	unsigned int sid;
+	DATA *dev;
+	int fd;
+	void *h;
+	int ts;
+	int fill;
+	struct _dvbcuse_req *reader;
+	struct _dvbcuse_req *rdwait;
+	pthread_mutex_t mtx;
+	DVBCUSE_STAGE *stages;
+	void **sst;
+	size_t (*filter)(void *user,int fd,void *buf,size_t count);
+	unsigned char tail[TS_SIZE];
+	int evhead;
+	int evcnt;
+	fuse_req_t evreq;
+	struct fuse_pollhandle *ph;
+	struct dvb_frontend_event ev[EVQUEUE];
+} STREAM;
+
+typedef struct _slab
+{
+	struct _slab *next;
+	STREAM s[SLABSIZE];
+} SLAB;
+
+typedef struct _chunk
+{
+	struct _chunk *next;
+	unsigned char data[CHUNKSIZE];
+} CHUNK;
+
+struct _dvbcuse_req
+{
+	struct _dvbcuse_req *next;
+	fuse_req_t req;
+	STREAM *s;
+	int op;
+	int state;
+	int aligned;
+	int taken;
+	int async;
+	int iovcnt;
+	struct iovec *iov;
+	struct iovec one;
+	CHUNK *chunks[CHUNKS];
+	unsigned long cmd;
+	void *arg;
+	size_t size;
+	size_t count;
+	size_t outsz;
+	void *cap;
+	int caplen;
+	ssize_t result;
+	unsigned long long start;
+	void (*done)(STREAM *s,void *arg);
+	unsigned char data[];
+};
+
+static struct cuse_lowlevel_ops traced[5];
+static pthread_key_t tidkey;
+static __thread NODE *self;
+static __thread int quiet;
+static unsigned int sids;
+
+static void leave(void *data)
+{
+	*(int *)data=0;
+}
+
+static void enroll(NODE *node)
+{
+	int tid;
+	int i;
+
+	if(self==node)return;
+	self=node;
+
+	tid=syscall(SYS_gettid);
+	for(i=0;i<MAXTIDS;i++)
+		if(__sync_bool_compare_and_swap(&node->tids[i],0,tid))
+	{
+		pthread_setspecific(tidkey,&node->tids[i]);
+		break;
+	}
+}
+
+static STREAM *stream_new(DATA *dev,int type)
+{
+	REGISTRY *r=&dev->reg[type];
+	SLAB *slab;
+	STREAM *s;
+	int i;
+
+	pthread_mutex_lock(&r->mtx);
+
+	if(!r->free)
+	{
+		if(!(slab=malloc(sizeof(SLAB))))
+		{
+			pthread_mutex_unlock(&r->mtx);
+			return NULL;
+		}
+		slab->next=r->slabs;
+		r->slabs=slab;
+		for(i=0;i<SLABSIZE;i++)
+		{
+			slab->s[i].next=r->free;
+			r->free=&slab->s[i];
+		}
+	}
+
+	s=r->free;
+	r->free=s->next;
+
+	pthread_mutex_unlock(&r->mtx);
+
+	memset(s,0,sizeof(STREAM));
+	s->type=type;
+	s->refs=1;
+	s->dev=dev;
+
+	return s;
+}
+
+static void stream_free(STREAM *s)
+{
+	REGISTRY *r=&s->dev->reg[s->type];
+
+	pthread_mutex_lock(&r->mtx);
+	s->next=r->free;
+	r->free=s;
+	pthread_mutex_unlock(&r->mtx);
+}
+
+static void stream_link(STREAM *s)
+{
+	REGISTRY *r=&s->dev->reg[s->type];
+
+	pthread_mutex_lock(&r->mtx);
+	s->prev=NULL;
+	if((s->next=r->s))s->next->prev=s;
+	r->s=s;
+	pthread_mutex_unlock(&r->mtx);
+}
+
+static void stream_unlink(STREAM *s)
+{
+	REGISTRY *r=&s->dev->reg[s->type];
+
+	pthread_mutex_lock(&r->mtx);
+	if(s->prev)s->prev->next=s->next;
+	else r->s=s->next;
+	if(s->next)s->next->prev=s->prev;
+	pthread_mutex_unlock(&r->mtx);
+}
+
+static void stream_get(STREAM *s)
+{
+	__sync_add_and_fetch(&s->refs,1);
+}
+
+static const void *payload(unsigned long request,void *arg,
+	unsigned long long *val,int *len)
+{
+	struct dtv_properties *p;
+
+	*len=0;
+
+	switch(request)
+	{
+	case FE_SET_PROPERTY:
+	case FE_GET_PROPERTY:
+		p=(struct dtv_properties *)arg;
+		*len=p->num*sizeof(struct dtv_property);
+		return p->props;
+	}
+
+	if(_IOC_DIR(request)==_IOC_NONE)
+	{
+		*val=(unsigned long)arg;
+		*len=sizeof(*val);
+		return val;
+	}
+
+	if(!arg||!(_IOC_DIR(request)&_IOC_WRITE))return NULL;
+	*len=_IOC_SIZE(request);
+	return arg;
+}
+
+static void capture(STREAM *s,int op,unsigned long long start,
+	unsigned long long arg,long long res,const void *data,int len)
+{
+	capture_add(op,s->dev->conf.adapter,s->type,s->unit,s->sid,start,arg,
+		res,data,len);
+}
+
+static int be_open(STREAM *s,const char *pathname,int flags)
+{
+	DVBCUSE_DEVICE *c=&s->dev->conf;
+	unsigned long long start=capture_enabled?capture_clock():0;
+	int r;
+	char bfr[PATH_MAX];
+
+	s->fd=-1;
+	s->sid=__sync_add_and_fetch(&sids,1);
+
+	TRACE(backend_entry,TR_BACKEND|TR_OPEN,s->type,s->unit,flags,0);
+
+	if(c->h.open)
+	{
+		s->h=c->h.open(c->user,s,s->type,s->unit,flags);
+		r=s->h?0:-1;
+		goto out;
+	}
+
+	if(s->unit)
+	{
+		if((r=c->unit_pathname(c->user,s->type,s->unit,bfr,
+			sizeof(bfr))))goto out;
+		pathname=bfr;
+	}
+
+	switch(s->type)
+	{
+	case DEV_FE:
+		s->fd=c->fe_open(c->user,pathname,flags);
+		break;
+	case DEV_DMX:
+		s->fd=c->dmx_open(c->user,pathname,flags);
+		break;
+	case DEV_DVR:
+		s->fd=c->dvr_open(c->user,pathname,flags);
+		break;
+	case DEV_CA:
+		s->fd=c->ca_open(c->user,pathname,flags);
+		break;
+	case DEV_NET:
+		s->fd=c->net_open(c->user,pathname,flags);
+		break;
+	}
+
+	r=s->fd==-1?-1:0;
+
+out:	TRACE(backend_exit,TR_BACKEND|TR_OPEN|TR_EXIT,s->type,s->unit,flags,
+		r?-errno:0);
+	if(start)capture(s,CAP_OPEN,start,flags,r?-errno:0,NULL,0);
+	return r;
+}
+
+static void be_close(STREAM *s)
+{
+	DVBCUSE_DEVICE *c=&s->dev->conf;
+	unsigned long long start=capture_enabled?capture_clock():0;
+
+	TRACE(backend_entry,TR_BACKEND|TR_RELEASE,s->type,s->unit,0,0);
+
+	if(c->h.open)c->h.close(c->user,s->h);
+	else switch(s->type)
+	{
+	case DEV_FE:
+		c->fe_close(c->user,s->fd);
+		break;
+	case DEV_DMX:
+		c->dmx_close(c->user,s->fd);
+		break;
+	case DEV_DVR:
+		c->dvr_close(c->user,s->fd);
+		break;
+	case DEV_CA:
+		c->ca_close(c->user,s->fd);
+		break;
+	case DEV_NET:
+		c->net_close(c->user,s->fd);
+		break;
+	}
+
+	TRACE(backend_exit,TR_BACKEND|TR_RELEASE|TR_EXIT,s->type,s->unit,0,0);
+	if(start)capture(s,CAP_RELEASE,start,0,0,NULL,0);
+}
+
+static int be_ioctl(STREAM *s,unsigned long request,void *arg)
+{
+	DVBCUSE_DEVICE *c=&s->dev->conf;
+	unsigned long long start=0;
+	unsigned long long val;
+	unsigned char bfr[CAPTURE_MAXDATA];
+	const void *data=NULL;
+	int len=0;
+	int r;
+
+	TRACE(backend_entry,TR_BACKEND|TR_IOCTL,s->type,s->unit,request,0);
+
+	if(capture_enabled&&!quiet)
+	{
+		if((data=payload(request,arg,&val,&len))&&len<=sizeof(bfr))
+			data=memcpy(bfr,data,len);
+		else len=0;
+		start=capture_clock();
+	}
+
+	if(c->h.open)r=c->h.ioctl(c->user,s->h,request,arg);
+	else switch(s->type)
+	{
+	case DEV_FE:
+		r=c->fe_ioctl(c->user,s->fd,request,arg);
+		break;
+	case DEV_DMX:
+		r=c->dmx_ioctl(c->user,s->fd,request,arg);
+		break;
+	case DEV_DVR:
+		r=c->dvr_ioctl(c->user,s->fd,request,arg);
+		break;
+	case DEV_CA:
+		r=c->ca_ioctl(c->user,s->fd,request,arg);
+		break;
+	default:
+		r=c->net_ioctl(c->user,s->fd,request,arg);
+		break;
+	}
+
+	TRACE(backend_exit,TR_BACKEND|TR_IOCTL|TR_EXIT,s->type,s->unit,request,
+		r==-1?-errno:r);
+	if(start)capture(s,CAP_IOCTL,start,request,r==-1?-errno:r,data,len);
+	return r;
+}
+
+static int be_poll(STREAM *s,int events)
+{
+	DVBCUSE_DEVICE *c=&s->dev->conf;
+	struct pollfd p;
+
+	TRACE(backend_entry,TR_BACKEND|TR_POLL,s->type,s->unit,events,0);
+
+	p.fd=s->fd;
+	p.events=events;
+	p.revents=0;
+
+	if(c->h.open)p.revents=c->h.poll(c->user,s->h)&events;
+	else switch(s->type)
+	{
+	case DEV_FE:
+		c->fe_poll(c->user,&p);
+		break;
+	case DEV_DMX:
+		c->dmx_poll(c->user,&p);
+		break;
+	case DEV_DVR:
+		c->dvr_poll(c->user,&p);
+		break;
+	case DEV_CA:
+		c->ca_poll(c->user,&p);
+		break;
+	}
+
+	TRACE(backend_exit,TR_BACKEND|TR_POLL|TR_EXIT,s->type,s->unit,events,
+		p.revents);
+	return p.revents;
+}
+
+static void stages_close(STREAM *s);
+
+static void stream_put(STREAM *s)
+{
+	if(__sync_sub_and_fetch(&s->refs,1))return;
+
+	be_close(s);
+	if(s->ph)fuse_pollhandle_destroy(s->ph);
+
+	if(s->type==DEV_DMX||s->type==DEV_DVR)
+	{
+		stages_close(s);
+		pthread_mutex_destroy(&s->mtx);
+	}
+
+	stream_free(s);
+}
+
+static size_t aligned(STREAM *s,unsigned char *bfr,size_t len);
+
+static DVBCUSE_REQ *request(fuse_req_t req,STREAM *s,int op,size_t size)
+{
+	DVBCUSE_REQ *r;
+
+	if(!(r=malloc(sizeof(DVBCUSE_REQ)+size)))
+	{
+		fuse_reply_err(req,ENOMEM);
+		return NULL;
+	}
+	memset(r,0,sizeof(DVBCUSE_REQ));
+	r->req=req;
+	r->s=s;
+	r->op=op;
+	r->size=size;
+	r->count=size;
+	if(capture_enabled)r->start=capture_clock();
+	stream_get(s);
+
+	return r;
+}
+
+static CHUNK *chunk_get(DATA *dev)
+{
+	CHUNK *c;
+
+	pthread_mutex_lock(&dev->pool.mtx);
+	if((c=dev->pool.free))dev->pool.free=c->next;
+	pthread_mutex_unlock(&dev->pool.mtx);
+
+	if(!c)c=malloc(sizeof(CHUNK));
+	return c;
+}
+
+static void chunk_put(DATA *dev,CHUNK *c)
+{
+	pthread_mutex_lock(&dev->pool.mtx);
+	c->next=dev->pool.free;
+	dev->pool.free=c;
+	pthread_mutex_unlock(&dev->pool.mtx);
+}
+
+static DVBCUSE_REQ *vrequest(fuse_req_t req,STREAM *s,size_t size)
+{
+	DVBCUSE_REQ *r;
+	int i;
+
+	if(!(r=request(req,s,OP_READ,CHUNKS*sizeof(struct iovec))))return NULL;
+	r->iov=(struct iovec *)r->data;
+	r->count=size;
+
+	for(;size;size-=r->iov[r->iovcnt++].iov_len)
+	{
+		if(!(r->chunks[r->iovcnt]=chunk_get(s->dev)))
+		{
+			for(i=0;i<r->iovcnt;i++)chunk_put(s->dev,r->chunks[i]);
+			stream_put(s);
+			free(r);
+			fuse_reply_err(req,ENOMEM);
+			return NULL;
+		}
+		r->iov[r->iovcnt].iov_base=r->chunks[r->iovcnt]->data;
+		r->iov[r->iovcnt].iov_len=size>CHUNKSIZE?CHUNKSIZE:size;
+	}
+
+	return r;
+}
+
+static void snapshot(DVBCUSE_REQ *r)
+{
+	unsigned long long val;
+	const void *data;
+	int len;
+
+	r->async=1;
+	if(!r->start||!(data=payload(r->cmd,r->arg,&val,&len))||
+		len>CAPTURE_MAXDATA||!(r->cap=malloc(len)))return;
+	memcpy(r->cap,data,len);
+	r->caplen=len;
+}
+
+static void finalize(DVBCUSE_REQ *r)
+{
+	size_t len;
+	int i;
+
+	if(r->start&&r->op!=OP_IOCTL)capture(r->s,
+		r->op==OP_READ?CAP_READ:CAP_WRITE,r->start,r->count,r->result,
+		NULL,0);
+	else if(r->start&&r->async)
+		capture(r->s,CAP_IOCTL,r->start,r->cmd,r->result,r->cap,
+			r->caplen);
+
+	if(r->result<0)fuse_reply_err(r->req,-r->result);
+	else switch(r->op)
+	{
+	case OP_READ:
+		if(!r->iov)
+		{
+			fuse_reply_buf(r->req,(char *)r->data,r->result);
+			break;
+		}
+		for(len=r->result,i=0;i<r->iovcnt;len-=r->iov[i++].iov_len)
+			if(r->iov[i].iov_len>len)r->iov[i].iov_len=len;
+		fuse_reply_iov(r->req,r->iov,r->iovcnt);
+		break;
+
+	case OP_WRITE:
+		fuse_reply_write(r->req,r->result);
+		break;
+
+	case OP_IOCTL:
+		if(r->done)r->done(r->s,r->data);
+		fuse_reply_ioctl(r->req,0,r->outsz?r->data:NULL,r->outsz);
+		break;
+	}
+
+	for(i=0;i<r->iovcnt;i++)chunk_put(r->s->dev,r->chunks[i]);
+	stream_put(r->s);
+	free(r->cap);
+	free(r);
+}
+
+static int plainread(DVBCUSE_DEVICE *c,int type)
+{
+	if(c->h.open)return c->h.read!=NULL;
+
+	switch(type)
+	{
+	case DEV_DMX:
+		return c->dmx_read||c->v2.dmx_read;
+	case DEV_DVR:
+		return c->dvr_read||c->v2.dvr_read;
+	default:
+		return 1;
+	}
+}
+
+static void call(DVBCUSE_REQ *r)
+{
+	STREAM *s=r->s;
+	DVBCUSE_DEVICE *c=&s->dev->conf;
+	DVBCUSE_REQ **rp;
+	struct iovec *iov;
+	unsigned char *buf;
+	size_t count;
+	ssize_t len;
+	int n;
+
+	switch(r->op)
+	{
+	case OP_READ:
+		if(r->aligned)
+		{
+			pthread_mutex_lock(&s->mtx);
+			if(s->reader&&s->reader!=r)
+			{
+				for(rp=&s->rdwait;*rp;rp=&(*rp)->next);
+				r->next=NULL;
+				*rp=r;
+				pthread_mutex_unlock(&s->mtx);
+				return;
+			}
+			s->reader=r;
+			memcpy(r->data,s->tail,r->taken=s->fill);
+			s->fill=0;
+			pthread_mutex_unlock(&s->mtx);
+		}
+		buf=r->data+r->taken;
+		count=r->size-r->taken;
+		if(!(iov=r->iov)&&!plainread(c,s->type))
+		{
+			r->one.iov_base=buf;
+			r->one.iov_len=count;
+			iov=&r->one;
+		}
+		if(iov)
+		{
+			n=iov==r->iov?r->iovcnt:1;
+			if(c->h.open)c->h.readv(c->user,r,s->h,iov,n);
+			else if(s->type==DEV_DMX)
+				c->v2.dmx_readv(c->user,r,s->fd,iov,n);
+			else c->v2.dvr_readv(c->user,r,s->fd,iov,n);
+			return;
+		}
+		if(c->h.open)
+		{
+			c->h.read(c->user,r,s->h,buf,count);
+			return;
+		}
+		switch(s->type)
+		{
+		case DEV_DMX:
+			if(c->v2.dmx_read)
+			{
+				c->v2.dmx_read(c->user,r,s->fd,buf,count);
+				return;
+			}
+			len=c->dmx_read(c->user,s->fd,buf,count);
+			break;
+		case DEV_DVR:
+			if(c->v2.dvr_read)
+			{
+				c->v2.dvr_read(c->user,r,s->fd,buf,count);
+				return;
+			}
+			len=c->dvr_read(c->user,s->fd,buf,count);
+			break;
+		default:
+			if(c->v2.ca_read)
+			{
+				c->v2.ca_read(c->user,r,s->fd,buf,count);
+				return;
+			}
+			len=c->ca_read(c->user,s->fd,buf,count);
+			break;
+		}
+		break;
+
+	case OP_WRITE:
+		if(c->h.open)
+		{
+			c->h.write(c->user,r,s->h,r->data,r->size);
+			return;
+		}
+		if(s->type==DEV_DVR)
+		{
+			if(c->v2.dvr_write)
+			{
+				c->v2.dvr_write(c->user,r,s->fd,r->data,
+					r->size);
+				return;
+			}
+			len=c->dvr_write(c->user,s->fd,r->data,r->size);
+		}
+		else
+		{
+			if(c->v2.ca_write)
+			{
+				c->v2.ca_write(c->user,r,s->fd,r->data,r->size);
+				return;
+			}
+			len=c->ca_write(c->user,s->fd,r->data,r->size);
+		}
+		break;
+
+	default:
+		if(!c->h.open)switch(s->type)
+		{
+		case DEV_DMX:
+			if(c->v2.dmx_ioctl)
+			{
+				snapshot(r);
+				c->v2.dmx_ioctl(c->user,r,s->fd,r->cmd,r->arg);
+				return;
+			}
+			break;
+		case DEV_DVR:
+			if(c->v2.dvr_ioctl)
+			{
+				snapshot(r);
+				c->v2.dvr_ioctl(c->user,r,s->fd,r->cmd,r->arg);
+				return;
+			}
+			break;
+		case DEV_CA:
+			if(c->v2.ca_ioctl)
+			{
+				snapshot(r);
+				c->v2.ca_ioctl(c->user,r,s->fd,r->cmd,r->arg);
+				return;
+			}
+			break;
+		}
+		len=be_ioctl(s,r->cmd,r->arg);
+		break;
+	}
+
+	dvbcuse_complete(r,len==-1?-errno:len);
+}
+
+static void submit(DVBCUSE_REQ *r)
+{
+	int state;
+
+	do
+	{
+		r->state=RQ_BUSY;
+		if(r->op==OP_IOCTL)call(r);
+		else
+		{
+			TRACE(backend_entry,TR_BACKEND|(TR_READ+r->op),
+				r->s->type,r->s->unit,r->count,0);
+			call(r);
+			TRACE(backend_exit,TR_BACKEND|TR_EXIT|(TR_READ+r->op),
+				r->s->type,r->s->unit,r->count,0);
+		}
+	} while((state=__sync_val_compare_and_swap(&r->state,RQ_BUSY,RQ_IDLE))
+		==RQ_RETRY);
+
+	if(state==RQ_DONE)finalize(r);
+}
+
+static void submit_ioctl(fuse_req_t req,STREAM *s,unsigned long cmd,
+	void *arg,const void *in,size_t insz,size_t outsz,
+	void (*done)(STREAM *s,void *arg))
+{
+	DVBCUSE_REQ *r;
+
+	if(!(r=request(req,s,OP_IOCTL,insz>outsz?insz:outsz)))return;
+	if(insz)memcpy(r->data,in,insz);
+	else if(outsz)memset(r->data,0,outsz);
+	r->cmd=cmd;
+	r->arg=insz||outsz?r->data:arg;
+	r->outsz=outsz;
+	r->done=done;
+	submit(r);
+}
+
+void dvbcuse_complete(DVBCUSE_REQ *r,ssize_t result)
+{
+	STREAM *s=r->s;
+	DVBCUSE_REQ *n=NULL;
+	int state=RQ_DONE;
+
+	if(r->aligned)
+	{
+		pthread_mutex_lock(&s->mtx);
+		if(result>0)
+		{
+			if(!(result=aligned(s,r->data,r->taken+result)))
+			{
+				if(!(s->flags&O_NONBLOCK))state=RQ_RETRY;
+				else result=-EAGAIN;
+			}
+		}
+		else
+		{
+			memcpy(s->tail,r->data,r->taken);
+			s->fill=r->taken;
+		}
+		if(state!=RQ_RETRY&&(s->reader=n=s->rdwait))
+			s->rdwait=n->next;
+		pthread_mutex_unlock(&s->mtx);
+	}
+
+	r->result=result;
+
+	TRACE(complete,TR_COMPLETE,s->type,s->unit,r->op,result);
+
+	if(__sync_val_compare_and_swap(&r->state,RQ_BUSY,state)!=RQ_BUSY)
+	{
+		if(state==RQ_RETRY)submit(r);
+		else finalize(r);
+	}
+
+	if(n)call(n);
+}
+
+void dvbcuse_notify(DVBCUSE_STREAM *s)
 {
-	struct _stream *next;
-	int flags;
-	DATA *dev;
-	int fd;
-} STREAM;
+	REGISTRY *r=&s->dev->reg[s->type];
+	struct fuse_pollhandle *ph;
+
+	TRACE(notify,TR_NOTIFY,s->type,s->unit,0,0);
+
+	if(s->type==DEV_FE)
+	{
+		eventfd_write(s->dev->node[DEV_FE][s->unit].evwake,1);
+		return;
+	}
+
+	pthread_mutex_lock(&r->mtx);
+	ph=s->ph;
+	s->ph=NULL;
+	pthread_mutex_unlock(&r->mtx);
+
+	if(ph)
+	{
+		fuse_lowlevel_notify_poll(ph);
+		fuse_pollhandle_destroy(ph);
+	}
+}
+
+static void data_poll(fuse_req_t req,STREAM *s,struct fuse_pollhandle *ph)
+{
+	REGISTRY *r=&s->dev->reg[s->type];
+	int revents;
+
+	if(ph)
+	{
+		pthread_mutex_lock(&r->mtx);
+		if(s->ph)fuse_pollhandle_destroy(s->ph);
+		s->ph=ph;
+		pthread_mutex_unlock(&r->mtx);
+	}
+
+	revents=be_poll(s,POLLIN);
+	fuse_reply_poll(req,revents);
+	if(revents)dvbcuse_notify(s);
+}
 
 static const struct fuse_opt dvbtvd_opts[]=
 {
@@ -63,55 +904,54 @@ static int dvbtvd_args(void *data,const char *arg,int key,
 
 static void net_post(void *userdata)
 {
-	DATA *dev=(DATA *)userdata;
+	NODE *node=(NODE *)userdata;
+	DATA *dev=node->dev;
 	char devpath[PATH_MAX];
 
-	sprintf(devpath,"/dev/dvb/adapter%d/net0",dev->conf.adapter);
+	sprintf(devpath,"/dev/dvb/adapter%d/net%d",dev->conf.adapter,
+		node->unit);
 	chown(devpath,dev->conf.owner,dev->conf.group);
 	chmod(devpath,dev->conf.perms);
 }
 
 static void net_open(fuse_req_t req,struct fuse_file_info *fi)
 {
-	DATA *dev=fuse_req_userdata(req);
+	NODE *node=fuse_req_userdata(req);
+	DATA *dev;
 	STREAM *s;
 
-	if(!dev)
+	if(!node)
 	{
 		fuse_reply_err(req,EINVAL);
 		return;
 	}
 
-	if(!dev->conf.net_open)
+	dev=node->dev;
+
+	if(!dev->conf.h.open&&!dev->conf.net_open)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
 	}
 
-	if(!(s=malloc(sizeof(STREAM))))
+	if(!(s=stream_new(dev,DEV_NET)))
 	{
 		fuse_reply_err(req,EMFILE);
 		return;
 	}
 
-	memset(s,0,sizeof(STREAM));
 	s->flags=fi->flags;
 	s->dev=dev;
+	s->unit=node->unit;
 
-	if((s->fd=dev->conf.net_open(dev->conf.user,dev->conf.net_pathname,
-		fi->flags))==-1)
+	if(be_open(s,dev->conf.net_pathname,fi->flags))
 	{
 		fuse_reply_err(req,errno);
-		free(s);
+		stream_free(s);
 		return;
 	}
 
-	pthread_mutex_lock(&dev->mtx);
-
-	s->next=dev->s;
-	dev->s=s;
-
-	pthread_mutex_unlock(&dev->mtx);
+	stream_link(s);
 
 	fi->direct_io=1;
 	fi->keep_cache=0;
@@ -148,26 +988,15 @@ static void net_release(fuse_req_t req,struct fuse_file_info *fi)
 {
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
-	STREAM **e;
 
-	if(!dev->conf.net_close)
+	if(!dev->conf.h.open&&!dev->conf.net_close)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
 	}
 
-	dev->conf.net_close(dev->conf.user,s->fd);
-
-	pthread_mutex_lock(&dev->mtx);
-
-	for(e=&dev->s;*e;e=&(*e)->next)if(*e==s)
-	{
-		*e=s->next;
-		free(s);
-		break;
-	}
-
-	pthread_mutex_unlock(&dev->mtx);
+	stream_unlink(s);
+	stream_put(s);
 
 	fuse_reply_err(req,0);
 }
@@ -183,14 +1012,10 @@ static void net_ioctl(fuse_req_t req,int cmd,void *arg,
 {
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
-	struct iovec iov;
-	union
-	{
-		struct dvb_net_if *in;
-		struct dvb_net_if out;
-	}u;
+	struct iovec iov[2];
+	struct dvb_net_if u;
 
-	if(!dev->conf.net_ioctl)
+	if(!dev->conf.h.open&&!dev->conf.net_ioctl)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
@@ -200,40 +1025,26 @@ static void net_ioctl(fuse_req_t req,int cmd,void *arg,
 	else switch(cmd)
 	{
 	case NET_REMOVE_IF:
-		if(dev->conf.net_ioctl(dev->conf.user,s->fd,cmd,NULL)==-1)
+		if(be_ioctl(s,cmd,arg)==-1)
 			fuse_reply_err(req,errno);
 		else fuse_reply_ioctl(req,0,NULL,0);
 		break;
 
 	case NET_ADD_IF:
-		if(!in_bufsz)
-		{
-			iov.iov_base=arg;
-			iov.iov_len=sizeof(struct dvb_net_if);
-			fuse_reply_ioctl_retry(req,&iov,1,NULL,0);
-		}
-		else
-		{
-			u.in=(struct dvb_net_if *)in_buf;
-			if(dev->conf.net_ioctl(dev->conf.user,s->fd,cmd,u.in)
-				==-1)fuse_reply_err(req,errno);
-			else fuse_reply_ioctl(req,0,NULL,0);
-		}
-		break;
-
 	case NET_GET_IF:
-		if(!out_bufsz)
+		if(!in_bufsz||!out_bufsz)
 		{
-			iov.iov_base=arg;
-			iov.iov_len=sizeof(struct dvb_net_if);
-			fuse_reply_ioctl_retry(req,NULL,0,&iov,1);
+			iov[0].iov_base=arg;
+			iov[0].iov_len=sizeof(struct dvb_net_if);
+			iov[1]=iov[0];
+			fuse_reply_ioctl_retry(req,&iov[0],1,&iov[1],1);
 		}
 		else
 		{
-			if(dev->conf.net_ioctl(dev->conf.user,s->fd,cmd,&u.out)
-				==-1)fuse_reply_err(req,errno);
-			else fuse_reply_ioctl(req,0,&u.out,
-				sizeof(struct dvb_net_if));
+			memcpy(&u,in_buf,sizeof(struct dvb_net_if));
+			if(be_ioctl(s,cmd,&u)==-1)
+				fuse_reply_err(req,errno);
+			else fuse_reply_ioctl(req,0,&u,sizeof(struct dvb_net_if));
 		}
 		break;
 
@@ -265,7 +1076,8 @@ static const struct cuse_lowlevel_ops net_ops=
 static void *networker(void *data)
 {
 	struct cuse_info ci;
-	DATA *dev=(DATA *)data;
+	NODE *node=(NODE *)data;
+	DATA *dev=node->dev;
 	char devpath[PATH_MAX+9];
 	const char *devarg[1]={devpath};
 	int dummy_argc=1;
@@ -275,19 +1087,21 @@ static void *networker(void *data)
 
 	sigfillset(&set);
 	pthread_sigmask(SIG_BLOCK,&set,NULL);
+	enroll(node);
 
 	if(fuse_opt_parse(&args,NULL,dvbtvd_opts,dvbtvd_args))goto out;
 	if(fuse_opt_add_arg(&args, "-f"))goto out;
 
-	sprintf(devpath,"DEVNAME=dvb/adapter%d/net0",dev->conf.adapter);
+	sprintf(devpath,"DEVNAME=dvb/adapter%d/net%d",dev->conf.adapter,
+		node->unit);
 	memset(&ci,0,sizeof(ci));
 	ci.dev_major=dev->conf.major;
-	ci.dev_minor=dev->conf.minbase+4;
+	ci.dev_minor=dev->conf.minbase+node->unit*8+4;
 	ci.dev_info_argc=1;
 	ci.dev_info_argv=devarg;
 	ci.flags=CUSE_UNRESTRICTED_IOCTL;
 
-	cuse_lowlevel_main(args.argc,args.argv,&ci,&net_ops,data);
+	cuse_lowlevel_main(args.argc,args.argv,&ci,&traced[DEV_NET],data);
 
 out:	fuse_opt_free_args(&args);
 
@@ -296,55 +1110,54 @@ out:	fuse_opt_free_args(&args);
 
 static void ca_post(void *userdata)
 {
-	DATA *dev=(DATA *)userdata;
+	NODE *node=(NODE *)userdata;
+	DATA *dev=node->dev;
 	char devpath[PATH_MAX];
 
-	sprintf(devpath,"/dev/dvb/adapter%d/ca0",dev->conf.adapter);
+	sprintf(devpath,"/dev/dvb/adapter%d/ca%d",dev->conf.adapter,
+		node->unit);
 	chown(devpath,dev->conf.owner,dev->conf.group);
 	chmod(devpath,dev->conf.perms);
 }
 
 static void ca_open(fuse_req_t req,struct fuse_file_info *fi)
 {
-	DATA *dev=fuse_req_userdata(req);
+	NODE *node=fuse_req_userdata(req);
+	DATA *dev;
 	STREAM *s;
 
-	if(!dev)
+	if(!node)
 	{
 		fuse_reply_err(req,EINVAL);
 		return;
 	}
 
-	if(!dev->conf.ca_open)
+	dev=node->dev;
+
+	if(!dev->conf.h.open&&!dev->conf.ca_open)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
 	}
 
-	if(!(s=malloc(sizeof(STREAM))))
+	if(!(s=stream_new(dev,DEV_CA)))
 	{
 		fuse_reply_err(req,EMFILE);
 		return;
 	}
 
-	memset(s,0,sizeof(STREAM));
 	s->flags=fi->flags;
 	s->dev=dev;
+	s->unit=node->unit;
 
-	if((s->fd=dev->conf.ca_open(dev->conf.user,dev->conf.ca_pathname,
-		fi->flags))==-1)
+	if(be_open(s,dev->conf.ca_pathname,fi->flags))
 	{
 		fuse_reply_err(req,errno);
-		free(s);
+		stream_free(s);
 		return;
 	}
 
-	pthread_mutex_lock(&dev->mtx);
-
-	s->next=dev->s;
-	dev->s=s;
-
-	pthread_mutex_unlock(&dev->mtx);
+	stream_link(s);
 
 	fi->direct_io=1;
 	fi->keep_cache=0;
@@ -359,8 +1172,7 @@ static void ca_read(fuse_req_t req,size_t size,off_t off,
 {
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
-	ssize_t len;
-	char bfr[131072];
+	DVBCUSE_REQ *r;
 
 	if((s->flags&O_ACCMODE)==O_WRONLY)
 	{
@@ -368,20 +1180,14 @@ static void ca_read(fuse_req_t req,size_t size,off_t off,
 		return;
 	}
 
-	if(!dev->conf.ca_read)
+	if(dev->conf.h.open?!dev->conf.h.read:
+		!dev->conf.ca_read&&!dev->conf.v2.ca_read)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
 	}
 
-	if((len=dev->conf.ca_read(dev->conf.user,s->fd,bfr,
-		size>sizeof(bfr)?sizeof(bfr):size))==-1)
-	{
-		fuse_reply_err(req,errno);
-		return;
-	}
-
-	fuse_reply_buf(req,bfr,len);
+	if((r=request(req,s,OP_READ,size>RDSIZE?RDSIZE:size)))submit(r);
 }
 
 static void ca_write(fuse_req_t req,const char *buf,size_t size,off_t off,
@@ -389,7 +1195,7 @@ static void ca_write(fuse_req_t req,const char *buf,size_t size,off_t off,
 {
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
-	ssize_t len;
+	DVBCUSE_REQ *r;
 
 	if((s->flags&O_ACCMODE)==O_RDONLY)
 	{
@@ -397,19 +1203,16 @@ static void ca_write(fuse_req_t req,const char *buf,size_t size,off_t off,
 		return;
 	}
 
-	if(!dev->conf.ca_write)
+	if(dev->conf.h.open?!dev->conf.h.write:
+		!dev->conf.ca_write&&!dev->conf.v2.ca_write)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
 	}
 
-	if((len=dev->conf.ca_write(dev->conf.user,s->fd,buf,size))==-1)
-	{
-		fuse_reply_err(req,errno);
-		return;
-	}
-
-	fuse_reply_write(req,len);
+	if(!(r=request(req,s,OP_WRITE,size)))return;
+	memcpy(r->data,buf,size);
+	submit(r);
 }
 
 static void ca_flush(fuse_req_t req,struct fuse_file_info *fi)
@@ -421,26 +1224,15 @@ static void ca_release(fuse_req_t req,struct fuse_file_info *fi)
 {
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
-	STREAM **e;
 
-	if(!dev->conf.ca_close)
+	if(!dev->conf.h.open&&!dev->conf.ca_close)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
 	}
 
-	dev->conf.ca_close(dev->conf.user,s->fd);
-
-	pthread_mutex_lock(&dev->mtx);
-
-	for(e=&dev->s;*e;e=&(*e)->next)if(*e==s)
-	{
-		*e=s->next;
-		free(s);
-		break;
-	}
-
-	pthread_mutex_unlock(&dev->mtx);
+	stream_unlink(s);
+	stream_put(s);
 
 	fuse_reply_err(req,0);
 }
@@ -457,18 +1249,9 @@ static void ca_ioctl(fuse_req_t req,int cmd,void *arg,
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
 	struct iovec iov;
-	union
-	{
-		ca_caps_t caps;
-		ca_slot_info_t sinfo;
-		ca_descr_info_t dinfo;
-		ca_msg_t mout;
-		ca_msg_t *min;
-		ca_descr_t *desc;
-		ca_pid_t *pid;
-	}u;
 
-	if(!dev->conf.ca_ioctl)
+	if(!dev->conf.h.open&&!dev->conf.ca_ioctl&&
+		!dev->conf.v2.ca_ioctl)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
@@ -478,121 +1261,47 @@ static void ca_ioctl(fuse_req_t req,int cmd,void *arg,
 	else switch(cmd)
 	{
 	case CA_RESET:
-		if(dev->conf.ca_ioctl(dev->conf.user,s->fd,cmd,NULL)==-1)
-			fuse_reply_err(req,errno);
-		else fuse_reply_ioctl(req,0,NULL,0);
+		submit_ioctl(req,s,cmd,NULL,NULL,0,0,NULL);
 		break;
 
 	case CA_GET_CAP:
-		if(!out_bufsz)
-		{
-			iov.iov_base=arg;
-			iov.iov_len=sizeof(ca_caps_t);
-			fuse_reply_ioctl_retry(req,NULL,0,&iov,1);
-		}
-		else
-		{
-			if(dev->conf.ca_ioctl(dev->conf.user,s->fd,cmd,&u.caps)
-				==-1)fuse_reply_err(req,errno);
-			else fuse_reply_ioctl(req,0,&u.caps,
-				sizeof(ca_caps_t));
-		}
-		break;
+		iov.iov_len=sizeof(ca_caps_t);
+		goto out;
 
 	case CA_GET_SLOT_INFO:
-		if(!out_bufsz)
-		{
-			iov.iov_base=arg;
-			iov.iov_len=sizeof(ca_slot_info_t);
-			fuse_reply_ioctl_retry(req,NULL,0,&iov,1);
-		}
-		else
-		{
-			if(dev->conf.ca_ioctl(dev->conf.user,s->fd,cmd,&u.sinfo)
-				==-1)fuse_reply_err(req,errno);
-			else fuse_reply_ioctl(req,0,&u.sinfo,
-				sizeof(ca_slot_info_t));
-		}
-		break;
+		iov.iov_len=sizeof(ca_slot_info_t);
+		goto out;
 
 	case CA_GET_DESCR_INFO:
-		if(!out_bufsz)
-		{
-			iov.iov_base=arg;
-			iov.iov_len=sizeof(ca_descr_info_t);
-			fuse_reply_ioctl_retry(req,NULL,0,&iov,1);
-		}
-		else
-		{
-			if(dev->conf.ca_ioctl(dev->conf.user,s->fd,cmd,&u.dinfo)
-				==-1)fuse_reply_err(req,errno);
-			else fuse_reply_ioctl(req,0,&u.dinfo,
-				sizeof(ca_descr_info_t));
-		}
-		break;
+		iov.iov_len=sizeof(ca_descr_info_t);
+		goto out;
 
 	case CA_GET_MSG:
-		if(!out_bufsz)
+		iov.iov_len=sizeof(ca_msg_t);
+out:		if(!out_bufsz)
 		{
 			iov.iov_base=arg;
-			iov.iov_len=sizeof(ca_msg_t);
 			fuse_reply_ioctl_retry(req,NULL,0,&iov,1);
 		}
-		else
-		{
-			if(dev->conf.ca_ioctl(dev->conf.user,s->fd,cmd,&u.mout)
-				==-1)fuse_reply_err(req,errno);
-			else fuse_reply_ioctl(req,0,&u.mout,
-				sizeof(ca_msg_t));
-		}
+		else submit_ioctl(req,s,cmd,NULL,NULL,0,iov.iov_len,NULL);
 		break;
 
 	case CA_SEND_MSG:
-		if(!in_bufsz)
-		{
-			iov.iov_base=arg;
-			iov.iov_len=sizeof(ca_msg_t);
-			fuse_reply_ioctl_retry(req,&iov,1,NULL,0);
-		}
-		else
-		{
-			u.min=(ca_msg_t *)in_buf;
-			if(dev->conf.ca_ioctl(dev->conf.user,s->fd,cmd,u.min)
-				==-1)fuse_reply_err(req,errno);
-			else fuse_reply_ioctl(req,0,NULL,0);
-		}
-		break;
+		iov.iov_len=sizeof(ca_msg_t);
+		goto in;
 
 	case CA_SET_DESCR:
-		if(!in_bufsz)
-		{
-			iov.iov_base=arg;
-			iov.iov_len=sizeof(ca_descr_t);
-			fuse_reply_ioctl_retry(req,&iov,1,NULL,0);
-		}
-		else
-		{
-			u.desc=(ca_descr_t *)in_buf;
-			if(dev->conf.ca_ioctl(dev->conf.user,s->fd,cmd,u.desc)
-				==-1)fuse_reply_err(req,errno);
-			else fuse_reply_ioctl(req,0,NULL,0);
-		}
-		break;
+		iov.iov_len=sizeof(ca_descr_t);
+		goto in;
 
 	case CA_SET_PID:
-		if(!in_bufsz)
+		iov.iov_len=sizeof(ca_pid_t);
+in:		if(!in_bufsz)
 		{
 			iov.iov_base=arg;
-			iov.iov_len=sizeof(ca_pid_t);
 			fuse_reply_ioctl_retry(req,&iov,1,NULL,0);
 		}
-		else
-		{
-			u.pid=(ca_pid_t *)in_buf;
-			if(dev->conf.ca_ioctl(dev->conf.user,s->fd,cmd,u.pid)
-				==-1)fuse_reply_err(req,errno);
-			else fuse_reply_ioctl(req,0,NULL,0);
-		}
+		else submit_ioctl(req,s,cmd,NULL,in_buf,iov.iov_len,0,NULL);
 		break;
 
 	default:
@@ -606,22 +1315,15 @@ static void ca_poll(fuse_req_t req,struct fuse_file_info *fi,
 {
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
-	struct pollfd p;
 
-	if(!dev->conf.ca_poll)
+	if(!dev->conf.h.open&&!dev->conf.ca_poll)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
+		if(ph)fuse_pollhandle_destroy(ph);
 		return;
 	}
 
-	p.fd=s->fd;
-	p.events=POLLIN;
-	p.revents=0;
-
-	dev->conf.ca_poll(dev->conf.user,&p);
-
-	fuse_reply_poll(req,p.revents);
-	if(p.revents&&ph)fuse_lowlevel_notify_poll(ph);
+	data_poll(req,s,ph);
 }
 
 static const struct cuse_lowlevel_ops ca_ops=
@@ -640,7 +1342,8 @@ static const struct cuse_lowlevel_ops ca_ops=
 static void *caworker(void *data)
 {
 	struct cuse_info ci;
-	DATA *dev=(DATA *)data;
+	NODE *node=(NODE *)data;
+	DATA *dev=node->dev;
 	char devpath[PATH_MAX+9];
 	const char *devarg[1]={devpath};
 	int dummy_argc=1;
@@ -650,76 +1353,198 @@ static void *caworker(void *data)
 
 	sigfillset(&set);
 	pthread_sigmask(SIG_BLOCK,&set,NULL);
+	enroll(node);
 
 	if(fuse_opt_parse(&args,NULL,dvbtvd_opts,dvbtvd_args))goto out;
 	if(fuse_opt_add_arg(&args, "-f"))goto out;
 
-	sprintf(devpath,"DEVNAME=dvb/adapter%d/ca0",dev->conf.adapter);
+	sprintf(devpath,"DEVNAME=dvb/adapter%d/ca%d",dev->conf.adapter,
+		node->unit);
 	memset(&ci,0,sizeof(ci));
 	ci.dev_major=dev->conf.major;
-	ci.dev_minor=dev->conf.minbase+3;
+	ci.dev_minor=dev->conf.minbase+node->unit*8+3;
 	ci.dev_info_argc=1;
 	ci.dev_info_argv=devarg;
 	ci.flags=CUSE_UNRESTRICTED_IOCTL;
 
-	cuse_lowlevel_main(args.argc,args.argv,&ci,&ca_ops,data);
+	cuse_lowlevel_main(args.argc,args.argv,&ci,&traced[DEV_CA],data);
 
 out:	fuse_opt_free_args(&args);
 
 	pthread_exit(NULL);
 }
 
+static unsigned char *resync(unsigned char *p,unsigned char *e)
+{
+	for(;(p=memchr(p,TS_SYNC,e-p));p++)
+		if(p+TS_SIZE>=e||p[TS_SIZE]==TS_SYNC)return p;
+	return e;
+}
+
+static unsigned long long nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (unsigned long long)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static int stages_open(STREAM *s,DVBCUSE_STAGE *list,
+	size_t (*filter)(void *user,int fd,void *buf,size_t count))
+{
+	DVBCUSE_STAGE *t;
+	int n;
+	int i;
+
+	s->filter=filter;
+	s->stages=list;
+	for(n=0,t=list;t;t=t->next)n++;
+	if(!n)return 0;
+
+	if(!(s->sst=malloc(n*sizeof(void *))))return -1;
+
+	for(n=0,t=list;t;t=t->next,n++)
+		if(!t->open)s->sst[n]=NULL;
+		else if(!(s->sst[n]=t->open(t->priv,s)))
+	{
+		for(i=0,t=list;i<n;i++,t=t->next)
+			if(t->close)t->close(t->priv,s->sst[i]);
+		free(s->sst);
+		s->sst=NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void stages_close(STREAM *s)
+{
+	DVBCUSE_STAGE *t;
+	int n;
+
+	if(!s->sst)return;
+	for(n=0,t=s->stages;t;t=t->next,n++)if(t->close)
+		t->close(t->priv,s->sst[n]);
+	free(s->sst);
+	s->sst=NULL;
+}
+
+static size_t stages_run(STREAM *s,unsigned char *bfr,size_t len)
+{
+	DVBCUSE_STAGE *t;
+	unsigned long long start;
+	size_t out;
+	int n;
+
+	for(n=0,t=s->stages;t&&len;t=t->next,n++)
+	{
+		start=nsecs();
+		out=t->process(t->priv,s->sst[n],bfr,len);
+		__atomic_add_fetch(&t->nsecs,nsecs()-start,__ATOMIC_RELAXED);
+		__atomic_add_fetch(&t->calls,1,__ATOMIC_RELAXED);
+		__atomic_add_fetch(&t->pkts_in,len/TS_SIZE,__ATOMIC_RELAXED);
+		__atomic_add_fetch(&t->pkts_out,out/TS_SIZE,__ATOMIC_RELAXED);
+		len=out;
+	}
+
+	return len;
+}
+
+static size_t aligned(STREAM *s,unsigned char *bfr,size_t len)
+{
+	unsigned char *p;
+	unsigned char *q;
+	unsigned char *e;
+
+	for(p=q=bfr,e=bfr+len;e-p>=TS_SIZE;)
+	{
+		if(*p!=TS_SYNC)
+		{
+			p=resync(p,e);
+			continue;
+		}
+		if(q!=p)memmove(q,p,TS_SIZE);
+		p+=TS_SIZE;
+		q+=TS_SIZE;
+	}
+
+	if(p<e&&*p!=TS_SYNC)p=resync(p,e);
+	memcpy(s->tail,p,e-p);
+	s->fill=e-p;
+
+	if((len=q-bfr)&&s->sst)len=stages_run(s,bfr,len);
+	if(len&&s->filter)len=s->filter(s->dev->conf.user,s->fd,bfr,len);
+
+	return len;
+}
+
 static void dvr_post(void *userdata)
 {
-	DATA *dev=(DATA *)userdata;
+	NODE *node=(NODE *)userdata;
+	DATA *dev=node->dev;
 	char devpath[PATH_MAX];
 
-	sprintf(devpath,"/dev/dvb/adapter%d/dvr0",dev->conf.adapter);
+	sprintf(devpath,"/dev/dvb/adapter%d/dvr%d",dev->conf.adapter,
+		node->unit);
 	chown(devpath,dev->conf.owner,dev->conf.group);
 	chmod(devpath,dev->conf.perms);
 }
 
 static void dvr_open(fuse_req_t req,struct fuse_file_info *fi)
 {
-	DATA *dev=fuse_req_userdata(req);
+	NODE *node=fuse_req_userdata(req);
+	DATA *dev;
 	STREAM *s;
 
-	if(!dev)
+	if(!node)
 	{
 		fuse_reply_err(req,EINVAL);
 		return;
 	}
 
-	if(!dev->conf.dvr_open)
+	dev=node->dev;
+
+	if(!dev->conf.h.open&&!dev->conf.dvr_open)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
 	}
 
-	if(!(s=malloc(sizeof(STREAM))))
+	if(!(s=stream_new(dev,DEV_DVR)))
 	{
 		fuse_reply_err(req,EMFILE);
 		return;
 	}
 
-	memset(s,0,sizeof(STREAM));
 	s->flags=fi->flags;
 	s->dev=dev;
+	s->unit=node->unit;
 
-	if((s->fd=dev->conf.dvr_open(dev->conf.user,dev->conf.dvr_pathname,
-		fi->flags))==-1)
+	if(pthread_mutex_init(&s->mtx,NULL))
 	{
-		fuse_reply_err(req,errno);
-		free(s);
+		fuse_reply_err(req,EMFILE);
+		stream_free(s);
 		return;
 	}
 
-	pthread_mutex_lock(&dev->mtx);
+	if(be_open(s,dev->conf.dvr_pathname,fi->flags))
+	{
+		fuse_reply_err(req,errno);
+		pthread_mutex_destroy(&s->mtx);
+		stream_free(s);
+		return;
+	}
 
-	s->next=dev->s;
-	dev->s=s;
+	if(stages_open(s,dev->conf.dvr_stages,dev->conf.dvr_filter))
+	{
+		be_close(s);
+		fuse_reply_err(req,EMFILE);
+		pthread_mutex_destroy(&s->mtx);
+		stream_free(s);
+		return;
+	}
 
-	pthread_mutex_unlock(&dev->mtx);
+	stream_link(s);
 
 	fi->direct_io=1;
 	fi->keep_cache=0;
@@ -734,8 +1559,8 @@ static void dvr_read(fuse_req_t req,size_t size,off_t off,
 {
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
-	ssize_t len;
-	char bfr[131072];
+	DVBCUSE_REQ *r;
+	int align;
 
 	if((s->flags&O_ACCMODE)==O_WRONLY)
 	{
@@ -743,20 +1568,32 @@ static void dvr_read(fuse_req_t req,size_t size,off_t off,
 		return;
 	}
 
-	if(!dev->conf.dvr_read)
+	if(dev->conf.h.open?!dev->conf.h.read&&!dev->conf.h.readv:
+		!dev->conf.dvr_read&&!dev->conf.v2.dvr_read&&
+		!dev->conf.v2.dvr_readv)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
 	}
 
-	if((len=dev->conf.dvr_read(dev->conf.user,s->fd,bfr,
-		size>sizeof(bfr)?sizeof(bfr):size))==-1)
+	if(size>RDSIZE)size=RDSIZE;
+	if((align=dev->conf.dvr_aligned||s->sst||s->filter)&&
+		(size-=size%TS_SIZE)<TS_SIZE)
 	{
-		fuse_reply_err(req,errno);
+		fuse_reply_err(req,EINVAL);
+		return;
+	}
+
+	if(!align&&(dev->conf.h.open?dev->conf.h.readv!=NULL:
+		dev->conf.v2.dvr_readv!=NULL))
+	{
+		if((r=vrequest(req,s,size)))submit(r);
 		return;
 	}
 
-	fuse_reply_buf(req,bfr,len);
+	if(!(r=request(req,s,OP_READ,size)))return;
+	r->aligned=align;
+	submit(r);
 }
 
 static void dvr_write(fuse_req_t req,const char *buf,size_t size,off_t off,
@@ -764,7 +1601,7 @@ static void dvr_write(fuse_req_t req,const char *buf,size_t size,off_t off,
 {
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
-	ssize_t len;
+	DVBCUSE_REQ *r;
 
 	if((s->flags&O_ACCMODE)==O_RDONLY)
 	{
@@ -772,19 +1609,16 @@ static void dvr_write(fuse_req_t req,const char *buf,size_t size,off_t off,
 		return;
 	}
 
-	if(!dev->conf.dvr_write)
+	if(dev->conf.h.open?!dev->conf.h.write:
+		!dev->conf.dvr_write&&!dev->conf.v2.dvr_write)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
 	}
 
-	if((len=dev->conf.dvr_write(dev->conf.user,s->fd,buf,size))==-1)
-	{
-		fuse_reply_err(req,errno);
-		return;
-	}
-
-	fuse_reply_write(req,len);
+	if(!(r=request(req,s,OP_WRITE,size)))return;
+	memcpy(r->data,buf,size);
+	submit(r);
 }
 
 static void dvr_flush(fuse_req_t req,struct fuse_file_info *fi)
@@ -796,26 +1630,15 @@ static void dvr_release(fuse_req_t req,struct fuse_file_info *fi)
 {
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
-	STREAM **e;
 
-	if(!dev->conf.dvr_close)
+	if(!dev->conf.h.open&&!dev->conf.dvr_close)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
 	}
 
-	dev->conf.dvr_close(dev->conf.user,s->fd);
-
-	pthread_mutex_lock(&dev->mtx);
-
-	for(e=&dev->s;*e;e=&(*e)->next)if(*e==s)
-	{
-		*e=s->next;
-		free(s);
-		break;
-	}
-
-	pthread_mutex_unlock(&dev->mtx);
+	stream_unlink(s);
+	stream_put(s);
 
 	fuse_reply_err(req,0);
 }
@@ -832,7 +1655,8 @@ static void dvr_ioctl(fuse_req_t req,int cmd,void *arg,
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
 
-	if(!dev->conf.dvr_ioctl)
+	if(!dev->conf.h.open&&!dev->conf.dvr_ioctl&&
+		!dev->conf.v2.dvr_ioctl)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
@@ -842,9 +1666,7 @@ static void dvr_ioctl(fuse_req_t req,int cmd,void *arg,
 	else switch(cmd)
 	{
 	case DMX_SET_BUFFER_SIZE:
-		if(dev->conf.dvr_ioctl(dev->conf.user,s->fd,cmd,arg)==-1)
-			fuse_reply_err(req,errno);
-		else fuse_reply_ioctl(req,0,NULL,0);
+		submit_ioctl(req,s,cmd,arg,NULL,0,0,NULL);
 		break;
 
 	default:
@@ -858,22 +1680,15 @@ static void dvr_poll(fuse_req_t req,struct fuse_file_info *fi,
 {
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
-	struct pollfd p;
 
-	if(!dev->conf.dvr_poll)
+	if(!dev->conf.h.open&&!dev->conf.dvr_poll)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
+		if(ph)fuse_pollhandle_destroy(ph);
 		return;
 	}
 
-	p.fd=s->fd;
-	p.events=POLLIN;
-	p.revents=0;
-
-	dev->conf.dvr_poll(dev->conf.user,&p);
-
-	fuse_reply_poll(req,p.revents);
-	if(p.revents&&ph)fuse_lowlevel_notify_poll(ph);
+	data_poll(req,s,ph);
 }
 
 static const struct cuse_lowlevel_ops dvr_ops=
@@ -892,7 +1707,8 @@ static const struct cuse_lowlevel_ops dvr_ops=
 static void *dvrworker(void *data)
 {
 	struct cuse_info ci;
-	DATA *dev=(DATA *)data;
+	NODE *node=(NODE *)data;
+	DATA *dev=node->dev;
 	char devpath[PATH_MAX+9];
 	const char *devarg[1]={devpath};
 	int dummy_argc=1;
@@ -902,19 +1718,21 @@ static void *dvrworker(void *data)
 
 	sigfillset(&set);
 	pthread_sigmask(SIG_BLOCK,&set,NULL);
+	enroll(node);
 
 	if(fuse_opt_parse(&args,NULL,dvbtvd_opts,dvbtvd_args))goto out;
 	if(fuse_opt_add_arg(&args, "-f"))goto out;
 
-	sprintf(devpath,"DEVNAME=dvb/adapter%d/dvr0",dev->conf.adapter);
+	sprintf(devpath,"DEVNAME=dvb/adapter%d/dvr%d",dev->conf.adapter,
+		node->unit);
 	memset(&ci,0,sizeof(ci));
 	ci.dev_major=dev->conf.major;
-	ci.dev_minor=dev->conf.minbase+2;
+	ci.dev_minor=dev->conf.minbase+node->unit*8+2;
 	ci.dev_info_argc=1;
 	ci.dev_info_argv=devarg;
 	ci.flags=CUSE_UNRESTRICTED_IOCTL;
 
-	cuse_lowlevel_main(args.argc,args.argv,&ci,&dvr_ops,data);
+	cuse_lowlevel_main(args.argc,args.argv,&ci,&traced[DEV_DVR],data);
 
 out:	fuse_opt_free_args(&args);
 
@@ -923,55 +1741,71 @@ out:	fuse_opt_free_args(&args);
 
 static void dmx_post(void *userdata)
 {
-	DATA *dev=(DATA *)userdata;
+	NODE *node=(NODE *)userdata;
+	DATA *dev=node->dev;
 	char devpath[PATH_MAX];
 
-	sprintf(devpath,"/dev/dvb/adapter%d/demux0",dev->conf.adapter);
+	sprintf(devpath,"/dev/dvb/adapter%d/demux%d",dev->conf.adapter,
+		node->unit);
 	chown(devpath,dev->conf.owner,dev->conf.group);
 	chmod(devpath,dev->conf.perms);
 }
 
 static void dmx_open(fuse_req_t req,struct fuse_file_info *fi)
 {
-	DATA *dev=fuse_req_userdata(req);
+	NODE *node=fuse_req_userdata(req);
+	DATA *dev;
 	STREAM *s;
 
-	if(!dev)
+	if(!node)
 	{
 		fuse_reply_err(req,EINVAL);
 		return;
 	}
 
-	if(!dev->conf.dmx_open)
+	dev=node->dev;
+
+	if(!dev->conf.h.open&&!dev->conf.dmx_open)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
 	}
 
-	if(!(s=malloc(sizeof(STREAM))))
+	if(!(s=stream_new(dev,DEV_DMX)))
 	{
 		fuse_reply_err(req,EMFILE);
 		return;
 	}
 
-	memset(s,0,sizeof(STREAM));
 	s->flags=fi->flags;
 	s->dev=dev;
+	s->unit=node->unit;
 
-	if((s->fd=dev->conf.dmx_open(dev->conf.user,dev->conf.dmx_pathname,
-		fi->flags))==-1)
+	if(pthread_mutex_init(&s->mtx,NULL))
 	{
-		fuse_reply_err(req,errno);
-		free(s);
+		fuse_reply_err(req,EMFILE);
+		stream_free(s);
 		return;
 	}
 
-	pthread_mutex_lock(&dev->mtx);
+	if(be_open(s,dev->conf.dmx_pathname,fi->flags))
+	{
+		fuse_reply_err(req,errno);
+		pthread_mutex_destroy(&s->mtx);
+		stream_free(s);
+		return;
+	}
 
-	s->next=dev->s;
-	dev->s=s;
+	if(stages_open(s,dev->conf.dmx_stages,dev->conf.dmx_filter))
+	{
+		be_close(s);
+		fuse_reply_err(req,EMFILE);
+		pthread_mutex_destroy(&s->mtx);
+		stream_free(s);
+		return;
+	}
 
-	pthread_mutex_unlock(&dev->mtx);
+	stream_link(s);
 
 	fi->direct_io=1;
 	fi->keep_cache=0;
@@ -986,8 +1820,8 @@ static void dmx_read(fuse_req_t req,size_t size,off_t off,
 {
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
-	ssize_t len;
-	char bfr[131072];
+	DVBCUSE_REQ *r;
+	int align;
 
 	if((s->flags&O_ACCMODE)==O_WRONLY)
 	{
@@ -995,20 +1829,32 @@ static void dmx_read(fuse_req_t req,size_t size,off_t off,
 		return;
 	}
 
-	if(!dev->conf.dmx_read)
+	if(dev->conf.h.open?!dev->conf.h.read&&!dev->conf.h.readv:
+		!dev->conf.dmx_read&&!dev->conf.v2.dmx_read&&
+		!dev->conf.v2.dmx_readv)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
 	}
 
-	if((len=dev->conf.dmx_read(dev->conf.user,s->fd,bfr,
-		size>sizeof(bfr)?sizeof(bfr):size))==-1)
+	if(size>RDSIZE)size=RDSIZE;
+	if((align=(dev->conf.dmx_aligned||s->sst||s->filter)&&s->ts)&&
+		(size-=size%TS_SIZE)<TS_SIZE)
 	{
-		fuse_reply_err(req,errno);
+		fuse_reply_err(req,EINVAL);
+		return;
+	}
+
+	if(!align&&(dev->conf.h.open?dev->conf.h.readv!=NULL:
+		dev->conf.v2.dmx_readv!=NULL))
+	{
+		if((r=vrequest(req,s,size)))submit(r);
 		return;
 	}
 
-	fuse_reply_buf(req,bfr,len);
+	if(!(r=request(req,s,OP_READ,size)))return;
+	r->aligned=align;
+	submit(r);
 }
 
 static void dmx_write(fuse_req_t req,const char *buf,size_t size,off_t off,
@@ -1028,27 +1874,16 @@ static void dmx_flush(fuse_req_t req,struct fuse_file_info *fi)
 static void dmx_release(fuse_req_t req,struct fuse_file_info *fi)
 {
 	STREAM *s=(STREAM *)fi->fh;
-	DATA *dev=s->dev;
-	STREAM **e;
-
-	if(!dev->conf.dmx_close)
-	{
-		fuse_reply_err(req,EOPNOTSUPP);
-		return;
-	}
-
-	dev->conf.dmx_close(dev->conf.user,s->fd);
-
-	pthread_mutex_lock(&dev->mtx);
+	DATA *dev=s->dev;
 
-	for(e=&dev->s;*e;e=&(*e)->next)if(*e==s)
+	if(!dev->conf.h.open&&!dev->conf.dmx_close)
 	{
-		*e=s->next;
-		free(s);
-		break;
+		fuse_reply_err(req,EOPNOTSUPP);
+		return;
 	}
 
-	pthread_mutex_unlock(&dev->mtx);
+	stream_unlink(s);
+	stream_put(s);
 
 	fuse_reply_err(req,0);
 }
@@ -1058,6 +1893,24 @@ static void dmx_fsync(fuse_req_t req,int datasync,struct fuse_file_info *fi)
 	fuse_reply_err(req,EOPNOTSUPP);
 }
 
+static void sct_done(STREAM *s,void *arg)
+{
+	pthread_mutex_lock(&s->mtx);
+	s->ts=0;
+	s->fill=0;
+	pthread_mutex_unlock(&s->mtx);
+}
+
+static void pes_done(STREAM *s,void *arg)
+{
+	struct dmx_pes_filter_params *pesflt=arg;
+
+	pthread_mutex_lock(&s->mtx);
+	s->ts=pesflt->output==DMX_OUT_TSDEMUX_TAP;
+	s->fill=0;
+	pthread_mutex_unlock(&s->mtx);
+}
+
 static void dmx_ioctl(fuse_req_t req,int cmd,void *arg,
 	struct fuse_file_info *fi,unsigned flags,const void *in_buf,
 	size_t in_bufsz,size_t out_bufsz)
@@ -1065,16 +1918,10 @@ static void dmx_ioctl(fuse_req_t req,int cmd,void *arg,
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
 	struct iovec iov;
-	union
-	{
-		uint16_t *pid;
-		struct dmx_sct_filter_params *sctflt;
-		struct dmx_pes_filter_params *pesflt;
-		struct dmx_stc stc;
-		uint16_t pespid[5];
-	}u;
+	void (*done)(STREAM *s,void *arg)=NULL;
 
-	if(!dev->conf.dmx_ioctl)
+	if(!dev->conf.h.open&&!dev->conf.dmx_ioctl&&
+		!dev->conf.v2.dmx_ioctl)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
@@ -1085,95 +1932,46 @@ static void dmx_ioctl(fuse_req_t req,int cmd,void *arg,
 	{
 	case DMX_START:
 	case DMX_STOP:
-		if(dev->conf.dmx_ioctl(dev->conf.user,s->fd,cmd,NULL)==-1)
-			fuse_reply_err(req,errno);
-		else fuse_reply_ioctl(req,0,NULL,0);
+		submit_ioctl(req,s,cmd,NULL,NULL,0,0,NULL);
 		break;
 
 	case DMX_SET_BUFFER_SIZE:
-		if(dev->conf.dmx_ioctl(dev->conf.user,s->fd,cmd,arg)==-1)
-			fuse_reply_err(req,errno);
-		else fuse_reply_ioctl(req,0,NULL,0);
+		submit_ioctl(req,s,cmd,arg,NULL,0,0,NULL);
 		break;
 
 	case DMX_ADD_PID:
 	case DMX_REMOVE_PID:
-		if(!in_bufsz)
-		{
-			iov.iov_base=arg;
-			iov.iov_len=sizeof(uint16_t);
-			fuse_reply_ioctl_retry(req,&iov,1,NULL,0);
-		}
-		else
-		{
-			u.pid=(uint16_t *)in_buf;
-			if(dev->conf.dmx_ioctl(dev->conf.user,s->fd,cmd,u.pid)
-				==-1)fuse_reply_err(req,errno);
-			else fuse_reply_ioctl(req,0,NULL,0);
-		}
-		break;
+		iov.iov_len=sizeof(uint16_t);
+		goto in;
 
 	case DMX_SET_FILTER:
-		if(!in_bufsz)
-		{
-			iov.iov_base=arg;
-			iov.iov_len=sizeof(struct dmx_sct_filter_params);
-			fuse_reply_ioctl_retry(req,&iov,1,NULL,0);
-		}
-		else
-		{
-			u.sctflt=(struct dmx_sct_filter_params *)in_buf;
-			if(dev->conf.dmx_ioctl(dev->conf.user,s->fd,cmd,
-				u.sctflt)==-1)fuse_reply_err(req,errno);
-			else fuse_reply_ioctl(req,0,NULL,0);
-		}
-		break;
+		iov.iov_len=sizeof(struct dmx_sct_filter_params);
+		done=sct_done;
+		goto in;
 
 	case DMX_SET_PES_FILTER:
-		if(!in_bufsz)
+		iov.iov_len=sizeof(struct dmx_pes_filter_params);
+		done=pes_done;
+in:		if(!in_bufsz)
 		{
 			iov.iov_base=arg;
-			iov.iov_len=sizeof(struct dmx_pes_filter_params);
 			fuse_reply_ioctl_retry(req,&iov,1,NULL,0);
 		}
-		else
-		{
-			u.pesflt=(struct dmx_pes_filter_params *)in_buf;
-			if(dev->conf.dmx_ioctl(dev->conf.user,s->fd,cmd,
-				u.pesflt)==-1)fuse_reply_err(req,errno);
-			else fuse_reply_ioctl(req,0,NULL,0);
-		}
+		else submit_ioctl(req,s,cmd,NULL,in_buf,iov.iov_len,0,done);
 		break;
 
 	case DMX_GET_STC:
-		if(!out_bufsz)
-		{
-			iov.iov_base=arg;
-			iov.iov_len=sizeof(struct dmx_stc);
-			fuse_reply_ioctl_retry(req,NULL,0,&iov,1);
-		}
-		else
-		{
-			if(dev->conf.dmx_ioctl(dev->conf.user,s->fd,cmd,&u.stc)
-				==-1)fuse_reply_err(req,errno);
-			else fuse_reply_ioctl(req,0,&u.stc,
-				sizeof(struct dmx_stc));
-		}
-		break;
+		iov.iov_len=sizeof(struct dmx_stc);
+		goto out;
 
 	case DMX_GET_PES_PIDS:
-		if(!out_bufsz)
+		iov.iov_len=5*sizeof(uint16_t);
+out:		if(!out_bufsz)
 		{
 			iov.iov_base=arg;
-			iov.iov_len=sizeof(u.pespid);
 			fuse_reply_ioctl_retry(req,NULL,0,&iov,1);
 		}
-		else
-		{
-			if(dev->conf.dmx_ioctl(dev->conf.user,s->fd,cmd,
-				u.pespid)==-1)fuse_reply_err(req,errno);
-			else fuse_reply_ioctl(req,0,u.pespid,sizeof(u.pespid));
-		}
+		else submit_ioctl(req,s,cmd,NULL,NULL,0,iov.iov_len,NULL);
 		break;
 
 	default:
@@ -1187,22 +1985,15 @@ static void dmx_poll(fuse_req_t req,struct fuse_file_info *fi,
 {
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
-	struct pollfd p;
 
-	if(!dev->conf.dmx_poll)
+	if(!dev->conf.h.open&&!dev->conf.dmx_poll)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
+		if(ph)fuse_pollhandle_destroy(ph);
 		return;
 	}
 
-	p.fd=s->fd;
-	p.events=POLLIN;
-	p.revents=0;
-
-	dev->conf.dmx_poll(dev->conf.user,&p);
-
-	fuse_reply_poll(req,p.revents);
-	if(p.revents&&ph)fuse_lowlevel_notify_poll(ph);
+	data_poll(req,s,ph);
 }
 
 static const struct cuse_lowlevel_ops dmx_ops=
@@ -1221,7 +2012,8 @@ static const struct cuse_lowlevel_ops dmx_ops=
 static void *dmxworker(void *data)
 {
 	struct cuse_info ci;
-	DATA *dev=(DATA *)data;
+	NODE *node=(NODE *)data;
+	DATA *dev=node->dev;
 	char devpath[PATH_MAX+9];
 	const char *devarg[1]={devpath};
 	int dummy_argc=1;
@@ -1231,19 +2023,21 @@ static void *dmxworker(void *data)
 
 	sigfillset(&set);
 	pthread_sigmask(SIG_BLOCK,&set,NULL);
+	enroll(node);
 
 	if(fuse_opt_parse(&args,NULL,dvbtvd_opts,dvbtvd_args))goto out;
 	if(fuse_opt_add_arg(&args, "-f"))goto out;
 
-	sprintf(devpath,"DEVNAME=dvb/adapter%d/demux0",dev->conf.adapter);
+	sprintf(devpath,"DEVNAME=dvb/adapter%d/demux%d",dev->conf.adapter,
+		node->unit);
 	memset(&ci,0,sizeof(ci));
 	ci.dev_major=dev->conf.major;
-	ci.dev_minor=dev->conf.minbase+1;
+	ci.dev_minor=dev->conf.minbase+node->unit*8+1;
 	ci.dev_info_argc=1;
 	ci.dev_info_argv=devarg;
 	ci.flags=CUSE_UNRESTRICTED_IOCTL;
 
-	cuse_lowlevel_main(args.argc,args.argv,&ci,&dmx_ops,data);
+	cuse_lowlevel_main(args.argc,args.argv,&ci,&traced[DEV_DMX],data);
 
 out:	fuse_opt_free_args(&args);
 
@@ -1252,55 +2046,56 @@ out:	fuse_opt_free_args(&args);
 
 static void fe_post(void *userdata)
 {
-	DATA *dev=(DATA *)userdata;
+	NODE *node=(NODE *)userdata;
+	DATA *dev=node->dev;
 	char devpath[PATH_MAX];
 
-	sprintf(devpath,"/dev/dvb/adapter%d/frontend0",dev->conf.adapter);
+	sprintf(devpath,"/dev/dvb/adapter%d/frontend%d",dev->conf.adapter,
+		node->unit);
 	chown(devpath,dev->conf.owner,dev->conf.group);
 	chmod(devpath,dev->conf.perms);
 }
 
 static void fe_open(fuse_req_t req,struct fuse_file_info *fi)
 {
-	DATA *dev=fuse_req_userdata(req);
+	NODE *node=fuse_req_userdata(req);
+	DATA *dev;
 	STREAM *s;
 
-	if(!dev)
+	if(!node)
 	{
 		fuse_reply_err(req,EINVAL);
 		return;
 	}
 
-	if(!dev->conf.fe_open)
+	dev=node->dev;
+
+	if(!dev->conf.h.open&&!dev->conf.fe_open)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
 	}
 
-	if(!(s=malloc(sizeof(STREAM))))
+	if(!(s=stream_new(dev,DEV_FE)))
 	{
 		fuse_reply_err(req,EMFILE);
 		return;
 	}
 
-	memset(s,0,sizeof(STREAM));
 	s->flags=fi->flags;
 	s->dev=dev;
+	s->unit=node->unit;
 
-	if((s->fd=dev->conf.fe_open(dev->conf.user,dev->conf.fe_pathname,
-		fi->flags))==-1)
+	if(be_open(s,dev->conf.fe_pathname,fi->flags))
 	{
 		fuse_reply_err(req,errno);
-		free(s);
+		stream_free(s);
 		return;
 	}
 
-	pthread_mutex_lock(&dev->mtx);
-
-	s->next=dev->s;
-	dev->s=s;
+	stream_link(s);
 
-	pthread_mutex_unlock(&dev->mtx);
+	if((s->flags&O_ACCMODE)!=O_RDONLY)eventfd_write(node->evwake,1);
 
 	fi->direct_io=1;
 	fi->keep_cache=0;
@@ -1337,26 +2132,27 @@ static void fe_release(fuse_req_t req,struct fuse_file_info *fi)
 {
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
-	STREAM **e;
+	NODE *node=&dev->node[DEV_FE][s->unit];
 
-	if(!dev->conf.fe_close)
+	if(!dev->conf.h.open&&!dev->conf.fe_close)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
 	}
 
-	dev->conf.fe_close(dev->conf.user,s->fd);
+	stream_unlink(s);
 
-	pthread_mutex_lock(&dev->mtx);
-
-	for(e=&dev->s;*e;e=&(*e)->next)if(*e==s)
+	pthread_mutex_lock(&dev->reg[DEV_FE].mtx);
+	if(node->evs==s)
 	{
-		*e=s->next;
-		free(s);
-		break;
+		eventfd_write(node->evwake,1);
+		while(node->evbusy&&node->evs==s)pthread_cond_wait(
+			&dev->evcond,&dev->reg[DEV_FE].mtx);
+		node->evs=NULL;
 	}
+	pthread_mutex_unlock(&dev->reg[DEV_FE].mtx);
 
-	pthread_mutex_unlock(&dev->mtx);
+	stream_put(s);
 
 	fuse_reply_err(req,0);
 }
@@ -1366,6 +2162,21 @@ static void fe_fsync(fuse_req_t req,int datasync,struct fuse_file_info *fi)
 	fuse_reply_err(req,EOPNOTSUPP);
 }
 
+static void fe_interrupt(fuse_req_t req,void *data)
+{
+	STREAM *s=(STREAM *)data;
+	DATA *dev=s->dev;
+
+	pthread_mutex_lock(&dev->reg[DEV_FE].mtx);
+	if(s->evreq==req)
+	{
+		s->evreq=NULL;
+		pthread_mutex_unlock(&dev->reg[DEV_FE].mtx);
+		fuse_reply_err(req,EINTR);
+	}
+	else pthread_mutex_unlock(&dev->reg[DEV_FE].mtx);
+}
+
 static void fe_ioctl(fuse_req_t req,int cmd,void *arg,
 	struct fuse_file_info *fi,unsigned flags,const void *in_buf,
 	size_t in_bufsz,size_t out_bufsz)
@@ -1386,8 +2197,9 @@ static void fe_ioctl(fuse_req_t req,int cmd,void *arg,
 		struct dvb_frontend_event event;
 	}u;
 	struct dtv_properties props;
+	int i;
 
-	if(!dev->conf.fe_ioctl)
+	if(!dev->conf.h.open&&!dev->conf.fe_ioctl)
 	{
 		fuse_reply_err(req,EOPNOTSUPP);
 		return;
@@ -1427,8 +2239,7 @@ static void fe_ioctl(fuse_req_t req,int cmd,void *arg,
 		{
 			props.props=(struct dtv_property *)in_buf;
 			props.num=in_bufsz/sizeof(struct dtv_property);
-			if(dev->conf.fe_ioctl(dev->conf.user,s->fd,cmd,&props)
-				==-1)fuse_reply_err(req,errno);
+			if(be_ioctl(s,cmd,&props)==-1)fuse_reply_err(req,errno);
 			else fuse_reply_ioctl(req,0,NULL,0);
 		}
 		break;
@@ -1457,8 +2268,7 @@ static void fe_ioctl(fuse_req_t req,int cmd,void *arg,
 		{
 			props.props=(struct dtv_property *)in_buf;
 			props.num=out_bufsz/sizeof(struct dtv_property);
-			if(dev->conf.fe_ioctl(dev->conf.user,s->fd,cmd,&props)
-				==-1)fuse_reply_err(req,errno);
+			if(be_ioctl(s,cmd,&props)==-1)fuse_reply_err(req,errno);
 			else fuse_reply_ioctl(req,0,in_buf,out_bufsz);
 		}
 		else fuse_reply_err(req,ENODATA);
@@ -1473,8 +2283,8 @@ static void fe_ioctl(fuse_req_t req,int cmd,void *arg,
 		}
 		else
 		{
-			if(dev->conf.fe_ioctl(dev->conf.user,s->fd,cmd,&u.info)
-				==-1)fuse_reply_err(req,errno);
+			if(be_ioctl(s,cmd,&u.info)==-1)
+				fuse_reply_err(req,errno);
 			else fuse_reply_ioctl(req,0,&u.info,
 				sizeof(struct dvb_frontend_info));
 		}
@@ -1489,8 +2299,8 @@ static void fe_ioctl(fuse_req_t req,int cmd,void *arg,
 		}
 		else
 		{
-			if(dev->conf.fe_ioctl(dev->conf.user,s->fd,cmd,
-				&u.status)==-1)fuse_reply_err(req,errno);
+			if(be_ioctl(s,cmd,&u.status)==-1)
+				fuse_reply_err(req,errno);
 			else fuse_reply_ioctl(req,0,&u.status,
 				sizeof(fe_status_t));
 		}
@@ -1506,8 +2316,7 @@ static void fe_ioctl(fuse_req_t req,int cmd,void *arg,
 		}
 		else
 		{
-			if(dev->conf.fe_ioctl(dev->conf.user,s->fd,cmd,&u.u32)
-				==-1)fuse_reply_err(req,errno);
+			if(be_ioctl(s,cmd,&u.u32)==-1)fuse_reply_err(req,errno);
 			else fuse_reply_ioctl(req,0,&u.u32,
 				sizeof(uint32_t));
 		}
@@ -1523,15 +2332,14 @@ static void fe_ioctl(fuse_req_t req,int cmd,void *arg,
 		}
 		else
 		{
-			if(dev->conf.fe_ioctl(dev->conf.user,s->fd,cmd,&u.u16)
-				==-1)fuse_reply_err(req,errno);
+			if(be_ioctl(s,cmd,&u.u16)==-1)fuse_reply_err(req,errno);
 			else fuse_reply_ioctl(req,0,&u.u16,
 				sizeof(uint16_t));
 		}
 		break;
 
 	case FE_DISEQC_RESET_OVERLOAD:
-		if(dev->conf.fe_ioctl(dev->conf.user,s->fd,cmd,NULL)==-1)
+		if(be_ioctl(s,cmd,NULL)==-1)
 			fuse_reply_err(req,errno);
 		else fuse_reply_ioctl(req,0,NULL,0);
 		break;
@@ -1546,8 +2354,7 @@ static void fe_ioctl(fuse_req_t req,int cmd,void *arg,
 		else
 		{
 			u.cmd=(struct dvb_diseqc_master_cmd *)in_buf;
-			if(dev->conf.fe_ioctl(dev->conf.user,s->fd,cmd,u.cmd)
-				==-1)fuse_reply_err(req,errno);
+			if(be_ioctl(s,cmd,u.cmd)==-1)fuse_reply_err(req,errno);
 			else fuse_reply_ioctl(req,0,NULL,0);
 		}
 		break;
@@ -1558,7 +2365,7 @@ static void fe_ioctl(fuse_req_t req,int cmd,void *arg,
 	case FE_DISHNETWORK_SEND_LEGACY_CMD:
 	case FE_ENABLE_HIGH_LNB_VOLTAGE:
 	case FE_SET_FRONTEND_TUNE_MODE:
-		if(dev->conf.fe_ioctl(dev->conf.user,s->fd,cmd,arg)==-1)
+		if(be_ioctl(s,cmd,arg)==-1)
 			fuse_reply_err(req,errno);
 		else fuse_reply_ioctl(req,0,NULL,0);
 		break;
@@ -1572,8 +2379,8 @@ static void fe_ioctl(fuse_req_t req,int cmd,void *arg,
 		}
 		else
 		{
-			if(dev->conf.fe_ioctl(dev->conf.user,s->fd,cmd,&u.reply)
-				==-1)fuse_reply_err(req,errno);
+			if(be_ioctl(s,cmd,&u.reply)==-1)
+				fuse_reply_err(req,errno);
 			else fuse_reply_ioctl(req,0,&u.reply,
 				sizeof(struct dvb_diseqc_slave_reply));
 		}
@@ -1589,8 +2396,7 @@ static void fe_ioctl(fuse_req_t req,int cmd,void *arg,
 		else
 		{
 			u.pin=(struct dvb_frontend_parameters *)in_buf;
-			if(dev->conf.fe_ioctl(dev->conf.user,s->fd,cmd,u.pin)
-				==-1)fuse_reply_err(req,errno);
+			if(be_ioctl(s,cmd,u.pin)==-1)fuse_reply_err(req,errno);
 			else fuse_reply_ioctl(req,0,NULL,0);
 		}
 		break;
@@ -1604,8 +2410,8 @@ static void fe_ioctl(fuse_req_t req,int cmd,void *arg,
 		}
 		else
 		{
-			if(dev->conf.fe_ioctl(dev->conf.user,s->fd,cmd,&u.pout)
-				==-1)fuse_reply_err(req,errno);
+			if(be_ioctl(s,cmd,&u.pout)==-1)
+				fuse_reply_err(req,errno);
 			else fuse_reply_ioctl(req,0,&u.pout,
 				sizeof(struct dvb_frontend_parameters));
 		}
@@ -1617,17 +2423,38 @@ static void fe_ioctl(fuse_req_t req,int cmd,void *arg,
 			iov.iov_base=arg;
 			iov.iov_len=sizeof(struct dvb_frontend_event);
 			fuse_reply_ioctl_retry(req,NULL,0,&iov,1);
+			break;
 		}
-		else
+
+		/* must be in place before the event thread can see req */
+		if(!(s->flags&O_NONBLOCK))
+			fuse_req_interrupt_func(req,fe_interrupt,s);
+
+		pthread_mutex_lock(&dev->reg[DEV_FE].mtx);
+		if(s->evcnt)
 		{
-			if(dev->conf.fe_ioctl(dev->conf.user,s->fd,cmd,&u.pout)
-				==-1)fuse_reply_err(req,errno);
-			else fuse_reply_ioctl(req,0,&u.event,
+			u.event=s->ev[s->evhead];
+			s->evhead=(s->evhead+1)%EVQUEUE;
+			s->evcnt--;
+			pthread_mutex_unlock(&dev->reg[DEV_FE].mtx);
+			fuse_reply_ioctl(req,0,&u.event,
 				sizeof(struct dvb_frontend_event));
 		}
+		else if((s->flags&O_NONBLOCK)||s->evreq||
+			fuse_req_interrupted(req))
+		{
+			i=s->evreq?EBUSY:(s->flags&O_NONBLOCK)?EWOULDBLOCK:
+				EINTR;
+			pthread_mutex_unlock(&dev->reg[DEV_FE].mtx);
+			fuse_reply_err(req,i);
+		}
+		else
+		{
+			s->evreq=req;
+			pthread_mutex_unlock(&dev->reg[DEV_FE].mtx);
+		}
 		break;
 
-
 	default:
 		fuse_reply_err(req,EINVAL);
 		break;
@@ -1639,22 +2466,115 @@ static void fe_poll(fuse_req_t req,struct fuse_file_info *fi,
 {
 	STREAM *s=(STREAM *)fi->fh;
 	DATA *dev=s->dev;
-	struct pollfd p;
 
-	if(!dev->conf.fe_poll)
+	pthread_mutex_lock(&dev->reg[DEV_FE].mtx);
+
+	if(s->evcnt)
 	{
-		fuse_reply_err(req,EOPNOTSUPP);
+		pthread_mutex_unlock(&dev->reg[DEV_FE].mtx);
+		fuse_reply_poll(req,POLLIN|POLLRDNORM|POLLPRI);
+		if(ph)
+		{
+			fuse_lowlevel_notify_poll(ph);
+			fuse_pollhandle_destroy(ph);
+		}
 		return;
 	}
 
-	p.fd=s->fd;
-	p.events=POLLIN;
-	p.revents=0;
+	if(ph)
+	{
+		if(s->ph)fuse_pollhandle_destroy(s->ph);
+		s->ph=ph;
+	}
+
+	pthread_mutex_unlock(&dev->reg[DEV_FE].mtx);
+
+	fuse_reply_poll(req,0);
+}
+
+static void *fe_events(void *data)
+{
+	NODE *node=(NODE *)data;
+	DATA *dev=node->dev;
+	STREAM *s;
+	STREAM *t;
+	struct pollfd p[2];
+	struct dvb_frontend_event ev;
+	eventfd_t v;
+	int r;
+
+	enroll(node);
+	quiet=1;
+
+	p[0].fd=node->evwake;
+	p[0].events=POLLIN;
+
+	pthread_mutex_lock(&dev->reg[DEV_FE].mtx);
+
+	while(!dev->evstop)
+	{
+		for(t=dev->reg[DEV_FE].s;t;t=t->next)
+			if(t->unit==node->unit&&(t->flags&O_ACCMODE)!=O_RDONLY)
+				break;
+
+		node->evs=t;
+		node->evbusy=1;
+		pthread_mutex_unlock(&dev->reg[DEV_FE].mtx);
+
+		p[1].fd=t?t->fd:-1;
+		p[1].events=POLLIN|POLLPRI;
+		p[1].revents=0;
+
+		r=0;
+		if(dev->conf.h.open)
+		{
+			if(t&&be_poll(t,POLLIN|POLLPRI)&&
+				!be_ioctl(t,FE_GET_EVENT,&ev))r=1;
+			else if(poll(p,1,-1)>0)eventfd_read(node->evwake,&v);
+		}
+		else if(poll(p,t?2:1,-1)>0)
+		{
+			if(p[0].revents&POLLIN)eventfd_read(node->evwake,&v);
+			if(p[1].revents&(POLLIN|POLLPRI))
+				r=be_ioctl(t,FE_GET_EVENT,&ev)?0:1;
+			else if(p[1].revents)usleep(10000);
+		}
 
-	dev->conf.fe_poll(dev->conf.user,&p);
+		pthread_mutex_lock(&dev->reg[DEV_FE].mtx);
+		node->evbusy=0;
+		pthread_cond_broadcast(&dev->evcond);
 
-	fuse_reply_poll(req,p.revents);
-	if(p.revents&&ph)fuse_lowlevel_notify_poll(ph);
+		if(r)for(s=dev->reg[DEV_FE].s;s;s=s->next)
+		{
+			if(s->unit!=node->unit)continue;
+
+			if(s->evreq)
+			{
+				fuse_reply_ioctl(s->evreq,0,&ev,
+					sizeof(struct dvb_frontend_event));
+				s->evreq=NULL;
+				continue;
+			}
+
+			if(s->evcnt==EVQUEUE)
+			{
+				s->evhead=(s->evhead+1)%EVQUEUE;
+				s->evcnt--;
+			}
+			s->ev[(s->evhead+s->evcnt++)%EVQUEUE]=ev;
+
+			if(s->ph)
+			{
+				fuse_lowlevel_notify_poll(s->ph);
+				fuse_pollhandle_destroy(s->ph);
+				s->ph=NULL;
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&dev->reg[DEV_FE].mtx);
+
+	pthread_exit(NULL);
 }
 
 static const struct cuse_lowlevel_ops fe_ops=
@@ -1673,7 +2593,8 @@ static const struct cuse_lowlevel_ops fe_ops=
 static void *feworker(void *data)
 {
 	struct cuse_info ci;
-	DATA *dev=(DATA *)data;
+	NODE *node=(NODE *)data;
+	DATA *dev=node->dev;
 	char devpath[PATH_MAX+9];
 	const char *devarg[1]={devpath};
 	int dummy_argc=1;
@@ -1683,31 +2604,199 @@ static void *feworker(void *data)
 
 	sigfillset(&set);
 	pthread_sigmask(SIG_BLOCK,&set,NULL);
+	enroll(node);
 
 	if(fuse_opt_parse(&args,NULL,dvbtvd_opts,dvbtvd_args))goto out;
 	if(fuse_opt_add_arg(&args, "-f"))goto out;
 
-	sprintf(devpath,"DEVNAME=dvb/adapter%d/frontend0",dev->conf.adapter);
+	sprintf(devpath,"DEVNAME=dvb/adapter%d/frontend%d",dev->conf.adapter,
+		node->unit);
 	memset(&ci,0,sizeof(ci));
 	ci.dev_major=dev->conf.major;
-	ci.dev_minor=dev->conf.minbase;
+	ci.dev_minor=dev->conf.minbase+node->unit*8;
 	ci.dev_info_argc=1;
 	ci.dev_info_argv=devarg;
 	ci.flags=CUSE_UNRESTRICTED_IOCTL;
 
-	cuse_lowlevel_main(args.argc,args.argv,&ci,&fe_ops,data);
+	cuse_lowlevel_main(args.argc,args.argv,&ci,&traced[DEV_FE],data);
 
 out:	fuse_opt_free_args(&args);
 
 	pthread_exit(NULL);
 }
 
+static const struct cuse_lowlevel_ops *const raw[5]=
+{
+	&fe_ops,
+	&dmx_ops,
+	&dvr_ops,
+	&ca_ops,
+	&net_ops,
+};
+
+static void t_open(fuse_req_t req,struct fuse_file_info *fi)
+{
+	NODE *node=fuse_req_userdata(req);
+
+	enroll(node);
+	TRACE(open_entry,TR_OPEN,node->type,node->unit,fi->flags,0);
+	raw[node->type]->open(req,fi);
+	TRACE(open_exit,TR_OPEN|TR_EXIT,node->type,node->unit,fi->flags,0);
+}
+
+static void t_read(fuse_req_t req,size_t size,off_t off,
+	struct fuse_file_info *fi)
+{
+	NODE *node=fuse_req_userdata(req);
+
+	enroll(node);
+	TRACE(read_entry,TR_READ,node->type,node->unit,size,0);
+	raw[node->type]->read(req,size,off,fi);
+	TRACE(read_exit,TR_READ|TR_EXIT,node->type,node->unit,size,0);
+}
+
+static void t_write(fuse_req_t req,const char *buf,size_t size,off_t off,
+	struct fuse_file_info *fi)
+{
+	NODE *node=fuse_req_userdata(req);
+
+	enroll(node);
+	TRACE(write_entry,TR_WRITE,node->type,node->unit,size,0);
+	raw[node->type]->write(req,buf,size,off,fi);
+	TRACE(write_exit,TR_WRITE|TR_EXIT,node->type,node->unit,size,0);
+}
+
+static void t_release(fuse_req_t req,struct fuse_file_info *fi)
+{
+	NODE *node=fuse_req_userdata(req);
+
+	enroll(node);
+	TRACE(release_entry,TR_RELEASE,node->type,node->unit,0,0);
+	raw[node->type]->release(req,fi);
+	TRACE(release_exit,TR_RELEASE|TR_EXIT,node->type,node->unit,0,0);
+}
+
+static void t_ioctl(fuse_req_t req,int cmd,void *arg,
+	struct fuse_file_info *fi,unsigned flags,const void *in_buf,
+	size_t in_bufsz,size_t out_bufsz)
+{
+	NODE *node=fuse_req_userdata(req);
+
+	enroll(node);
+	TRACE(ioctl_entry,TR_IOCTL,node->type,node->unit,cmd,0);
+	raw[node->type]->ioctl(req,cmd,arg,fi,flags,in_buf,in_bufsz,
+		out_bufsz);
+	TRACE(ioctl_exit,TR_IOCTL|TR_EXIT,node->type,node->unit,cmd,0);
+}
+
+static void t_poll(fuse_req_t req,struct fuse_file_info *fi,
+	struct fuse_pollhandle *ph)
+{
+	NODE *node=fuse_req_userdata(req);
+
+	enroll(node);
+	TRACE(poll_entry,TR_POLL,node->type,node->unit,ph?1:0,0);
+	raw[node->type]->poll(req,fi,ph);
+	TRACE(poll_exit,TR_POLL|TR_EXIT,node->type,node->unit,ph?1:0,0);
+}
+
+static void prepare(void)
+{
+	int i;
+
+	pthread_key_create(&tidkey,leave);
+
+	for(i=0;i<5;i++)
+	{
+		traced[i]=*raw[i];
+		traced[i].open=t_open;
+		traced[i].read=t_read;
+		traced[i].write=t_write;
+		traced[i].release=t_release;
+		traced[i].ioctl=t_ioctl;
+		traced[i].poll=t_poll;
+	}
+}
+
+static const char *devname[5]=
+{
+	"frontend",
+	"demux",
+	"dvr",
+	"ca",
+	"net",
+};
+
+static void *(*worker[5])(void *data)=
+{
+	feworker,
+	dmxworker,
+	dvrworker,
+	caworker,
+	networker,
+};
+
+static int attr(pthread_attr_t *a,unsigned long long cpus,int prio)
+{
+	struct sched_param p;
+	cpu_set_t set;
+	int i;
+
+	if(pthread_attr_init(a))goto err1;
+
+	if(cpus)
+	{
+		CPU_ZERO(&set);
+		for(i=0;i<64;i++)if(cpus&(1ULL<<i))CPU_SET(i,&set);
+		if(pthread_attr_setaffinity_np(a,sizeof(set),&set))goto err2;
+	}
+
+	if(prio)
+	{
+		memset(&p,0,sizeof(p));
+		p.sched_priority=prio;
+		if(pthread_attr_setinheritsched(a,PTHREAD_EXPLICIT_SCHED)||
+			pthread_attr_setschedpolicy(a,SCHED_FIFO)||
+			pthread_attr_setschedparam(a,&p))goto err2;
+	}
+
+	return 0;
+
+err2:	pthread_attr_destroy(a);
+err1:	return -1;
+}
+
+static int nodes(DVBCUSE_DEVICE *conf,int units,int type)
+{
+	switch(type)
+	{
+	case DEV_FE:
+		return conf->fe_enabled?units:0;
+	case DEV_DMX:
+		return conf->dmx_enabled?units:0;
+	case DEV_DVR:
+		return conf->dvr_enabled?units:0;
+	case DEV_CA:
+		return conf->ca_enabled?1:0;
+	case DEV_NET:
+		return conf->net_enabled?1:0;
+	}
+	return 0;
+}
+
 void *dvbcuse_create(DVBCUSE_DEVICE *config)
 {
 	DATA *dev;
+	NODE *node;
 	int i;
+	int j;
+	int n=0;
+	int units;
 	struct stat stb;
+	pthread_attr_t ctrl;
+	pthread_attr_t data;
 	char bfr[PATH_MAX];
+	static pthread_once_t once=PTHREAD_ONCE_INIT;
 
 	if(!config)goto err1;
 
@@ -1717,96 +2806,96 @@ void *dvbcuse_create(DVBCUSE_DEVICE *config)
 
 	if(config->minbase&7)goto err1;
 
+	if(config->rt_prio&&
+		(config->rt_prio<sched_get_priority_min(SCHED_FIFO)||
+		config->rt_prio>sched_get_priority_max(SCHED_FIFO)))goto err1;
+
 	if(stat("/dev/cuse",&stb)||!S_ISCHR(stb.st_mode)||
 		access("/dev/cuse",R_OK|W_OK))goto err1;
 
-	if(config->fe_enabled)
-	{
-		sprintf(bfr,"/dev/dvb/adapter%d/frontend0",config->adapter);
-		if(!stat(bfr,&stb))goto err1;
-	}
-
-	if(config->dmx_enabled)
-	{
-		sprintf(bfr,"/dev/dvb/adapter%d/demux0",config->adapter);
-		if(!stat(bfr,&stb))goto err1;
-	}
-
-	if(config->dvr_enabled)
-	{
-		sprintf(bfr,"/dev/dvb/adapter%d/dvr0",config->adapter);
-		if(!stat(bfr,&stb))goto err1;
-	}
-
-	if(config->ca_enabled)
-	{
-		sprintf(bfr,"/dev/dvb/adapter%d/ca0",config->adapter);
-		if(!stat(bfr,&stb))goto err1;
-	}
+	units=config->units?config->units:1;
+	if(units<1||units>DVBCUSE_UNITS||config->minbase+units*8>0x8000||
+		(units>1&&!config->h.open&&!config->unit_pathname))goto err1;
 
-	if(config->net_enabled)
+	for(i=0;i<5;i++)for(j=0;j<nodes(config,units,i);j++)
 	{
-		sprintf(bfr,"/dev/dvb/adapter%d/net0",config->adapter);
+		sprintf(bfr,"/dev/dvb/adapter%d/%s%d",config->adapter,devname[i],j);
 		if(!stat(bfr,&stb))goto err1;
 	}
 
 	if(!(dev=malloc(sizeof(DATA))))goto err1;
 	memset(dev,0,sizeof(DATA));
 	dev->conf=*config;
+	dev->units=units;
 
-	if(pthread_mutex_init(&dev->mtx,NULL))goto err2;
+	pthread_once(&once,prepare);
 
-	for(i=0;i<5;i++)switch(i)
+	for(i=0;i<5;i++)for(j=0;j<DVBCUSE_UNITS;j++)
 	{
-	case 0:	if(dev->conf.fe_enabled)
-			if(pthread_create(&dev->th[0],NULL,feworker,dev))
-				goto err3;
-		break;
-
-	case 1:	if(dev->conf.dmx_enabled)
-			if(pthread_create(&dev->th[1],NULL,dmxworker,dev))
-				goto err3;
-		break;
+		dev->node[i][j].dev=dev;
+		dev->node[i][j].type=i;
+		dev->node[i][j].unit=j;
+		dev->node[i][j].evs=NULL;
+		dev->node[i][j].evwake=-1;
+	}
 
-	case 2:	if(dev->conf.dvr_enabled)
-			if(pthread_create(&dev->th[2],NULL,dvrworker,dev))
-				goto err3;
-		break;
+	for(i=0;i<5;i++)if(pthread_mutex_init(&dev->reg[i].mtx,NULL))
+	{
+		while(--i>=0)pthread_mutex_destroy(&dev->reg[i].mtx);
+		goto err2;
+	}
+	if(pthread_cond_init(&dev->evcond,NULL))goto err3;
+	if(pthread_mutex_init(&dev->pool.mtx,NULL))goto err4;
+	if(attr(&ctrl,config->ctrl_cpus,0))goto err5;
+	if(attr(&data,config->data_cpus,config->rt_prio))goto err6;
 
-	case 3:	if(dev->conf.ca_enabled)
-			if(pthread_create(&dev->th[3],NULL,caworker,dev))
-				goto err3;
-		break;
+	for(n=0;n<nodes(config,units,DEV_FE);n++)
+	{
+		node=&dev->node[DEV_FE][n];
+		if((node->evwake=eventfd(0,EFD_CLOEXEC|EFD_NONBLOCK))==-1)
+			goto err7;
+		if(pthread_create(&node->evth,&ctrl,fe_events,node))
+		{
+			close(node->evwake);
+			goto err7;
+		}
+	}
 
-	case 4:	if(dev->conf.net_enabled)
-			if(pthread_create(&dev->th[4],NULL,networker,dev))
-				goto err3;
-		break;
+	for(i=0;i<5;i++)for(j=0;j<nodes(config,units,i);j++)
+		if(pthread_create(&dev->node[i][j].th,
+			i==DEV_DMX||i==DEV_DVR?&data:&ctrl,worker[i],
+			&dev->node[i][j]))goto err8;
 
-	}
+	pthread_attr_destroy(&data);
+	pthread_attr_destroy(&ctrl);
 
 	return dev;
 
-err3:	for(i--;i>=0;i--)switch(i)
+err8:	while(--j>=0)
 	{
-	case 3:	if(!dev->conf.ca_enabled)break;
-		pthread_cancel(dev->th[i]);
-		pthread_join(dev->th[i],NULL);
-		break;
-	case 2:	if(!dev->conf.dvr_enabled)break;
-		pthread_cancel(dev->th[i]);
-		pthread_join(dev->th[i],NULL);
-		break;
-	case 1:	if(!dev->conf.dmx_enabled)break;
-		pthread_cancel(dev->th[i]);
-		pthread_join(dev->th[i],NULL);
-		break;
-	case 0:	if(!dev->conf.fe_enabled)break;
-		pthread_cancel(dev->th[i]);
-		pthread_join(dev->th[i],NULL);
-		break;
+		pthread_cancel(dev->node[i][j].th);
+		pthread_join(dev->node[i][j].th,NULL);
+	}
+	while(--i>=0)for(j=0;j<nodes(config,units,i);j++)
+	{
+		pthread_cancel(dev->node[i][j].th);
+		pthread_join(dev->node[i][j].th,NULL);
+	}
+err7:	pthread_mutex_lock(&dev->reg[DEV_FE].mtx);
+	dev->evstop=1;
+	pthread_mutex_unlock(&dev->reg[DEV_FE].mtx);
+	while(--n>=0)
+	{
+		node=&dev->node[DEV_FE][n];
+		eventfd_write(node->evwake,1);
+		pthread_join(node->evth,NULL);
+		close(node->evwake);
 	}
-	pthread_mutex_destroy(&dev->mtx);
+	pthread_attr_destroy(&data);
+err6:	pthread_attr_destroy(&ctrl);
+err5:	pthread_mutex_destroy(&dev->pool.mtx);
+err4:	pthread_cond_destroy(&dev->evcond);
+err3:	for(i=0;i<5;i++)pthread_mutex_destroy(&dev->reg[i].mtx);
 err2:	free(dev);
 err1:	return NULL;
 }
@@ -1814,56 +2903,88 @@ err1:	return NULL;
 void dvbcuse_destroy(void *ctx)
 {
 	int i;
+	int j;
+	NODE *node;
+	SLAB *slab;
+	CHUNK *c;
 	DATA *dev=(DATA *)ctx;
 
 	if(!dev)return;
 
-	for(i=5;i>=0;i--)switch(i)
-	{
-	case 4:	if(!dev->conf.net_enabled)break;
-		pthread_cancel(dev->th[i]);
-		break;
+	for(i=4;i>=0;i--)for(j=0;j<nodes(&dev->conf,dev->units,i);j++)
+		pthread_cancel(dev->node[i][j].th);
 
-	case 3:	if(!dev->conf.ca_enabled)break;
-		pthread_cancel(dev->th[i]);
-		break;
+	for(i=4;i>=0;i--)for(j=0;j<nodes(&dev->conf,dev->units,i);j++)
+		pthread_join(dev->node[i][j].th,NULL);
 
-	case 2:	if(!dev->conf.dvr_enabled)break;
-		pthread_cancel(dev->th[i]);
-		break;
+	pthread_mutex_lock(&dev->reg[DEV_FE].mtx);
+	dev->evstop=1;
+	pthread_mutex_unlock(&dev->reg[DEV_FE].mtx);
 
-	case 1:	if(!dev->conf.dmx_enabled)break;
-		pthread_cancel(dev->th[i]);
-		break;
+	for(j=0;j<nodes(&dev->conf,dev->units,DEV_FE);j++)
+	{
+		node=&dev->node[DEV_FE][j];
+		eventfd_write(node->evwake,1);
+		pthread_join(node->evth,NULL);
+		close(node->evwake);
+	}
 
-	case 0:	if(!dev->conf.fe_enabled)break;
-		pthread_cancel(dev->th[i]);
-		break;
+	while((c=dev->pool.free))
+	{
+		dev->pool.free=c->next;
+		free(c);
 	}
+	pthread_mutex_destroy(&dev->pool.mtx);
 
-	for(i=5;i>=0;i--)switch(i)
+	pthread_cond_destroy(&dev->evcond);
+	for(i=0;i<5;i++)
 	{
-	case 4:	if(!dev->conf.net_enabled)break;
-		pthread_join(dev->th[i],NULL);
-		break;
+		while((slab=dev->reg[i].slabs))
+		{
+			dev->reg[i].slabs=slab->next;
+			free(slab);
+		}
+		pthread_mutex_destroy(&dev->reg[i].mtx);
+	}
+	free(dev);
+}
 
-	case 3:	if(!dev->conf.ca_enabled)break;
-		pthread_join(dev->th[i],NULL);
-		break;
+void dvbcuse_dump(void *ctx,FILE *fp,const char *prefix)
+{
+	DATA *dev=(DATA *)ctx;
+	NODE *node;
+	FILE *st;
+	unsigned long long v[3];
+	unsigned long long sum[3];
+	char bfr[64];
+	int tid;
+	int i;
+	int j;
+	int k;
+	int n;
 
-	case 2:	if(!dev->conf.dvr_enabled)break;
-		pthread_join(dev->th[i],NULL);
-		break;
+	for(i=0;i<5;i++)for(j=0;j<nodes(&dev->conf,dev->units,i);j++)
+	{
+		node=&dev->node[i][j];
+		memset(sum,0,sizeof(sum));
 
-	case 1:	if(!dev->conf.dmx_enabled)break;
-		pthread_join(dev->th[i],NULL);
-		break;
+		for(n=0,k=0;k<MAXTIDS;k++)if((tid=node->tids[k]))
+		{
+			sprintf(bfr,"/proc/self/task/%d/schedstat",tid);
+			if(!(st=fopen(bfr,"r")))continue;
+			if(fscanf(st,"%llu %llu %llu",&v[0],&v[1],&v[2])==3)
+			{
+				sum[0]+=v[0];
+				sum[1]+=v[1];
+				sum[2]+=v[2];
+				n++;
+			}
+			fclose(st);
+		}
 
-	case 0:	if(!dev->conf.fe_enabled)break;
-		pthread_join(dev->th[i],NULL);
-		break;
+		fprintf(fp,"%s %s%d threads=%d cpu_ms=%llu delay_ms=%llu "
+			"slices=%llu delay_avg_us=%llu\n",prefix,devname[i],j,n,
+			sum[0]/1000000,sum[1]/1000000,sum[2],
+			sum[2]?sum[1]/sum[2]/1000:0);
 	}
-
-	pthread_mutex_destroy(&dev->mtx);
-	free(dev);
 }
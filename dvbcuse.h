@@ -12,6 +12,14 @@
 #ifndef DVB_CUSE_H
 #define DVB_CUSE_H
 
+#define DVBCUSE_UNITS	4
+
+#define DVBCUSE_FE	0
+#define DVBCUSE_DMX	1
+#define DVBCUSE_DVR	2
+#define DVBCUSE_CA	3
+#define DVBCUSE_NET	4
+
 #ifndef CA_SET_PID /* removed in kernel 4.14 */
 typedef struct ca_pid {
         unsigned int pid;
@@ -20,11 +28,36 @@ typedef struct ca_pid {
 #define CA_SET_PID _IOW('o', 135, struct ca_pid)
 #endif
 
+struct iovec;
+
+typedef struct _dvbcuse_req DVBCUSE_REQ;
+typedef struct _dvbcuse_stream DVBCUSE_STREAM;
+
+typedef struct _dvbcuse_stage
+{
+	struct _dvbcuse_stage *next;
+	const char *name;
+
+	/* stream is the opaque key of the device stream being opened */
+	void *(*open)(void *priv,DVBCUSE_STREAM *stream);
+	void (*close)(void *priv,void *stream);
+	size_t (*process)(void *priv,void *stream,unsigned char *buf,
+		size_t len);
+
+	void *priv;
+
+	unsigned long long calls;
+	unsigned long long pkts_in;
+	unsigned long long pkts_out;
+	unsigned long long nsecs;
+} DVBCUSE_STAGE;
+
 typedef struct
 {
 	int adapter;
 	int major;
 	int minbase;
+	int units;
 
 	int owner;
 	int group;
@@ -36,12 +69,33 @@ typedef struct
 	int ca_enabled:1;
 	int net_enabled:1;
 
+	int dvr_aligned:1;
+	int dmx_aligned:1;
+
+	/* run in order on aligned packet batches, dvr_filter and dmx_filter
+	   (if set) run after them and return the remaining length */
+	DVBCUSE_STAGE *dvr_stages;
+	DVBCUSE_STAGE *dmx_stages;
+
+	/* cpu masks (bit n is cpu n, 0 is unpinned) for the demux and dvr
+	   threads including the ones libfuse spawns and for all others,
+	   data path threads run SCHED_FIFO at rt_prio if it is not 0 */
+	unsigned long long data_cpus;
+	unsigned long long ctrl_cpus;
+	int rt_prio;
+
 	char fe_pathname[PATH_MAX];
 	char dmx_pathname[PATH_MAX];
 	char dvr_pathname[PATH_MAX];
 	char ca_pathname[PATH_MAX];
 	char net_pathname[PATH_MAX];
 
+	/* source pathname of a DVBCUSE_FE, DVBCUSE_DMX or DVBCUSE_DVR unit
+	   above 0 (which uses the fields above), required for units>1
+	   unless h.open is set, returns -1 with errno set on failure */
+	int (*unit_pathname)(void *user,int type,int unit,char *bfr,
+		size_t size);
+
 	int (*fe_open)(void *user,const char *pathname,int flags);
 	void (*fe_close)(void *user,int fd);
 	int (*fe_ioctl)(void *user,int fd,unsigned long request,void *arg);
@@ -52,6 +106,7 @@ typedef struct
 	void (*dmx_close)(void *user,int fd);
 	int (*dmx_ioctl)(void *user,int fd,unsigned long request,void *arg);
 	int (*dmx_poll)(void *user,struct pollfd *fd);
+	size_t (*dmx_filter)(void *user,int fd,void *buf,size_t count);
 
 	int (*dvr_open)(void *user,const char *pathname,int flags);
 	ssize_t (*dvr_read)(void *user,int fd,void *buf,size_t count);
@@ -59,6 +114,7 @@ typedef struct
 	void (*dvr_close)(void *user,int fd);
 	int (*dvr_ioctl)(void *user,int fd, unsigned long request,void *arg);
 	int (*dvr_poll)(void *user,struct pollfd *fd);
+	size_t (*dvr_filter)(void *user,int fd,void *buf,size_t count);
 
 	int (*ca_open)(void *user,const char *pathname,int flags);
 	ssize_t (*ca_read)(void *user,int fd,void *buf,size_t count);
@@ -71,11 +127,65 @@ typedef struct
 	void (*net_close)(void *user,int fd);
 	int (*net_ioctl)(void *user,int fd,unsigned long request,void *arg);
 
+	/* asynchronous variants, used instead of the above when set, every
+	   request must be completed exactly once by dvbcuse_complete() with
+	   the byte count (0 for ioctls) or -errno, buf and arg stay valid
+	   until then, readv gets pooled chunks of whole packets and trims
+	   each iov_len to the amount filled, streams needing packet
+	   alignment or stages pass a single linear buffer instead */
+	struct
+	{
+		void (*dmx_read)(void *user,DVBCUSE_REQ *req,int fd,void *buf,
+			size_t count);
+		void (*dmx_readv)(void *user,DVBCUSE_REQ *req,int fd,
+			struct iovec *iov,int iovcnt);
+		void (*dmx_ioctl)(void *user,DVBCUSE_REQ *req,int fd,
+			unsigned long request,void *arg);
+
+		void (*dvr_read)(void *user,DVBCUSE_REQ *req,int fd,void *buf,
+			size_t count);
+		void (*dvr_readv)(void *user,DVBCUSE_REQ *req,int fd,
+			struct iovec *iov,int iovcnt);
+		void (*dvr_write)(void *user,DVBCUSE_REQ *req,int fd,
+			const void *buf,size_t count);
+		void (*dvr_ioctl)(void *user,DVBCUSE_REQ *req,int fd,
+			unsigned long request,void *arg);
+
+		void (*ca_read)(void *user,DVBCUSE_REQ *req,int fd,void *buf,
+			size_t count);
+		void (*ca_write)(void *user,DVBCUSE_REQ *req,int fd,
+			const void *buf,size_t count);
+		void (*ca_ioctl)(void *user,DVBCUSE_REQ *req,int fd,
+			unsigned long request,void *arg);
+	} v2;
+
+	/* fd-less backend, replaces all of the above when open is set, the
+	   handle returned by open is passed to all other calls, poll returns
+	   the ready events and the backend calls dvbcuse_notify() for the
+	   stream whenever these change, read and write complete like v2 */
+	struct
+	{
+		void *(*open)(void *user,DVBCUSE_STREAM *stream,int type,
+			int unit,int flags);
+		void (*close)(void *user,void *h);
+		void (*read)(void *user,DVBCUSE_REQ *req,void *h,void *buf,
+			size_t count);
+		void (*readv)(void *user,DVBCUSE_REQ *req,void *h,
+			struct iovec *iov,int iovcnt);
+		void (*write)(void *user,DVBCUSE_REQ *req,void *h,
+			const void *buf,size_t count);
+		int (*ioctl)(void *user,void *h,unsigned long request,void *arg);
+		int (*poll)(void *user,void *h);
+	} h;
+
 	void *user;
 } DVBCUSE_DEVICE;
 
 
 extern void *dvbcuse_create(DVBCUSE_DEVICE *config);
 extern void dvbcuse_destroy(void *ctx);
+extern void dvbcuse_complete(DVBCUSE_REQ *req,ssize_t result);
+extern void dvbcuse_notify(DVBCUSE_STREAM *stream);
+extern void dvbcuse_dump(void *ctx,FILE *fp,const char *prefix);
 
 #endif
@@ -9,17 +9,117 @@
  *
  */
 
+#include <linux/dvb/frontend.h>
+#include <linux/dvb/dmx.h>
+
+#include <sys/socket.h>
 #include <sys/ioctl.h>
 #include <limits.h>
 #include <signal.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <poll.h>
+#include <pthread.h>
 
 #include "dvbcuse.h"
+#include "psicache.h"
+#include "tsscan.h"
+#include "spts.h"
+#include "stages.h"
+#include "ts.h"
+#include "swsrc.h"
+#include "udpsrc.h"
+#include "filesrc.h"
+#include "tsgen.h"
+#include "simfe.h"
+#include "hwsrc.h"
+#include "t2mi.h"
+#include "trace.h"
+#include "capture.h"
+#include "udpout.h"
+#include "dvbnet.h"
+#include "fdcache.h"
+#include "ctrl.h"
+#include "failover.h"
+#include "faultwrap.h"
+#include "epg.h"
+#include "unicable.h"
+
+typedef struct _fdinfo
+{
+	struct _fdinfo *next;
+	const char *type;
+	int fd;
+	void *scan;
+} FDINFO;
+
+typedef struct _loop
+{
+	struct _loop *next;
+	void *psi;
+	void *spts;
+	int analyze;
+	pthread_mutex_t mtx;
+	FDINFO *fds;
+	void *closed;
+	DVBCUSE_STAGE *stages;
+	DVBCUSE_STAGE *dmxstages;
+	void *swsrc;
+	void *udp;
+	void *file;
+	void *gen;
+	void *sim;
+	void *out;
+	void *net;
+	void *fdc;
+	void *fo;
+	void *fault;
+	void *uni;
+	void *epg;
+	void *epgc;
+	void *ctx;
+	int source;
+	int fed;
+	char url[256];
+	char standby[256];
+	DVBCUSE_DEVICE src;
+	DVBCUSE_DEVICE dev;
+} LOOP;
+
+typedef struct
+{
+	DVBCUSE_DEVICE dev;
+	SWSRC_INFO info;
+	char *out;
+	char *pids;
+	char *sim;
+	char *fault;
+	char *epg;
+	int dwell;
+	void *pool;
+	int net;
+	int linger;
+	int cache;
+	int analyze;
+	int fed;
+} SETUP;
+
+typedef struct
+{
+	pthread_mutex_t mtx;
+	LOOP *list;
+	SETUP *setup;
+	const char *outdir;
+	void *t2mi;
+	void *udp;
+	void *file;
+	void *hw;
+} LOOPS;
 
 static int sys_open(void *user,const char *pathname,int flags)
 {
@@ -51,13 +151,521 @@ static int sys_poll(void *user,struct pollfd *fd)
 	return poll(fd,1,0);
 }
 
+static void claim(LOOP *loop)
+{
+	if(loop->epg)epg_claim(loop->epg);
+}
+
+static int unclaim(LOOP *loop,int fd)
+{
+	if(fd==-1&&loop->epg)epg_unclaim(loop->epg);
+	return fd;
+}
+
+static int loop_unit_pathname(void *user,int type,int unit,char *bfr,
+	size_t size)
+{
+	LOOP *loop=(LOOP *)user;
+	static const char *name[]={"frontend","demux","dvr"};
+
+	if(type<DVBCUSE_FE||type>DVBCUSE_DVR||snprintf(bfr,size,
+		"/dev/dvb/adapter%d/%s%d",loop->source,name[type],unit)>=size)
+	{
+		errno=EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+static int loop_fe_open(void *user,const char *pathname,int flags)
+{
+	LOOP *loop=(LOOP *)user;
+
+	claim(loop);
+	if(loop->fdc)return unclaim(loop,
+		fdcache_open(loop->fdc,FDCACHE_FE,pathname,flags));
+	return unclaim(loop,loop->src.fe_open(loop->src.user,pathname,flags));
+}
+
+static void loop_fe_close(void *user,int fd)
+{
+	LOOP *loop=(LOOP *)user;
+
+	if(loop->fdc)fdcache_close(loop->fdc,FDCACHE_FE,fd);
+	else loop->src.fe_close(loop->src.user,fd);
+	unclaim(loop,-1);
+}
+
+static int loop_fe_poll(void *user,struct pollfd *fd)
+{
+	LOOP *loop=(LOOP *)user;
+
+	return loop->src.fe_poll(loop->src.user,fd);
+}
+
+static int loop_dmx_open(void *user,const char *pathname,int flags)
+{
+	LOOP *loop=(LOOP *)user;
+
+	claim(loop);
+	if(loop->fdc)return unclaim(loop,
+		fdcache_open(loop->fdc,FDCACHE_DMX,pathname,flags));
+	return unclaim(loop,loop->src.dmx_open(loop->src.user,pathname,flags));
+}
+
+static ssize_t loop_dvr_write(void *user,int fd,const void *buf,size_t count)
+{
+	LOOP *loop=(LOOP *)user;
+
+	return loop->src.dvr_write(loop->src.user,fd,buf,count);
+}
+
+static int loop_dvr_ioctl(void *user,int fd, unsigned long request,void *arg)
+{
+	LOOP *loop=(LOOP *)user;
+
+	return loop->src.dvr_ioctl(loop->src.user,fd,request,arg);
+}
+
+static int loop_dvr_poll(void *user,struct pollfd *fd)
+{
+	LOOP *loop=(LOOP *)user;
+
+	return loop->src.dvr_poll(loop->src.user,fd);
+}
+
+static int loop_ca_open(void *user,const char *pathname,int flags)
+{
+	LOOP *loop=(LOOP *)user;
+
+	return loop->src.ca_open(loop->src.user,pathname,flags);
+}
+
+static ssize_t loop_ca_read(void *user,int fd,void *buf,size_t count)
+{
+	LOOP *loop=(LOOP *)user;
+
+	return loop->src.ca_read(loop->src.user,fd,buf,count);
+}
+
+static ssize_t loop_ca_write(void *user,int fd,const void *buf,size_t count)
+{
+	LOOP *loop=(LOOP *)user;
+
+	return loop->src.ca_write(loop->src.user,fd,buf,count);
+}
+
+static void loop_ca_close(void *user,int fd)
+{
+	LOOP *loop=(LOOP *)user;
+
+	loop->src.ca_close(loop->src.user,fd);
+}
+
+static int loop_ca_ioctl(void *user,int fd, unsigned long request,void *arg)
+{
+	LOOP *loop=(LOOP *)user;
+
+	return loop->src.ca_ioctl(loop->src.user,fd,request,arg);
+}
+
+static int loop_ca_poll(void *user,struct pollfd *fd)
+{
+	LOOP *loop=(LOOP *)user;
+
+	return loop->src.ca_poll(loop->src.user,fd);
+}
+
+static int loop_net_open(void *user,const char *pathname,int flags)
+{
+	LOOP *loop=(LOOP *)user;
+
+	claim(loop);
+	if(loop->net)return unclaim(loop,dvbnet_open(loop->net,pathname,flags));
+	return unclaim(loop,loop->src.net_open(loop->src.user,pathname,flags));
+}
+
+static void loop_net_close(void *user,int fd)
+{
+	LOOP *loop=(LOOP *)user;
+
+	if(loop->net)dvbnet_close(loop->net,fd);
+	else loop->src.net_close(loop->src.user,fd);
+	unclaim(loop,-1);
+}
+
+static int loop_net_ioctl(void *user,int fd, unsigned long request,void *arg)
+{
+	LOOP *loop=(LOOP *)user;
+
+	if(loop->net)return dvbnet_ioctl(loop->net,fd,request,arg);
+	return loop->src.net_ioctl(loop->src.user,fd,request,arg);
+}
+
+static int fdinfo(LOOP *loop,int fd,const char *type)
+{
+	FDINFO *e;
+
+	if(!(e=malloc(sizeof(FDINFO))))return -1;
+	memset(e,0,sizeof(FDINFO));
+	e->type=type;
+	e->fd=fd;
+
+	if(!(e->scan=tsscan_create()))
+	{
+		free(e);
+		return -1;
+	}
+
+	pthread_mutex_lock(&loop->mtx);
+	e->next=loop->fds;
+	loop->fds=e;
+	pthread_mutex_unlock(&loop->mtx);
+
+	return 0;
+}
+
+static void fdfree(LOOP *loop,int fd)
+{
+	FDINFO **e;
+	FDINFO *r;
+
+	pthread_mutex_lock(&loop->mtx);
+
+	for(e=&loop->fds;*e;e=&(*e)->next)if((*e)->fd==fd)
+	{
+		r=*e;
+		*e=r->next;
+		if(loop->closed)tsscan_merge(loop->closed,r->scan);
+		tsscan_destroy(r->scan);
+		free(r);
+		break;
+	}
+
+	pthread_mutex_unlock(&loop->mtx);
+}
+
+static int scan(LOOP *loop,int fd,const void *buf,size_t len)
+{
+	FDINFO *e;
+
+	pthread_mutex_lock(&loop->mtx);
+
+	for(e=loop->fds;e;e=e->next)if(e->fd==fd)break;
+	if(e&&len)tsscan_feed(e->scan,buf,len);
+
+	pthread_mutex_unlock(&loop->mtx);
+
+	return e?1:0;
+}
+
+static void stats(LOOP *loop,FILE *fp)
+{
+	FDINFO *e;
+	char prefix[32];
+
+	pthread_mutex_lock(&loop->mtx);
+
+	for(e=loop->fds;e;e=e->next)
+	{
+		snprintf(prefix,sizeof(prefix),"%s[%d]",e->type,e->fd);
+		tsscan_dump(e->scan,fp,prefix);
+	}
+	if(loop->closed)tsscan_dump(loop->closed,fp,"closed");
+
+	pthread_mutex_unlock(&loop->mtx);
+
+	if(loop->udp)udpsrc_dump(loop->udp,fp,"udp");
+	if(loop->file)filesrc_dump(loop->file,fp,"file");
+	if(loop->gen)tsgen_dump(loop->gen,fp,"gen");
+	if(loop->sim)simfe_dump(loop->sim,fp,"frontend");
+	if(loop->fo)failover_dump(loop->fo,fp,"failover");
+	if(loop->out)udpout_dump(loop->out,fp,"output");
+	if(loop->net)dvbnet_dump(loop->net,fp,"net");
+	if(loop->fdc)fdcache_dump(loop->fdc,fp,"handles");
+	if(loop->fault)faultwrap_dump(loop->fault,fp,"faults");
+	if(loop->uni)unicable_dump(loop->uni,fp,"unicable");
+	if(loop->epg)epg_dump(loop->epg,fp,"epg");
+	stage_dump(loop->stages,fp,"dvr_pipeline");
+	stage_dump(loop->dmxstages,fp,"demux_pipeline");
+	dvbcuse_dump(loop->ctx,fp,"threads");
+
+	fflush(fp);
+}
+
+static int tuned(unsigned long request,void *arg)
+{
+	struct dtv_properties *props=(struct dtv_properties *)arg;
+	int i;
+
+	switch(request)
+	{
+	case FE_SET_FRONTEND:
+		return 1;
+
+	case FE_SET_PROPERTY:
+		for(i=0;i<props->num;i++)if(props->props[i].cmd==DTV_TUNE)
+			return 1;
+	default:return 0;
+	}
+}
+
+static int loop_fe_ioctl(void *user,int fd, unsigned long request,void *arg)
+{
+	LOOP *loop=(LOOP *)user;
+	int r;
+
+	if((r=loop->src.fe_ioctl(loop->src.user,fd,request,arg))!=-1&&
+		loop->psi&&tuned(request,arg))
+		psicache_flush(loop->psi);
+	return r;
+}
+
+static int loop_dvr_open(void *user,const char *pathname,int flags)
+{
+	LOOP *loop=(LOOP *)user;
+	int fd;
+
+	claim(loop);
+	if((fd=loop->src.dvr_open(loop->src.user,pathname,flags))==-1)
+		return unclaim(loop,-1);
+
+	if(loop->analyze&&fdinfo(loop,fd,"dvr"))
+	{
+		loop->src.dvr_close(loop->src.user,fd);
+		errno=ENOMEM;
+		return unclaim(loop,-1);
+	}
+
+	return fd;
+}
+
+static ssize_t loop_dvr_read(void *user,int fd,void *buf,size_t count)
+{
+	LOOP *loop=(LOOP *)user;
+	ssize_t len;
+
+	if((len=loop->src.dvr_read(loop->src.user,fd,buf,count))>0&&
+		loop->analyze)scan(loop,fd,buf,len);
+	return len;
+}
+
+static void loop_dvr_aread(void *user,DVBCUSE_REQ *req,int fd,void *buf,
+	size_t count)
+{
+	LOOP *loop=(LOOP *)user;
+
+	loop->src.v2.dvr_read(loop->src.user,req,fd,buf,count);
+}
+
+static void loop_dvr_areadv(void *user,DVBCUSE_REQ *req,int fd,
+	struct iovec *iov,int iovcnt)
+{
+	LOOP *loop=(LOOP *)user;
+
+	loop->src.v2.dvr_readv(loop->src.user,req,fd,iov,iovcnt);
+}
+
+static void loop_dvr_close(void *user,int fd)
+{
+	LOOP *loop=(LOOP *)user;
+
+	fdfree(loop,fd);
+	loop->src.dvr_close(loop->src.user,fd);
+	unclaim(loop,-1);
+}
+
+static ssize_t loop_dmx_read(void *user,int fd,void *buf,size_t count)
+{
+	LOOP *loop=(LOOP *)user;
+	ssize_t len;
+	int stop;
+
+	if(loop->analyze&&scan(loop,fd,NULL,0))
+	{
+		if((len=loop->src.dmx_read(loop->src.user,fd,buf,count))>0)
+			scan(loop,fd,buf,len);
+		return len;
+	}
+
+	while(1)
+	{
+		if(loop->epgc&&(len=psicache_read(loop->epgc,fd,buf,count,
+			&stop))!=-1)
+		{
+			if(stop)
+			{
+				if(loop->psi)psicache_stop(loop->psi,fd);
+				loop->src.dmx_ioctl(loop->src.user,fd,DMX_STOP,
+					NULL);
+			}
+		}
+		else if(loop->psi&&(len=psicache_read(loop->psi,fd,buf,count,
+			&stop))!=-1)
+		{
+			if(stop)
+			{
+				if(loop->epgc)psicache_stop(loop->epgc,fd);
+				loop->src.dmx_ioctl(loop->src.user,fd,DMX_STOP,
+					NULL);
+			}
+		}
+		else if((len=loop->src.dmx_read(loop->src.user,fd,buf,count))>0&&
+			loop->psi)
+			psicache_store(loop->psi,fd,buf,len);
+
+		if(len<=0||!loop->spts||(len=spts_section(loop->spts,buf,len)))
+			break;
+	}
+
+	return len;
+}
+
+static void loop_dmx_close(void *user,int fd)
+{
+	LOOP *loop=(LOOP *)user;
+
+	if(loop->psi)psicache_release(loop->psi,fd);
+	if(loop->epgc)psicache_release(loop->epgc,fd);
+	fdfree(loop,fd);
+	if(loop->fdc)fdcache_close(loop->fdc,FDCACHE_DMX,fd);
+	else loop->src.dmx_close(loop->src.user,fd);
+	unclaim(loop,-1);
+}
+
+static int cache(void *psi,int fd,unsigned long request,
+	struct dmx_sct_filter_params *sct)
+{
+	switch(request)
+	{
+	case DMX_SET_FILTER:
+		if(psicache_filter(psi,fd,sct)==-1)return -1;
+		break;
+
+	case DMX_START:
+		psicache_start(psi,fd);
+		break;
+
+	case DMX_STOP:
+	case DMX_SET_PES_FILTER:
+		psicache_stop(psi,fd);
+		break;
+	}
+
+	return 0;
+}
+
+static int loop_dmx_ioctl(void *user,int fd, unsigned long request,void *arg)
+{
+	LOOP *loop=(LOOP *)user;
+	struct dmx_pes_filter_params *pes=(struct dmx_pes_filter_params *)arg;
+	struct dmx_sct_filter_params *sct=(struct dmx_sct_filter_params *)arg;
+	int r;
+
+	if(loop->spts)switch(request)
+	{
+	case DMX_SET_FILTER:
+		if(!spts_allowed(loop->spts,sct->pid))goto inval;
+		break;
+
+	case DMX_SET_PES_FILTER:
+		if(!spts_allowed(loop->spts,pes->pid))goto inval;
+		break;
+
+	case DMX_ADD_PID:
+		if(!spts_allowed(loop->spts,*(uint16_t *)arg))goto inval;
+		break;
+	}
+
+	if((r=loop->src.dmx_ioctl(loop->src.user,fd,request,arg))==-1)
+		return r;
+
+	switch(request)
+	{
+	case DMX_SET_FILTER:
+		fdfree(loop,fd);
+		break;
+
+	case DMX_SET_PES_FILTER:
+		fdfree(loop,fd);
+		if(pes->output==DMX_OUT_TSDEMUX_TAP&&loop->analyze&&
+			fdinfo(loop,fd,"demux"))
+		{
+			errno=ENOMEM;
+			return -1;
+		}
+		break;
+	}
+
+	if(loop->psi&&cache(loop->psi,fd,request,sct))return -1;
+	if(loop->epgc&&cache(loop->epgc,fd,request,sct))return -1;
+
+	return r;
+
+inval:	errno=EINVAL;
+	return -1;
+}
+
+static int loop_dmx_poll(void *user,struct pollfd *fd)
+{
+	LOOP *loop=(LOOP *)user;
+
+	if((loop->psi&&psicache_pending(loop->psi,fd->fd))||
+		(loop->epgc&&psicache_pending(loop->epgc,fd->fd)))
+	{
+		fd->revents=fd->events&POLLIN;
+		return 1;
+	}
+	return loop->src.dmx_poll(loop->src.user,fd);
+}
+
+static int cpus(const char *list,unsigned long long *mask)
+{
+	char *e;
+	int from;
+	int to;
+
+	for(*mask=0;*list;list=e)
+	{
+		from=to=strtol(list,&e,10);
+		if(e==list)return -1;
+		if(*e=='-')to=strtol(e+1,&e,10);
+		if(from<0||to>63||from>to)return -1;
+		while(from<=to)*mask|=1ULL<<from++;
+		if(*e==',')e++;
+		else if(*e)return -1;
+	}
+
+	return *mask?0:-1;
+}
+
 static void usage(void)
 {
 	fprintf(stderr,"Usage: dvbloopd [params]\n"
 	"-s source       source dvb adapter number\n"
+	"-u url          source udp://host:port, rtp://host:port or\n"
+	"                file://path[?rate=bps] or\n"
+	"                gen://[?rate=bps&programs=n&tsid=n] instead\n"
+	"-E key=val,...  simulated frontend for url sources (lock,jitter,\n"
+	"                fail,strength,cnr,ber,diseqc,seed)\n"
+	"-I key=val,...  source frontend info (name,delsys,freq,sr,strength,snr)\n"
+	"-B standby      standby source adapter number or url for failover\n"
+	"-O url          also send source stream to udp://host:port or rtp://...\n"
+	"-S pid,...      send only the given pids (default all)\n"
+	"-T pid:plp,...  decapsulate T2-MI on pid, one adapter per plp\n"
+	"                starting at -a (stages apply to the first only)\n"
 	"-a adapter      lopp dvb adapter number (target)\n"
 	"-m major        major device number\n"
 	"-M minor-base   minor device base number (multiple of 8)\n"
+	"-U units        frontend/demux/dvr units per adapter (1-4)\n"
+	"-X path         control socket (add, remove, switch, list, stats,\n"
+	"                trace on|off|dump file, fault adapter spec|off,\n"
+	"                capture start file|stop), socket mode 0600\n"
+	"-W dir          directory for control socket dump and capture files\n"
+	"-w path         capture backend requests to path for dvbreplay\n"
+	"-f key=val,...  inject source faults (delay,jitter,stall,stallms,\n"
+	"                short,overflow,again,ioctl,period,active,seed)\n"
+	"-t path         enable hot path tracing, SIGUSR2 dumps to path\n"
 	"-o owner        device uid\n"
 	"-g group        device gid\n"
 	"-p perms        device permission (octal)\n"
@@ -65,131 +673,903 @@ static void usage(void)
 	"-D              disable demux device\n"
 	"-V              disable dvr device\n"
 	"-C              disable ca device\n"
-	"-N              disable net device\n");
+	"-N              disable net device\n"
+	"-n              userspace net device (MPE/ULE to TUN)\n"
+	"-c              disable section cache\n"
+	"-L msecs        keep closed source fe/demux handles open for reuse\n"
+	"-Y key=val,...  source adapters share a unicable cable (type=en50494|\n"
+	"                en50607,ub=slot:MHz repeatable, one per user band)\n"
+	"-H path         harvest EIT/SDT/NIT on the idle source adapter from\n"
+	"                the transponders listed in path (one per line,\n"
+	"                delsys,freq,sr,pol,band,bw,stream,lof), satellite\n"
+	"                freq in kHz, above 2150000 converted to the IF by\n"
+	"                lof=lo:hi:switch (default universal LNB)\n"
+	"-G secs         seconds to stay on each transponder (default 20)\n"
+	"-k cpus         pin demux/dvr threads to cpus (e.g. 2,3 or 2-3)\n"
+	"-K cpus         pin all other threads to cpus\n"
+	"-r prio         run demux/dvr threads SCHED_FIFO at prio\n"
+	"-i              enable stream integrity analysis (SIGUSR1 dumps)\n"
+	"-A              return whole TS packets only on dvr/demux reads\n"
+	"-P program      present only the given program (SPTS)\n"
+	"-Z              strip null packets\n"
+	"-R from:to      remap pid (repeatable)\n"
+	"-x pid          drop pid (repeatable)\n"
+	"stages -P, -Z, -R and -x are applied in command line order\n");
 
 	exit(1);
 }
 
+static void loop_destroy(LOOP *loop)
+{
+	dvbcuse_destroy(loop->ctx);
+	epg_destroy(loop->epg);
+	while(loop->fds)fdfree(loop,loop->fds->fd);
+	tsscan_destroy(loop->closed);
+	dvbnet_destroy(loop->net);
+	udpout_destroy(loop->out);
+	fdcache_destroy(loop->fdc);
+	faultwrap_destroy(loop->fault);
+	unicable_destroy(loop->uni);
+	udpsrc_destroy(loop->udp);
+	filesrc_destroy(loop->file);
+	tsgen_destroy(loop->gen);
+	failover_destroy(loop->fo);
+	simfe_destroy(loop->sim);
+	swsrc_destroy(loop->swsrc);
+	stage_free(loop->stages);
+	stage_free(loop->dmxstages);
+	spts_destroy(loop->spts);
+	psicache_destroy(loop->psi);
+	psicache_destroy(loop->epgc);
+	pthread_mutex_destroy(&loop->mtx);
+	free(loop);
+}
+
+static int attach(LOOP *loop,const char *url)
+{
+	TS_SINK sink;
+
+	if(loop->sim)simfe_sink(loop->sim,&sink);
+	else
+	{
+		sink.feed=swsrc_feed;
+		sink.lost=swsrc_lost;
+		sink.user=loop->swsrc;
+	}
+
+	if(!strncmp(url,"file://",7))
+		return (loop->file=filesrc_create(url,&sink))?0:-1;
+	if(!strncmp(url,"gen://",6))
+		return (loop->gen=tsgen_create(url,&sink))?0:-1;
+	return (loop->udp=udpsrc_create(url,&sink))?0:-1;
+}
+
+static void detach(LOOP *loop)
+{
+	udpsrc_destroy(loop->udp);
+	filesrc_destroy(loop->file);
+	tsgen_destroy(loop->gen);
+	loop->udp=NULL;
+	loop->file=NULL;
+	loop->gen=NULL;
+}
+
+static LOOP *loop_create(SETUP *setup,int adapter,int minbase,int units,
+	const char *url,int source,const char *standby,DVBCUSE_STAGE *stages,
+	void *spts)
+{
+	LOOP *loop;
+	DVBCUSE_DEVICE *dev;
+	SWSRC_FE fe;
+	TS_SINK sink;
+	char primary[16];
+
+	if(!(loop=malloc(sizeof(LOOP))))
+	{
+		stage_free(stages);
+		spts_destroy(spts);
+		return NULL;
+	}
+	memset(loop,0,sizeof(LOOP));
+	loop->stages=stages;
+	loop->spts=spts;
+	loop->analyze=setup->analyze;
+	loop->source=source;
+	loop->fed=setup->fed;
+
+	if(pthread_mutex_init(&loop->mtx,NULL))
+	{
+		stage_free(stages);
+		spts_destroy(spts);
+		free(loop);
+		return NULL;
+	}
+
+	dev=&loop->dev;
+	*dev=setup->dev;
+	dev->adapter=adapter;
+	dev->minbase=minbase;
+	dev->units=units;
+
+	sprintf(dev->fe_pathname,"/dev/dvb/adapter%d/frontend0",source);
+	sprintf(dev->dmx_pathname,"/dev/dvb/adapter%d/demux0",source);
+	sprintf(dev->dvr_pathname,"/dev/dvb/adapter%d/dvr0",source);
+	sprintf(dev->ca_pathname,"/dev/dvb/adapter%d/ca0",source);
+	sprintf(dev->net_pathname,"/dev/dvb/adapter%d/net0",source);
+
+	if(stages&&!(loop->dmxstages=stage_clone(stages)))goto err;
+
+	if(standby&&!url)
+	{
+		sprintf(primary,"%d",source);
+		url=primary;
+	}
+
+	if(url)
+	{
+		if(strlen(url)>=sizeof(loop->url))goto err;
+		strcpy(loop->url,url);
+		if(!(loop->swsrc=swsrc_create(&setup->info)))goto err;
+		swsrc_backend(loop->swsrc,&loop->src);
+		dev->ca_enabled=0;
+
+		if(setup->sim)
+		{
+			sink.feed=swsrc_feed;
+			sink.lost=swsrc_lost;
+			sink.user=loop->swsrc;
+			if(!(loop->sim=simfe_create(&setup->info,setup->sim,
+				&sink)))goto err;
+			simfe_frontend(loop->sim,&fe);
+			swsrc_frontend(loop->swsrc,&fe);
+		}
+	}
+	else
+	{
+		loop->src.fe_open=sys_open;
+		loop->src.fe_close=sys_close;
+		loop->src.fe_ioctl=sys_ioctl;
+		loop->src.fe_poll=sys_poll;
+
+		loop->src.dmx_open=sys_open;
+		loop->src.dmx_read=sys_read;
+		loop->src.dmx_close=sys_close;
+		loop->src.dmx_ioctl=sys_ioctl;
+		loop->src.dmx_poll=sys_poll;
+
+		loop->src.dvr_open=sys_open;
+		loop->src.dvr_read=sys_read;
+		loop->src.dvr_write=sys_write;
+		loop->src.dvr_close=sys_close;
+		loop->src.dvr_ioctl=sys_ioctl;
+		loop->src.dvr_poll=sys_poll;
+
+		loop->src.ca_open=sys_open;
+		loop->src.ca_read=sys_read;
+		loop->src.ca_write=sys_write;
+		loop->src.ca_close=sys_close;
+		loop->src.ca_ioctl=sys_ioctl;
+		loop->src.ca_poll=sys_poll;
+
+		loop->src.net_open=sys_open;
+		loop->src.net_close=sys_close;
+		loop->src.net_ioctl=sys_ioctl;
+
+		if(setup->pool&&!(loop->uni=unicable_create(&loop->src,
+			setup->pool)))goto err;
+	}
+
+	if(setup->fault&&!(loop->fault=faultwrap_create(&loop->src,
+		setup->fault)))goto err;
+
+	dev->unit_pathname=loop_unit_pathname;
+	dev->fe_open=loop_fe_open;
+	dev->fe_close=loop_fe_close;
+	dev->fe_ioctl=loop_fe_ioctl;
+	dev->fe_poll=loop_fe_poll;
+
+	dev->dmx_open=loop_dmx_open;
+	dev->dmx_read=loop_dmx_read;
+	dev->dmx_close=loop_dmx_close;
+	dev->dmx_ioctl=loop_dmx_ioctl;
+	dev->dmx_poll=loop_dmx_poll;
+	dev->dmx_stages=loop->dmxstages;
+
+	dev->dvr_open=loop_dvr_open;
+	dev->dvr_read=loop_dvr_read;
+	if(!loop->analyze&&loop->src.v2.dvr_read)
+		dev->v2.dvr_read=loop_dvr_aread;
+	if(!loop->analyze&&loop->src.v2.dvr_readv)
+		dev->v2.dvr_readv=loop_dvr_areadv;
+	dev->dvr_write=loop->src.dvr_write?loop_dvr_write:NULL;
+	dev->dvr_close=loop_dvr_close;
+	dev->dvr_ioctl=loop_dvr_ioctl;
+	dev->dvr_poll=loop_dvr_poll;
+	dev->dvr_stages=loop->stages;
+
+	dev->ca_open=loop_ca_open;
+	dev->ca_read=loop_ca_read;
+	dev->ca_write=loop_ca_write;
+	dev->ca_close=loop_ca_close;
+	dev->ca_ioctl=loop_ca_ioctl;
+	dev->ca_poll=loop_ca_poll;
+
+	dev->net_open=loop_net_open;
+	dev->net_close=loop_net_close;
+	dev->net_ioctl=loop_net_ioctl;
+
+	if(setup->cache&&(url||units<=1)&&!(loop->psi=psicache_create()))
+		goto err;
+	if(standby)
+	{
+		if(strlen(standby)>=sizeof(loop->standby)||
+			!(loop->fo=failover_create(url,standby,loop->swsrc)))
+		{
+			fprintf(stderr,"can't open %s or %s\n",url,standby);
+			goto err;
+		}
+		strcpy(loop->standby,standby);
+	}
+	else if(url&&!setup->fed&&attach(loop,url))
+	{
+		fprintf(stderr,"can't open %s\n",url);
+		goto err;
+	}
+	if(setup->linger>0&&
+		!(loop->fdc=fdcache_create(&loop->src,setup->linger)))goto err;
+	if(setup->epg&&!url&&(!(loop->epgc=psicache_create())||
+		!(loop->epg=epg_create(&loop->src,dev->fe_pathname,
+		dev->dmx_pathname,setup->epg,setup->dwell,
+		setup->linger+5000,loop->epgc))))
+	{
+		fprintf(stderr,"can't harvest epg using %s\n",setup->epg);
+		goto err;
+	}
+	if((url||setup->net)&&dev->net_enabled&&!(loop->net=
+		dvbnet_create(&loop->src,dev->dmx_pathname,adapter)))
+		goto err;
+	if(setup->out&&!(loop->out=udpout_create(setup->out,&loop->src,
+		dev->dmx_pathname,setup->pids)))
+	{
+		fprintf(stderr,"can't send to %s\n",setup->out);
+		goto err;
+	}
+	if(loop->analyze&&!(loop->closed=tsscan_create()))goto err;
+	dev->user=loop;
+
+	/* nothing to interpose, let dvbcuse drive the source directly */
+	if(loop->swsrc&&!loop->psi&&!loop->analyze&&!loop->spts&&
+		!loop->fault&&!loop->fdc&&!loop->net&&!loop->sim)
+		swsrc_handles(loop->swsrc,dev);
+
+	if(!(loop->ctx=dvbcuse_create(dev)))goto err;
+
+	return loop;
+
+err:	loop_destroy(loop);
+	return NULL;
+}
+
+static void source(LOOP *loop,char *bfr,int size)
+{
+	if(loop->fo)snprintf(bfr,size,"%s standby=%s",loop->url,
+		loop->standby);
+	else if(loop->swsrc)snprintf(bfr,size,"%s",loop->url);
+	else snprintf(bfr,size,"adapter%d",loop->source);
+}
+
+static void t2stats(LOOPS *l,FILE *fp)
+{
+	if(!l->t2mi)return;
+	if(l->udp)udpsrc_dump(l->udp,fp,"t2mi udp");
+	if(l->file)filesrc_dump(l->file,fp,"t2mi file");
+	t2mi_dump(l->t2mi,fp,"t2mi");
+	fflush(fp);
+}
+
+static int t2setup(LOOPS *l,const char *spec,const char *url,int source,
+	DVBCUSE_STAGE *stages,void *spts)
+{
+	SETUP *setup=l->setup;
+	LOOP *loop;
+	TS_SINK sink;
+	char name[32];
+	char *end;
+	char *p;
+	int pid;
+	int plp;
+	int i;
+
+	pid=strtol(spec,&end,0);
+	if(*end!=':'||!(l->t2mi=t2mi_create(pid)))goto fail;
+
+	setup->fed=1;
+
+	for(i=0;*end;i++)
+	{
+		plp=strtol(p=end+1,&end,0);
+		if(end==p||(*end&&*end!=','))goto fail;
+		if(!url&&source>=setup->dev.adapter&&
+			source<=setup->dev.adapter+i)goto fail;
+
+		sprintf(name,"t2mi:%d/%d",pid,plp);
+		loop=loop_create(setup,setup->dev.adapter+i,
+			setup->dev.minbase+i*8*(setup->dev.units?
+			setup->dev.units:1),setup->dev.units,name,source,NULL,
+			stages,spts);
+		stages=NULL;
+		spts=NULL;
+		if(!loop)goto fail;
+		setup->out=NULL;
+		setup->pids=NULL;
+
+		loop->next=l->list;
+		l->list=loop;
+
+		if(loop->sim)simfe_sink(loop->sim,&sink);
+		else
+		{
+			sink.feed=swsrc_feed;
+			sink.lost=swsrc_lost;
+			sink.user=loop->swsrc;
+		}
+		if(t2mi_plp(l->t2mi,plp,&sink))goto fail;
+	}
+
+	setup->fed=0;
+
+	t2mi_sink(l->t2mi,&sink);
+	if(!url)l->hw=hwsrc_create(source,&sink);
+	else if(!strncmp(url,"file://",7))l->file=filesrc_create(url,&sink);
+	else l->udp=udpsrc_create(url,&sink);
+	if(!l->hw&&!l->file&&!l->udp)
+	{
+		if(url)fprintf(stderr,"can't open %s\n",url);
+		else fprintf(stderr,"can't open adapter%d\n",source);
+		return -1;
+	}
+
+	return 0;
+
+fail:	setup->fed=0;
+	stage_free(stages);
+	spts_destroy(spts);
+	return -1;
+}
+
+static void teardown(LOOPS *l)
+{
+	LOOP *loop;
+
+	hwsrc_destroy(l->hw);
+	filesrc_destroy(l->file);
+	udpsrc_destroy(l->udp);
+
+	while((loop=l->list))
+	{
+		l->list=loop->next;
+		loop_destroy(loop);
+	}
+
+	t2mi_destroy(l->t2mi);
+}
+
+static int tracedump(const char *path)
+{
+	FILE *fp;
+	int r;
+
+	if(!(fp=fopen(path,"w")))return -1;
+	r=trace_dump(fp);
+	if(fclose(fp))r=-1;
+	return r;
+}
+
+static int number(const char *str,int min,int max,int *val)
+{
+	char *e;
+	long v;
+
+	errno=0;
+	v=strtol(str,&e,10);
+	if(e==str||*e||errno||v<min||v>max)return -1;
+	*val=(int)v;
+	return 0;
+}
+
+static int outfile(LOOPS *l,const char *name,char *path,int size)
+{
+	if(!l->outdir)
+	{
+		errno=EPERM;
+		return -1;
+	}
+	if(!*name||strchr(name,'/')||!strcmp(name,".")||!strcmp(name,"..")||
+		snprintf(path,size,"%s/%s",l->outdir,name)>=size)
+	{
+		errno=EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+static int control(void *user,char *line,FILE *fp)
+{
+	LOOPS *l=(LOOPS *)user;
+	LOOP **e;
+	LOOP *loop;
+	char *cmd;
+	char *arg[4];
+	char *mem;
+	char bfr[600];
+	char path[PATH_MAX];
+	int adapter;
+	int minbase;
+	int units;
+	int src;
+	int n;
+	int r=-1;
+
+	if(!(cmd=strtok_r(line," \t",&mem)))goto inval;
+	for(n=0;n<4&&(arg[n]=strtok_r(NULL," \t",&mem));n++);
+
+	pthread_mutex_lock(&l->mtx);
+
+	if(!strcmp(cmd,"list"))
+	{
+		for(loop=l->list;loop;loop=loop->next)
+		{
+			source(loop,bfr,sizeof(bfr));
+			fprintf(fp,"adapter%d minbase=%d units=%d source=%s\n",
+				loop->dev.adapter,loop->dev.minbase,
+				loop->dev.units?loop->dev.units:1,bfr);
+		}
+		r=0;
+	}
+	else if(!strcmp(cmd,"stats"))
+	{
+		for(loop=l->list;loop;loop=loop->next)
+			if(!n||loop->dev.adapter==atoi(arg[0]))
+		{
+			fprintf(fp,"adapter%d\n",loop->dev.adapter);
+			stats(loop,fp);
+		}
+		if(!n)t2stats(l,fp);
+		if(!n)capture_dump(fp,"capture");
+		if(!n&&l->setup->pool)
+			unicable_pool_dump(l->setup->pool,fp,"unicable");
+		r=0;
+	}
+	else if(!strcmp(cmd,"add"))
+	{
+		units=1;
+		src=-1;
+		if(n<3||number(arg[0],0,255,&adapter)||
+			number(arg[1],0,0x7ff8,&minbase)||(minbase&7)||
+			(n>3&&number(arg[3],1,DVBCUSE_UNITS,&units)))
+			goto unlock;
+		if(!strstr(arg[2],"://")&&(number(arg[2],0,255,&src)||
+			src==adapter))goto unlock;
+		for(loop=l->list;loop;loop=loop->next)
+			if(loop->dev.adapter==adapter)break;
+		if(loop)
+		{
+			errno=EEXIST;
+			goto unlock;
+		}
+		for(loop=l->list;loop;loop=loop->next)
+			if(minbase<loop->dev.minbase+(loop->dev.units?
+			loop->dev.units:1)*8&&
+			loop->dev.minbase<minbase+units*8)break;
+		if(loop)
+		{
+			errno=EBUSY;
+			goto unlock;
+		}
+		errno=0;
+		if(!(loop=loop_create(l->setup,adapter,minbase,units,
+			src==-1?arg[2]:NULL,src,NULL,NULL,NULL)))
+		{
+			if(!errno)errno=EIO;
+			goto unlock;
+		}
+		loop->next=l->list;
+		l->list=loop;
+		r=0;
+	}
+	else if(!strcmp(cmd,"remove"))
+	{
+		if(n<1)goto unlock;
+		for(e=&l->list;*e;e=&(*e)->next)
+			if((*e)->dev.adapter==atoi(arg[0]))break;
+		if(!*e)
+		{
+			errno=ENOENT;
+			goto unlock;
+		}
+		if((*e)->fed)
+		{
+			errno=EBUSY;
+			goto unlock;
+		}
+		loop=*e;
+		*e=loop->next;
+		loop_destroy(loop);
+		r=0;
+	}
+	else if(!strcmp(cmd,"switch"))
+	{
+		if(n<2)goto unlock;
+		for(loop=l->list;loop;loop=loop->next)
+			if(loop->dev.adapter==atoi(arg[0]))break;
+		if(!loop)
+		{
+			errno=ENOENT;
+			goto unlock;
+		}
+		if((!loop->udp&&!loop->file&&!loop->gen)||
+			strlen(arg[1])>=sizeof(loop->url))
+		{
+			errno=EOPNOTSUPP;
+			goto unlock;
+		}
+		detach(loop);
+		if(attach(loop,arg[1]))
+		{
+			attach(loop,loop->url);
+			errno=EIO;
+			goto unlock;
+		}
+		strcpy(loop->url,arg[1]);
+		if(loop->psi)psicache_flush(loop->psi);
+		r=0;
+	}
+	else if(!strcmp(cmd,"trace"))
+	{
+		if(n<1)goto unlock;
+		if(!strcmp(arg[0],"on"))trace_enable(1);
+		else if(!strcmp(arg[0],"off"))trace_enable(0);
+		else if(strcmp(arg[0],"dump")||n<2)goto unlock;
+		else if(outfile(l,arg[1],path,sizeof(path))||tracedump(path))
+			goto unlock;
+		r=0;
+	}
+	else if(!strcmp(cmd,"capture"))
+	{
+		if(n<1)goto unlock;
+		if(!strcmp(arg[0],"stop"))r=capture_stop();
+		else if(!strcmp(arg[0],"start")&&n>1&&
+			!outfile(l,arg[1],path,sizeof(path)))
+			r=capture_start(path);
+	}
+	else if(!strcmp(cmd,"fault"))
+	{
+		if(n<2)goto unlock;
+		for(loop=l->list;loop;loop=loop->next)
+			if(loop->dev.adapter==atoi(arg[0]))break;
+		if(!loop)
+		{
+			errno=ENOENT;
+			goto unlock;
+		}
+		if(!loop->fault)
+		{
+			errno=EOPNOTSUPP;
+			goto unlock;
+		}
+		if(faultwrap_config(loop->fault,arg[1]))goto unlock;
+		r=0;
+	}
+
+unlock:	if(r&&!errno)errno=EINVAL;
+	pthread_mutex_unlock(&l->mtx);
+	return r;
+
+inval:	errno=EINVAL;
+	return -1;
+}
+
 int main(int argc,char *argv[])
 {
-	DVBCUSE_DEVICE dev;
-	void *ctx;
+	SETUP setup;
+	LOOPS loops;
+	LOOP *loop;
+	void *ctx=NULL;
 	sigset_t set;
+	char *url=NULL;
+	char *standby=NULL;
+	char *ctrl=NULL;
+	char *tpath=NULL;
+	char *cpath=NULL;
+	char *t2mi=NULL;
 	int source=4;
+	DVBCUSE_STAGE *stages=NULL;
+	DVBCUSE_STAGE *t=NULL;
+	void *spts=NULL;
+	int program;
+	int from;
+	int to;
+	int sig;
 	int c;
 
-	memset(&dev,0,sizeof(dev));
+	memset(&setup,0,sizeof(setup));
+	memset(&loops,0,sizeof(loops));
+
+	strcpy(setup.info.name,"dvbloopd UDP/RTP source");
+	setup.info.delsys=SYS_DVBS2;
+	setup.info.strength=0xc000;
+	setup.info.snr=120;
+
+	setup.cache=1;
+	setup.dwell=20;
 
-	dev.major=256;
+	setup.dev.major=256;
 
-	dev.owner=0;
-	dev.group=0;
-	dev.perms=0666;
+	setup.dev.owner=0;
+	setup.dev.group=0;
+	setup.dev.perms=0666;
 
-	dev.fe_enabled=1;
-	dev.dmx_enabled=1;
-	dev.dvr_enabled=1;
-	dev.ca_enabled=1;
-	dev.net_enabled=1;
+	setup.dev.fe_enabled=1;
+	setup.dev.dmx_enabled=1;
+	setup.dev.dvr_enabled=1;
+	setup.dev.ca_enabled=1;
+	setup.dev.net_enabled=1;
 
-	while((c=getopt(argc,argv,"a:m:M:o:g:p:FDVCNs:"))!=-1)switch(c)
+	while((c=getopt(argc,argv,"a:m:M:U:o:g:p:FDVCNns:u:B:I:O:E:f:S:T:cL:k:"
+		"K:r:iAP:ZR:x:X:W:t:w:H:G:Y:"))!=-1)switch(c)
 	{
 	case 'a':
-		dev.adapter=atoi(optarg);
+		setup.dev.adapter=atoi(optarg);
 		break;
 
 	case 'm':
-		dev.major=atoi(optarg);
+		setup.dev.major=atoi(optarg);
 		break;
 
 	case 'M':
-		dev.minbase=atoi(optarg);
+		setup.dev.minbase=atoi(optarg);
+		break;
+
+	case 'U':
+		setup.dev.units=atoi(optarg);
+		if(setup.dev.units<1||setup.dev.units>DVBCUSE_UNITS)usage();
 		break;
 
 	case 'o':
-		dev.owner=atoi(optarg);
+		setup.dev.owner=atoi(optarg);
 		break;
 
 	case 'g':
-		dev.group=atoi(optarg);
+		setup.dev.group=atoi(optarg);
 		break;
 
 	case 'p':
-		dev.perms=(int)strtol(optarg,NULL,8);
+		setup.dev.perms=(int)strtol(optarg,NULL,8);
 		break;
 
 	case 'F':
-		dev.fe_enabled=0;
+		setup.dev.fe_enabled=0;
 		break;
 
 	case 'D':
-		dev.dmx_enabled=0;
+		setup.dev.dmx_enabled=0;
 		break;
 
 	case 'V':
-		dev.dvr_enabled=0;
+		setup.dev.dvr_enabled=0;
 		break;
 
 	case 'C':
-		dev.ca_enabled=0;
+		setup.dev.ca_enabled=0;
 		break;
 
 	case 'N':
-		dev.net_enabled=0;
+		setup.dev.net_enabled=0;
+		break;
+
+	case 'n':
+		setup.net=1;
 		break;
 
 	case 's':
 		source=atoi(optarg);
 		break;
 
+	case 'u':
+		url=optarg;
+		break;
+
+	case 'B':
+		standby=optarg;
+		break;
+
+	case 'I':
+		if(swsrc_info(&setup.info,optarg))usage();
+		break;
+
+	case 'O':
+		setup.out=optarg;
+		break;
+
+	case 'E':
+		setup.sim=optarg;
+		break;
+
+	case 'f':
+		setup.fault=optarg;
+		break;
+
+	case 'S':
+		setup.pids=optarg;
+		break;
+
+	case 'T':
+		t2mi=optarg;
+		break;
+
+	case 'c':
+		setup.cache=0;
+		break;
+
+	case 'L':
+		setup.linger=atoi(optarg);
+		break;
+
+	case 'Y':
+		if(setup.pool||!(setup.pool=unicable_pool_create(optarg)))
+			usage();
+		break;
+
+	case 'H':
+		setup.epg=optarg;
+		break;
+
+	case 'G':
+		if((setup.dwell=atoi(optarg))<1)usage();
+		break;
+
+	case 'k':
+		if(cpus(optarg,&setup.dev.data_cpus))usage();
+		break;
+
+	case 'K':
+		if(cpus(optarg,&setup.dev.ctrl_cpus))usage();
+		break;
+
+	case 'r':
+		if((setup.dev.rt_prio=atoi(optarg))<1||setup.dev.rt_prio>99)
+			usage();
+		break;
+
+	case 'i':
+		setup.analyze=1;
+		break;
+
+	case 'A':
+		setup.dev.dvr_aligned=1;
+		setup.dev.dmx_aligned=1;
+		break;
+
+	case 'P':
+		program=atoi(optarg);
+		if(spts||!(spts=spts_create(program))||
+			!(t=stage_spts(spts)))usage();
+		stage_append(&stages,t);
+		break;
+
+	case 'Z':
+		if(!(t=stage_nullstrip()))usage();
+		stage_append(&stages,t);
+		break;
+
+	case 'R':
+		if(sscanf(optarg,"%i:%i",&from,&to)!=2)usage();
+		if(!t||stage_remap_add(t,from,to))
+		{
+			if(!(t=stage_remap()))usage();
+			stage_append(&stages,t);
+			if(stage_remap_add(t,from,to))usage();
+		}
+		break;
+
+	case 'X':
+		ctrl=optarg;
+		break;
+
+	case 'W':
+		loops.outdir=optarg;
+		break;
+
+	case 't':
+		tpath=optarg;
+		trace_enable(1);
+		break;
+
+	case 'w':
+		cpath=optarg;
+		break;
+
+	case 'x':
+		if(!t||stage_drop_add(t,strtol(optarg,NULL,0)))
+		{
+			if(!(t=stage_drop()))usage();
+			stage_append(&stages,t);
+			if(stage_drop_add(t,strtol(optarg,NULL,0)))usage();
+		}
+		break;
+
 	default:usage();
 	}
 
-	if(dev.adapter==source||!dev.major)usage();
+	if((!url&&setup.dev.adapter==source)||!setup.dev.major||
+		(t2mi&&standby)||(setup.sim&&(!url||standby))||
+		(setup.epg&&(url||standby||t2mi||setup.out))||
+		(setup.pool&&(url||standby||t2mi)))usage();
 
-	sprintf(dev.fe_pathname,"/dev/dvb/adapter%d/frontend0",source);
-	sprintf(dev.dmx_pathname,"/dev/dvb/adapter%d/demux0",source);
-	sprintf(dev.dvr_pathname,"/dev/dvb/adapter%d/dvr0",source);
-	sprintf(dev.ca_pathname,"/dev/dvb/adapter%d/ca0",source);
-	sprintf(dev.net_pathname,"/dev/dvb/adapter%d/net0",source);
+	sigemptyset(&set);
+	sigaddset(&set,SIGUSR1);
+	sigaddset(&set,SIGUSR2);
+	sigaddset(&set,SIGINT);
+	sigaddset(&set,SIGTERM);
+	sigaddset(&set,SIGHUP);
+	sigprocmask(SIG_BLOCK,&set,NULL);
 
-	dev.fe_open=sys_open;
-	dev.fe_close=sys_close;
-	dev.fe_ioctl=sys_ioctl;
-	dev.fe_poll=sys_poll;
+	if(pthread_mutex_init(&loops.mtx,NULL))return 1;
+	loops.setup=&setup;
 
-	dev.dmx_open=sys_open;
-	dev.dmx_read=sys_read;
-	dev.dmx_close=sys_close;
-	dev.dmx_ioctl=sys_ioctl;
-	dev.dmx_poll=sys_poll;
+	if(cpath&&capture_start(cpath))
+	{
+		fprintf(stderr,"can't write %s\n",cpath);
+		return 1;
+	}
 
-	dev.dvr_open=sys_open;
-	dev.dvr_read=sys_read;
-	dev.dvr_write=sys_write;
-	dev.dvr_close=sys_close;
-	dev.dvr_ioctl=sys_ioctl;
-	dev.dvr_poll=sys_poll;
+	if(t2mi)
+	{
+		if(t2setup(&loops,t2mi,url,source,stages,spts))
+		{
+			teardown(&loops);
+			return 1;
+		}
+	}
+	else if(!(loops.list=loop_create(&setup,setup.dev.adapter,
+		setup.dev.minbase,setup.dev.units,url,source,standby,stages,
+		spts)))return 1;
 
-	dev.ca_open=sys_open;
-	dev.ca_read=sys_read;
-	dev.ca_write=sys_write;
-	dev.ca_close=sys_close;
-	dev.ca_ioctl=sys_ioctl;
-	dev.ca_poll=sys_poll;
+	if(ctrl&&!(ctx=ctrl_create(ctrl,control,&loops)))
+	{
+		fprintf(stderr,"can't listen on %s\n",ctrl);
+		teardown(&loops);
+		return 1;
+	}
 
-	dev.net_open=sys_open;
-	dev.net_close=sys_close;
-	dev.net_ioctl=sys_ioctl;
+	setup.out=NULL;
+	setup.pids=NULL;
 
-	if((ctx=dvbcuse_create(&dev)))
+	while(!sigwait(&set,&sig)&&(sig==SIGUSR1||sig==SIGUSR2))
 	{
-		sigemptyset(&set);
-		sigsuspend(&set);
-
-		dvbcuse_destroy(ctx);
+		if(sig==SIGUSR2)
+		{
+			if(tpath&&tracedump(tpath))
+				fprintf(stderr,"can't write %s\n",tpath);
+			continue;
+		}
+		pthread_mutex_lock(&loops.mtx);
+		for(loop=loops.list;loop;loop=loop->next)
+		{
+			if(loops.list->next)fprintf(stderr,"adapter%d\n",
+				loop->dev.adapter);
+			stats(loop,stderr);
+		}
+		t2stats(&loops,stderr);
+		pthread_mutex_unlock(&loops.mtx);
 	}
-	else return 1;
+
+	ctrl_destroy(ctx);
+	teardown(&loops);
+	unicable_pool_destroy(setup.pool);
+	capture_stop();
+
+	pthread_mutex_destroy(&loops.mtx);
 
 	return 0;
 }
@@ -0,0 +1,508 @@
+/*
+ * Userspace dvb net device (MPE/ULE decapsulation into TUN interfaces)
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <sys/ioctl.h>
+#include <linux/dvb/dmx.h>
+#include <linux/dvb/net.h>
+#include <linux/if_tun.h>
+#include <linux/if_ether.h>
+
+#include <sys/eventfd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <poll.h>
+#include <pthread.h>
+
+#include "dvbcuse.h"
+#include "ts.h"
+#include "dvbnet.h"
+
+#define MAXIF		10
+#define MAXPDU		4096
+#define BATCH		256
+#define DMXBUFSIZE	(TS_SIZE*4096)
+
+#define MPE_TID		0x3e
+#define ULE_END		0xffff
+
+typedef struct
+{
+	int used;
+	int tun;
+	int dmx;
+	int pid;
+	int feedtype;
+	int cc;
+	int synced;
+	int fill;
+	char name[IFNAMSIZ];
+	unsigned long long pdus;
+	unsigned long long bytes;
+	unsigned long long errors;
+	uint8_t pdu[MAXPDU+TS_SIZE];
+} NETIF;
+
+typedef struct
+{
+	pthread_t th;
+	pthread_mutex_t mtx;
+	DVBCUSE_DEVICE *src;
+	const char *dmxpath;
+	int adapter;
+	int wake;
+	int stop;
+	NETIF netif[MAXIF];
+	uint8_t bfr[BATCH*TS_SIZE];
+} DVBNET;
+
+static void deliver(NETIF *n,int proto,const uint8_t *data,int len)
+{
+	struct tun_pi pi;
+	struct iovec iov[2];
+
+	if(!proto)switch(data[0]>>4)
+	{
+	case 4:	proto=ETH_P_IP;
+		break;
+	case 6:	proto=ETH_P_IPV6;
+		break;
+	default:n->errors++;
+		return;
+	}
+
+	pi.flags=0;
+	pi.proto=htons(proto);
+	iov[0].iov_base=&pi;
+	iov[0].iov_len=sizeof(pi);
+	iov[1].iov_base=(void *)data;
+	iov[1].iov_len=len;
+
+	if(writev(n->tun,iov,2)==-1)n->errors++;
+	else
+	{
+		n->pdus++;
+		n->bytes+=len;
+	}
+}
+
+static void mpe(NETIF *n,const uint8_t *s,int len)
+{
+	int hdr=12;
+	int proto=0;
+
+	if(s[0]!=MPE_TID||len<16||(s[5]&0x3c))
+	{
+		n->errors++;
+		return;
+	}
+
+	if((s[1]&0x80)&&ts_crc32(s,len))
+	{
+		n->errors++;
+		return;
+	}
+
+	if(s[5]&0x02)
+	{
+		if(len<hdr+8+4||s[hdr]!=0xaa||s[hdr+1]!=0xaa||s[hdr+2]!=0x03)
+		{
+			n->errors++;
+			return;
+		}
+		proto=(s[hdr+6]<<8)|s[hdr+7];
+		hdr+=8;
+	}
+
+	deliver(n,proto,s+hdr,len-hdr-4);
+}
+
+static void ule(NETIF *n,const uint8_t *s,int len)
+{
+	int hdr=4;
+	int type=(s[2]<<8)|s[3];
+
+	if(ts_crc32(s,len))
+	{
+		n->errors++;
+		return;
+	}
+
+	if(!(s[0]&0x80))hdr+=6;
+
+	if(type!=ETH_P_IP&&type!=ETH_P_IPV6)
+	{
+		n->errors++;
+		return;
+	}
+
+	deliver(n,type,s+hdr,len-hdr-4);
+}
+
+static int pdulen(NETIF *n)
+{
+	if(n->feedtype==DVB_NET_FEEDTYPE_ULE)
+	{
+		if(n->fill<2)return 0;
+		if(((n->pdu[0]<<8)|n->pdu[1])==ULE_END)return -1;
+		return (((n->pdu[0]&0x7f)<<8)|n->pdu[1])+4;
+	}
+
+	if(n->fill<3)return 0;
+	if(n->pdu[0]==0xff)return -1;
+	return SCT_LEN(n->pdu);
+}
+
+static void append(NETIF *n,const uint8_t *data,int len)
+{
+	int l;
+
+	if(n->fill+len>sizeof(n->pdu))
+	{
+		n->errors++;
+		n->fill=0;
+		n->synced=0;
+		return;
+	}
+	memcpy(n->pdu+n->fill,data,len);
+	n->fill+=len;
+
+	while(n->synced&&(l=pdulen(n)))
+	{
+		if(l<0||l>MAXPDU)
+		{
+			n->fill=0;
+			n->synced=0;
+			return;
+		}
+		if(n->fill<l)return;
+
+		if(n->feedtype==DVB_NET_FEEDTYPE_ULE)ule(n,n->pdu,l);
+		else mpe(n,n->pdu,l);
+
+		memmove(n->pdu,n->pdu+l,n->fill-l);
+		n->fill-=l;
+	}
+}
+
+static void packet(NETIF *n,const uint8_t *p)
+{
+	int off=4;
+	int cc=TS_CC(p);
+	int ptr;
+
+	if(TS_TEI(p)||!(TS_AFC(p)&1)||TS_PID(p)!=n->pid)return;
+	if(TS_AFC(p)&2)off+=p[4]+1;
+	if(off>=TS_SIZE)return;
+
+	if(n->cc!=-1&&cc!=((n->cc+1)&0xf))
+	{
+		if(cc==n->cc)return;
+		if(n->synced)n->errors++;
+		n->fill=0;
+		n->synced=0;
+	}
+	n->cc=cc;
+
+	if(TS_PUSI(p))
+	{
+		ptr=p[off++];
+		if(off+ptr>TS_SIZE)
+		{
+			n->fill=0;
+			n->synced=0;
+			return;
+		}
+		if(n->synced&&ptr)append(n,p+off,ptr);
+		n->fill=0;
+		n->synced=1;
+		off+=ptr;
+	}
+	else if(!n->synced)return;
+
+	append(n,p+off,TS_SIZE-off);
+}
+
+static void *reader(void *data)
+{
+	DVBNET *d=(DVBNET *)data;
+	struct pollfd p[MAXIF+1];
+	NETIF *map[MAXIF+1];
+	eventfd_t v;
+	ssize_t len;
+	int off;
+	int i;
+	int n;
+
+	while(!d->stop)
+	{
+		pthread_mutex_lock(&d->mtx);
+		p[0].fd=d->wake;
+		p[0].events=POLLIN;
+		for(n=1,i=0;i<MAXIF;i++)if(d->netif[i].used)
+		{
+			map[n]=&d->netif[i];
+			p[n].fd=d->netif[i].dmx;
+			p[n++].events=POLLIN;
+		}
+		pthread_mutex_unlock(&d->mtx);
+
+		if(poll(p,n,200)<1)continue;
+		if(p[0].revents&POLLIN)
+		{
+			eventfd_read(d->wake,&v);
+			continue;
+		}
+
+		pthread_mutex_lock(&d->mtx);
+		for(i=1;i<n;i++)if(p[i].revents&&map[i]->used&&
+			map[i]->dmx==p[i].fd)
+		{
+			if((len=d->src->dmx_read(d->src->user,p[i].fd,d->bfr,
+				sizeof(d->bfr)))<=0)
+			{
+				if(len<0&&errno==EOVERFLOW)
+				{
+					map[i]->errors++;
+					map[i]->fill=0;
+					map[i]->synced=0;
+				}
+				continue;
+			}
+			for(off=0;off+TS_SIZE<=len;off+=TS_SIZE)
+				packet(map[i],d->bfr+off);
+		}
+		pthread_mutex_unlock(&d->mtx);
+	}
+
+	pthread_exit(NULL);
+}
+
+static int tun(NETIF *n,int adapter,int num)
+{
+	struct ifreq ifr;
+
+	if((n->tun=open("/dev/net/tun",O_RDWR|O_CLOEXEC))==-1)return -1;
+
+	memset(&ifr,0,sizeof(ifr));
+	ifr.ifr_flags=IFF_TUN;
+	snprintf(ifr.ifr_name,IFNAMSIZ,"dvb%d_%d",adapter,num);
+
+	if(ioctl(n->tun,TUNSETIFF,&ifr)==-1)
+	{
+		close(n->tun);
+		return -1;
+	}
+
+	memcpy(n->name,ifr.ifr_name,IFNAMSIZ);
+	return 0;
+}
+
+static int demux(DVBNET *d,int pid)
+{
+	struct dmx_pes_filter_params pes;
+	int fd;
+
+	if((fd=d->src->dmx_open(d->src->user,d->dmxpath,O_RDONLY|O_NONBLOCK))
+		==-1)return -1;
+
+	d->src->dmx_ioctl(d->src->user,fd,DMX_SET_BUFFER_SIZE,
+		(void *)(unsigned long)DMXBUFSIZE);
+
+	memset(&pes,0,sizeof(pes));
+	pes.pid=pid;
+	pes.input=DMX_IN_FRONTEND;
+	pes.output=DMX_OUT_TSDEMUX_TAP;
+	pes.pes_type=DMX_PES_OTHER;
+	pes.flags=DMX_IMMEDIATE_START;
+
+	if(d->src->dmx_ioctl(d->src->user,fd,DMX_SET_PES_FILTER,&pes))
+	{
+		d->src->dmx_close(d->src->user,fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int ifadd(DVBNET *d,struct dvb_net_if *req)
+{
+	NETIF *n;
+	int i;
+
+	if(req->pid>=TS_NULLPID||(req->feedtype!=DVB_NET_FEEDTYPE_MPE&&
+		req->feedtype!=DVB_NET_FEEDTYPE_ULE))
+	{
+		errno=EINVAL;
+		return -1;
+	}
+
+	for(i=0;i<MAXIF;i++)if(!d->netif[i].used)break;
+	if(i==MAXIF)
+	{
+		errno=ENOSPC;
+		return -1;
+	}
+	n=&d->netif[i];
+
+	memset(n,0,sizeof(NETIF));
+	n->pid=req->pid;
+	n->feedtype=req->feedtype;
+	n->cc=-1;
+
+	if(tun(n,d->adapter,i))return -1;
+	if((n->dmx=demux(d,n->pid))==-1)
+	{
+		close(n->tun);
+		return -1;
+	}
+
+	n->used=1;
+	req->if_num=i;
+	eventfd_write(d->wake,1);
+
+	return 0;
+}
+
+static int ifdel(DVBNET *d,unsigned long num)
+{
+	NETIF *n;
+
+	if(num>=MAXIF||!d->netif[num].used)
+	{
+		errno=EINVAL;
+		return -1;
+	}
+	n=&d->netif[num];
+
+	n->used=0;
+	d->src->dmx_close(d->src->user,n->dmx);
+	close(n->tun);
+	eventfd_write(d->wake,1);
+
+	return 0;
+}
+
+/* the net device carries no data, an eventfd just provides a unique fd */
+int dvbnet_open(void *user,const char *pathname,int flags)
+{
+	return eventfd(0,EFD_CLOEXEC|EFD_NONBLOCK);
+}
+
+void dvbnet_close(void *user,int fd)
+{
+	close(fd);
+}
+
+int dvbnet_ioctl(void *user,int fd,unsigned long request,void *arg)
+{
+	DVBNET *d=(DVBNET *)user;
+	struct dvb_net_if *req=(struct dvb_net_if *)arg;
+	int r=0;
+
+	pthread_mutex_lock(&d->mtx);
+
+	switch(request)
+	{
+	case NET_ADD_IF:
+		r=ifadd(d,req);
+		break;
+
+	case NET_REMOVE_IF:
+		r=ifdel(d,(unsigned long)arg);
+		break;
+
+	case NET_GET_IF:
+		if(req->if_num>=MAXIF||!d->netif[req->if_num].used)
+		{
+			errno=EINVAL;
+			r=-1;
+			break;
+		}
+		req->pid=d->netif[req->if_num].pid;
+		req->feedtype=d->netif[req->if_num].feedtype;
+		break;
+
+	default:errno=EINVAL;
+		r=-1;
+		break;
+	}
+
+	pthread_mutex_unlock(&d->mtx);
+
+	return r;
+}
+
+void *dvbnet_create(DVBCUSE_DEVICE *src,const char *dmxpath,int adapter)
+{
+	DVBNET *d;
+
+	if(!(d=malloc(sizeof(DVBNET))))goto err1;
+	memset(d,0,sizeof(DVBNET));
+	d->src=src;
+	d->dmxpath=dmxpath;
+	d->adapter=adapter;
+
+	if((d->wake=eventfd(0,EFD_CLOEXEC|EFD_NONBLOCK))==-1)goto err2;
+	if(pthread_mutex_init(&d->mtx,NULL))goto err3;
+	if(pthread_create(&d->th,NULL,reader,d))goto err4;
+
+	return d;
+
+err4:	pthread_mutex_destroy(&d->mtx);
+err3:	close(d->wake);
+err2:	free(d);
+err1:	return NULL;
+}
+
+void dvbnet_destroy(void *ctx)
+{
+	DVBNET *d=(DVBNET *)ctx;
+	int i;
+
+	if(!d)return;
+
+	d->stop=1;
+	eventfd_write(d->wake,1);
+	pthread_join(d->th,NULL);
+
+	for(i=0;i<MAXIF;i++)if(d->netif[i].used)ifdel(d,i);
+
+	pthread_mutex_destroy(&d->mtx);
+	close(d->wake);
+	free(d);
+}
+
+void dvbnet_dump(void *ctx,FILE *fp,const char *prefix)
+{
+	DVBNET *d=(DVBNET *)ctx;
+	NETIF *n;
+	int i;
+
+	pthread_mutex_lock(&d->mtx);
+
+	for(i=0;i<MAXIF;i++)if((n=&d->netif[i])->used)
+		fprintf(fp,"%s if=%s pid=0x%04x type=%s pdus=%llu bytes=%llu "
+		"errors=%llu\n",prefix,n->name,n->pid,
+		n->feedtype==DVB_NET_FEEDTYPE_ULE?"ule":"mpe",n->pdus,n->bytes,
+		n->errors);
+
+	pthread_mutex_unlock(&d->mtx);
+}
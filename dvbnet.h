@@ -0,0 +1,23 @@
+/*
+ * Userspace dvb net device (MPE/ULE decapsulation into TUN interfaces)
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef DVBNET_H
+#define DVBNET_H
+
+extern void *dvbnet_create(DVBCUSE_DEVICE *src,const char *dmxpath,
+	int adapter);
+extern void dvbnet_destroy(void *ctx);
+extern void dvbnet_dump(void *ctx,FILE *fp,const char *prefix);
+extern int dvbnet_open(void *user,const char *pathname,int flags);
+extern void dvbnet_close(void *user,int fd);
+extern int dvbnet_ioctl(void *user,int fd,unsigned long request,void *arg);
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ * MPE/ULE decapsulation tests
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include "dvbnet.c"
+
+#define CHECK(x) do{if(!(x)){fprintf(stderr,"%s:%d: %s\n",__FILE__,\
+	__LINE__,#x);return -1;}}while(0)
+
+#define NETPID	0x200
+
+static NETIF n;
+static int rfd;
+
+static int setup(int feedtype)
+{
+	int fd[2];
+
+	memset(&n,0,sizeof(n));
+	if(pipe(fd))return -1;
+	fcntl(fd[0],F_SETFL,O_NONBLOCK);
+	rfd=fd[0];
+	n.tun=fd[1];
+	n.pid=NETPID;
+	n.cc=-1;
+	n.feedtype=feedtype;
+	return 0;
+}
+
+static void cleanup(void)
+{
+	close(rfd);
+	close(n.tun);
+}
+
+static void datagram(uint8_t *ip,int len)
+{
+	int i;
+
+	ip[0]=0x45;
+	for(i=1;i<len;i++)ip[i]=i;
+}
+
+static void crc(uint8_t *data,int len)
+{
+	uint32_t c=ts_crc32(data,len);
+
+	data[len]=c>>24;
+	data[len+1]=c>>16;
+	data[len+2]=c>>8;
+	data[len+3]=c;
+}
+
+static int mpesection(uint8_t *s,const uint8_t *ip,int len)
+{
+	int total=12+len+4;
+
+	s[0]=MPE_TID;
+	s[1]=0xb0|((total-3)>>8);
+	s[2]=(total-3)&0xff;
+	s[3]=0x02;
+	s[4]=0x01;
+	s[5]=0xc1;
+	s[6]=0x00;
+	s[7]=0x00;
+	s[8]=0x10;
+	s[9]=0x20;
+	s[10]=0x30;
+	s[11]=0x40;
+	memcpy(s+12,ip,len);
+	crc(s,12+len);
+	return total;
+}
+
+static int ulesndu(uint8_t *s,const uint8_t *ip,int len)
+{
+	s[0]=0x80|((len+4)>>8);
+	s[1]=(len+4)&0xff;
+	s[2]=ETH_P_IP>>8;
+	s[3]=ETH_P_IP&0xff;
+	memcpy(s+4,ip,len);
+	crc(s,4+len);
+	return 4+len+4;
+}
+
+/* feeds a PDU starting in a new packet and padded to the packet end */
+static void feed(const uint8_t *pdu,int len)
+{
+	uint8_t p[TS_SIZE];
+	int off;
+	int k;
+
+	for(off=0;off<len;off+=k)
+	{
+		memset(p,0xff,TS_SIZE);
+		p[0]=TS_SYNC;
+		p[1]=(off?0x00:0x40)|(NETPID>>8);
+		p[2]=NETPID&0xff;
+		p[3]=0x10|((n.cc+1)&0x0f);
+		if(!off)p[4]=0;
+		k=off?TS_SIZE-4:TS_SIZE-5;
+		if(k>len-off)k=len-off;
+		memcpy(p+(off?4:5),pdu+off,k);
+		packet(&n,p);
+	}
+}
+
+static int received(const uint8_t *ip,int len)
+{
+	uint8_t bfr[MAXPDU];
+	struct tun_pi pi;
+
+	if(read(rfd,bfr,sizeof(bfr))!=sizeof(pi)+len)return 0;
+	memcpy(&pi,bfr,sizeof(pi));
+	return pi.proto==htons(ETH_P_IP)&&!memcmp(bfr+sizeof(pi),ip,len);
+}
+
+static int mpetest(void)
+{
+	uint8_t ip[300];
+	uint8_t pdu[400];
+	int len;
+
+	CHECK(!setup(DVB_NET_FEEDTYPE_MPE));
+	datagram(ip,28);
+
+	len=mpesection(pdu,ip,28);
+	feed(pdu,len);
+	CHECK(received(ip,28));
+
+	datagram(ip,300);
+	len=mpesection(pdu,ip,300);
+	feed(pdu,len);
+	CHECK(received(ip,300));
+
+	pdu[20]^=0x01;
+	feed(pdu,len);
+	CHECK(!received(ip,300));
+	CHECK(n.pdus==2&&n.errors==1);
+
+	cleanup();
+
+	return 0;
+}
+
+static int uletest(void)
+{
+	uint8_t ip[300];
+	uint8_t pdu[400];
+	int len;
+
+	CHECK(!setup(DVB_NET_FEEDTYPE_ULE));
+
+	datagram(ip,28);
+	len=ulesndu(pdu,ip,28);
+	feed(pdu,len);
+	CHECK(received(ip,28));
+
+	datagram(ip,300);
+	len=ulesndu(pdu,ip,300);
+	feed(pdu,len);
+	CHECK(received(ip,300));
+
+	pdu[2]=ETH_P_ARP>>8;
+	pdu[3]=ETH_P_ARP&0xff;
+	crc(pdu,4+300);
+	feed(pdu,len);
+	CHECK(!received(ip,300));
+	CHECK(n.pdus==2&&n.errors==1);
+
+	cleanup();
+
+	return 0;
+}
+
+int main(int argc,char *argv[])
+{
+	if(mpetest()||uletest())return 1;
+	return 0;
+}
@@ -0,0 +1,430 @@
+/*
+ * Replay of captured dvbloopd backend requests against loop devices
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <linux/dvb/frontend.h>
+
+#include <sys/ioctl.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "capture.h"
+
+#define TYPES	5
+#define OPS	7
+#define BUFSIZE	(1024*1024)
+
+typedef struct
+{
+	CAPTURE_REC rec;
+	unsigned char *data;
+	uint64_t dur;
+	int64_t res;
+	int done;
+} ENTRY;
+
+typedef struct
+{
+	pthread_t th;
+	ENTRY **e;
+	int n;
+	int fd;
+	uint64_t late;
+} SESSION;
+
+typedef struct
+{
+	unsigned long long count;
+	unsigned long long skipped;
+	unsigned long long errors;
+	unsigned long long mismatch;
+	unsigned long long recsum;
+	unsigned long long recmax;
+	unsigned long long repsum;
+	unsigned long long repmax;
+} SUMMARY;
+
+static const char *types[TYPES]={"frontend","demux","dvr","ca","net"};
+static const char *ops[OPS]={NULL,"open","read","write","ioctl",NULL,
+	"close"};
+
+static uint64_t base;
+static double speed=1.0;
+static int offset;
+static int wait=5000;
+
+static uint64_t nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static void until(uint64_t t)
+{
+	struct timespec ts;
+
+	ts.tv_sec=t/1000000000ULL;
+	ts.tv_nsec=t%1000000000ULL;
+	while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,NULL)==EINTR);
+}
+
+static int cmp(const void *p1,const void *p2)
+{
+	const ENTRY *e1=*(const ENTRY **)p1;
+	const ENTRY *e2=*(const ENTRY **)p2;
+
+	if(e1->rec.sid!=e2->rec.sid)return e1->rec.sid<e2->rec.sid?-1:1;
+	if(e1->rec.ns!=e2->rec.ns)return e1->rec.ns<e2->rec.ns?-1:1;
+	return 0;
+}
+
+static int devopen(CAPTURE_REC *r)
+{
+	char path[64];
+
+	if(r->type==3||r->type==4)snprintf(path,sizeof(path),
+		"/dev/dvb/adapter%d/%s0",r->adapter+offset,types[r->type]);
+	else snprintf(path,sizeof(path),"/dev/dvb/adapter%d/%s%d",
+		r->adapter+offset,types[r->type],r->unit);
+
+	return open(path,r->arg);
+}
+
+static long long devread(int fd,void *buf,size_t count,int flags)
+{
+	struct pollfd p;
+	ssize_t len;
+	int r;
+
+	if(!(flags&O_NONBLOCK))
+	{
+		p.fd=fd;
+		p.events=POLLIN;
+		if(!(r=poll(&p,1,wait)))return -ETIMEDOUT;
+		else if(r<0)return -errno;
+	}
+
+	return (len=read(fd,buf,count))==-1?-errno:len;
+}
+
+static long long devwrite(int fd,void *buf,size_t count)
+{
+	unsigned char *p=(unsigned char *)buf;
+	ssize_t len;
+	size_t i;
+
+	memset(buf,0xff,count);
+	for(i=0;i+188<=count;i+=188)
+	{
+		p[i]=0x47;
+		p[i+1]=0x1f;
+		p[i+2]=0xff;
+		p[i+3]=0x10;
+	}
+
+	return (len=write(fd,buf,count))==-1?-errno:len;
+}
+
+static long long devioctl(int fd,CAPTURE_REC *r,unsigned char *data,
+	unsigned char *bfr)
+{
+	unsigned long request=r->arg;
+	struct dtv_properties props;
+	unsigned long long val=0;
+	void *arg=NULL;
+
+	switch(request)
+	{
+	case FE_SET_PROPERTY:
+	case FE_GET_PROPERTY:
+		props.num=r->len/sizeof(struct dtv_property);
+		props.props=(struct dtv_property *)bfr;
+		memcpy(bfr,data,r->len);
+		arg=&props;
+		break;
+
+	default:
+		if(_IOC_DIR(request)==_IOC_NONE)
+		{
+			if(r->len==sizeof(val))memcpy(&val,data,sizeof(val));
+			arg=(void *)(unsigned long)val;
+		}
+		else if(_IOC_SIZE(request)<=BUFSIZE)
+		{
+			memset(bfr,0,_IOC_SIZE(request));
+			if(r->len)memcpy(bfr,data,r->len<_IOC_SIZE(request)?
+				r->len:_IOC_SIZE(request));
+			arg=bfr;
+		}
+		break;
+	}
+
+	return ioctl(fd,request,arg)==-1?-errno:0;
+}
+
+static void *replay(void *data)
+{
+	SESSION *s=(SESSION *)data;
+	ENTRY *e;
+	unsigned char *bfr;
+	uint64_t due;
+	uint64_t now;
+	int flags=0;
+	int i;
+
+	if(!(bfr=malloc(BUFSIZE)))pthread_exit(NULL);
+
+	for(i=0;i<s->n;i++)
+	{
+		e=s->e[i];
+
+		if(s->fd==-1&&e->rec.op!=CAP_OPEN)continue;
+
+		due=base+(uint64_t)(e->rec.ns/speed);
+		if((now=nsecs())<due)until(due);
+		else if(now-due>s->late)s->late=now-due;
+
+		now=nsecs();
+		switch(e->rec.op)
+		{
+		case CAP_OPEN:
+			if(s->fd!=-1)continue;
+			if((s->fd=devopen(&e->rec))==-1)e->res=-errno;
+			else e->res=0;
+			flags=e->rec.arg;
+			break;
+
+		case CAP_READ:
+			e->res=devread(s->fd,bfr,e->rec.arg>BUFSIZE?BUFSIZE:
+				e->rec.arg,flags);
+			break;
+
+		case CAP_WRITE:
+			e->res=devwrite(s->fd,bfr,e->rec.arg>BUFSIZE?BUFSIZE:
+				e->rec.arg);
+			break;
+
+		case CAP_IOCTL:
+			e->res=devioctl(s->fd,&e->rec,e->data,bfr);
+			break;
+
+		case CAP_RELEASE:
+			close(s->fd);
+			s->fd=-1;
+			e->res=0;
+			break;
+
+		default:continue;
+		}
+		e->dur=nsecs()-now;
+		e->done=1;
+	}
+
+	if(s->fd!=-1)close(s->fd);
+	free(bfr);
+	pthread_exit(NULL);
+}
+
+static int load(FILE *fp,ENTRY **list,int *total)
+{
+	CAPTURE_HDR hdr;
+	ENTRY *e;
+	int max=0;
+
+	*list=NULL;
+	*total=0;
+
+	if(fread(&hdr,sizeof(hdr),1,fp)!=1||
+		memcmp(hdr.magic,CAPTURE_MAGIC,sizeof(hdr.magic))||
+		hdr.version!=CAPTURE_VERSION||hdr.recsize!=sizeof(CAPTURE_REC))
+		return -1;
+
+	while(1)
+	{
+		if(*total==max)
+		{
+			max+=4096;
+			if(!(e=realloc(*list,max*sizeof(ENTRY))))return -1;
+			*list=e;
+		}
+		e=&(*list)[*total];
+		memset(e,0,sizeof(ENTRY));
+
+		if(fread(&e->rec,sizeof(CAPTURE_REC),1,fp)!=1)break;
+		if(e->rec.len>CAPTURE_MAXDATA||e->rec.op>=OPS||
+			!ops[e->rec.op]||e->rec.type>=TYPES)return -1;
+		if(e->rec.len)
+		{
+			if(!(e->data=malloc(e->rec.len)))return -1;
+			if(fread(e->data,e->rec.len,1,fp)!=1)
+			{
+				free(e->data);
+				break;
+			}
+		}
+		(*total)++;
+	}
+
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,"Usage: dvbreplay [params] capture-file\n"
+	"-a offset       added to the captured adapter numbers\n"
+	"-s speed        replay speed factor (default 1.0)\n"
+	"-w msecs        wait limit for blocking reads (default 5000)\n"
+	"-v              print every request\n"
+	"Replays the requests dvbloopd -w captured against running loop\n"
+	"devices, e.g. dvbloopd -u gen:// -E lock=100 as synthetic backend,\n"
+	"and compares results and latencies per device type and request.\n");
+	exit(1);
+}
+
+int main(int argc,char *argv[])
+{
+	FILE *fp;
+	ENTRY *list;
+	ENTRY **idx;
+	SESSION *sess;
+	SUMMARY sum[TYPES][OPS];
+	SUMMARY *m;
+	ENTRY *e;
+	uint64_t late=0;
+	unsigned long long k;
+	int verbose=0;
+	int total;
+	int n;
+	int i;
+	int j;
+	int c;
+
+	while((c=getopt(argc,argv,"a:s:w:v"))!=-1)switch(c)
+	{
+	case 'a':
+		offset=atoi(optarg);
+		break;
+
+	case 's':
+		if((speed=strtod(optarg,NULL))<=0)usage();
+		break;
+
+	case 'w':
+		if((wait=atoi(optarg))<1)usage();
+		break;
+
+	case 'v':
+		verbose=1;
+		break;
+
+	default:usage();
+	}
+
+	if(optind!=argc-1)usage();
+
+	if(!(fp=fopen(argv[optind],"r")))
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+	if(load(fp,&list,&total))
+	{
+		fprintf(stderr,"%s: invalid capture\n",argv[optind]);
+		return 1;
+	}
+	fclose(fp);
+
+	if(!total)return 0;
+
+	if(!(idx=malloc(total*sizeof(ENTRY *))))return 1;
+	for(i=0;i<total;i++)idx[i]=&list[i];
+	qsort(idx,total,sizeof(ENTRY *),cmp);
+
+	for(n=1,i=1;i<total;i++)if(idx[i]->rec.sid!=idx[i-1]->rec.sid)n++;
+	if(!(sess=malloc(n*sizeof(SESSION))))return 1;
+	memset(sess,0,n*sizeof(SESSION));
+
+	for(j=-1,i=0;i<total;i++)
+	{
+		if(!i||idx[i]->rec.sid!=idx[i-1]->rec.sid)
+		{
+			sess[++j].e=&idx[i];
+			sess[j].fd=-1;
+		}
+		sess[j].n++;
+	}
+
+	base=nsecs()+10000000ULL;
+	for(i=0;i<n;i++)if(pthread_create(&sess[i].th,NULL,replay,&sess[i]))
+	{
+		perror("pthread_create");
+		return 1;
+	}
+	for(i=0;i<n;i++)
+	{
+		pthread_join(sess[i].th,NULL);
+		if(sess[i].late>late)late=sess[i].late;
+	}
+
+	memset(sum,0,sizeof(sum));
+
+	for(i=0;i<total;i++)
+	{
+		e=idx[i];
+		m=&sum[e->rec.type][e->rec.op];
+		m->count++;
+		if(!e->done)
+		{
+			m->skipped++;
+			continue;
+		}
+		if(e->res<0)m->errors++;
+		if(e->rec.op==CAP_READ?(e->res<0)!=(e->rec.res<0):
+			e->res!=e->rec.res)m->mismatch++;
+		m->recsum+=e->rec.dur;
+		m->repsum+=e->dur;
+		if(e->rec.dur>m->recmax)m->recmax=e->rec.dur;
+		if(e->dur>m->repmax)m->repmax=e->dur;
+
+		if(verbose)printf("%llu adapter%d %s%d %s 0x%llx res=%lld/%lld "
+			"us=%llu/%llu\n",(unsigned long long)e->rec.ns/1000,
+			e->rec.adapter,types[e->rec.type],e->rec.unit,
+			ops[e->rec.op],(unsigned long long)e->rec.arg,
+			(long long)e->rec.res,(long long)e->res,
+			(unsigned long long)e->rec.dur/1000,
+			(unsigned long long)e->dur/1000);
+	}
+
+	for(i=0;i<TYPES;i++)for(j=0;j<OPS;j++)if((m=&sum[i][j])->count)
+	{
+		k=m->count-m->skipped;
+		printf("%s %s count=%llu skipped=%llu errors=%llu "
+			"mismatch=%llu captured_avg_us=%llu "
+			"captured_max_us=%llu replay_avg_us=%llu "
+			"replay_max_us=%llu\n",types[i],ops[j],m->count,
+			m->skipped,m->errors,m->mismatch,
+			k?m->recsum/k/1000:0,m->recmax/1000,
+			k?m->repsum/k/1000:0,m->repmax/1000);
+	}
+	printf("sessions=%d requests=%d max_late_us=%llu\n",n,total,
+		(unsigned long long)late/1000);
+
+	return 0;
+}
@@ -0,0 +1,556 @@
+/*
+ * Background EPG harvesting on idle source tuners
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <linux/dvb/frontend.h>
+#include <linux/dvb/dmx.h>
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "dvbcuse.h"
+#include "ts.h"
+#include "swsrc.h"
+#include "psicache.h"
+#include "epg.h"
+
+#define MAXXPDR		256
+#define LOCKWAIT	3000000000ULL
+#define REST		600000000000ULL
+#define STEP		20000
+#define CACHESIZE	(16*1024*1024)
+#define SCTBUF		8192
+#define IFMIN		950000
+#define IFMAX		2150000
+
+static const int pids[3]={0x10,0x11,0x12};
+
+typedef struct
+{
+	SWSRC_INFO info;
+	int voltage;
+	int tone;
+	int bw;
+	int stream;
+} XPDR;
+
+typedef struct
+{
+	pthread_t th;
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	DVBCUSE_DEVICE *src;
+	void *cache;
+	uint64_t dwell;
+	uint64_t idle;
+	uint64_t since;
+	int stop;
+	int users;
+	int active;
+	int n;
+	int cur;
+	unsigned long long cycles;
+	unsigned long long locks;
+	unsigned long long failures;
+	unsigned long long aborts;
+	unsigned long long sections;
+	char fe[PATH_MAX];
+	char dmx[PATH_MAX];
+	XPDR list[MAXXPDR];
+} EPG;
+
+static uint64_t nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static int busy(EPG *e)
+{
+	int r;
+
+	pthread_mutex_lock(&e->mtx);
+	r=e->users||e->stop;
+	pthread_mutex_unlock(&e->mtx);
+
+	return r;
+}
+
+static int other(uint8_t *sct,int len)
+{
+	uint32_t crc;
+
+	switch(SCT_TID(sct))
+	{
+	case 0x40:
+		sct[0]=0x41;
+		break;
+	case 0x42:
+		sct[0]=0x46;
+		break;
+	case 0x4e:
+		sct[0]=0x4f;
+		break;
+	case 0x41:
+	case 0x46:
+	case 0x4a:
+	case 0x4f:
+		return 0;
+	default:if(SCT_TID(sct)>=0x60&&SCT_TID(sct)<=0x6f)return 0;
+		if(SCT_TID(sct)<0x50||SCT_TID(sct)>0x5f)return -1;
+		sct[0]+=0x10;
+		break;
+	}
+
+	crc=ts_crc32(sct,len-4);
+	sct[len-4]=crc>>24;
+	sct[len-3]=(crc>>16)&0xff;
+	sct[len-2]=(crc>>8)&0xff;
+	sct[len-1]=crc&0xff;
+
+	return 0;
+}
+
+static int tune(EPG *e,int fd,XPDR *x)
+{
+	DVBCUSE_DEVICE *src=e->src;
+	struct dtv_property p[8];
+	struct dtv_properties props;
+	fe_status_t status;
+	uint64_t start;
+	int n=0;
+
+	if(x->voltage!=-1&&src->fe_ioctl(src->user,fd,FE_SET_VOLTAGE,
+		(void *)(long)x->voltage))return -1;
+	if(x->tone!=-1&&src->fe_ioctl(src->user,fd,FE_SET_TONE,
+		(void *)(long)x->tone))return -1;
+
+	memset(p,0,sizeof(p));
+	p[n++].cmd=DTV_CLEAR;
+	p[n].cmd=DTV_DELIVERY_SYSTEM;
+	p[n++].u.data=x->info.delsys;
+	p[n].cmd=DTV_FREQUENCY;
+	p[n++].u.data=x->info.frequency;
+	if(x->info.symbol_rate)
+	{
+		p[n].cmd=DTV_SYMBOL_RATE;
+		p[n++].u.data=x->info.symbol_rate;
+	}
+	if(x->bw)
+	{
+		p[n].cmd=DTV_BANDWIDTH_HZ;
+		p[n++].u.data=x->bw;
+	}
+	if(x->stream!=-1)
+	{
+		p[n].cmd=DTV_STREAM_ID;
+		p[n++].u.data=x->stream;
+	}
+	p[n++].cmd=DTV_TUNE;
+
+	props.num=n;
+	props.props=p;
+	if(src->fe_ioctl(src->user,fd,FE_SET_PROPERTY,&props))return -1;
+
+	for(start=nsecs();nsecs()-start<LOCKWAIT;usleep(STEP))
+	{
+		if(busy(e))return 1;
+		if(!src->fe_ioctl(src->user,fd,FE_READ_STATUS,&status)&&
+			(status&FE_HAS_LOCK))return 0;
+	}
+
+	return -1;
+}
+
+static int split(EPG *e,int tag,int pid,uint8_t *bfr,int len,
+	unsigned long long *total)
+{
+	uint8_t *p=bfr;
+	uint8_t *end=bfr+len;
+	int n;
+
+	for(;end-p>=3&&*p!=0xff&&end-p>=(n=SCT_LEN(p));p+=n)
+		if(n>=12&&!other(p,n))
+	{
+		psicache_add(e->cache,tag,pid,p,n);
+		(*total)++;
+	}
+
+	if(p==end||*p==0xff)return 0;
+	memmove(bfr,p,end-p);
+	return end-p;
+}
+
+static int harvest(EPG *e,int tag,int *fds,unsigned long long *total)
+{
+	DVBCUSE_DEVICE *src=e->src;
+	uint8_t bfr[3][SCTBUF];
+	int fill[3]={0,0,0};
+	uint64_t start;
+	ssize_t len;
+	int i;
+
+	for(start=nsecs();nsecs()-start<e->dwell;usleep(STEP))
+	{
+		if(busy(e))return 1;
+
+		for(i=0;i<3;i++)while((len=src->dmx_read(src->user,fds[i],
+			bfr[i]+fill[i],SCTBUF-fill[i]))>0||
+			(len==-1&&errno==EOVERFLOW))
+		{
+			if(len>0)fill[i]=split(e,tag,pids[i],bfr[i],
+				fill[i]+len,total);
+			else fill[i]=0;
+		}
+	}
+
+	return 0;
+}
+
+static int visit(EPG *e,XPDR *x,unsigned long long *total)
+{
+	DVBCUSE_DEVICE *src=e->src;
+	struct dmx_sct_filter_params flt;
+	int fds[3]={-1,-1,-1};
+	int fd;
+	int r=-1;
+	int i;
+
+	if((fd=src->fe_open(src->user,e->fe,O_RDWR|O_NONBLOCK))==-1)
+		return -1;
+
+	if((r=tune(e,fd,x)))goto out;
+
+	psicache_expire(e->cache,x-e->list+1);
+
+	for(i=0;i<3;i++)
+	{
+		if((fds[i]=src->dmx_open(src->user,e->dmx,
+			O_RDONLY|O_NONBLOCK))==-1)goto out;
+		src->dmx_ioctl(src->user,fds[i],DMX_SET_BUFFER_SIZE,
+			(void *)(long)(1024*1024));
+		memset(&flt,0,sizeof(flt));
+		flt.pid=pids[i];
+		flt.flags=DMX_CHECK_CRC|DMX_IMMEDIATE_START;
+		if(src->dmx_ioctl(src->user,fds[i],DMX_SET_FILTER,&flt))
+			goto out;
+	}
+
+	r=harvest(e,x-e->list+1,fds,total);
+
+out:	for(i=0;i<3;i++)if(fds[i]!=-1)src->dmx_close(src->user,fds[i]);
+	src->fe_close(src->user,fd);
+	return r;
+}
+
+static void *worker(void *data)
+{
+	EPG *e=(EPG *)data;
+	unsigned long long total;
+	struct timespec ts;
+	sigset_t set;
+	uint64_t next=0;
+	uint64_t now;
+	uint64_t t;
+	int r;
+
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK,&set,NULL);
+
+	pthread_mutex_lock(&e->mtx);
+
+	while(!e->stop)
+	{
+		now=nsecs();
+		if(e->users||now-e->since<e->idle||now<next)
+		{
+			t=now+1000000000ULL;
+			if(!e->users&&e->since+e->idle>now&&e->since+e->idle<t)
+				t=e->since+e->idle;
+			if(next>now&&next<t)t=next;
+			ts.tv_sec=t/1000000000ULL;
+			ts.tv_nsec=t%1000000000ULL;
+			pthread_cond_timedwait(&e->cond,&e->mtx,&ts);
+			continue;
+		}
+
+		e->active=1;
+		pthread_mutex_unlock(&e->mtx);
+
+		total=0;
+		r=visit(e,&e->list[e->cur],&total);
+
+		pthread_mutex_lock(&e->mtx);
+		e->active=0;
+		pthread_cond_broadcast(&e->cond);
+
+		e->sections+=total;
+		if(r==1)
+		{
+			e->aborts++;
+			continue;
+		}
+		if(r)e->failures++;
+		else e->locks++;
+
+		if(++e->cur==e->n)
+		{
+			e->cur=0;
+			e->cycles++;
+			next=nsecs()+REST;
+		}
+	}
+
+	pthread_mutex_unlock(&e->mtx);
+
+	pthread_exit(NULL);
+}
+
+static int satellite(int delsys)
+{
+	switch(delsys)
+	{
+	case SYS_DVBS:
+	case SYS_DVBS2:
+	case SYS_TURBO:
+	case SYS_ISDBS:
+	case SYS_DSS:
+		return 1;
+	default:return 0;
+	}
+}
+
+/* satellite frequencies above the IF range are transponder frequencies,
+   lof=lo:hi:switch or lof=single in kHz, default universal LNB */
+static int parse(XPDR *x,char *line)
+{
+	unsigned int lof[3]={9750000,10600000,11700000};
+	unsigned int f;
+	char rest[256];
+	char *item;
+	char *val;
+	char *mem;
+	int n;
+
+	memset(x,0,sizeof(XPDR));
+	x->voltage=-1;
+	x->tone=-1;
+	x->stream=-1;
+	x->info.delsys=SYS_DVBS2;
+	*rest=0;
+
+	for(item=strtok_r(line,",",&mem);item;item=strtok_r(NULL,",",&mem))
+	{
+		if(!(val=strchr(item,'=')))return -1;
+
+		if(!strncmp(item,"pol=",4))switch(val[1])
+		{
+		case 'v':
+		case 'V':
+		case 'r':
+		case 'R':
+			x->voltage=SEC_VOLTAGE_13;
+			break;
+		case 'h':
+		case 'H':
+		case 'l':
+		case 'L':
+			x->voltage=SEC_VOLTAGE_18;
+			break;
+		default:return -1;
+		}
+		else if(!strncmp(item,"band=",5))
+		{
+			if(!strcmp(val+1,"hi"))x->tone=SEC_TONE_ON;
+			else if(!strcmp(val+1,"lo"))x->tone=SEC_TONE_OFF;
+			else return -1;
+		}
+		else if(!strncmp(item,"bw=",3))x->bw=strtoul(val+1,NULL,0);
+		else if(!strncmp(item,"stream=",7))x->stream=atoi(val+1);
+		else if(!strncmp(item,"lof=",4))
+		{
+			n=sscanf(val+1,"%u:%u:%u",&lof[0],&lof[1],&lof[2]);
+			if(n==1)
+			{
+				lof[1]=lof[0];
+				lof[2]=0;
+			}
+			else if(n!=3)return -1;
+		}
+		else if(strlen(rest)+strlen(item)+2>sizeof(rest))return -1;
+		else
+		{
+			if(*rest)strcat(rest,",");
+			strcat(rest,item);
+		}
+	}
+
+	if(swsrc_info(&x->info,rest)||!x->info.frequency)return -1;
+
+	if(!satellite(x->info.delsys))return 0;
+
+	if(x->info.frequency>IFMAX)
+	{
+		if(x->tone==-1&&lof[2])x->tone=x->info.frequency>=lof[2]?
+			SEC_TONE_ON:SEC_TONE_OFF;
+		f=lof[x->tone==SEC_TONE_ON?1:0];
+		x->info.frequency=x->info.frequency>f?x->info.frequency-f:
+			f-x->info.frequency;
+	}
+
+	return x->info.frequency<IFMIN||x->info.frequency>IFMAX?-1:0;
+}
+
+static int load(EPG *e,const char *list)
+{
+	FILE *fp;
+	char line[256];
+	char *p;
+
+	if(!(fp=fopen(list,"r")))return -1;
+
+	while(fgets(line,sizeof(line),fp))
+	{
+		if((p=strpbrk(line,"#\r\n")))*p=0;
+		if(!*line)continue;
+
+		if(e->n==MAXXPDR||parse(&e->list[e->n++],line))
+		{
+			fclose(fp);
+			errno=EINVAL;
+			return -1;
+		}
+	}
+
+	fclose(fp);
+
+	if(!e->n)
+	{
+		errno=EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+void *epg_create(DVBCUSE_DEVICE *src,const char *fe,const char *dmx,
+	const char *list,int dwell,int idle,void *cache)
+{
+	EPG *e;
+	pthread_condattr_t attr;
+
+	if(dwell<1||idle<0||strlen(fe)>=PATH_MAX||strlen(dmx)>=PATH_MAX)
+	{
+		errno=EINVAL;
+		goto err1;
+	}
+
+	if(!(e=malloc(sizeof(EPG))))goto err1;
+	memset(e,0,sizeof(EPG));
+	e->src=src;
+	e->cache=cache;
+	psicache_limit(cache,CACHESIZE);
+	e->dwell=dwell*1000000000ULL;
+	e->idle=idle*1000000ULL;
+	e->since=nsecs();
+	strcpy(e->fe,fe);
+	strcpy(e->dmx,dmx);
+
+	if(load(e,list))goto err2;
+
+	if(pthread_condattr_init(&attr))goto err2;
+	if(pthread_condattr_setclock(&attr,CLOCK_MONOTONIC)||
+		pthread_cond_init(&e->cond,&attr))
+	{
+		pthread_condattr_destroy(&attr);
+		goto err2;
+	}
+	pthread_condattr_destroy(&attr);
+
+	if(pthread_mutex_init(&e->mtx,NULL))goto err3;
+	if(pthread_create(&e->th,NULL,worker,e))goto err4;
+
+	return e;
+
+err4:	pthread_mutex_destroy(&e->mtx);
+err3:	pthread_cond_destroy(&e->cond);
+err2:	free(e);
+err1:	return NULL;
+}
+
+void epg_destroy(void *ctx)
+{
+	EPG *e=(EPG *)ctx;
+
+	if(!e)return;
+
+	pthread_mutex_lock(&e->mtx);
+	e->stop=1;
+	pthread_cond_broadcast(&e->cond);
+	pthread_mutex_unlock(&e->mtx);
+
+	pthread_join(e->th,NULL);
+	pthread_mutex_destroy(&e->mtx);
+	pthread_cond_destroy(&e->cond);
+	free(e);
+}
+
+void epg_claim(void *ctx)
+{
+	EPG *e=(EPG *)ctx;
+
+	pthread_mutex_lock(&e->mtx);
+	e->users++;
+	while(e->active)pthread_cond_wait(&e->cond,&e->mtx);
+	pthread_mutex_unlock(&e->mtx);
+}
+
+void epg_unclaim(void *ctx)
+{
+	EPG *e=(EPG *)ctx;
+
+	pthread_mutex_lock(&e->mtx);
+	if(!--e->users)
+	{
+		e->since=nsecs();
+		pthread_cond_broadcast(&e->cond);
+	}
+	pthread_mutex_unlock(&e->mtx);
+}
+
+void epg_dump(void *ctx,FILE *fp,const char *prefix)
+{
+	EPG *e=(EPG *)ctx;
+	size_t bytes;
+	int n;
+
+	psicache_usage(e->cache,&bytes,&n);
+
+	pthread_mutex_lock(&e->mtx);
+	fprintf(fp,"%s transponders=%d next=%d active=%d users=%d cycles=%llu "
+		"locks=%llu failures=%llu aborts=%llu sections=%llu "
+		"cached=%d/%zu\n",prefix,e->n,e->cur,e->active,e->users,
+		e->cycles,e->locks,e->failures,e->aborts,e->sections,n,bytes);
+	pthread_mutex_unlock(&e->mtx);
+}
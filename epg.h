@@ -0,0 +1,22 @@
+/*
+ * Background EPG harvesting on idle source tuners
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef EPG_H
+#define EPG_H
+
+extern void *epg_create(DVBCUSE_DEVICE *src,const char *fe,const char *dmx,
+	const char *list,int dwell,int idle,void *cache);
+extern void epg_destroy(void *ctx);
+extern void epg_claim(void *ctx);
+extern void epg_unclaim(void *ctx);
+extern void epg_dump(void *ctx,FILE *fp,const char *prefix);
+
+#endif
@@ -0,0 +1,358 @@
+/*
+ * Primary/standby source failover
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "dvbcuse.h"
+#include "ts.h"
+#include "udpsrc.h"
+#include "hwsrc.h"
+#include "swsrc.h"
+#include "failover.h"
+
+#define RINGPKTS	8192
+#define HISTORY		4
+#define WINDOW		250000000ULL
+#define SILENCE		300000000ULL
+#define ALIGNWAIT	500000000ULL
+#define MAXERRORS	8
+
+typedef struct
+{
+	struct _failover *fo;
+	void *udp;
+	void *hw;
+	int bad;
+	int errors;
+	uint64_t window;
+	uint64_t lastdata;
+	unsigned int wpos;
+	unsigned long long pkts;
+	unsigned long long ccerr;
+	unsigned long long tei;
+	unsigned long long lost;
+	uint8_t cc[8192];
+	uint8_t *ring;
+	char spec[256];
+} INPUT;
+
+typedef struct _failover
+{
+	pthread_mutex_t mtx;
+	void *swsrc;
+	int active;
+	int pending;
+	uint64_t pendsince;
+	unsigned int mark;
+	unsigned int amark;
+	int hist;
+	unsigned long long switches;
+	unsigned long long aligned;
+	unsigned long long gaps;
+	unsigned long long dropped;
+	uint8_t last[HISTORY][TS_SIZE];
+	INPUT in[2];
+} FAILOVER;
+
+static uint64_t nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static int check(INPUT *in,const uint8_t *p)
+{
+	int pid=TS_PID(p);
+	int err=0;
+
+	in->pkts++;
+
+	if(TS_TEI(p))
+	{
+		in->tei++;
+		err=1;
+	}
+	else if(pid!=TS_NULLPID&&(TS_AFC(p)&1))
+	{
+		if(in->cc[pid]&0x10&&TS_CC(p)!=((in->cc[pid]+1)&0x0f)&&
+			TS_CC(p)!=(in->cc[pid]&0x0f)&&!((TS_AFC(p)&2)&&p[4]&&
+			(p[5]&0x80)))
+		{
+			in->ccerr++;
+			err=1;
+		}
+		in->cc[pid]=0x10|TS_CC(p);
+	}
+
+	if(err)in->errors++;
+
+	return err;
+}
+
+static int state(INPUT *in,uint64_t now)
+{
+	return !in->bad&&(!in->hw||hwsrc_locked(in->hw))&&
+		now-in->lastdata<SILENCE;
+}
+
+static int healthy(INPUT *in,uint64_t now)
+{
+	if(now-in->window>=WINDOW)
+	{
+		in->bad=in->errors>MAXERRORS;
+		in->errors=0;
+		in->window=now;
+	}
+	return state(in,now);
+}
+
+static void suspect(FAILOVER *fo,INPUT *standby,uint64_t now)
+{
+	fo->pending=1;
+	fo->pendsince=now;
+	fo->mark=standby->wpos;
+	fo->amark=fo->in[fo->active].wpos;
+}
+
+static void emit(FAILOVER *fo,INPUT *in,unsigned int from)
+{
+	unsigned int n=in->wpos-from;
+	unsigned int idx=from&(RINGPKTS-1);
+
+	if(!n)return;
+	if(idx+n>RINGPKTS)
+	{
+		swsrc_feed(fo->swsrc,in->ring+idx*TS_SIZE,
+			(RINGPKTS-idx)*TS_SIZE);
+		n-=RINGPKTS-idx;
+		idx=0;
+	}
+	swsrc_feed(fo->swsrc,in->ring+idx*TS_SIZE,n*TS_SIZE);
+}
+
+static int align(FAILOVER *fo,INPUT *in)
+{
+	unsigned int pos;
+	unsigned int lim;
+	int i;
+
+	if(fo->hist<HISTORY)return -1;
+
+	lim=in->wpos>RINGPKTS?in->wpos-RINGPKTS+HISTORY:HISTORY;
+
+	for(pos=in->wpos;pos>=lim;pos--)
+	{
+		for(i=0;i<HISTORY;i++)if(memcmp(in->ring+((pos-1-i)&
+			(RINGPKTS-1))*TS_SIZE,fo->last[HISTORY-1-i],TS_SIZE))
+				break;
+		if(i==HISTORY)return pos;
+	}
+
+	return -1;
+}
+
+static void feed(void *user,const void *buf,size_t len)
+{
+	INPUT *in=(INPUT *)user;
+	FAILOVER *fo=in->fo;
+	INPUT *other;
+	const uint8_t *p=(const uint8_t *)buf;
+	const uint8_t *e=p+len;
+	unsigned int gap;
+	uint64_t now=nsecs();
+	int act;
+	int pos;
+
+	pthread_mutex_lock(&fo->mtx);
+
+	act=(in==&fo->in[fo->active]);
+	other=&fo->in[act?!fo->active:fo->active];
+
+	while(e-p>=TS_SIZE)
+	{
+		if(*p!=TS_SYNC)
+		{
+			if(!(p=memchr(p+1,TS_SYNC,e-p-1)))break;
+			continue;
+		}
+
+		if(!check(in,p)&&TS_PID(p)!=TS_NULLPID&&act)
+		{
+			memmove(fo->last[0],fo->last[1],(HISTORY-1)*TS_SIZE);
+			memcpy(fo->last[HISTORY-1],p,TS_SIZE);
+			if(fo->hist<HISTORY)fo->hist++;
+		}
+
+		if(TS_PID(p)!=TS_NULLPID)memcpy(in->ring+
+			(in->wpos++&(RINGPKTS-1))*TS_SIZE,p,TS_SIZE);
+
+		p+=TS_SIZE;
+	}
+
+	in->lastdata=now;
+
+	if(act)
+	{
+		swsrc_feed(fo->swsrc,buf,len);
+		if(!fo->pending&&!healthy(in,now)&&healthy(other,now))
+			suspect(fo,other,now);
+	}
+	else if(!fo->pending)
+	{
+		if(!healthy(other,now)&&healthy(in,now))suspect(fo,in,now);
+	}
+
+	if(!act&&fo->pending)
+	{
+		if((pos=align(fo,in))!=-1)
+		{
+			emit(fo,in,pos);
+			fo->aligned++;
+		}
+		else if(now-fo->pendsince>=ALIGNWAIT)
+		{
+			/* skip what the active input delivered while pending */
+			gap=other->wpos-fo->amark;
+			if(gap>in->wpos-fo->mark)gap=in->wpos-fo->mark;
+			fo->mark+=gap;
+			if((gap=in->wpos-fo->mark)>RINGPKTS)
+			{
+				fo->dropped+=gap-RINGPKTS;
+				swsrc_lost(fo->swsrc,gap-RINGPKTS);
+				fo->mark=in->wpos-RINGPKTS;
+			}
+			emit(fo,in,fo->mark);
+			fo->gaps++;
+		}
+		else goto out;
+
+		fo->active=!fo->active;
+		fo->pending=0;
+		fo->hist=0;
+		fo->switches++;
+	}
+
+out:	pthread_mutex_unlock(&fo->mtx);
+}
+
+static void lost(void *user,unsigned int pkts)
+{
+	INPUT *in=(INPUT *)user;
+	FAILOVER *fo=in->fo;
+	int act;
+
+	pthread_mutex_lock(&fo->mtx);
+	in->lost+=pkts;
+	in->errors+=pkts;
+	act=(in==&fo->in[fo->active]);
+	pthread_mutex_unlock(&fo->mtx);
+
+	if(act)swsrc_lost(fo->swsrc,pkts);
+}
+
+static int input(FAILOVER *fo,INPUT *in,const char *spec)
+{
+	TS_SINK sink;
+
+	in->fo=fo;
+
+	if(strlen(spec)>=sizeof(in->spec))goto err1;
+	strcpy(in->spec,spec);
+	if(!(in->ring=malloc(RINGPKTS*TS_SIZE)))goto err1;
+
+	sink.feed=feed;
+	sink.lost=lost;
+	sink.user=in;
+
+	if(!strstr(spec,"://"))
+	{
+		if(!(in->hw=hwsrc_create(atoi(spec),&sink)))goto err2;
+	}
+	else if(!(in->udp=udpsrc_create(spec,&sink)))goto err2;
+
+	return 0;
+
+err2:	free(in->ring);
+err1:	return -1;
+}
+
+static void release(INPUT *in)
+{
+	hwsrc_destroy(in->hw);
+	udpsrc_destroy(in->udp);
+	free(in->ring);
+}
+
+void *failover_create(const char *primary,const char *standby,void *swsrc)
+{
+	FAILOVER *fo;
+
+	if(!(fo=malloc(sizeof(FAILOVER))))goto err1;
+	memset(fo,0,sizeof(FAILOVER));
+	fo->swsrc=swsrc;
+
+	if(pthread_mutex_init(&fo->mtx,NULL))goto err2;
+	if(input(fo,&fo->in[0],primary))goto err3;
+	if(input(fo,&fo->in[1],standby))goto err4;
+
+	return fo;
+
+err4:	release(&fo->in[0]);
+err3:	pthread_mutex_destroy(&fo->mtx);
+err2:	free(fo);
+err1:	return NULL;
+}
+
+void failover_destroy(void *ctx)
+{
+	FAILOVER *fo=(FAILOVER *)ctx;
+
+	if(!fo)return;
+
+	release(&fo->in[1]);
+	release(&fo->in[0]);
+	pthread_mutex_destroy(&fo->mtx);
+	free(fo);
+}
+
+void failover_dump(void *ctx,FILE *fp,const char *prefix)
+{
+	FAILOVER *fo=(FAILOVER *)ctx;
+	uint64_t now=nsecs();
+	int i;
+
+	pthread_mutex_lock(&fo->mtx);
+
+	fprintf(fp,"%s active=%s pending=%d switches=%llu aligned=%llu "
+		"gaps=%llu dropped=%llu\n",prefix,fo->in[fo->active].spec,
+		fo->pending,fo->switches,fo->aligned,fo->gaps,fo->dropped);
+
+	for(i=0;i<2;i++)fprintf(fp,"%s %s %s packets=%llu cc_errors=%llu "
+		"tei=%llu lost=%llu healthy=%d\n",prefix,i?"standby":"primary",
+		fo->in[i].spec,fo->in[i].pkts,fo->in[i].ccerr,fo->in[i].tei,
+		fo->in[i].lost,state(&fo->in[i],now));
+
+	pthread_mutex_unlock(&fo->mtx);
+
+	for(i=0;i<2;i++)if(fo->in[i].udp)udpsrc_dump(fo->in[i].udp,fp,prefix);
+}
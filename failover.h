@@ -0,0 +1,20 @@
+/*
+ * Primary/standby source failover
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef FAILOVER_H
+#define FAILOVER_H
+
+extern void *failover_create(const char *primary,const char *standby,
+	void *swsrc);
+extern void failover_destroy(void *ctx);
+extern void failover_dump(void *ctx,FILE *fp,const char *prefix);
+
+#endif
@@ -0,0 +1,785 @@
+/*
+ * Fault and latency injecting backend wrapper
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <stdio.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "dvbcuse.h"
+#include "ts.h"
+#include "faultwrap.h"
+
+#define RD		0
+#define WR		1
+#define IO		2
+
+#define F_AGAIN		1
+#define F_OVERFLOW	2
+#define F_SHORT		4
+#define F_FAIL		8
+
+typedef struct
+{
+	int delay;
+	int jitter;
+	int stallms;
+	int period;
+	int active;
+	double stall;
+	double shrt;
+	double overflow;
+	double again;
+	double fail;
+} CONFIG;
+
+typedef struct
+{
+	pthread_mutex_t mtx;
+	DVBCUSE_DEVICE *dev;
+	CONFIG cfg;
+	uint64_t start;
+	unsigned int seed;
+	unsigned long long reads;
+	unsigned long long writes;
+	unsigned long long ioctls;
+	unsigned long long delayed;
+	unsigned long long stalls;
+	unsigned long long shorts;
+	unsigned long long overflows;
+	unsigned long long agains;
+	unsigned long long failures;
+	DVBCUSE_DEVICE orig;
+} FAULTWRAP;
+
+static uint64_t nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static void sleepms(int ms)
+{
+	struct timespec ts;
+
+	ts.tv_sec=ms/1000;
+	ts.tv_nsec=(ms%1000)*1000000;
+	while(nanosleep(&ts,&ts)&&errno==EINTR);
+}
+
+static int pick(FAULTWRAP *w,double pct)
+{
+	return pct>0&&rand_r(&w->seed)/(RAND_MAX+1.0)*100.0<pct;
+}
+
+static int inject(FAULTWRAP *w,int kind,size_t *count,int *ms)
+{
+	CONFIG *c=&w->cfg;
+	size_t n;
+	int f=0;
+
+	*ms=0;
+
+	pthread_mutex_lock(&w->mtx);
+
+	switch(kind)
+	{
+	case RD:w->reads++;
+		break;
+	case WR:w->writes++;
+		break;
+	default:w->ioctls++;
+		break;
+	}
+
+	if(c->period&&(nsecs()-w->start)/1000000%c->period>=c->active)
+		goto out;
+
+	if(c->delay||c->jitter)
+	{
+		*ms=c->delay;
+		if(c->jitter)*ms+=rand_r(&w->seed)%(c->jitter+1);
+		if(*ms)w->delayed++;
+	}
+
+	if(kind!=IO&&pick(w,c->stall))
+	{
+		*ms+=c->stallms;
+		w->stalls++;
+	}
+
+	if(kind==IO)
+	{
+		if(pick(w,c->fail))
+		{
+			f=F_FAIL;
+			w->failures++;
+		}
+	}
+	else if(pick(w,c->again))
+	{
+		f=F_AGAIN;
+		w->agains++;
+	}
+	else if(kind==RD&&pick(w,c->overflow))
+	{
+		f=F_OVERFLOW;
+		w->overflows++;
+	}
+	else if(kind==RD&&*count>1&&pick(w,c->shrt))
+	{
+		f=F_SHORT;
+		w->shorts++;
+		if((n=*count/TS_SIZE)>1)
+			*count=(1+rand_r(&w->seed)%(n-1))*TS_SIZE;
+		else if(n)*count=1+rand_r(&w->seed)%(TS_SIZE-1);
+		else *count=1+rand_r(&w->seed)%(*count-1);
+	}
+
+out:	pthread_mutex_unlock(&w->mtx);
+
+	return f;
+}
+
+static ssize_t rd(FAULTWRAP *w,
+	ssize_t (*fn)(void *user,int fd,void *buf,size_t count),int fd,
+	void *buf,size_t count)
+{
+	ssize_t len;
+	int ms;
+	int f;
+
+	f=inject(w,RD,&count,&ms);
+	if(ms)sleepms(ms);
+
+	if(f==F_AGAIN)
+	{
+		errno=EAGAIN;
+		return -1;
+	}
+
+	if((len=fn(w->orig.user,fd,buf,count))>=0&&f==F_OVERFLOW)
+	{
+		errno=EOVERFLOW;
+		return -1;
+	}
+
+	return len;
+}
+
+static ssize_t wr(FAULTWRAP *w,
+	ssize_t (*fn)(void *user,int fd,const void *buf,size_t count),int fd,
+	const void *buf,size_t count)
+{
+	int ms;
+	int f;
+
+	f=inject(w,WR,&count,&ms);
+	if(ms)sleepms(ms);
+
+	if(f==F_AGAIN)
+	{
+		errno=EAGAIN;
+		return -1;
+	}
+
+	return fn(w->orig.user,fd,buf,count);
+}
+
+static int io(FAULTWRAP *w,
+	int (*fn)(void *user,int fd,unsigned long request,void *arg),int fd,
+	unsigned long request,void *arg)
+{
+	size_t dummy=0;
+	int ms;
+	int f;
+
+	f=inject(w,IO,&dummy,&ms);
+	if(ms)sleepms(ms);
+
+	if(f==F_FAIL)
+	{
+		errno=EIO;
+		return -1;
+	}
+
+	return fn(w->orig.user,fd,request,arg);
+}
+
+static int pre(FAULTWRAP *w,int kind,size_t *count)
+{
+	int ms;
+	int f;
+
+	f=inject(w,kind,count,&ms);
+	if(ms)sleepms(ms);
+	return f;
+}
+
+static int fail(DVBCUSE_REQ *req,int f)
+{
+	switch(f)
+	{
+	case F_AGAIN:
+		dvbcuse_complete(req,-EAGAIN);
+		return -1;
+	case F_OVERFLOW:
+		dvbcuse_complete(req,-EOVERFLOW);
+		return -1;
+	case F_FAIL:
+		dvbcuse_complete(req,-EIO);
+		return -1;
+	default:return 0;
+	}
+}
+
+static size_t total(struct iovec *iov,int iovcnt)
+{
+	size_t n=0;
+	int i;
+
+	for(i=0;i<iovcnt;i++)n+=iov[i].iov_len;
+	return n;
+}
+
+static void trim(struct iovec *iov,int iovcnt,size_t count)
+{
+	int i;
+
+	for(i=0;i<iovcnt;i++)
+	{
+		if(iov[i].iov_len>count)iov[i].iov_len=count;
+		count-=iov[i].iov_len;
+	}
+}
+
+static void fw_a_read(FAULTWRAP *w,
+	void (*fn)(void *user,DVBCUSE_REQ *req,int fd,void *buf,size_t count),
+	DVBCUSE_REQ *req,int fd,void *buf,size_t count)
+{
+	if(!fail(req,pre(w,RD,&count)))fn(w->orig.user,req,fd,buf,count);
+}
+
+static void fw_a_readv(FAULTWRAP *w,
+	void (*fn)(void *user,DVBCUSE_REQ *req,int fd,struct iovec *iov,
+	int iovcnt),DVBCUSE_REQ *req,int fd,struct iovec *iov,int iovcnt)
+{
+	size_t count=total(iov,iovcnt);
+
+	if(fail(req,pre(w,RD,&count)))return;
+	trim(iov,iovcnt,count);
+	fn(w->orig.user,req,fd,iov,iovcnt);
+}
+
+static void fw_a_write(FAULTWRAP *w,
+	void (*fn)(void *user,DVBCUSE_REQ *req,int fd,const void *buf,
+	size_t count),DVBCUSE_REQ *req,int fd,const void *buf,size_t count)
+{
+	if(!fail(req,pre(w,WR,&count)))fn(w->orig.user,req,fd,buf,count);
+}
+
+static void fw_a_ioctl(FAULTWRAP *w,
+	void (*fn)(void *user,DVBCUSE_REQ *req,int fd,unsigned long request,
+	void *arg),DVBCUSE_REQ *req,int fd,unsigned long request,void *arg)
+{
+	size_t dummy=0;
+
+	if(!fail(req,pre(w,IO,&dummy)))fn(w->orig.user,req,fd,request,arg);
+}
+
+static int fw_fe_open(void *user,const char *pathname,int flags)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return w->orig.fe_open(w->orig.user,pathname,flags);
+}
+
+static void fw_fe_close(void *user,int fd)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	w->orig.fe_close(w->orig.user,fd);
+}
+
+static int fw_fe_ioctl(void *user,int fd,unsigned long request,void *arg)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return io(w,w->orig.fe_ioctl,fd,request,arg);
+}
+
+static int fw_fe_poll(void *user,struct pollfd *fd)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return w->orig.fe_poll(w->orig.user,fd);
+}
+
+static int fw_dmx_open(void *user,const char *pathname,int flags)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return w->orig.dmx_open(w->orig.user,pathname,flags);
+}
+
+static ssize_t fw_dmx_read(void *user,int fd,void *buf,size_t count)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return rd(w,w->orig.dmx_read,fd,buf,count);
+}
+
+static void fw_dmx_close(void *user,int fd)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	w->orig.dmx_close(w->orig.user,fd);
+}
+
+static int fw_dmx_ioctl(void *user,int fd,unsigned long request,void *arg)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return io(w,w->orig.dmx_ioctl,fd,request,arg);
+}
+
+static int fw_dmx_poll(void *user,struct pollfd *fd)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return w->orig.dmx_poll(w->orig.user,fd);
+}
+
+static int fw_dvr_open(void *user,const char *pathname,int flags)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return w->orig.dvr_open(w->orig.user,pathname,flags);
+}
+
+static ssize_t fw_dvr_read(void *user,int fd,void *buf,size_t count)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return rd(w,w->orig.dvr_read,fd,buf,count);
+}
+
+static ssize_t fw_dvr_write(void *user,int fd,const void *buf,size_t count)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return wr(w,w->orig.dvr_write,fd,buf,count);
+}
+
+static void fw_dvr_close(void *user,int fd)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	w->orig.dvr_close(w->orig.user,fd);
+}
+
+static int fw_dvr_ioctl(void *user,int fd,unsigned long request,void *arg)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return io(w,w->orig.dvr_ioctl,fd,request,arg);
+}
+
+static int fw_dvr_poll(void *user,struct pollfd *fd)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return w->orig.dvr_poll(w->orig.user,fd);
+}
+
+static int fw_ca_open(void *user,const char *pathname,int flags)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return w->orig.ca_open(w->orig.user,pathname,flags);
+}
+
+static ssize_t fw_ca_read(void *user,int fd,void *buf,size_t count)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return rd(w,w->orig.ca_read,fd,buf,count);
+}
+
+static ssize_t fw_ca_write(void *user,int fd,const void *buf,size_t count)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return wr(w,w->orig.ca_write,fd,buf,count);
+}
+
+static void fw_ca_close(void *user,int fd)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	w->orig.ca_close(w->orig.user,fd);
+}
+
+static int fw_ca_ioctl(void *user,int fd,unsigned long request,void *arg)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return io(w,w->orig.ca_ioctl,fd,request,arg);
+}
+
+static int fw_ca_poll(void *user,struct pollfd *fd)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return w->orig.ca_poll(w->orig.user,fd);
+}
+
+static int fw_net_open(void *user,const char *pathname,int flags)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return w->orig.net_open(w->orig.user,pathname,flags);
+}
+
+static void fw_net_close(void *user,int fd)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	w->orig.net_close(w->orig.user,fd);
+}
+
+static int fw_net_ioctl(void *user,int fd,unsigned long request,void *arg)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return io(w,w->orig.net_ioctl,fd,request,arg);
+}
+
+static void fw_v2_dmx_read(void *user,DVBCUSE_REQ *req,int fd,void *buf,
+	size_t count)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	fw_a_read(w,w->orig.v2.dmx_read,req,fd,buf,count);
+}
+
+static void fw_v2_dmx_readv(void *user,DVBCUSE_REQ *req,int fd,
+	struct iovec *iov,int iovcnt)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	fw_a_readv(w,w->orig.v2.dmx_readv,req,fd,iov,iovcnt);
+}
+
+static void fw_v2_dmx_ioctl(void *user,DVBCUSE_REQ *req,int fd,
+	unsigned long request,void *arg)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	fw_a_ioctl(w,w->orig.v2.dmx_ioctl,req,fd,request,arg);
+}
+
+static void fw_v2_dvr_read(void *user,DVBCUSE_REQ *req,int fd,void *buf,
+	size_t count)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	fw_a_read(w,w->orig.v2.dvr_read,req,fd,buf,count);
+}
+
+static void fw_v2_dvr_readv(void *user,DVBCUSE_REQ *req,int fd,
+	struct iovec *iov,int iovcnt)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	fw_a_readv(w,w->orig.v2.dvr_readv,req,fd,iov,iovcnt);
+}
+
+static void fw_v2_dvr_write(void *user,DVBCUSE_REQ *req,int fd,
+	const void *buf,size_t count)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	fw_a_write(w,w->orig.v2.dvr_write,req,fd,buf,count);
+}
+
+static void fw_v2_dvr_ioctl(void *user,DVBCUSE_REQ *req,int fd,
+	unsigned long request,void *arg)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	fw_a_ioctl(w,w->orig.v2.dvr_ioctl,req,fd,request,arg);
+}
+
+static void fw_v2_ca_read(void *user,DVBCUSE_REQ *req,int fd,void *buf,
+	size_t count)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	fw_a_read(w,w->orig.v2.ca_read,req,fd,buf,count);
+}
+
+static void fw_v2_ca_write(void *user,DVBCUSE_REQ *req,int fd,
+	const void *buf,size_t count)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	fw_a_write(w,w->orig.v2.ca_write,req,fd,buf,count);
+}
+
+static void fw_v2_ca_ioctl(void *user,DVBCUSE_REQ *req,int fd,
+	unsigned long request,void *arg)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	fw_a_ioctl(w,w->orig.v2.ca_ioctl,req,fd,request,arg);
+}
+
+static void *fw_h_open(void *user,DVBCUSE_STREAM *stream,int type,int unit,
+	int flags)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return w->orig.h.open(w->orig.user,stream,type,unit,flags);
+}
+
+static void fw_h_close(void *user,void *h)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	w->orig.h.close(w->orig.user,h);
+}
+
+static void fw_h_read(void *user,DVBCUSE_REQ *req,void *h,void *buf,
+	size_t count)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	if(!fail(req,pre(w,RD,&count)))
+		w->orig.h.read(w->orig.user,req,h,buf,count);
+}
+
+static void fw_h_readv(void *user,DVBCUSE_REQ *req,void *h,
+	struct iovec *iov,int iovcnt)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+	size_t count=total(iov,iovcnt);
+
+	if(fail(req,pre(w,RD,&count)))return;
+	trim(iov,iovcnt,count);
+	w->orig.h.readv(w->orig.user,req,h,iov,iovcnt);
+}
+
+static void fw_h_write(void *user,DVBCUSE_REQ *req,void *h,
+	const void *buf,size_t count)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	if(!fail(req,pre(w,WR,&count)))
+		w->orig.h.write(w->orig.user,req,h,buf,count);
+}
+
+static int fw_h_ioctl(void *user,void *h,unsigned long request,void *arg)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+	size_t dummy=0;
+
+	if(pre(w,IO,&dummy)==F_FAIL)
+	{
+		errno=EIO;
+		return -1;
+	}
+
+	return w->orig.h.ioctl(w->orig.user,h,request,arg);
+}
+
+static int fw_h_poll(void *user,void *h)
+{
+	FAULTWRAP *w=(FAULTWRAP *)user;
+
+	return w->orig.h.poll(w->orig.user,h);
+}
+
+static int parse(CONFIG *c,unsigned int *seed,const char *spec)
+{
+	char bfr[256];
+	char *item;
+	char *val;
+	char *mem;
+
+	memset(c,0,sizeof(CONFIG));
+	c->stallms=1000;
+
+	if(!strcmp(spec,"off"))return 0;
+	if(strlen(spec)>=sizeof(bfr))return -1;
+	strcpy(bfr,spec);
+
+	for(item=strtok_r(bfr,",",&mem);item;item=strtok_r(NULL,",",&mem))
+	{
+		if(!(val=strchr(item,'=')))return -1;
+		*val++=0;
+
+		if(!strcmp(item,"delay"))c->delay=atoi(val);
+		else if(!strcmp(item,"jitter"))c->jitter=atoi(val);
+		else if(!strcmp(item,"stall"))c->stall=strtod(val,NULL);
+		else if(!strcmp(item,"stallms"))c->stallms=atoi(val);
+		else if(!strcmp(item,"short"))c->shrt=strtod(val,NULL);
+		else if(!strcmp(item,"overflow"))c->overflow=strtod(val,NULL);
+		else if(!strcmp(item,"again"))c->again=strtod(val,NULL);
+		else if(!strcmp(item,"ioctl"))c->fail=strtod(val,NULL);
+		else if(!strcmp(item,"period"))c->period=atoi(val);
+		else if(!strcmp(item,"active"))c->active=atoi(val);
+		else if(!strcmp(item,"seed"))*seed=strtoul(val,NULL,0);
+		else return -1;
+	}
+
+	if(c->delay<0||c->jitter<0||c->stallms<0||c->period<0||
+		c->active<0||c->stall<0||c->shrt<0||c->overflow<0||
+		c->again<0||c->fail<0)return -1;
+	if(c->period&&!c->active)c->active=c->period/2;
+
+	return 0;
+}
+
+void *faultwrap_create(DVBCUSE_DEVICE *dev,const char *spec)
+{
+	FAULTWRAP *w;
+
+	if(!(w=malloc(sizeof(FAULTWRAP))))goto err1;
+	memset(w,0,sizeof(FAULTWRAP));
+	w->dev=dev;
+	w->orig=*dev;
+	w->seed=1;
+	w->start=nsecs();
+
+	if(parse(&w->cfg,&w->seed,spec))
+	{
+		errno=EINVAL;
+		goto err2;
+	}
+
+	if(pthread_mutex_init(&w->mtx,NULL))goto err2;
+
+	if(dev->fe_open)dev->fe_open=fw_fe_open;
+	if(dev->fe_close)dev->fe_close=fw_fe_close;
+	if(dev->fe_ioctl)dev->fe_ioctl=fw_fe_ioctl;
+	if(dev->fe_poll)dev->fe_poll=fw_fe_poll;
+
+	if(dev->dmx_open)dev->dmx_open=fw_dmx_open;
+	if(dev->dmx_read)dev->dmx_read=fw_dmx_read;
+	if(dev->dmx_close)dev->dmx_close=fw_dmx_close;
+	if(dev->dmx_ioctl)dev->dmx_ioctl=fw_dmx_ioctl;
+	if(dev->dmx_poll)dev->dmx_poll=fw_dmx_poll;
+
+	if(dev->dvr_open)dev->dvr_open=fw_dvr_open;
+	if(dev->dvr_read)dev->dvr_read=fw_dvr_read;
+	if(dev->dvr_write)dev->dvr_write=fw_dvr_write;
+	if(dev->dvr_close)dev->dvr_close=fw_dvr_close;
+	if(dev->dvr_ioctl)dev->dvr_ioctl=fw_dvr_ioctl;
+	if(dev->dvr_poll)dev->dvr_poll=fw_dvr_poll;
+
+	if(dev->ca_open)dev->ca_open=fw_ca_open;
+	if(dev->ca_read)dev->ca_read=fw_ca_read;
+	if(dev->ca_write)dev->ca_write=fw_ca_write;
+	if(dev->ca_close)dev->ca_close=fw_ca_close;
+	if(dev->ca_ioctl)dev->ca_ioctl=fw_ca_ioctl;
+	if(dev->ca_poll)dev->ca_poll=fw_ca_poll;
+
+	if(dev->net_open)dev->net_open=fw_net_open;
+	if(dev->net_close)dev->net_close=fw_net_close;
+	if(dev->net_ioctl)dev->net_ioctl=fw_net_ioctl;
+
+	if(dev->v2.dmx_read)dev->v2.dmx_read=fw_v2_dmx_read;
+	if(dev->v2.dmx_readv)dev->v2.dmx_readv=fw_v2_dmx_readv;
+	if(dev->v2.dmx_ioctl)dev->v2.dmx_ioctl=fw_v2_dmx_ioctl;
+
+	if(dev->v2.dvr_read)dev->v2.dvr_read=fw_v2_dvr_read;
+	if(dev->v2.dvr_readv)dev->v2.dvr_readv=fw_v2_dvr_readv;
+	if(dev->v2.dvr_write)dev->v2.dvr_write=fw_v2_dvr_write;
+	if(dev->v2.dvr_ioctl)dev->v2.dvr_ioctl=fw_v2_dvr_ioctl;
+
+	if(dev->v2.ca_read)dev->v2.ca_read=fw_v2_ca_read;
+	if(dev->v2.ca_write)dev->v2.ca_write=fw_v2_ca_write;
+	if(dev->v2.ca_ioctl)dev->v2.ca_ioctl=fw_v2_ca_ioctl;
+
+	if(dev->h.open)dev->h.open=fw_h_open;
+	if(dev->h.close)dev->h.close=fw_h_close;
+	if(dev->h.read)dev->h.read=fw_h_read;
+	if(dev->h.readv)dev->h.readv=fw_h_readv;
+	if(dev->h.write)dev->h.write=fw_h_write;
+	if(dev->h.ioctl)dev->h.ioctl=fw_h_ioctl;
+	if(dev->h.poll)dev->h.poll=fw_h_poll;
+
+	dev->user=w;
+
+	return w;
+
+err2:	free(w);
+err1:	return NULL;
+}
+
+void faultwrap_destroy(void *ctx)
+{
+	FAULTWRAP *w=(FAULTWRAP *)ctx;
+
+	if(!w)return;
+
+	*w->dev=w->orig;
+	pthread_mutex_destroy(&w->mtx);
+	free(w);
+}
+
+int faultwrap_config(void *ctx,const char *spec)
+{
+	FAULTWRAP *w=(FAULTWRAP *)ctx;
+	unsigned int seed;
+	CONFIG c;
+
+	pthread_mutex_lock(&w->mtx);
+	seed=w->seed;
+	pthread_mutex_unlock(&w->mtx);
+
+	if(parse(&c,&seed,spec))
+	{
+		errno=EINVAL;
+		return -1;
+	}
+
+	pthread_mutex_lock(&w->mtx);
+	w->cfg=c;
+	w->seed=seed;
+	w->start=nsecs();
+	pthread_mutex_unlock(&w->mtx);
+
+	return 0;
+}
+
+void faultwrap_dump(void *ctx,FILE *fp,const char *prefix)
+{
+	FAULTWRAP *w=(FAULTWRAP *)ctx;
+
+	pthread_mutex_lock(&w->mtx);
+	fprintf(fp,"%s reads=%llu writes=%llu ioctls=%llu delayed=%llu "
+		"stalls=%llu short=%llu overflow=%llu again=%llu "
+		"ioctl_errors=%llu\n",prefix,w->reads,w->writes,w->ioctls,
+		w->delayed,w->stalls,w->shorts,w->overflows,w->agains,
+		w->failures);
+	pthread_mutex_unlock(&w->mtx);
+}
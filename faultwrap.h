@@ -0,0 +1,22 @@
+/*
+ * Fault and latency injecting backend wrapper
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef FAULTWRAP_H
+#define FAULTWRAP_H
+
+/* wraps all callbacks of dev in place, asynchronous requests that are
+   failed get completed right away, dev must stay valid */
+extern void *faultwrap_create(DVBCUSE_DEVICE *dev,const char *spec);
+extern void faultwrap_destroy(void *ctx);
+extern int faultwrap_config(void *ctx,const char *spec);
+extern void faultwrap_dump(void *ctx,FILE *fp,const char *prefix);
+
+#endif
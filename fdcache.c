@@ -0,0 +1,308 @@
+/*
+ * Source device handle cache with delayed close
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <sys/ioctl.h>
+#include <linux/dvb/frontend.h>
+#include <linux/dvb/dmx.h>
+
+#include <sys/types.h>
+#include <limits.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <stdio.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "dvbcuse.h"
+#include "fdcache.h"
+
+#define MAXPARKED	16
+#define MAXEVENTS	16
+#define DMXBUFFER	8192
+
+typedef struct _entry
+{
+	struct _entry *next;
+	int type;
+	int fd;
+	int flags;
+	int parked;
+	uint64_t expires;
+	char pathname[PATH_MAX];
+} ENTRY;
+
+typedef struct
+{
+	pthread_t th;
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	DVBCUSE_DEVICE *src;
+	uint64_t linger;
+	int stop;
+	int parked;
+	ENTRY *list;
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long expired;
+} FDCACHE;
+
+static uint64_t nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static void release(FDCACHE *c,ENTRY *e)
+{
+	if(e->type==FDCACHE_FE)c->src->fe_close(c->src->user,e->fd);
+	else c->src->dmx_close(c->src->user,e->fd);
+	free(e);
+}
+
+static void reset(FDCACHE *c,int type,int fd)
+{
+	struct dvb_frontend_event ev;
+	struct pollfd p;
+	int i;
+
+	if(type==FDCACHE_DMX)
+	{
+		c->src->dmx_ioctl(c->src->user,fd,DMX_STOP,NULL);
+		c->src->dmx_ioctl(c->src->user,fd,DMX_SET_BUFFER_SIZE,
+			(void *)(long)DMXBUFFER);
+		return;
+	}
+
+	for(i=0;i<MAXEVENTS;i++)
+	{
+		p.fd=fd;
+		p.events=POLLPRI;
+		p.revents=0;
+		if(c->src->fe_poll(c->src->user,&p)<=0||!(p.revents&POLLPRI))
+			break;
+		if(c->src->fe_ioctl(c->src->user,fd,FE_GET_EVENT,&ev))break;
+	}
+}
+
+static void *reaper(void *data)
+{
+	FDCACHE *c=(FDCACHE *)data;
+	struct timespec ts;
+	ENTRY **e;
+	ENTRY *r;
+	uint64_t now;
+	uint64_t next;
+
+	pthread_mutex_lock(&c->mtx);
+
+	while(!c->stop)
+	{
+		now=nsecs();
+		next=now+1000000000ULL;
+
+		for(e=&c->list;*e;)if((*e)->parked&&(*e)->expires<=now)
+		{
+			r=*e;
+			*e=r->next;
+			c->parked--;
+			c->expired++;
+			release(c,r);
+		}
+		else
+		{
+			if((*e)->parked&&(*e)->expires<next)next=(*e)->expires;
+			e=&(*e)->next;
+		}
+
+		ts.tv_sec=next/1000000000ULL;
+		ts.tv_nsec=next%1000000000ULL;
+		pthread_cond_timedwait(&c->cond,&c->mtx,&ts);
+	}
+
+	pthread_mutex_unlock(&c->mtx);
+
+	pthread_exit(NULL);
+}
+
+void *fdcache_create(DVBCUSE_DEVICE *src,int linger)
+{
+	FDCACHE *c;
+	pthread_condattr_t attr;
+
+	if(!(c=malloc(sizeof(FDCACHE))))goto err1;
+	memset(c,0,sizeof(FDCACHE));
+	c->src=src;
+	c->linger=(uint64_t)linger*1000000ULL;
+
+	if(pthread_mutex_init(&c->mtx,NULL))goto err2;
+	if(pthread_condattr_init(&attr))goto err3;
+	if(pthread_condattr_setclock(&attr,CLOCK_MONOTONIC))goto err4;
+	if(pthread_cond_init(&c->cond,&attr))goto err4;
+	if(pthread_create(&c->th,NULL,reaper,c))goto err5;
+	pthread_condattr_destroy(&attr);
+
+	return c;
+
+err5:	pthread_cond_destroy(&c->cond);
+err4:	pthread_condattr_destroy(&attr);
+err3:	pthread_mutex_destroy(&c->mtx);
+err2:	free(c);
+err1:	return NULL;
+}
+
+void fdcache_destroy(void *ctx)
+{
+	FDCACHE *c=(FDCACHE *)ctx;
+	ENTRY *e;
+
+	if(!c)return;
+
+	pthread_mutex_lock(&c->mtx);
+	c->stop=1;
+	pthread_cond_signal(&c->cond);
+	pthread_mutex_unlock(&c->mtx);
+	pthread_join(c->th,NULL);
+
+	while((e=c->list))
+	{
+		c->list=e->next;
+		release(c,e);
+	}
+
+	pthread_cond_destroy(&c->cond);
+	pthread_mutex_destroy(&c->mtx);
+	free(c);
+}
+
+int fdcache_open(void *ctx,int type,const char *pathname,int flags)
+{
+	FDCACHE *c=(FDCACHE *)ctx;
+	ENTRY **p;
+	ENTRY *e;
+	ENTRY *stale=NULL;
+
+	pthread_mutex_lock(&c->mtx);
+
+	for(e=c->list;e;e=e->next)if(e->parked&&e->type==type&&
+		e->flags==flags&&!strcmp(e->pathname,pathname))
+	{
+		e->parked=0;
+		c->parked--;
+		c->hits++;
+		pthread_mutex_unlock(&c->mtx);
+		return e->fd;
+	}
+
+	c->misses++;
+
+	/* a parked handle of the same device may hold the single writer slot */
+	for(p=&c->list;*p;)if((*p)->parked&&(*p)->type==type&&
+		!strcmp((*p)->pathname,pathname))
+	{
+		e=*p;
+		*p=e->next;
+		e->next=stale;
+		stale=e;
+		c->parked--;
+		c->expired++;
+	}
+	else p=&(*p)->next;
+
+	pthread_mutex_unlock(&c->mtx);
+
+	while((e=stale))
+	{
+		stale=e->next;
+		release(c,e);
+	}
+
+	if(strlen(pathname)>=sizeof(e->pathname)||!(e=malloc(sizeof(ENTRY))))
+	{
+		errno=ENOMEM;
+		return -1;
+	}
+
+	if(type==FDCACHE_FE)e->fd=c->src->fe_open(c->src->user,pathname,flags);
+	else e->fd=c->src->dmx_open(c->src->user,pathname,flags);
+
+	if(e->fd==-1)
+	{
+		free(e);
+		return -1;
+	}
+
+	e->type=type;
+	e->flags=flags;
+	e->parked=0;
+	strcpy(e->pathname,pathname);
+
+	pthread_mutex_lock(&c->mtx);
+	e->next=c->list;
+	c->list=e;
+	pthread_mutex_unlock(&c->mtx);
+
+	return e->fd;
+}
+
+void fdcache_close(void *ctx,int type,int fd)
+{
+	FDCACHE *c=(FDCACHE *)ctx;
+	ENTRY **e;
+	ENTRY **o=NULL;
+	ENTRY *r;
+
+	reset(c,type,fd);
+
+	pthread_mutex_lock(&c->mtx);
+
+	for(e=&c->list;*e;e=&(*e)->next)if(!(*e)->parked&&(*e)->type==type&&
+		(*e)->fd==fd)break;
+
+	if(!*e)
+	{
+		pthread_mutex_unlock(&c->mtx);
+		if(type==FDCACHE_FE)c->src->fe_close(c->src->user,fd);
+		else c->src->dmx_close(c->src->user,fd);
+		return;
+	}
+
+	(*e)->parked=1;
+	(*e)->expires=nsecs()+c->linger;
+
+	if(++c->parked>MAXPARKED)
+	{
+		for(e=&c->list;*e;e=&(*e)->next)if((*e)->parked&&
+			(!o||(*e)->expires<(*o)->expires))o=e;
+		r=*o;
+		*o=r->next;
+		c->parked--;
+		c->expired++;
+		release(c,r);
+	}
+
+	pthread_cond_signal(&c->cond);
+	pthread_mutex_unlock(&c->mtx);
+}
+
+void fdcache_dump(void *ctx,FILE *fp,const char *prefix)
+{
+	FDCACHE *c=(FDCACHE *)ctx;
+
+	pthread_mutex_lock(&c->mtx);
+	fprintf(fp,"%s hits=%llu misses=%llu expired=%llu parked=%d\n",prefix,
+		c->hits,c->misses,c->expired,c->parked);
+	pthread_mutex_unlock(&c->mtx);
+}
@@ -0,0 +1,24 @@
+/*
+ * Source device handle cache with delayed close
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef FDCACHE_H
+#define FDCACHE_H
+
+#define FDCACHE_FE	0
+#define FDCACHE_DMX	1
+
+extern void *fdcache_create(DVBCUSE_DEVICE *src,int linger);
+extern void fdcache_destroy(void *ctx);
+extern int fdcache_open(void *ctx,int type,const char *pathname,int flags);
+extern void fdcache_close(void *ctx,int type,int fd);
+extern void fdcache_dump(void *ctx,FILE *fp,const char *prefix);
+
+#endif
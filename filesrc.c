@@ -0,0 +1,203 @@
+/*
+ * Recorded transport stream file source
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "ts.h"
+#include "filesrc.h"
+
+#define CHUNK		(TS_SIZE*7*16)
+#define DEFRATE		40000000ULL
+#define PCRJUMP		(27000000ULL*2)
+
+typedef struct
+{
+	pthread_t th;
+	pthread_mutex_t mtx;
+	TS_SINK sink;
+	int fd;
+	int stop;
+	uint64_t rate;
+	int pcrpid;
+	uint64_t pcr0;
+	uint64_t t0;
+	uint64_t bytes;
+	unsigned long long total;
+	unsigned long long loops;
+	char path[PATH_MAX];
+} FILESRC;
+
+static uint64_t nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static void pause_until(uint64_t t)
+{
+	struct timespec ts;
+
+	ts.tv_sec=t/1000000000ULL;
+	ts.tv_nsec=t%1000000000ULL;
+	clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,NULL);
+}
+
+static int pcr(const uint8_t *p,uint64_t *val)
+{
+	if(!(TS_AFC(p)&2)||p[4]<7||!(p[5]&0x10))return 0;
+	*val=(((uint64_t)p[6]<<25)|(p[7]<<17)|(p[8]<<9)|(p[9]<<1)|
+		(p[10]>>7))*300+(((p[10]&1)<<8)|p[11]);
+	return 1;
+}
+
+static void pace(FILESRC *f,const uint8_t *bfr,int len)
+{
+	uint64_t now=nsecs();
+	uint64_t val;
+	uint64_t due=0;
+	int i;
+
+	if(!f->t0)
+	{
+		f->t0=now;
+		f->bytes=0;
+		f->pcr0=0;
+		f->pcrpid=-1;
+	}
+
+	for(i=0;i+TS_SIZE<=len;i+=TS_SIZE)
+	{
+		if(bfr[i]!=TS_SYNC||!pcr(bfr+i,&val))continue;
+		if(f->pcrpid==-1)f->pcrpid=TS_PID(bfr+i);
+		else if(TS_PID(bfr+i)!=f->pcrpid)continue;
+		if(!f->pcr0||val<f->pcr0||val-f->pcr0>
+			(now-f->t0)*27/1000+PCRJUMP)
+		{
+			f->pcr0=val;
+			f->t0=now;
+			f->bytes=0;
+		}
+		due=f->t0+(val-f->pcr0)*1000/27;
+	}
+
+	f->bytes+=len;
+
+	if(f->pcrpid==-1)due=f->t0+f->bytes*8000000000ULL/f->rate;
+	if(due>now)pause_until(due);
+}
+
+static void *reader(void *data)
+{
+	FILESRC *f=(FILESRC *)data;
+	uint8_t bfr[CHUNK];
+	int fill=0;
+	int got=0;
+	int len;
+
+	while(!f->stop)
+	{
+		if((len=read(f->fd,bfr+fill,sizeof(bfr)-fill))<=0)
+		{
+			if(!got||lseek(f->fd,0,SEEK_SET))break;
+			got=0;
+			pthread_mutex_lock(&f->mtx);
+			f->loops++;
+			pthread_mutex_unlock(&f->mtx);
+			f->t0=0;
+			fill=0;
+			continue;
+		}
+		got=1;
+		fill+=len;
+		len=fill-fill%TS_SIZE;
+
+		pace(f,bfr,len);
+		f->sink.feed(f->sink.user,bfr,len);
+
+		pthread_mutex_lock(&f->mtx);
+		f->total+=len;
+		pthread_mutex_unlock(&f->mtx);
+
+		memmove(bfr,bfr+len,fill-len);
+		fill-=len;
+	}
+
+	pthread_exit(NULL);
+}
+
+void *filesrc_create(const char *url,const TS_SINK *sink)
+{
+	FILESRC *f;
+	const char *p;
+
+	if(strncmp(url,"file://",7))goto err1;
+	url+=7;
+
+	if(!(f=malloc(sizeof(FILESRC))))goto err1;
+	memset(f,0,sizeof(FILESRC));
+	f->sink=*sink;
+	f->rate=DEFRATE;
+
+	if((p=strchr(url,'?')))
+	{
+		if(strncmp(p,"?rate=",6)||!(f->rate=strtoull(p+6,NULL,10)))
+			goto err2;
+	}
+	else p=url+strlen(url);
+
+	if(p-url>=sizeof(f->path))goto err2;
+	memcpy(f->path,url,p-url);
+	f->path[p-url]=0;
+
+	if((f->fd=open(f->path,O_RDONLY|O_CLOEXEC))==-1)goto err2;
+	if(pthread_mutex_init(&f->mtx,NULL))goto err3;
+	if(pthread_create(&f->th,NULL,reader,f))goto err4;
+
+	return f;
+
+err4:	pthread_mutex_destroy(&f->mtx);
+err3:	close(f->fd);
+err2:	free(f);
+err1:	return NULL;
+}
+
+void filesrc_destroy(void *ctx)
+{
+	FILESRC *f=(FILESRC *)ctx;
+
+	if(!f)return;
+
+	f->stop=1;
+	pthread_join(f->th,NULL);
+	pthread_mutex_destroy(&f->mtx);
+	close(f->fd);
+	free(f);
+}
+
+void filesrc_dump(void *ctx,FILE *fp,const char *prefix)
+{
+	FILESRC *f=(FILESRC *)ctx;
+
+	pthread_mutex_lock(&f->mtx);
+	fprintf(fp,"%s file=%s bytes=%llu loops=%llu\n",prefix,f->path,
+		f->total,f->loops);
+	pthread_mutex_unlock(&f->mtx);
+}
@@ -0,0 +1,19 @@
+/*
+ * Recorded transport stream file source
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef FILESRC_H
+#define FILESRC_H
+
+extern void *filesrc_create(const char *url,const TS_SINK *sink);
+extern void filesrc_destroy(void *ctx);
+extern void filesrc_dump(void *ctx,FILE *fp,const char *prefix);
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ * Full transport stream reader for a hardware DVB adapter
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <sys/ioctl.h>
+#include <linux/dvb/frontend.h>
+#include <linux/dvb/dmx.h>
+
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "ts.h"
+#include "hwsrc.h"
+
+#define READSIZE	(TS_SIZE*512)
+#define DMXBUFSIZE	(TS_SIZE*8192)
+#define STATUSINT	250000000ULL
+
+typedef struct
+{
+	pthread_t th;
+	TS_SINK sink;
+	int dmx;
+	int dvr;
+	int fe;
+	int stop;
+	int locked;
+} HWSRC;
+
+static uint64_t nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static void *reader(void *data)
+{
+	HWSRC *h=(HWSRC *)data;
+	struct pollfd p;
+	fe_status_t status;
+	uint64_t now;
+	uint64_t next=0;
+	uint8_t bfr[READSIZE];
+	int fill=0;
+	int len;
+
+	p.fd=h->dvr;
+	p.events=POLLIN;
+
+	while(!h->stop)
+	{
+		if(h->fe!=-1&&(now=nsecs())>=next)
+		{
+			next=now+STATUSINT;
+			if(ioctl(h->fe,FE_READ_STATUS,&status))status=0;
+			h->locked=(status&FE_HAS_LOCK)?1:0;
+		}
+
+		if(poll(&p,1,100)<1)continue;
+
+		if((len=read(h->dvr,bfr+fill,sizeof(bfr)-fill))<=0)continue;
+		fill+=len;
+
+		len=fill-fill%TS_SIZE;
+		h->sink.feed(h->sink.user,bfr,len);
+		memmove(bfr,bfr+len,fill-len);
+		fill-=len;
+	}
+
+	pthread_exit(NULL);
+}
+
+void *hwsrc_create(int adapter,const TS_SINK *sink)
+{
+	HWSRC *h;
+	struct dmx_pes_filter_params pes;
+	char bfr[PATH_MAX];
+
+	if(!(h=malloc(sizeof(HWSRC))))goto err1;
+	memset(h,0,sizeof(HWSRC));
+	h->sink=*sink;
+	h->locked=1;
+
+	sprintf(bfr,"/dev/dvb/adapter%d/demux0",adapter);
+	if((h->dmx=open(bfr,O_RDWR|O_NONBLOCK|O_CLOEXEC))==-1)goto err2;
+
+	ioctl(h->dmx,DMX_SET_BUFFER_SIZE,DMXBUFSIZE);
+
+	memset(&pes,0,sizeof(pes));
+	pes.pid=TS_ALLPIDS;
+	pes.input=DMX_IN_FRONTEND;
+	pes.output=DMX_OUT_TS_TAP;
+	pes.pes_type=DMX_PES_OTHER;
+	if(ioctl(h->dmx,DMX_SET_PES_FILTER,&pes))goto err3;
+
+	sprintf(bfr,"/dev/dvb/adapter%d/dvr0",adapter);
+	if((h->dvr=open(bfr,O_RDONLY|O_NONBLOCK|O_CLOEXEC))==-1)goto err3;
+	ioctl(h->dvr,DMX_SET_BUFFER_SIZE,DMXBUFSIZE);
+
+	sprintf(bfr,"/dev/dvb/adapter%d/frontend0",adapter);
+	h->fe=open(bfr,O_RDONLY|O_NONBLOCK|O_CLOEXEC);
+
+	if(ioctl(h->dmx,DMX_START,NULL))goto err4;
+	if(pthread_create(&h->th,NULL,reader,h))goto err4;
+
+	return h;
+
+err4:	if(h->fe!=-1)close(h->fe);
+	close(h->dvr);
+err3:	close(h->dmx);
+err2:	free(h);
+err1:	return NULL;
+}
+
+void hwsrc_destroy(void *ctx)
+{
+	HWSRC *h=(HWSRC *)ctx;
+
+	if(!h)return;
+
+	h->stop=1;
+	pthread_join(h->th,NULL);
+	if(h->fe!=-1)close(h->fe);
+	close(h->dvr);
+	close(h->dmx);
+	free(h);
+}
+
+int hwsrc_locked(void *ctx)
+{
+	HWSRC *h=(HWSRC *)ctx;
+
+	return h->locked;
+}
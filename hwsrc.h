@@ -0,0 +1,19 @@
+/*
+ * Full transport stream reader for a hardware DVB adapter
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef HWSRC_H
+#define HWSRC_H
+
+extern void *hwsrc_create(int adapter,const TS_SINK *sink);
+extern void hwsrc_destroy(void *ctx);
+extern int hwsrc_locked(void *ctx);
+
+#endif
@@ -0,0 +1,522 @@
+/*
+ * PSI/SI section cache
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <linux/dvb/dmx.h>
+
+#include <sys/types.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "ts.h"
+#include "psicache.h"
+
+#define BUCKETS	1024
+#define MAXSCT	4098
+
+typedef struct _section
+{
+	struct _section *next;
+	struct _section *older;
+	struct _section *newer;
+	int pid;
+	int tag;
+	int len;
+	int refs;
+	uint8_t data[0];
+} SECTION;
+
+typedef struct _pending
+{
+	struct _pending *next;
+	SECTION *sct;
+} PENDING;
+
+typedef struct _client
+{
+	struct _client *next;
+	int fd;
+	int started;
+	int offset;
+	int plen;
+	struct dmx_sct_filter_params flt;
+	PENDING *pend;
+	uint8_t part[MAXSCT];
+} CLIENT;
+
+typedef struct
+{
+	pthread_mutex_t mtx;
+	SECTION *bucket[BUCKETS];
+	SECTION *oldest;
+	SECTION *newest;
+	size_t bytes;
+	size_t limit;
+	int count;
+	CLIENT *c;
+} CACHE;
+
+static void unref(SECTION *s)
+{
+	if(!--s->refs)free(s);
+}
+
+static int cacheable(const uint8_t *sct,int len)
+{
+	if(!SCT_SYNTAX(sct)||!SCT_CURRENT(sct))return 0;
+
+	switch(SCT_TID(sct))
+	{
+	case 0x00:
+	case 0x01:
+	case 0x02:
+	case 0x40:
+	case 0x41:
+	case 0x42:
+	case 0x46:
+	case 0x4a:
+		return sct_valid(sct,len);
+	default:return 0;
+	}
+}
+
+static int same(const uint8_t *a,const uint8_t *b)
+{
+	if(SCT_TID(a)!=SCT_TID(b)||SCT_EXT(a)!=SCT_EXT(b))return 0;
+	if(SCT_TID(a)==0x42||SCT_TID(a)==0x46)return a[8]==b[8]&&a[9]==b[9];
+	if(SCT_TID(a)>=0x4e&&SCT_TID(a)<=0x6f)return !memcmp(a+8,b+8,4);
+	return 1;
+}
+
+static int key(int pid,int tid,int ext)
+{
+	return (pid^(tid<<3)^ext^(ext>>10))&(BUCKETS-1);
+}
+
+static SECTION **bucket(CACHE *c,SECTION *s)
+{
+	return &c->bucket[key(s->pid,SCT_TID(s->data),SCT_EXT(s->data))];
+}
+
+static void drop(CACHE *c,SECTION *s)
+{
+	if(s->older)s->older->newer=s->newer;
+	else c->oldest=s->newer;
+	if(s->newer)s->newer->older=s->older;
+	else c->newest=s->older;
+	c->bytes-=s->len;
+	c->count--;
+	unref(s);
+}
+
+static void evict(CACHE *c,SECTION *s)
+{
+	SECTION **p;
+
+	for(p=bucket(c,s);*p;p=&(*p)->next)if(*p==s)
+	{
+		*p=s->next;
+		break;
+	}
+	drop(c,s);
+}
+
+static void insert(CACHE *c,SECTION *n)
+{
+	SECTION **s;
+	SECTION *r;
+
+	for(s=bucket(c,n);*s;)
+	{
+		r=*s;
+		if(r->pid!=n->pid||!same(r->data,n->data))
+		{
+			s=&r->next;
+			continue;
+		}
+
+		if(SCT_VERSION(r->data)==SCT_VERSION(n->data)&&
+			SCT_NUMBER(r->data)!=SCT_NUMBER(n->data))
+		{
+			s=&r->next;
+			continue;
+		}
+
+		*s=r->next;
+		drop(c,r);
+	}
+
+	s=bucket(c,n);
+	n->next=*s;
+	*s=n;
+	n->newer=NULL;
+	if((n->older=c->newest))n->older->newer=n;
+	else c->oldest=n;
+	c->newest=n;
+	c->bytes+=n->len;
+	c->count++;
+
+	while(c->limit&&c->bytes>c->limit&&c->oldest!=n)evict(c,c->oldest);
+}
+
+static CLIENT *lookup(CACHE *c,int fd)
+{
+	CLIENT *e;
+
+	for(e=c->c;e;e=e->next)if(e->fd==fd)break;
+	return e;
+}
+
+static void drain(CLIENT *e)
+{
+	PENDING *p;
+
+	while(e->pend)
+	{
+		p=e->pend;
+		e->pend=p->next;
+		unref(p->sct);
+		free(p);
+	}
+	e->offset=0;
+}
+
+static int exact(struct dmx_filter *f)
+{
+	int i;
+
+	for(i=0;i<3;i++)if(f->mask[i]!=0xff||f->mode[i])return 0;
+	return 1;
+}
+
+static void prime(CACHE *c,CLIENT *e)
+{
+	struct dmx_filter *f=&e->flt.filter;
+	SECTION *s;
+	PENDING *p;
+	PENDING **tail=&e->pend;
+	int x=exact(f);
+
+	drain(e);
+
+	for(s=x?c->bucket[key(e->flt.pid,f->filter[0],
+		(f->filter[1]<<8)|f->filter[2])]:c->newest;s;
+		s=x?s->next:s->older)
+			if(s->pid==e->flt.pid&&sct_match(f->filter,f->mask,
+				f->mode,DMX_FILTER_SIZE,s->data,s->len))
+	{
+		if(!(p=malloc(sizeof(PENDING))))break;
+		p->next=NULL;
+		p->sct=s;
+		s->refs++;
+		*tail=p;
+		tail=&p->next;
+		if(e->flt.flags&DMX_ONESHOT)break;
+	}
+}
+
+void *psicache_create(void)
+{
+	CACHE *c;
+
+	if(!(c=malloc(sizeof(CACHE))))goto err1;
+	memset(c,0,sizeof(CACHE));
+	if(pthread_mutex_init(&c->mtx,NULL))goto err2;
+	return c;
+
+err2:	free(c);
+err1:	return NULL;
+}
+
+void psicache_destroy(void *ctx)
+{
+	CACHE *c=(CACHE *)ctx;
+	CLIENT *e;
+
+	if(!c)return;
+
+	psicache_flush(c);
+
+	while(c->c)
+	{
+		e=c->c;
+		c->c=e->next;
+		drain(e);
+		free(e);
+	}
+
+	pthread_mutex_destroy(&c->mtx);
+	free(c);
+}
+
+void psicache_flush(void *ctx)
+{
+	CACHE *c=(CACHE *)ctx;
+	CLIENT *e;
+
+	pthread_mutex_lock(&c->mtx);
+
+	for(e=c->c;e;e=e->next)drain(e);
+	while(c->oldest)drop(c,c->oldest);
+	memset(c->bucket,0,sizeof(c->bucket));
+
+	pthread_mutex_unlock(&c->mtx);
+}
+
+void psicache_limit(void *ctx,size_t bytes)
+{
+	CACHE *c=(CACHE *)ctx;
+
+	pthread_mutex_lock(&c->mtx);
+	c->limit=bytes;
+	while(c->limit&&c->bytes>c->limit)evict(c,c->oldest);
+	pthread_mutex_unlock(&c->mtx);
+}
+
+void psicache_expire(void *ctx,int tag)
+{
+	CACHE *c=(CACHE *)ctx;
+	SECTION *s;
+	SECTION *o;
+
+	pthread_mutex_lock(&c->mtx);
+	for(s=c->oldest;s;s=o)
+	{
+		o=s->newer;
+		if(s->tag==tag)evict(c,s);
+	}
+	pthread_mutex_unlock(&c->mtx);
+}
+
+void psicache_usage(void *ctx,size_t *bytes,int *sections)
+{
+	CACHE *c=(CACHE *)ctx;
+
+	pthread_mutex_lock(&c->mtx);
+	*bytes=c->bytes;
+	*sections=c->count;
+	pthread_mutex_unlock(&c->mtx);
+}
+
+int psicache_filter(void *ctx,int fd,struct dmx_sct_filter_params *p)
+{
+	CACHE *c=(CACHE *)ctx;
+	CLIENT *e;
+
+	pthread_mutex_lock(&c->mtx);
+
+	if(!(e=lookup(c,fd)))
+	{
+		if(!(e=malloc(sizeof(CLIENT))))
+		{
+			pthread_mutex_unlock(&c->mtx);
+			errno=ENOMEM;
+			return -1;
+		}
+		memset(e,0,sizeof(CLIENT));
+		e->fd=fd;
+		e->next=c->c;
+		c->c=e;
+	}
+	else drain(e);
+
+	e->plen=0;
+	e->flt=*p;
+	if((e->started=(p->flags&DMX_IMMEDIATE_START)?1:0))prime(c,e);
+
+	pthread_mutex_unlock(&c->mtx);
+
+	return 0;
+}
+
+void psicache_start(void *ctx,int fd)
+{
+	CACHE *c=(CACHE *)ctx;
+	CLIENT *e;
+
+	pthread_mutex_lock(&c->mtx);
+
+	if((e=lookup(c,fd))&&!e->started)
+	{
+		e->started=1;
+		prime(c,e);
+	}
+
+	pthread_mutex_unlock(&c->mtx);
+}
+
+void psicache_stop(void *ctx,int fd)
+{
+	CACHE *c=(CACHE *)ctx;
+	CLIENT *e;
+
+	pthread_mutex_lock(&c->mtx);
+
+	if((e=lookup(c,fd)))
+	{
+		e->started=0;
+		e->plen=0;
+		drain(e);
+	}
+
+	pthread_mutex_unlock(&c->mtx);
+}
+
+void psicache_release(void *ctx,int fd)
+{
+	CACHE *c=(CACHE *)ctx;
+	CLIENT **e;
+	CLIENT *r;
+
+	pthread_mutex_lock(&c->mtx);
+
+	for(e=&c->c;*e;e=&(*e)->next)if((*e)->fd==fd)
+	{
+		r=*e;
+		*e=r->next;
+		drain(r);
+		free(r);
+		break;
+	}
+
+	pthread_mutex_unlock(&c->mtx);
+}
+
+int psicache_pending(void *ctx,int fd)
+{
+	CACHE *c=(CACHE *)ctx;
+	CLIENT *e;
+	int r;
+
+	pthread_mutex_lock(&c->mtx);
+	r=(e=lookup(c,fd))&&e->pend?1:0;
+	pthread_mutex_unlock(&c->mtx);
+
+	return r;
+}
+
+ssize_t psicache_read(void *ctx,int fd,void *buf,size_t count,int *stop)
+{
+	CACHE *c=(CACHE *)ctx;
+	CLIENT *e;
+	PENDING *p;
+	ssize_t len;
+
+	*stop=0;
+
+	pthread_mutex_lock(&c->mtx);
+
+	if(!(e=lookup(c,fd))||!e->pend)
+	{
+		pthread_mutex_unlock(&c->mtx);
+		errno=EAGAIN;
+		return -1;
+	}
+
+	p=e->pend;
+	len=p->sct->len-e->offset;
+	if(len>count)len=count;
+	memcpy(buf,p->sct->data+e->offset,len);
+
+	if((e->offset+=len)==p->sct->len)
+	{
+		e->pend=p->next;
+		e->offset=0;
+		unref(p->sct);
+		free(p);
+		if(e->flt.flags&DMX_ONESHOT)
+		{
+			drain(e);
+			e->started=0;
+			*stop=1;
+		}
+	}
+
+	pthread_mutex_unlock(&c->mtx);
+
+	return len;
+}
+
+static void store(CACHE *c,CLIENT *e,const uint8_t *sct,int len)
+{
+	SECTION *n;
+
+	if(len<12||!cacheable(sct,len))return;
+
+	if(!(n=malloc(sizeof(SECTION)+len)))return;
+	n->pid=e->flt.pid;
+	n->tag=0;
+	n->len=len;
+	n->refs=1;
+	memcpy(n->data,sct,len);
+	insert(c,n);
+}
+
+void psicache_store(void *ctx,int fd,const void *buf,size_t len)
+{
+	CACHE *c=(CACHE *)ctx;
+	const uint8_t *p=(const uint8_t *)buf;
+	const uint8_t *end=p+len;
+	CLIENT *e;
+	int n;
+
+	pthread_mutex_lock(&c->mtx);
+
+	if(!(e=lookup(c,fd)))goto out;
+
+	while(e->plen&&p<end)
+	{
+		n=e->plen<3?3-e->plen:SCT_LEN(e->part)-e->plen;
+		if(n>end-p)n=end-p;
+		memcpy(e->part+e->plen,p,n);
+		e->plen+=n;
+		p+=n;
+		if(e->plen>=3&&e->plen==SCT_LEN(e->part))
+		{
+			store(c,e,e->part,e->plen);
+			e->plen=0;
+		}
+	}
+
+	for(;end-p>=3&&*p!=0xff&&end-p>=SCT_LEN(p);p+=SCT_LEN(p))
+		store(c,e,p,SCT_LEN(p));
+
+	if(p<end&&*p!=0xff)
+	{
+		memcpy(e->part,p,end-p);
+		e->plen=end-p;
+	}
+
+out:	pthread_mutex_unlock(&c->mtx);
+}
+
+void psicache_add(void *ctx,int tag,int pid,const void *buf,size_t len)
+{
+	CACHE *c=(CACHE *)ctx;
+	const uint8_t *sct=(const uint8_t *)buf;
+	SECTION *n;
+
+	if(len<12||!SCT_SYNTAX(sct)||!SCT_CURRENT(sct)||!sct_valid(sct,len))
+		return;
+
+	if(!(n=malloc(sizeof(SECTION)+len)))return;
+	n->pid=pid;
+	n->tag=tag;
+	n->len=len;
+	n->refs=1;
+	memcpy(n->data,sct,len);
+
+	pthread_mutex_lock(&c->mtx);
+	insert(c,n);
+	pthread_mutex_unlock(&c->mtx);
+}
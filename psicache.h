@@ -0,0 +1,32 @@
+/*
+ * PSI/SI section cache
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef PSICACHE_H
+#define PSICACHE_H
+
+extern void *psicache_create(void);
+extern void psicache_destroy(void *ctx);
+extern void psicache_flush(void *ctx);
+extern int psicache_filter(void *ctx,int fd,struct dmx_sct_filter_params *p);
+extern void psicache_start(void *ctx,int fd);
+extern void psicache_stop(void *ctx,int fd);
+extern void psicache_release(void *ctx,int fd);
+extern int psicache_pending(void *ctx,int fd);
+extern ssize_t psicache_read(void *ctx,int fd,void *buf,size_t count,
+	int *stop);
+extern void psicache_store(void *ctx,int fd,const void *buf,size_t len);
+extern void psicache_add(void *ctx,int tag,int pid,const void *buf,
+	size_t len);
+extern void psicache_limit(void *ctx,size_t bytes);
+extern void psicache_expire(void *ctx,int tag);
+extern void psicache_usage(void *ctx,size_t *bytes,int *sections);
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ * PSI/SI section cache tests
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <linux/dvb/dmx.h>
+#include <sys/types.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ts.h"
+#include "psicache.h"
+
+#define CHECK(x) do{if(!(x)){fprintf(stderr,"%s:%d: %s\n",__FILE__,\
+	__LINE__,#x);goto err;}}while(0)
+
+#define SCTLEN	(8+2*4+4)
+
+/* a PAT section with two programs */
+static void pat(uint8_t *s,int version,int number,int last)
+{
+	uint32_t crc;
+
+	s[0]=0x00;
+	s[1]=0xb0;
+	s[2]=SCTLEN-3;
+	s[3]=0x00;
+	s[4]=0x01;
+	s[5]=0xc1|(version<<1);
+	s[6]=number;
+	s[7]=last;
+	s[8]=0x00;
+	s[9]=2*number+1;
+	s[10]=0xe1;
+	s[11]=0x00|number;
+	s[12]=0x00;
+	s[13]=2*number+2;
+	s[14]=0xe2;
+	s[15]=0x00|number;
+	crc=ts_crc32(s,SCTLEN-4);
+	s[SCTLEN-4]=crc>>24;
+	s[SCTLEN-3]=crc>>16;
+	s[SCTLEN-2]=crc>>8;
+	s[SCTLEN-1]=crc;
+}
+
+static void filter(struct dmx_sct_filter_params *p,int flags)
+{
+	memset(p,0,sizeof(*p));
+	p->pid=0;
+	p->filter.mask[0]=0xff;
+	p->flags=flags;
+}
+
+static int count(void *c)
+{
+	size_t bytes;
+	int n;
+
+	psicache_usage(c,&bytes,&n);
+	return n;
+}
+
+static int sections(void)
+{
+	struct dmx_sct_filter_params p;
+	uint8_t bfr[2*SCTLEN+4];
+	uint8_t out[2*SCTLEN];
+	int stop;
+	int n;
+	void *c;
+
+	pat(bfr,1,0,1);
+	pat(bfr+SCTLEN,1,1,1);
+	memset(bfr+2*SCTLEN,0xff,4);
+
+	if(!(c=psicache_create()))return -1;
+	filter(&p,0);
+	CHECK(!psicache_filter(c,1,&p));
+	psicache_start(c,1);
+
+	psicache_store(c,1,bfr,5);
+	psicache_store(c,1,bfr+5,SCTLEN);
+	psicache_store(c,1,bfr+5+SCTLEN,sizeof(bfr)-5-SCTLEN);
+	CHECK(count(c)==2);
+
+	CHECK(!psicache_filter(c,2,&p));
+	CHECK(!psicache_pending(c,2));
+	psicache_start(c,2);
+	CHECK(psicache_pending(c,2));
+	CHECK(psicache_read(c,2,out,SCTLEN,&stop)==SCTLEN&&!stop);
+	CHECK(psicache_read(c,2,out+SCTLEN,5,&stop)==5);
+	CHECK(psicache_read(c,2,out+SCTLEN+5,SCTLEN,&stop)==SCTLEN-5);
+	CHECK(!psicache_pending(c,2));
+	CHECK(psicache_read(c,2,out,SCTLEN,&stop)==-1);
+	n=memcmp(out,bfr,SCTLEN)?SCTLEN:0;
+	CHECK(!memcmp(out+n,bfr,SCTLEN));
+	CHECK(!memcmp(out+SCTLEN-n,bfr+SCTLEN,SCTLEN));
+
+	psicache_destroy(c);
+	return 0;
+
+err:	psicache_destroy(c);
+	return -1;
+}
+
+static int versions(void)
+{
+	struct dmx_sct_filter_params p;
+	uint8_t bfr[SCTLEN];
+	uint8_t out[SCTLEN];
+	int stop;
+	void *c;
+
+	if(!(c=psicache_create()))return -1;
+	filter(&p,0);
+	CHECK(!psicache_filter(c,1,&p));
+
+	pat(bfr,1,0,1);
+	psicache_store(c,1,bfr,SCTLEN);
+	pat(bfr,1,1,1);
+	psicache_store(c,1,bfr,SCTLEN);
+	psicache_store(c,1,bfr,SCTLEN);
+	CHECK(count(c)==2);
+
+	pat(bfr,2,0,0);
+	psicache_store(c,1,bfr,SCTLEN);
+	CHECK(count(c)==1);
+
+	pat(bfr,3,0,0);
+	bfr[10]^=0x01;
+	psicache_store(c,1,bfr,SCTLEN);
+	CHECK(count(c)==1);
+
+	filter(&p,DMX_IMMEDIATE_START|DMX_ONESHOT);
+	CHECK(!psicache_filter(c,2,&p));
+	CHECK(psicache_read(c,2,out,SCTLEN,&stop)==SCTLEN&&stop);
+	CHECK(SCT_VERSION(out)==2);
+	CHECK(!psicache_pending(c,2));
+
+	psicache_destroy(c);
+	return 0;
+
+err:	psicache_destroy(c);
+	return -1;
+}
+
+int main(int argc,char *argv[])
+{
+	if(sections()||versions())return 1;
+	return 0;
+}
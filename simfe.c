@@ -0,0 +1,863 @@
+/*
+ * Simulated frontend with lock timing and signal model
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <sys/ioctl.h>
+#include <linux/dvb/frontend.h>
+#include <linux/dvb/version.h>
+
+#include <sys/eventfd.h>
+#include <sys/types.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "dvbcuse.h"
+#include "ts.h"
+#include "swsrc.h"
+#include "simfe.h"
+
+#define EVQUEUE		8
+#define CHUNK		(TS_SIZE*64)
+#define LOCKED		(FE_HAS_SIGNAL|FE_HAS_CARRIER|FE_HAS_VITERBI|\
+			 FE_HAS_SYNC|FE_HAS_LOCK)
+
+typedef struct _simfile
+{
+	struct _simfile *next;
+	int fd;
+	int flags;
+	int ready;
+	int head;
+	int cnt;
+	int overflow;
+	struct dvb_frontend_event ev[EVQUEUE];
+} SIMFILE;
+
+typedef struct
+{
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	pthread_t th;
+	int stop;
+	SWSRC_INFO info;
+	TS_SINK out;
+	SIMFILE *files;
+	unsigned int seed;
+	int lockms;
+	int jitter;
+	int fail;
+	int strength;
+	int cnr;
+	double ber;
+	double acc;
+	int diseqcms;
+	int delsys;
+	unsigned int frequency;
+	unsigned int symbol_rate;
+	unsigned int modulation;
+	unsigned int fec;
+	unsigned int bandwidth;
+	unsigned int inversion;
+	unsigned int stream_id;
+	int voltage;
+	int tone;
+	int reply;
+	int stage;
+	uint64_t due;
+	uint64_t rest;
+	fe_status_t status;
+	unsigned long long tunes;
+	unsigned long long locks;
+	unsigned long long failures;
+	unsigned long long diseqc;
+	unsigned long long dropped;
+	unsigned long long bits;
+	unsigned long long errors;
+	unsigned long long blocks;
+	unsigned long long ucb;
+} SIMFE;
+
+static uint64_t nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static int satellite(int sys)
+{
+	return sys==SYS_DVBS||sys==SYS_DVBS2;
+}
+
+static void ready(int fd,int *state,int on)
+{
+	eventfd_t v;
+
+	if(on&&!*state)eventfd_write(fd,1);
+	else if(!on&&*state)eventfd_read(fd,&v);
+	*state=on;
+}
+
+static int present(SIMFE *s)
+{
+	return s->frequency&&
+		(!satellite(s->delsys)||s->voltage!=SEC_VOLTAGE_OFF);
+}
+
+static unsigned int strength(SIMFE *s)
+{
+	int v;
+
+	if(!present(s))return 0;
+	v=s->strength*65535/100+(int)(rand_r(&s->seed)%1311)-655;
+	return v<0?0:v>65535?65535:v;
+}
+
+static int cnr(SIMFE *s)
+{
+	return s->cnr+(int)(rand_r(&s->seed)%201)-100;
+}
+
+static void post(SIMFE *s,fe_status_t status)
+{
+	struct dvb_frontend_event *e;
+	SIMFILE *f;
+
+	s->status=status;
+
+	for(f=s->files;f;f=f->next)
+	{
+		if(f->cnt==EVQUEUE)
+		{
+			f->head=(f->head+1)%EVQUEUE;
+			f->cnt--;
+			f->overflow=1;
+		}
+		e=&f->ev[(f->head+f->cnt++)%EVQUEUE];
+		memset(e,0,sizeof(struct dvb_frontend_event));
+		e->status=status;
+		e->parameters.frequency=s->frequency;
+		e->parameters.inversion=s->inversion;
+		if(satellite(s->delsys))
+			e->parameters.u.qpsk.symbol_rate=s->symbol_rate;
+		else if(s->delsys==SYS_DVBC_ANNEX_A)
+			e->parameters.u.qam.symbol_rate=s->symbol_rate;
+		ready(f->fd,&f->ready,1);
+	}
+}
+
+static int tune(SIMFE *s)
+{
+	SIMFILE *f;
+	uint64_t t;
+	int ms;
+
+	if(satellite(s->delsys)?s->frequency<950000||s->frequency>2150000:
+		s->frequency<47000000||s->frequency>862000000)
+	{
+		errno=EINVAL;
+		return -1;
+	}
+
+	ms=s->lockms;
+	if(s->jitter)ms+=(int)(rand_r(&s->seed)%(2*s->jitter+1))-s->jitter;
+	t=ms>0?ms*1000000ULL:0;
+
+	for(f=s->files;f;f=f->next)
+	{
+		f->cnt=0;
+		f->overflow=0;
+		ready(f->fd,&f->ready,0);
+	}
+
+	s->tunes++;
+	post(s,0);
+	s->stage=1;
+	s->due=nsecs()+t/2+1;
+	s->rest=t-t/2;
+	pthread_cond_signal(&s->cond);
+
+	return 0;
+}
+
+static void *model(void *data)
+{
+	SIMFE *s=(SIMFE *)data;
+	struct timespec ts;
+	uint64_t now;
+
+	pthread_mutex_lock(&s->mtx);
+
+	while(!s->stop)
+	{
+		if(!s->due)
+		{
+			pthread_cond_wait(&s->cond,&s->mtx);
+			continue;
+		}
+
+		if((now=nsecs())<s->due)
+		{
+			ts.tv_sec=s->due/1000000000ULL;
+			ts.tv_nsec=s->due%1000000000ULL;
+			pthread_cond_timedwait(&s->cond,&s->mtx,&ts);
+			continue;
+		}
+
+		s->due=0;
+
+		if(s->stage==1&&present(s))
+		{
+			post(s,FE_HAS_SIGNAL|FE_HAS_CARRIER);
+			s->stage=2;
+			s->due=now+s->rest+1;
+		}
+		else if(s->stage==2&&rand_r(&s->seed)%100>=s->fail)
+		{
+			s->locks++;
+			s->stage=0;
+			post(s,LOCKED);
+		}
+		else
+		{
+			s->failures++;
+			s->stage=0;
+			post(s,present(s)?FE_HAS_SIGNAL|FE_TIMEDOUT:
+				FE_TIMEDOUT);
+		}
+	}
+
+	pthread_mutex_unlock(&s->mtx);
+
+	pthread_exit(NULL);
+}
+
+static void feed(void *user,const void *buf,size_t len)
+{
+	SIMFE *s=(SIMFE *)user;
+	const uint8_t *p=(const uint8_t *)buf;
+	uint8_t bfr[CHUNK];
+	size_t n;
+
+	pthread_mutex_lock(&s->mtx);
+
+	if(!(s->status&FE_HAS_LOCK))
+	{
+		s->dropped+=len/TS_SIZE;
+		pthread_mutex_unlock(&s->mtx);
+		return;
+	}
+
+	s->bits+=len*8;
+	s->blocks+=len/TS_SIZE;
+
+	if(s->ber<=0)
+	{
+		pthread_mutex_unlock(&s->mtx);
+		s->out.feed(s->out.user,buf,len);
+		return;
+	}
+
+	while(len)
+	{
+		n=len>CHUNK?CHUNK:len;
+		memcpy(bfr,p,n);
+
+		for(s->acc+=n*8*s->ber;s->acc>=1&&n>=TS_SIZE;s->acc-=1)
+		{
+			bfr[rand_r(&s->seed)%(n/TS_SIZE)*TS_SIZE+1]|=0x80;
+			s->errors++;
+			s->ucb++;
+		}
+
+		pthread_mutex_unlock(&s->mtx);
+		s->out.feed(s->out.user,bfr,n);
+		pthread_mutex_lock(&s->mtx);
+
+		p+=n;
+		len-=n;
+	}
+
+	pthread_mutex_unlock(&s->mtx);
+}
+
+static void lost(void *user,unsigned int pkts)
+{
+	SIMFE *s=(SIMFE *)user;
+
+	s->out.lost(s->out.user,pkts);
+}
+
+static void stat(struct dtv_property *p,int scale,unsigned long long val)
+{
+	p->u.st.len=1;
+	p->u.st.stat[0].scale=scale;
+	p->u.st.stat[0].uvalue=val;
+}
+
+static void getprop(SIMFE *s,struct dtv_property *p)
+{
+	int locked=s->status&FE_HAS_LOCK;
+	int i;
+
+	switch(p->cmd)
+	{
+	case DTV_API_VERSION:
+		p->u.data=(DVB_API_VERSION<<8)|DVB_API_VERSION_MINOR;
+		break;
+
+	case DTV_DELIVERY_SYSTEM:
+		p->u.data=s->delsys;
+		break;
+
+	case DTV_FREQUENCY:
+		p->u.data=s->frequency;
+		break;
+
+	case DTV_SYMBOL_RATE:
+		p->u.data=s->symbol_rate;
+		break;
+
+	case DTV_MODULATION:
+		p->u.data=s->modulation;
+		break;
+
+	case DTV_INNER_FEC:
+		p->u.data=s->fec;
+		break;
+
+	case DTV_BANDWIDTH_HZ:
+		p->u.data=s->bandwidth;
+		break;
+
+	case DTV_INVERSION:
+		p->u.data=s->inversion;
+		break;
+
+	case DTV_STREAM_ID:
+		p->u.data=s->stream_id;
+		break;
+
+	case DTV_VOLTAGE:
+		p->u.data=s->voltage;
+		break;
+
+	case DTV_TONE:
+		p->u.data=s->tone;
+		break;
+
+	case DTV_ENUM_DELSYS:
+		p->u.buffer.len=0;
+		if(satellite(s->info.delsys))
+		{
+			p->u.buffer.data[p->u.buffer.len++]=SYS_DVBS;
+			p->u.buffer.data[p->u.buffer.len++]=SYS_DVBS2;
+		}
+		else p->u.buffer.data[p->u.buffer.len++]=s->info.delsys;
+		break;
+
+	case DTV_STAT_SIGNAL_STRENGTH:
+		stat(p,FE_SCALE_RELATIVE,strength(s));
+		break;
+
+	case DTV_STAT_CNR:
+		if(!(s->status&FE_HAS_CARRIER))stat(p,FE_SCALE_NOT_AVAILABLE,0);
+		else
+		{
+			stat(p,FE_SCALE_DECIBEL,0);
+			p->u.st.stat[0].svalue=cnr(s);
+		}
+		break;
+
+	case DTV_STAT_POST_ERROR_BIT_COUNT:
+		stat(p,locked?FE_SCALE_COUNTER:FE_SCALE_NOT_AVAILABLE,
+			s->errors);
+		break;
+
+	case DTV_STAT_POST_TOTAL_BIT_COUNT:
+		stat(p,locked?FE_SCALE_COUNTER:FE_SCALE_NOT_AVAILABLE,
+			s->bits);
+		break;
+
+	case DTV_STAT_ERROR_BLOCK_COUNT:
+		stat(p,locked?FE_SCALE_COUNTER:FE_SCALE_NOT_AVAILABLE,s->ucb);
+		break;
+
+	case DTV_STAT_TOTAL_BLOCK_COUNT:
+		stat(p,locked?FE_SCALE_COUNTER:FE_SCALE_NOT_AVAILABLE,
+			s->blocks);
+		break;
+
+	case DTV_STAT_PRE_ERROR_BIT_COUNT:
+	case DTV_STAT_PRE_TOTAL_BIT_COUNT:
+		stat(p,FE_SCALE_NOT_AVAILABLE,0);
+		break;
+
+	default:
+		for(i=0;i<sizeof(p->u.buffer.data);i++)p->u.buffer.data[i]=0;
+		p->u.data=0;
+		break;
+	}
+}
+
+static int setprop(SIMFE *s,struct dtv_property *p)
+{
+	switch(p->cmd)
+	{
+	case DTV_CLEAR:
+		s->frequency=0;
+		s->symbol_rate=0;
+		s->modulation=0;
+		s->fec=0;
+		s->bandwidth=0;
+		s->inversion=INVERSION_AUTO;
+		s->stream_id=NO_STREAM_ID_FILTER;
+		break;
+
+	case DTV_DELIVERY_SYSTEM:
+		if(satellite(p->u.data)!=satellite(s->info.delsys)||
+			(!satellite(p->u.data)&&p->u.data!=s->info.delsys))
+		{
+			errno=EINVAL;
+			return -1;
+		}
+		s->delsys=p->u.data;
+		break;
+
+	case DTV_FREQUENCY:
+		s->frequency=p->u.data;
+		break;
+
+	case DTV_SYMBOL_RATE:
+		s->symbol_rate=p->u.data;
+		break;
+
+	case DTV_MODULATION:
+		s->modulation=p->u.data;
+		break;
+
+	case DTV_INNER_FEC:
+		s->fec=p->u.data;
+		break;
+
+	case DTV_BANDWIDTH_HZ:
+		s->bandwidth=p->u.data;
+		break;
+
+	case DTV_INVERSION:
+		s->inversion=p->u.data;
+		break;
+
+	case DTV_STREAM_ID:
+		s->stream_id=p->u.data;
+		break;
+
+	case DTV_VOLTAGE:
+		s->voltage=p->u.data;
+		break;
+
+	case DTV_TONE:
+		s->tone=p->u.data;
+		break;
+
+	case DTV_TUNE:
+		return tune(s);
+	}
+
+	return 0;
+}
+
+static void getinfo(SIMFE *s,struct dvb_frontend_info *info)
+{
+	memset(info,0,sizeof(struct dvb_frontend_info));
+	snprintf(info->name,sizeof(info->name),"%s",s->info.name);
+
+	if(satellite(s->info.delsys))
+	{
+		info->type=FE_QPSK;
+		info->frequency_min=950000;
+		info->frequency_max=2150000;
+		info->symbol_rate_min=1000000;
+		info->symbol_rate_max=45000000;
+	}
+	else if(s->info.delsys==SYS_DVBC_ANNEX_A)
+	{
+		info->type=FE_QAM;
+		info->frequency_min=47000000;
+		info->frequency_max=862000000;
+		info->symbol_rate_min=1000000;
+		info->symbol_rate_max=7200000;
+	}
+	else
+	{
+		info->type=s->info.delsys==SYS_ATSC?FE_ATSC:FE_OFDM;
+		info->frequency_min=47000000;
+		info->frequency_max=862000000;
+	}
+
+	info->caps=FE_CAN_INVERSION_AUTO|FE_CAN_FEC_AUTO|FE_CAN_QPSK|
+		FE_CAN_QAM_AUTO|FE_CAN_TRANSMISSION_MODE_AUTO|
+		FE_CAN_GUARD_INTERVAL_AUTO|FE_CAN_HIERARCHY_AUTO|
+		FE_CAN_2G_MODULATION|FE_CAN_MULTISTREAM;
+}
+
+static int simfe_fe_open(void *user,const char *pathname,int flags)
+{
+	SIMFE *s=(SIMFE *)user;
+	SIMFILE *f;
+
+	if(!(f=malloc(sizeof(SIMFILE))))
+	{
+		errno=ENOMEM;
+		return -1;
+	}
+	memset(f,0,sizeof(SIMFILE));
+	f->flags=flags;
+
+	if((f->fd=eventfd(0,EFD_CLOEXEC|EFD_NONBLOCK))==-1)
+	{
+		free(f);
+		return -1;
+	}
+
+	pthread_mutex_lock(&s->mtx);
+	f->next=s->files;
+	s->files=f;
+	pthread_mutex_unlock(&s->mtx);
+
+	return f->fd;
+}
+
+static void simfe_fe_close(void *user,int fd)
+{
+	SIMFE *s=(SIMFE *)user;
+	SIMFILE **e;
+	SIMFILE *f;
+
+	pthread_mutex_lock(&s->mtx);
+	for(e=&s->files;*e;e=&(*e)->next)if((*e)->fd==fd)
+	{
+		f=*e;
+		*e=f->next;
+		free(f);
+		break;
+	}
+	pthread_mutex_unlock(&s->mtx);
+
+	close(fd);
+}
+
+static int simfe_fe_ioctl(void *user,int fd,unsigned long request,void *arg)
+{
+	SIMFE *s=(SIMFE *)user;
+	struct dtv_properties *props=(struct dtv_properties *)arg;
+	struct dvb_frontend_parameters *fep=
+		(struct dvb_frontend_parameters *)arg;
+	struct dvb_diseqc_master_cmd *cmd=
+		(struct dvb_diseqc_master_cmd *)arg;
+	struct dvb_diseqc_slave_reply *reply=
+		(struct dvb_diseqc_slave_reply *)arg;
+	SIMFILE *f;
+	int r=0;
+	int i;
+
+	if((request==FE_DISEQC_SEND_MASTER_CMD||
+		request==FE_DISEQC_SEND_BURST)&&s->diseqcms)
+			usleep(s->diseqcms*1000);
+
+	pthread_mutex_lock(&s->mtx);
+
+	for(f=s->files;f;f=f->next)if(f->fd==fd)break;
+	if(!f)
+	{
+		errno=EBADF;
+		r=-1;
+		goto out;
+	}
+
+	switch(request)
+	{
+	case FE_GET_INFO:
+		getinfo(s,(struct dvb_frontend_info *)arg);
+		break;
+
+	case FE_READ_STATUS:
+		*(fe_status_t *)arg=s->status;
+		break;
+
+	case FE_READ_BER:
+		*(uint32_t *)arg=s->errors;
+		break;
+
+	case FE_READ_UNCORRECTED_BLOCKS:
+		*(uint32_t *)arg=s->ucb;
+		break;
+
+	case FE_READ_SIGNAL_STRENGTH:
+		*(uint16_t *)arg=strength(s);
+		break;
+
+	case FE_READ_SNR:
+		*(uint16_t *)arg=s->status&FE_HAS_CARRIER?cnr(s)/100:0;
+		break;
+
+	case FE_SET_PROPERTY:
+		for(i=0;i<props->num&&!r;i++)r=setprop(s,&props->props[i]);
+		break;
+
+	case FE_GET_PROPERTY:
+		for(i=0;i<props->num;i++)getprop(s,&props->props[i]);
+		break;
+
+	case FE_SET_FRONTEND:
+		s->frequency=fep->frequency;
+		s->inversion=fep->inversion;
+		if(satellite(s->delsys))s->symbol_rate=fep->u.qpsk.symbol_rate;
+		else if(s->delsys==SYS_DVBC_ANNEX_A)
+			s->symbol_rate=fep->u.qam.symbol_rate;
+		r=tune(s);
+		break;
+
+	case FE_GET_FRONTEND:
+		memset(fep,0,sizeof(struct dvb_frontend_parameters));
+		fep->frequency=s->frequency;
+		fep->inversion=s->inversion;
+		if(satellite(s->delsys))fep->u.qpsk.symbol_rate=s->symbol_rate;
+		else if(s->delsys==SYS_DVBC_ANNEX_A)
+			fep->u.qam.symbol_rate=s->symbol_rate;
+		break;
+
+	case FE_GET_EVENT:
+		if(f->overflow)
+		{
+			f->overflow=0;
+			errno=EOVERFLOW;
+			r=-1;
+		}
+		else if(!f->cnt)
+		{
+			errno=EWOULDBLOCK;
+			r=-1;
+		}
+		else
+		{
+			*(struct dvb_frontend_event *)arg=f->ev[f->head];
+			f->head=(f->head+1)%EVQUEUE;
+			f->cnt--;
+		}
+		ready(f->fd,&f->ready,f->cnt||f->overflow);
+		break;
+
+	case FE_SET_VOLTAGE:
+		s->voltage=(long)arg;
+		break;
+
+	case FE_SET_TONE:
+		s->tone=(long)arg;
+		break;
+
+	case FE_ENABLE_HIGH_LNB_VOLTAGE:
+	case FE_DISEQC_RESET_OVERLOAD:
+		break;
+
+	case FE_DISEQC_SEND_MASTER_CMD:
+		if(cmd->msg_len<3||cmd->msg_len>6)
+		{
+			errno=EINVAL;
+			r=-1;
+			break;
+		}
+		s->reply=cmd->msg[0]==0xe2||cmd->msg[0]==0xe3;
+		s->diseqc++;
+		break;
+
+	case FE_DISEQC_SEND_BURST:
+		s->diseqc++;
+		break;
+
+	case FE_DISEQC_RECV_SLAVE_REPLY:
+		if(!s->reply)
+		{
+			errno=ETIMEDOUT;
+			r=-1;
+			break;
+		}
+		memset(reply,0,sizeof(struct dvb_diseqc_slave_reply));
+		reply->msg[0]=0xe4;
+		reply->msg_len=1;
+		s->reply=0;
+		break;
+
+	default:
+		errno=EOPNOTSUPP;
+		r=-1;
+		break;
+	}
+
+out:	pthread_mutex_unlock(&s->mtx);
+
+	return r;
+}
+
+static int simfe_fe_poll(void *user,struct pollfd *fd)
+{
+	SIMFE *s=(SIMFE *)user;
+	SIMFILE *f;
+
+	pthread_mutex_lock(&s->mtx);
+	for(f=s->files;f;f=f->next)if(f->fd==fd->fd)break;
+	fd->revents=f&&(f->cnt||f->overflow)?POLLPRI:0;
+	pthread_mutex_unlock(&s->mtx);
+
+	return fd->revents?1:0;
+}
+
+static int parse(SIMFE *s,const char *spec)
+{
+	char bfr[256];
+	char *item;
+	char *val;
+	char *mem;
+
+	if(strlen(spec)>=sizeof(bfr))return -1;
+	strcpy(bfr,spec);
+
+	for(item=strtok_r(bfr,",",&mem);item;item=strtok_r(NULL,",",&mem))
+	{
+		if(!(val=strchr(item,'=')))return -1;
+		*val++=0;
+
+		if(!strcmp(item,"lock"))s->lockms=atoi(val);
+		else if(!strcmp(item,"jitter"))s->jitter=atoi(val);
+		else if(!strcmp(item,"fail"))s->fail=atoi(val);
+		else if(!strcmp(item,"strength"))s->strength=atoi(val);
+		else if(!strcmp(item,"cnr"))s->cnr=strtod(val,NULL)*1000;
+		else if(!strcmp(item,"ber"))s->ber=strtod(val,NULL);
+		else if(!strcmp(item,"diseqc"))s->diseqcms=atoi(val);
+		else if(!strcmp(item,"seed"))s->seed=strtoul(val,NULL,0);
+		else return -1;
+	}
+
+	if(s->lockms<0||s->jitter<0||s->fail<0||s->fail>100||
+		s->strength<0||s->strength>100||s->ber<0||s->ber>=1||
+		s->diseqcms<0)return -1;
+
+	return 0;
+}
+
+void *simfe_create(const SWSRC_INFO *info,const char *spec,
+	const TS_SINK *out)
+{
+	SIMFE *s;
+	pthread_condattr_t attr;
+
+	if(!(s=malloc(sizeof(SIMFE))))goto err1;
+	memset(s,0,sizeof(SIMFE));
+	s->info=*info;
+	s->out=*out;
+	s->seed=1;
+	s->lockms=200;
+	s->strength=75;
+	s->cnr=12000;
+	s->diseqcms=15;
+	s->delsys=info->delsys;
+	s->frequency=info->frequency;
+	s->symbol_rate=info->symbol_rate;
+	s->inversion=INVERSION_AUTO;
+	s->stream_id=NO_STREAM_ID_FILTER;
+	s->voltage=SEC_VOLTAGE_13;
+	s->tone=SEC_TONE_OFF;
+
+	if(parse(s,spec))goto err2;
+
+	if(pthread_condattr_init(&attr))goto err2;
+	if(pthread_condattr_setclock(&attr,CLOCK_MONOTONIC)||
+		pthread_cond_init(&s->cond,&attr))
+	{
+		pthread_condattr_destroy(&attr);
+		goto err2;
+	}
+	pthread_condattr_destroy(&attr);
+
+	if(pthread_mutex_init(&s->mtx,NULL))goto err3;
+	if(s->frequency&&tune(s))goto err4;
+	if(pthread_create(&s->th,NULL,model,s))goto err4;
+
+	return s;
+
+err4:	pthread_mutex_destroy(&s->mtx);
+err3:	pthread_cond_destroy(&s->cond);
+err2:	free(s);
+err1:	return NULL;
+}
+
+void simfe_destroy(void *ctx)
+{
+	SIMFE *s=(SIMFE *)ctx;
+	SIMFILE *f;
+
+	if(!s)return;
+
+	pthread_mutex_lock(&s->mtx);
+	s->stop=1;
+	pthread_cond_signal(&s->cond);
+	pthread_mutex_unlock(&s->mtx);
+	pthread_join(s->th,NULL);
+
+	while((f=s->files))
+	{
+		s->files=f->next;
+		close(f->fd);
+		free(f);
+	}
+
+	pthread_mutex_destroy(&s->mtx);
+	pthread_cond_destroy(&s->cond);
+	free(s);
+}
+
+void simfe_sink(void *ctx,TS_SINK *sink)
+{
+	sink->feed=feed;
+	sink->lost=lost;
+	sink->user=ctx;
+}
+
+void simfe_frontend(void *ctx,SWSRC_FE *fe)
+{
+	fe->open=simfe_fe_open;
+	fe->close=simfe_fe_close;
+	fe->ioctl=simfe_fe_ioctl;
+	fe->poll=simfe_fe_poll;
+	fe->user=ctx;
+}
+
+void simfe_dump(void *ctx,FILE *fp,const char *prefix)
+{
+	SIMFE *s=(SIMFE *)ctx;
+
+	pthread_mutex_lock(&s->mtx);
+	fprintf(fp,"%s status=0x%02x frequency=%u tunes=%llu locks=%llu "
+		"failures=%llu diseqc=%llu dropped=%llu bits=%llu "
+		"errors=%llu\n",
+		prefix,s->status,s->frequency,s->tunes,s->locks,s->failures,
+		s->diseqc,s->dropped,s->bits,s->errors);
+	pthread_mutex_unlock(&s->mtx);
+}
@@ -0,0 +1,22 @@
+/*
+ * Simulated frontend with lock timing and signal model
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef SIMFE_H
+#define SIMFE_H
+
+extern void *simfe_create(const SWSRC_INFO *info,const char *spec,
+	const TS_SINK *out);
+extern void simfe_destroy(void *ctx);
+extern void simfe_sink(void *ctx,TS_SINK *sink);
+extern void simfe_frontend(void *ctx,SWSRC_FE *fe);
+extern void simfe_dump(void *ctx,FILE *fp,const char *prefix);
+
+#endif
@@ -0,0 +1,373 @@
+/*
+ * Single program transport stream filter
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <sys/types.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "ts.h"
+#include "spts.h"
+
+#define MAXSCT	1024
+
+typedef struct
+{
+	pthread_mutex_t mtx;
+	int program;
+	int tsid;
+	int pmtpid;
+	int patversion;
+	int patlen;
+	int pmtlen;
+	uint8_t pat[MAXSCT];
+	uint8_t pmt[MAXSCT];
+	uint8_t pids[TS_ALLPIDS/8];
+} SERVICE;
+
+typedef struct
+{
+	int fill;
+	int need;
+	uint8_t data[MAXSCT+TS_SIZE];
+} ASSEMBLY;
+
+typedef struct
+{
+	SERVICE *svc;
+	ASSEMBLY pat;
+	ASSEMBLY pmt;
+	int patcc;
+	int pmtcc;
+	int patpos;
+	int pmtpos;
+	int patqlen;
+	int pmtqlen;
+	uint8_t patq[TS_SIZE];
+	uint8_t pmtq[TS_SIZE*((MAXSCT+TS_SIZE-1)/(TS_SIZE-4)+1)];
+} STREAM;
+
+#define SETPID(s,p)	((s)->pids[(p)>>3]|=1<<((p)&7))
+#define HASPID(s,p)	((s)->pids[(p)>>3]&(1<<((p)&7)))
+
+static void basepids(SERVICE *s)
+{
+	memset(s->pids,0,sizeof(s->pids));
+	SETPID(s,0x0000);
+	SETPID(s,0x0001);
+	SETPID(s,0x0014);
+	if(s->pmtpid!=-1)SETPID(s,s->pmtpid);
+}
+
+static void capids(SERVICE *s,const uint8_t *d,int len)
+{
+	int i;
+
+	for(i=0;i+2<=len&&i+2+d[i+1]<=len;i+=2+d[i+1])
+		if(d[i]==0x09&&d[i+1]>=4)SETPID(s,((d[i+4]&0x1f)<<8)|d[i+5]);
+}
+
+static void mkpat(SERVICE *s)
+{
+	uint8_t *p=s->pat;
+	uint32_t crc;
+
+	p[0]=0x00;
+	p[1]=0xb0;
+	p[2]=13;
+	p[3]=s->tsid>>8;
+	p[4]=s->tsid;
+	p[5]=0xc1|(s->patversion<<1);
+	p[6]=0;
+	p[7]=0;
+	p[8]=s->program>>8;
+	p[9]=s->program;
+	p[10]=0xe0|(s->pmtpid>>8);
+	p[11]=s->pmtpid;
+	crc=ts_crc32(p,12);
+	p[12]=crc>>24;
+	p[13]=crc>>16;
+	p[14]=crc>>8;
+	p[15]=crc;
+	s->patlen=16;
+}
+
+static int pat(SERVICE *s,const uint8_t *sct,int len)
+{
+	int i;
+
+	if(SCT_TID(sct)||!SCT_CURRENT(sct)||!sct_valid(sct,len))return 0;
+
+	for(i=8;i+4<=len-4;i+=4)if(((sct[i]<<8)|sct[i+1])==s->program)
+	{
+		s->tsid=SCT_EXT(sct);
+		s->patversion=SCT_VERSION(sct);
+		if(s->pmtpid!=(((sct[i+2]&0x1f)<<8)|sct[i+3]))
+		{
+			s->pmtpid=((sct[i+2]&0x1f)<<8)|sct[i+3];
+			s->pmtlen=0;
+			basepids(s);
+		}
+		mkpat(s);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int pmt(SERVICE *s,const uint8_t *sct,int len)
+{
+	int i;
+	int n;
+
+	if(SCT_TID(sct)!=0x02||SCT_EXT(sct)!=s->program||!SCT_CURRENT(sct)||
+		len<16||!sct_valid(sct,len))return 0;
+
+	if(s->pmtlen==len&&!memcmp(s->pmt,sct,len))return 1;
+
+	basepids(s);
+	SETPID(s,((sct[8]&0x1f)<<8)|sct[9]);
+	n=((sct[10]&0x0f)<<8)|sct[11];
+	if(12+n>len-4)return 0;
+	capids(s,sct+12,n);
+
+	for(i=12+n;i+5<=len-4;i+=5+n)
+	{
+		SETPID(s,((sct[i+1]&0x1f)<<8)|sct[i+2]);
+		n=((sct[i+3]&0x0f)<<8)|sct[i+4];
+		if(i+5+n>len-4)break;
+		capids(s,sct+i+5,n);
+	}
+
+	memcpy(s->pmt,sct,len);
+	s->pmtlen=len;
+	return 1;
+}
+
+static int packetize(const uint8_t *sct,int len,int pid,uint8_t *out)
+{
+	int n=0;
+	int i;
+	int pusi=0x40;
+
+	while(len>0||pusi)
+	{
+		out[0]=TS_SYNC;
+		out[1]=pusi|(pid>>8);
+		out[2]=pid;
+		out[3]=0x10;
+		i=4;
+		if(pusi)out[i++]=0;
+		pusi=0;
+		if(len<TS_SIZE-i)
+		{
+			memcpy(out+i,sct,len);
+			memset(out+i+len,0xff,TS_SIZE-i-len);
+			len=0;
+		}
+		else
+		{
+			memcpy(out+i,sct,TS_SIZE-i);
+			sct+=TS_SIZE-i;
+			len-=TS_SIZE-i;
+		}
+		out+=TS_SIZE;
+		n++;
+	}
+
+	return n;
+}
+
+static int assemble(ASSEMBLY *a,const uint8_t *pkt)
+{
+	int i=4;
+	int n;
+
+	if(TS_TEI(pkt)||!(TS_AFC(pkt)&1))return 0;
+	if(TS_AFC(pkt)&2)i+=pkt[4]+1;
+	if(i>=TS_SIZE)return 0;
+
+	if(TS_PUSI(pkt))
+	{
+		i+=pkt[i]+1;
+		if(i>=TS_SIZE)return 0;
+		a->fill=0;
+		a->need=3;
+	}
+	else if(!a->need)return 0;
+
+	n=TS_SIZE-i;
+	if(a->fill+n>sizeof(a->data))n=sizeof(a->data)-a->fill;
+	memcpy(a->data+a->fill,pkt+i,n);
+	a->fill+=n;
+
+	if(a->need==3&&a->fill>=3)
+	{
+		if(a->data[0]==0xff||SCT_LEN(a->data)>MAXSCT)
+		{
+			a->need=0;
+			return 0;
+		}
+		a->need=SCT_LEN(a->data);
+	}
+
+	if(a->need<=3||a->fill<a->need)return 0;
+
+	n=a->need;
+	a->need=0;
+	return n;
+}
+
+void *spts_create(int program)
+{
+	SERVICE *s;
+
+	if(program<1||program>0xffff)goto err1;
+	if(!(s=malloc(sizeof(SERVICE))))goto err1;
+	memset(s,0,sizeof(SERVICE));
+	if(pthread_mutex_init(&s->mtx,NULL))goto err2;
+
+	s->program=program;
+	s->pmtpid=-1;
+	basepids(s);
+	return s;
+
+err2:	free(s);
+err1:	return NULL;
+}
+
+void spts_destroy(void *ctx)
+{
+	SERVICE *s=(SERVICE *)ctx;
+
+	if(!s)return;
+	pthread_mutex_destroy(&s->mtx);
+	free(s);
+}
+
+int spts_allowed(void *ctx,int pid)
+{
+	SERVICE *s=(SERVICE *)ctx;
+	int r;
+
+	pthread_mutex_lock(&s->mtx);
+	r=!s->pmtlen||pid>=TS_ALLPIDS||HASPID(s,pid);
+	pthread_mutex_unlock(&s->mtx);
+
+	return r;
+}
+
+ssize_t spts_section(void *ctx,void *buf,size_t len)
+{
+	SERVICE *s=(SERVICE *)ctx;
+	uint8_t *sct=(uint8_t *)buf;
+	ssize_t r=len;
+
+	if(len<3||SCT_LEN(sct)!=len)return len;
+
+	pthread_mutex_lock(&s->mtx);
+
+	switch(SCT_TID(sct))
+	{
+	case 0x00:
+		if(!pat(s,sct,len))r=0;
+		else memcpy(sct,s->pat,r=s->patlen);
+		break;
+
+	case 0x02:
+		if(!pmt(s,sct,len))r=0;
+		break;
+	}
+
+	pthread_mutex_unlock(&s->mtx);
+
+	return r;
+}
+
+void *spts_open(void *ctx)
+{
+	STREAM *t;
+
+	if(!(t=malloc(sizeof(STREAM))))return NULL;
+	memset(t,0,sizeof(STREAM));
+	t->svc=(SERVICE *)ctx;
+	return t;
+}
+
+void spts_close(void *stream)
+{
+	free(stream);
+}
+
+static int replace(uint8_t *q,uint8_t *queue,int qlen,int *pos,int *cc)
+{
+	if(*pos>=qlen)return 0;
+	memcpy(q,queue+*pos*TS_SIZE,TS_SIZE);
+	q[3]=(q[3]&0xf0)|*cc;
+	*cc=(*cc+1)&0xf;
+	(*pos)++;
+	return 1;
+}
+
+size_t spts_filter(void *stream,void *buf,size_t len)
+{
+	STREAM *t=(STREAM *)stream;
+	SERVICE *s=t->svc;
+	uint8_t *p=(uint8_t *)buf;
+	uint8_t *q=(uint8_t *)buf;
+	uint8_t *e=p+len-len%TS_SIZE;
+	int pid;
+	int n;
+
+	pthread_mutex_lock(&s->mtx);
+
+	for(;p<e;p+=TS_SIZE)
+	{
+		if(*p!=TS_SYNC)continue;
+
+		pid=TS_PID(p);
+
+		if(!pid)
+		{
+			if((n=assemble(&t->pat,p))&&pat(s,t->pat.data,n))
+			{
+				t->patqlen=packetize(s->pat,s->patlen,0,t->patq);
+				t->patpos=0;
+			}
+			if(replace(q,t->patq,t->patqlen,&t->patpos,&t->patcc))
+				q+=TS_SIZE;
+			continue;
+		}
+
+		if(pid==s->pmtpid)
+		{
+			if((n=assemble(&t->pmt,p))&&pmt(s,t->pmt.data,n))
+			{
+				t->pmtqlen=packetize(s->pmt,s->pmtlen,pid,
+					t->pmtq);
+				t->pmtpos=0;
+			}
+			if(replace(q,t->pmtq,t->pmtqlen,&t->pmtpos,&t->pmtcc))
+				q+=TS_SIZE;
+			continue;
+		}
+
+		if(pid!=TS_NULLPID&&(!HASPID(s,pid)||!s->pmtlen))continue;
+
+		if(q!=p)memcpy(q,p,TS_SIZE);
+		q+=TS_SIZE;
+	}
+
+	pthread_mutex_unlock(&s->mtx);
+
+	return q-(uint8_t *)buf;
+}
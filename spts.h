@@ -0,0 +1,23 @@
+/*
+ * Single program transport stream filter
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef SPTS_H
+#define SPTS_H
+
+extern void *spts_create(int program);
+extern void spts_destroy(void *ctx);
+extern int spts_allowed(void *ctx,int pid);
+extern ssize_t spts_section(void *ctx,void *buf,size_t len);
+extern void *spts_open(void *ctx);
+extern void spts_close(void *stream);
+extern size_t spts_filter(void *stream,void *buf,size_t len);
+
+#endif
@@ -0,0 +1,320 @@
+/*
+ * Built-in transport stream pipeline stages
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <sys/types.h>
+#include <limits.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <poll.h>
+
+#include "dvbcuse.h"
+#include "ts.h"
+#include "spts.h"
+#include "stages.h"
+
+typedef struct
+{
+	uint16_t map[TS_ALLPIDS];
+} REMAP;
+
+typedef struct
+{
+	uint8_t pmt[TS_ALLPIDS/8];
+} PMTS;
+
+typedef struct
+{
+	uint8_t pids[TS_ALLPIDS/8];
+} DROP;
+
+static DVBCUSE_STAGE *stage_alloc(const char *name,size_t privsize)
+{
+	DVBCUSE_STAGE *t;
+
+	if(!(t=malloc(sizeof(DVBCUSE_STAGE))))goto err1;
+	memset(t,0,sizeof(DVBCUSE_STAGE));
+	t->name=name;
+
+	if(privsize)
+	{
+		if(!(t->priv=malloc(privsize)))goto err2;
+		memset(t->priv,0,privsize);
+	}
+
+	return t;
+
+err2:	free(t);
+err1:	return NULL;
+}
+
+static size_t nullstrip(void *priv,void *stream,unsigned char *buf,size_t len)
+{
+	unsigned char *p;
+	unsigned char *q;
+	unsigned char *e=buf+len;
+
+	for(p=buf;p<e&&TS_PID(p)!=TS_NULLPID;p+=TS_SIZE);
+
+	for(q=p;p<e;p+=TS_SIZE)if(TS_PID(p)!=TS_NULLPID)
+	{
+		memcpy(q,p,TS_SIZE);
+		q+=TS_SIZE;
+	}
+
+	return q-buf;
+}
+
+static int repid(REMAP *r,uint8_t *f)
+{
+	int pid=((f[0]&0x1f)<<8)|f[1];
+
+	if(r->map[pid]==pid)return 0;
+	f[0]=(f[0]&0xe0)|(r->map[pid]>>8);
+	f[1]=r->map[pid];
+	return 1;
+}
+
+static void psi(REMAP *r,PMTS *m,unsigned char *p)
+{
+	unsigned char *s;
+	uint32_t crc;
+	int pid=TS_PID(p);
+	int len;
+	int chg=0;
+	int i;
+
+	if(!TS_PUSI(p)||TS_TEI(p)||!(TS_AFC(p)&1))return;
+	if(pid&&!(m->pmt[pid>>3]&(1<<(pid&7))))return;
+
+	i=4;
+	if(TS_AFC(p)&2)i+=1+p[4];
+	if(i>=TS_SIZE||(i+=1+p[i])+3>TS_SIZE)return;
+	s=p+i;
+	if(!SCT_SYNTAX(s)||(len=SCT_LEN(s))<12||i+len>TS_SIZE)return;
+
+	if(!pid&&SCT_TID(s)==0x00)for(i=8;i+4<=len-4;i+=4)
+	{
+		if(!s[i]&&!s[i+1])continue;
+		pid=((s[i+2]&0x1f)<<8)|s[i+3];
+		m->pmt[pid>>3]|=1<<(pid&7);
+		chg|=repid(r,s+i+2);
+	}
+	else if(pid&&SCT_TID(s)==0x02&&len>=16)
+	{
+		chg|=repid(r,s+8);
+		for(i=12+(((s[10]&0x0f)<<8)|s[11]);i+5<=len-4;
+			i+=5+(((s[i+3]&0x0f)<<8)|s[i+4]))chg|=repid(r,s+i+1);
+	}
+
+	if(!chg)return;
+
+	crc=ts_crc32(s,len-4);
+	s[len-4]=crc>>24;
+	s[len-3]=crc>>16;
+	s[len-2]=crc>>8;
+	s[len-1]=crc;
+}
+
+static void *remap_open(void *priv,DVBCUSE_STREAM *stream)
+{
+	PMTS *m;
+
+	if(!(m=malloc(sizeof(PMTS))))return NULL;
+	memset(m,0,sizeof(PMTS));
+	return m;
+}
+
+static void remap_close(void *priv,void *stream)
+{
+	free(stream);
+}
+
+static size_t remap(void *priv,void *stream,unsigned char *buf,size_t len)
+{
+	REMAP *r=(REMAP *)priv;
+	unsigned char *p;
+	unsigned char *e=buf+len;
+
+	for(p=buf;p<e;p+=TS_SIZE)
+	{
+		psi(r,(PMTS *)stream,p);
+		repid(r,p+1);
+	}
+
+	return len;
+}
+
+static size_t drop(void *priv,void *stream,unsigned char *buf,size_t len)
+{
+	DROP *d=(DROP *)priv;
+	unsigned char *p;
+	unsigned char *q;
+	unsigned char *e=buf+len;
+	int pid;
+
+	for(p=q=buf;p<e;p+=TS_SIZE)
+	{
+		pid=TS_PID(p);
+		if(d->pids[pid>>3]&(1<<(pid&7)))continue;
+		if(q!=p)memcpy(q,p,TS_SIZE);
+		q+=TS_SIZE;
+	}
+
+	return q-buf;
+}
+
+static void *spts_stream(void *priv,DVBCUSE_STREAM *stream)
+{
+	return spts_open(priv);
+}
+
+static void spts_release(void *priv,void *stream)
+{
+	spts_close(stream);
+}
+
+static size_t spts_process(void *priv,void *stream,unsigned char *buf,
+	size_t len)
+{
+	return spts_filter(stream,buf,len);
+}
+
+DVBCUSE_STAGE *stage_nullstrip(void)
+{
+	DVBCUSE_STAGE *t;
+
+	if(!(t=stage_alloc("nullstrip",0)))return NULL;
+	t->process=nullstrip;
+	return t;
+}
+
+DVBCUSE_STAGE *stage_remap(void)
+{
+	DVBCUSE_STAGE *t;
+	REMAP *r;
+	int i;
+
+	if(!(t=stage_alloc("remap",sizeof(REMAP))))return NULL;
+	t->open=remap_open;
+	t->close=remap_close;
+	t->process=remap;
+	r=(REMAP *)t->priv;
+	for(i=0;i<TS_ALLPIDS;i++)r->map[i]=i;
+	return t;
+}
+
+int stage_remap_add(DVBCUSE_STAGE *stage,int from,int to)
+{
+	REMAP *r=(REMAP *)stage->priv;
+
+	if(stage->process!=remap||from<0||from>=TS_NULLPID||to<0||
+		to>=TS_NULLPID)return -1;
+	r->map[from]=to;
+	return 0;
+}
+
+DVBCUSE_STAGE *stage_drop(void)
+{
+	DVBCUSE_STAGE *t;
+
+	if(!(t=stage_alloc("drop",sizeof(DROP))))return NULL;
+	t->process=drop;
+	return t;
+}
+
+int stage_drop_add(DVBCUSE_STAGE *stage,int pid)
+{
+	DROP *d=(DROP *)stage->priv;
+
+	if(stage->process!=drop||pid<0||pid>=TS_ALLPIDS)return -1;
+	d->pids[pid>>3]|=1<<(pid&7);
+	return 0;
+}
+
+DVBCUSE_STAGE *stage_spts(void *spts)
+{
+	DVBCUSE_STAGE *t;
+
+	if(!(t=stage_alloc("spts",0)))return NULL;
+	t->open=spts_stream;
+	t->close=spts_release;
+	t->process=spts_process;
+	t->priv=spts;
+	return t;
+}
+
+void stage_append(DVBCUSE_STAGE **list,DVBCUSE_STAGE *stage)
+{
+	while(*list)list=&(*list)->next;
+	*list=stage;
+}
+
+DVBCUSE_STAGE *stage_clone(DVBCUSE_STAGE *list)
+{
+	DVBCUSE_STAGE *head=NULL;
+	DVBCUSE_STAGE *t;
+	size_t privsize;
+
+	for(;list;list=list->next)
+	{
+		if(list->process==remap)privsize=sizeof(REMAP);
+		else if(list->process==drop)privsize=sizeof(DROP);
+		else privsize=0;
+
+		if(!(t=stage_alloc(list->name,privsize)))goto err;
+		t->open=list->open;
+		t->close=list->close;
+		t->process=list->process;
+		if(privsize)memcpy(t->priv,list->priv,privsize);
+		else t->priv=list->priv;
+		stage_append(&head,t);
+	}
+
+	return head;
+
+err:	stage_free(head);
+	return NULL;
+}
+
+void stage_free(DVBCUSE_STAGE *list)
+{
+	DVBCUSE_STAGE *t;
+
+	while(list)
+	{
+		t=list;
+		list=t->next;
+		if(t->process!=spts_process)free(t->priv);
+		free(t);
+	}
+}
+
+void stage_dump(DVBCUSE_STAGE *list,FILE *fp,const char *prefix)
+{
+	unsigned long long calls;
+	unsigned long long nsecs;
+	unsigned long long pkts;
+
+	for(;list;list=list->next)
+	{
+		calls=__atomic_load_n(&list->calls,__ATOMIC_RELAXED);
+		nsecs=__atomic_load_n(&list->nsecs,__ATOMIC_RELAXED);
+		pkts=__atomic_load_n(&list->pkts_in,__ATOMIC_RELAXED);
+
+		fprintf(fp,"%s stage=%s calls=%llu packets_in=%llu "
+			"packets_out=%llu nsecs=%llu ns_per_packet=%llu\n",
+			prefix,list->name,calls,pkts,
+			__atomic_load_n(&list->pkts_out,__ATOMIC_RELAXED),nsecs,
+			pkts?nsecs/pkts:0ULL);
+	}
+}
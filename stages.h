@@ -0,0 +1,28 @@
+/*
+ * Built-in transport stream pipeline stages
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef STAGES_H
+#define STAGES_H
+
+extern DVBCUSE_STAGE *stage_nullstrip(void);
+/* PAT and PMT sections are rewritten to the new PIDs when they fit into
+   the packet that starts them, longer ones are passed unchanged */
+extern DVBCUSE_STAGE *stage_remap(void);
+extern int stage_remap_add(DVBCUSE_STAGE *stage,int from,int to);
+extern DVBCUSE_STAGE *stage_drop(void);
+extern int stage_drop_add(DVBCUSE_STAGE *stage,int pid);
+extern DVBCUSE_STAGE *stage_spts(void *spts);
+extern void stage_append(DVBCUSE_STAGE **list,DVBCUSE_STAGE *stage);
+extern DVBCUSE_STAGE *stage_clone(DVBCUSE_STAGE *list);
+extern void stage_free(DVBCUSE_STAGE *list);
+extern void stage_dump(DVBCUSE_STAGE *list,FILE *fp,const char *prefix);
+
+#endif
@@ -0,0 +1,1487 @@
+/*
+ * Software DVB source (ring buffer, demux and frontend emulation)
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <sys/ioctl.h>
+#include <linux/dvb/frontend.h>
+#include <linux/dvb/version.h>
+#include <linux/dvb/dmx.h>
+
+#include <sys/eventfd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "dvbcuse.h"
+#include "ts.h"
+#include "swsrc.h"
+
+#define RINGPKTS	32768
+#define DMXBUFSIZE	(TS_SIZE*1024)
+#define MAXSCT		4096
+
+typedef struct _pending
+{
+	struct _pending *next;
+	DVBCUSE_REQ *req;
+	struct iovec *iov;
+	int iovcnt;
+	ssize_t result;
+	struct iovec one;
+} PENDING;
+
+typedef struct _dvrfile
+{
+	struct _dvrfile *next;
+	DVBCUSE_STREAM *stream;
+	PENDING *pend;
+	int fd;
+	int flags;
+	int ready;
+	uint64_t rpos;
+} DVRFILE;
+
+typedef struct _dmxfile
+{
+	struct _dmxfile *next;
+	DVBCUSE_STREAM *stream;
+	PENDING *pend;
+	int fd;
+	int flags;
+	int ready;
+	int mode;
+	int started;
+	int output;
+	int all;
+	int overflow;
+	struct dmx_sct_filter_params sct;
+	uint8_t pids[TS_ALLPIDS/8];
+	unsigned char *buf;
+	size_t size;
+	size_t head;
+	size_t fill;
+	int cc;
+	int synced;
+	int afill;
+	uint8_t asmb[MAXSCT+TS_SIZE];
+} DMXFILE;
+
+typedef struct _fefile
+{
+	struct _fefile *next;
+	DVBCUSE_STREAM *stream;
+	int fd;
+	int flags;
+	int ready;
+	int event;
+} FEFILE;
+
+typedef struct
+{
+	int type;
+	int fd;
+} HANDLE;
+
+typedef struct
+{
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	SWSRC_INFO info;
+	unsigned char *ring;
+	uint64_t wpos;
+	DVRFILE *dvr;
+	DMXFILE *dmx;
+	FEFILE *fe;
+	SWSRC_FE ext;
+	int tapall;
+	uint8_t tap[TS_ALLPIDS/8];
+	uint64_t lastfeed;
+	uint32_t lost;
+	int delsys;
+	unsigned int frequency;
+	unsigned int symbol_rate;
+} SWSRC;
+
+#define MODE_NONE	0
+#define MODE_SECTION	1
+#define MODE_PES	2
+
+#define SETPID(b,p)	((b)[(p)>>3]|=1<<((p)&7))
+#define CLRPID(b,p)	((b)[(p)>>3]&=~(1<<((p)&7)))
+#define HASPID(b,p)	((b)[(p)>>3]&(1<<((p)&7)))
+
+static const struct
+{
+	const char *name;
+	int delsys;
+} delsys[]=
+{
+	{"dvbs",SYS_DVBS},
+	{"dvbs2",SYS_DVBS2},
+	{"dvbt",SYS_DVBT},
+	{"dvbt2",SYS_DVBT2},
+	{"dvbc",SYS_DVBC_ANNEX_A},
+	{"atsc",SYS_ATSC},
+	{"isdbt",SYS_ISDBT},
+	{NULL,0}
+};
+
+static uint64_t nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static int satellite(int sys)
+{
+	return sys==SYS_DVBS||sys==SYS_DVBS2;
+}
+
+static void put(DMXFILE *f,const void *data,size_t len)
+{
+	size_t pos;
+	size_t n;
+
+	if(f->overflow)return;
+
+	if(f->size-f->fill<len)
+	{
+		f->overflow=1;
+		return;
+	}
+
+	pos=(f->head+f->fill)%f->size;
+	n=f->size-pos<len?f->size-pos:len;
+	memcpy(f->buf+pos,data,n);
+	if(n<len)memcpy(f->buf,(const uint8_t *)data+n,len-n);
+	f->fill+=len;
+}
+
+static size_t get(DMXFILE *f,void *data,size_t len)
+{
+	size_t n;
+
+	if(len>f->fill)len=f->fill;
+	n=f->size-f->head<len?f->size-f->head:len;
+	memcpy(data,f->buf+f->head,n);
+	if(n<len)memcpy((uint8_t *)data+n,f->buf,len-n);
+	f->head=(f->head+len)%f->size;
+	f->fill-=len;
+	return len;
+}
+
+static void section(DMXFILE *f,const uint8_t *sct,int len)
+{
+	if((f->sct.flags&DMX_CHECK_CRC)&&!sct_valid(sct,len))return;
+	if(!sct_match(f->sct.filter.filter,f->sct.filter.mask,
+		f->sct.filter.mode,DMX_FILTER_SIZE,sct,len))return;
+
+	put(f,sct,len);
+	if(f->sct.flags&DMX_ONESHOT)f->started=0;
+}
+
+static void extract(DMXFILE *f)
+{
+	int len;
+
+	while(f->afill>=3&&f->started)
+	{
+		if(f->asmb[0]==0xff||(len=SCT_LEN(f->asmb))>MAXSCT)
+		{
+			f->afill=0;
+			f->synced=0;
+			return;
+		}
+
+		if(f->afill<len)return;
+
+		section(f,f->asmb,len);
+		memmove(f->asmb,f->asmb+len,f->afill-len);
+		f->afill-=len;
+	}
+}
+
+static void append(DMXFILE *f,const uint8_t *data,int len)
+{
+	if(f->afill+len>sizeof(f->asmb))
+	{
+		f->afill=0;
+		f->synced=0;
+		return;
+	}
+	memcpy(f->asmb+f->afill,data,len);
+	f->afill+=len;
+	extract(f);
+}
+
+static void sections(DMXFILE *f,const uint8_t *p)
+{
+	int off=4;
+	int cc=TS_CC(p);
+	int ptr;
+
+	if(TS_TEI(p)||!(TS_AFC(p)&1))return;
+	if(TS_AFC(p)&2)off+=p[4]+1;
+	if(off>=TS_SIZE)return;
+
+	if(f->cc!=-1&&cc!=((f->cc+1)&0xf))
+	{
+		if(cc==f->cc)return;
+		f->afill=0;
+		f->synced=0;
+	}
+	f->cc=cc;
+
+	if(TS_PUSI(p))
+	{
+		ptr=p[off++];
+		if(off+ptr>TS_SIZE)
+		{
+			f->afill=0;
+			f->synced=0;
+			return;
+		}
+		if(f->synced&&ptr)append(f,p+off,ptr);
+		f->afill=0;
+		f->synced=1;
+		off+=ptr;
+	}
+	else if(!f->synced)return;
+
+	append(f,p+off,TS_SIZE-off);
+}
+
+static void dispatch(SWSRC *s,const uint8_t *p)
+{
+	DMXFILE *f;
+	int pid=TS_PID(p);
+	int off;
+
+	for(f=s->dmx;f;f=f->next)if(f->started)switch(f->mode)
+	{
+	case MODE_SECTION:
+		if(f->sct.pid==pid)sections(f,p);
+		break;
+
+	case MODE_PES:
+		if(!f->all&&!HASPID(f->pids,pid))break;
+		switch(f->output)
+		{
+		case DMX_OUT_TSDEMUX_TAP:
+			put(f,p,TS_SIZE);
+			break;
+
+		case DMX_OUT_TAP:
+			if(!(TS_AFC(p)&1))break;
+			off=4;
+			if(TS_AFC(p)&2)off+=p[4]+1;
+			if(off<TS_SIZE)put(f,p+off,TS_SIZE-off);
+			break;
+		}
+		break;
+	}
+}
+
+static void retap(SWSRC *s)
+{
+	DMXFILE *f;
+	int i;
+
+	s->tapall=0;
+	memset(s->tap,0,sizeof(s->tap));
+
+	for(f=s->dmx;f;f=f->next)
+		if(f->mode==MODE_PES&&f->started&&f->output==DMX_OUT_TS_TAP)
+	{
+		if(f->all)s->tapall=1;
+		else for(i=0;i<sizeof(s->tap);i++)s->tap[i]|=f->pids[i];
+	}
+}
+
+static int handle(void)
+{
+	return eventfd(0,EFD_CLOEXEC|EFD_NONBLOCK);
+}
+
+static void ready(int fd,int *state,DVBCUSE_STREAM *stream,int on)
+{
+	eventfd_t v;
+
+	if(on&&!*state)
+	{
+		eventfd_write(fd,1);
+		if(stream)dvbcuse_notify(stream);
+	}
+	else if(!on&&*state)eventfd_read(fd,&v);
+	*state=on;
+}
+
+static void complete(PENDING *p)
+{
+	PENDING *n;
+
+	for(;p;p=n)
+	{
+		n=p->next;
+		dvbcuse_complete(p->req,p->result);
+		free(p);
+	}
+}
+
+static int swsrc_fe_open(void *user,const char *pathname,int flags)
+{
+	SWSRC *s=(SWSRC *)user;
+	FEFILE *f;
+
+	if(s->ext.open)return s->ext.open(s->ext.user,pathname,flags);
+
+	if(!(f=malloc(sizeof(FEFILE))))
+	{
+		errno=ENOMEM;
+		return -1;
+	}
+	memset(f,0,sizeof(FEFILE));
+	f->flags=flags;
+
+	if((f->fd=handle())==-1)
+	{
+		free(f);
+		return -1;
+	}
+
+	pthread_mutex_lock(&s->mtx);
+	f->next=s->fe;
+	s->fe=f;
+	pthread_mutex_unlock(&s->mtx);
+
+	return f->fd;
+}
+
+static void swsrc_fe_close(void *user,int fd)
+{
+	SWSRC *s=(SWSRC *)user;
+	FEFILE **e;
+	FEFILE *f;
+
+	if(s->ext.close)
+	{
+		s->ext.close(s->ext.user,fd);
+		return;
+	}
+
+	pthread_mutex_lock(&s->mtx);
+	for(e=&s->fe;*e;e=&(*e)->next)if((*e)->fd==fd)
+	{
+		f=*e;
+		*e=f->next;
+		free(f);
+		break;
+	}
+	pthread_mutex_unlock(&s->mtx);
+
+	close(fd);
+}
+
+static fe_status_t status(SWSRC *s)
+{
+	if(!s->lastfeed||nsecs()-s->lastfeed>2000000000ULL)return 0;
+	return FE_HAS_SIGNAL|FE_HAS_CARRIER|FE_HAS_VITERBI|FE_HAS_SYNC|
+		FE_HAS_LOCK;
+}
+
+static void getprop(SWSRC *s,struct dtv_property *p)
+{
+	int i;
+
+	switch(p->cmd)
+	{
+	case DTV_API_VERSION:
+		p->u.data=(DVB_API_VERSION<<8)|DVB_API_VERSION_MINOR;
+		break;
+
+	case DTV_DELIVERY_SYSTEM:
+		p->u.data=s->delsys;
+		break;
+
+	case DTV_FREQUENCY:
+		p->u.data=s->frequency;
+		break;
+
+	case DTV_SYMBOL_RATE:
+		p->u.data=s->symbol_rate;
+		break;
+
+	case DTV_ENUM_DELSYS:
+		p->u.buffer.len=0;
+		for(i=0;delsys[i].name;i++)
+			if(satellite(delsys[i].delsys)==satellite(s->info.delsys))
+				p->u.buffer.data[p->u.buffer.len++]=
+					delsys[i].delsys;
+		break;
+
+	case DTV_STAT_SIGNAL_STRENGTH:
+		p->u.st.len=1;
+		p->u.st.stat[0].scale=FE_SCALE_RELATIVE;
+		p->u.st.stat[0].uvalue=s->info.strength;
+		break;
+
+	case DTV_STAT_CNR:
+		p->u.st.len=1;
+		p->u.st.stat[0].scale=FE_SCALE_DECIBEL;
+		p->u.st.stat[0].svalue=s->info.snr*100;
+		break;
+
+	case DTV_STAT_ERROR_BLOCK_COUNT:
+		p->u.st.len=1;
+		p->u.st.stat[0].scale=FE_SCALE_COUNTER;
+		p->u.st.stat[0].uvalue=s->lost;
+		break;
+
+	default:
+		p->u.data=0;
+		break;
+	}
+}
+
+static void tuned(SWSRC *s)
+{
+	FEFILE *f;
+
+	for(f=s->fe;f;f=f->next)
+	{
+		f->event=1;
+		ready(f->fd,&f->ready,f->stream,1);
+	}
+}
+
+static int swsrc_fe_ioctl(void *user,int fd,unsigned long request,void *arg)
+{
+	SWSRC *s=(SWSRC *)user;
+	struct dtv_properties *props=(struct dtv_properties *)arg;
+	struct dvb_frontend_info *info=(struct dvb_frontend_info *)arg;
+	struct dvb_frontend_event *event=(struct dvb_frontend_event *)arg;
+	FEFILE *f;
+	int r=0;
+	int i;
+
+	if(s->ext.ioctl)return s->ext.ioctl(s->ext.user,fd,request,arg);
+
+	pthread_mutex_lock(&s->mtx);
+
+	switch(request)
+	{
+	case FE_GET_INFO:
+		memset(info,0,sizeof(struct dvb_frontend_info));
+		snprintf(info->name,sizeof(info->name),"%s",s->info.name);
+		switch(s->info.delsys)
+		{
+		case SYS_DVBS:
+		case SYS_DVBS2:
+			info->type=FE_QPSK;
+			info->frequency_min=950000;
+			info->frequency_max=2150000;
+			info->symbol_rate_min=1000000;
+			info->symbol_rate_max=45000000;
+			break;
+
+		case SYS_DVBC_ANNEX_A:
+			info->type=FE_QAM;
+			info->frequency_min=47000000;
+			info->frequency_max=862000000;
+			info->symbol_rate_min=1000000;
+			info->symbol_rate_max=7200000;
+			break;
+
+		case SYS_ATSC:
+			info->type=FE_ATSC;
+			info->frequency_min=54000000;
+			info->frequency_max=858000000;
+			break;
+
+		default:info->type=FE_OFDM;
+			info->frequency_min=47000000;
+			info->frequency_max=862000000;
+			break;
+		}
+		info->caps=FE_CAN_INVERSION_AUTO|FE_CAN_FEC_AUTO|
+			FE_CAN_QPSK|FE_CAN_QAM_AUTO|
+			FE_CAN_TRANSMISSION_MODE_AUTO|
+			FE_CAN_GUARD_INTERVAL_AUTO|FE_CAN_HIERARCHY_AUTO|
+			FE_CAN_2G_MODULATION;
+		break;
+
+	case FE_READ_STATUS:
+		*(fe_status_t *)arg=status(s);
+		break;
+
+	case FE_READ_BER:
+		*(uint32_t *)arg=0;
+		break;
+
+	case FE_READ_UNCORRECTED_BLOCKS:
+		*(uint32_t *)arg=s->lost;
+		break;
+
+	case FE_READ_SIGNAL_STRENGTH:
+		*(uint16_t *)arg=s->info.strength;
+		break;
+
+	case FE_READ_SNR:
+		*(uint16_t *)arg=s->info.snr;
+		break;
+
+	case FE_SET_PROPERTY:
+		for(i=0;i<props->num;i++)switch(props->props[i].cmd)
+		{
+		case DTV_DELIVERY_SYSTEM:
+			s->delsys=props->props[i].u.data;
+			break;
+
+		case DTV_FREQUENCY:
+			s->frequency=props->props[i].u.data;
+			break;
+
+		case DTV_SYMBOL_RATE:
+			s->symbol_rate=props->props[i].u.data;
+			break;
+
+		case DTV_TUNE:
+			tuned(s);
+			break;
+		}
+		break;
+
+	case FE_GET_PROPERTY:
+		for(i=0;i<props->num;i++)getprop(s,&props->props[i]);
+		break;
+
+	case FE_SET_FRONTEND:
+		s->frequency=((struct dvb_frontend_parameters *)arg)->frequency;
+		tuned(s);
+		break;
+
+	case FE_GET_FRONTEND:
+		memset(arg,0,sizeof(struct dvb_frontend_parameters));
+		((struct dvb_frontend_parameters *)arg)->frequency=s->frequency;
+		break;
+
+	case FE_GET_EVENT:
+		for(f=s->fe;f;f=f->next)if(f->fd==fd)break;
+		if(!f||!f->event)
+		{
+			errno=EWOULDBLOCK;
+			r=-1;
+			break;
+		}
+		f->event=0;
+		ready(f->fd,&f->ready,f->stream,0);
+		memset(event,0,sizeof(struct dvb_frontend_event));
+		event->status=status(s);
+		event->parameters.frequency=s->frequency;
+		break;
+
+	case FE_DISEQC_RECV_SLAVE_REPLY:
+		memset(arg,0,sizeof(struct dvb_diseqc_slave_reply));
+		break;
+	}
+
+	pthread_mutex_unlock(&s->mtx);
+
+	return r;
+}
+
+static int swsrc_fe_poll(void *user,struct pollfd *fd)
+{
+	SWSRC *s=(SWSRC *)user;
+	FEFILE *f;
+
+	if(s->ext.poll)return s->ext.poll(s->ext.user,fd);
+
+	pthread_mutex_lock(&s->mtx);
+	for(f=s->fe;f;f=f->next)if(f->fd==fd->fd)break;
+	fd->revents=f&&f->event?POLLPRI:0;
+	pthread_mutex_unlock(&s->mtx);
+
+	return fd->revents?1:0;
+}
+
+static int swsrc_dmx_open(void *user,const char *pathname,int flags)
+{
+	SWSRC *s=(SWSRC *)user;
+	DMXFILE *f;
+
+	if(!(f=malloc(sizeof(DMXFILE))))goto err1;
+	memset(f,0,sizeof(DMXFILE));
+	f->flags=flags;
+	f->size=DMXBUFSIZE;
+	if(!(f->buf=malloc(f->size)))goto err2;
+	if((f->fd=handle())==-1)goto err3;
+
+	pthread_mutex_lock(&s->mtx);
+	f->next=s->dmx;
+	s->dmx=f;
+	pthread_mutex_unlock(&s->mtx);
+
+	return f->fd;
+
+err3:	free(f->buf);
+err2:	free(f);
+err1:	errno=ENOMEM;
+	return -1;
+}
+
+static DMXFILE *dmxfile(SWSRC *s,int fd)
+{
+	DMXFILE *f;
+
+	for(f=s->dmx;f;f=f->next)if(f->fd==fd)break;
+	return f;
+}
+
+static ssize_t dmxcopy(DMXFILE *f,struct iovec *iov,int iovcnt)
+{
+	size_t len=0;
+	size_t n;
+	int i;
+
+	if(f->overflow)
+	{
+		f->overflow=0;
+		f->head=0;
+		f->fill=0;
+		return -EOVERFLOW;
+	}
+
+	for(i=0;i<iovcnt&&f->fill;i++)
+	{
+		len+=(n=get(f,iov[i].iov_base,iov[i].iov_len));
+		if(n<iov[i].iov_len)break;
+	}
+
+	return len;
+}
+
+static ssize_t swsrc_dmx_read(void *user,int fd,void *buf,size_t count)
+{
+	SWSRC *s=(SWSRC *)user;
+	struct iovec iov;
+	DMXFILE *f;
+	ssize_t len;
+
+	iov.iov_base=buf;
+	iov.iov_len=count;
+
+	pthread_mutex_lock(&s->mtx);
+
+	while(1)
+	{
+		if(!(f=dmxfile(s,fd)))
+		{
+			errno=EBADF;
+			len=-1;
+			break;
+		}
+
+		if((len=dmxcopy(f,&iov,1))<0)
+		{
+			errno=-len;
+			len=-1;
+			break;
+		}
+
+		if(len)break;
+
+		if(f->flags&O_NONBLOCK)
+		{
+			errno=EWOULDBLOCK;
+			len=-1;
+			break;
+		}
+
+		pthread_cond_wait(&s->cond,&s->mtx);
+	}
+
+	if(f)ready(f->fd,&f->ready,f->stream,f->fill||f->overflow);
+
+	pthread_mutex_unlock(&s->mtx);
+
+	return len;
+}
+
+static void dmxqueue(SWSRC *s,int fd,PENDING *p)
+{
+	PENDING **e;
+	DMXFILE *f;
+
+	p->next=NULL;
+
+	pthread_mutex_lock(&s->mtx);
+
+	if(!(f=dmxfile(s,fd)))p->result=-EBADF;
+	else if(!(p->result=dmxcopy(f,p->iov,p->iovcnt)))
+	{
+		if(!(f->flags&O_NONBLOCK))
+		{
+			for(e=&f->pend;*e;e=&(*e)->next);
+			*e=p;
+			pthread_mutex_unlock(&s->mtx);
+			return;
+		}
+		p->result=-EWOULDBLOCK;
+	}
+
+	if(f)ready(f->fd,&f->ready,f->stream,f->fill||f->overflow);
+
+	pthread_mutex_unlock(&s->mtx);
+
+	complete(p);
+}
+
+static void swsrc_dmx_close(void *user,int fd)
+{
+	SWSRC *s=(SWSRC *)user;
+	PENDING *p=NULL;
+	DMXFILE **e;
+	DMXFILE *f;
+
+	pthread_mutex_lock(&s->mtx);
+	for(e=&s->dmx;*e;e=&(*e)->next)if((*e)->fd==fd)
+	{
+		f=*e;
+		*e=f->next;
+		for(p=f->pend;p;p=p->next)p->result=-EBADF;
+		p=f->pend;
+		free(f->buf);
+		free(f);
+		break;
+	}
+	retap(s);
+	pthread_mutex_unlock(&s->mtx);
+
+	complete(p);
+	close(fd);
+}
+
+static int swsrc_dmx_ioctl(void *user,int fd,unsigned long request,void *arg)
+{
+	SWSRC *s=(SWSRC *)user;
+	struct dmx_pes_filter_params *pes=(struct dmx_pes_filter_params *)arg;
+	DMXFILE *f;
+	unsigned char *buf;
+	size_t size;
+	int pid;
+	int r=0;
+
+	pthread_mutex_lock(&s->mtx);
+
+	if(!(f=dmxfile(s,fd)))
+	{
+		errno=EBADF;
+		r=-1;
+		goto out;
+	}
+
+	switch(request)
+	{
+	case DMX_START:
+		if(f->mode==MODE_NONE)goto inval;
+		f->started=1;
+		f->head=f->fill=f->overflow=0;
+		f->afill=f->synced=0;
+		f->cc=-1;
+		break;
+
+	case DMX_STOP:
+		f->started=0;
+		break;
+
+	case DMX_SET_FILTER:
+		f->mode=MODE_SECTION;
+		f->sct=*(struct dmx_sct_filter_params *)arg;
+		f->head=f->fill=f->overflow=0;
+		f->afill=f->synced=0;
+		f->cc=-1;
+		f->started=(f->sct.flags&DMX_IMMEDIATE_START)?1:0;
+		break;
+
+	case DMX_SET_PES_FILTER:
+		if(pes->pid>TS_ALLPIDS)goto inval;
+		f->mode=MODE_PES;
+		f->output=pes->output;
+		memset(f->pids,0,sizeof(f->pids));
+		if(!(f->all=pes->pid==TS_ALLPIDS))SETPID(f->pids,pes->pid);
+		f->head=f->fill=f->overflow=0;
+		f->started=(pes->flags&DMX_IMMEDIATE_START)?1:0;
+		break;
+
+	case DMX_ADD_PID:
+	case DMX_REMOVE_PID:
+		if(f->mode!=MODE_PES||(pid=*(uint16_t *)arg)>=TS_ALLPIDS)
+			goto inval;
+		if(request==DMX_ADD_PID)SETPID(f->pids,pid);
+		else CLRPID(f->pids,pid);
+		break;
+
+	case DMX_SET_BUFFER_SIZE:
+		if(!(size=(unsigned long)arg)||size>64*1024*1024)goto inval;
+		if(!(buf=malloc(size)))
+		{
+			errno=ENOMEM;
+			r=-1;
+			break;
+		}
+		free(f->buf);
+		f->buf=buf;
+		f->size=size;
+		f->head=f->fill=f->overflow=0;
+		break;
+
+	case DMX_GET_PES_PIDS:
+		memset(arg,0,5*sizeof(uint16_t));
+		break;
+
+	default:
+		goto inval;
+	}
+
+	ready(f->fd,&f->ready,f->stream,f->fill||f->overflow);
+	retap(s);
+	goto out;
+
+inval:	errno=EINVAL;
+	r=-1;
+out:	pthread_mutex_unlock(&s->mtx);
+
+	return r;
+}
+
+static int swsrc_dmx_poll(void *user,struct pollfd *fd)
+{
+	SWSRC *s=(SWSRC *)user;
+	DMXFILE *f;
+
+	pthread_mutex_lock(&s->mtx);
+	fd->revents=(f=dmxfile(s,fd->fd))&&(f->fill||f->overflow)?POLLIN:0;
+	pthread_mutex_unlock(&s->mtx);
+
+	return fd->revents?1:0;
+}
+
+static int swsrc_dvr_open(void *user,const char *pathname,int flags)
+{
+	SWSRC *s=(SWSRC *)user;
+	DVRFILE *f;
+
+	if((flags&O_ACCMODE)!=O_RDONLY)
+	{
+		errno=EOPNOTSUPP;
+		return -1;
+	}
+
+	if(!(f=malloc(sizeof(DVRFILE))))
+	{
+		errno=ENOMEM;
+		return -1;
+	}
+	memset(f,0,sizeof(DVRFILE));
+	f->flags=flags;
+
+	if((f->fd=handle())==-1)
+	{
+		free(f);
+		return -1;
+	}
+
+	pthread_mutex_lock(&s->mtx);
+	f->rpos=s->wpos;
+	f->next=s->dvr;
+	s->dvr=f;
+	pthread_mutex_unlock(&s->mtx);
+
+	return f->fd;
+}
+
+static DVRFILE *dvrfile(SWSRC *s,int fd)
+{
+	DVRFILE *f;
+
+	for(f=s->dvr;f;f=f->next)if(f->fd==fd)break;
+	return f;
+}
+
+static int queued(SWSRC *s,DVRFILE *f)
+{
+	if(s->wpos-f->rpos>RINGPKTS)return 1;
+	if(!s->tapall)while(f->rpos<s->wpos&&!HASPID(s->tap,
+		TS_PID(s->ring+(f->rpos&(RINGPKTS-1))*TS_SIZE)))f->rpos++;
+	return f->rpos!=s->wpos;
+}
+
+static ssize_t dvrcopy(SWSRC *s,DVRFILE *f,struct iovec *iov,int iovcnt)
+{
+	unsigned char *p;
+	size_t len=0;
+	size_t off=0;
+	int i=0;
+
+	if(s->wpos-f->rpos>RINGPKTS)
+	{
+		f->rpos=s->wpos;
+		return -EOVERFLOW;
+	}
+
+	for(;f->rpos<s->wpos;f->rpos++)
+	{
+		for(;i<iovcnt&&iov[i].iov_len-off<TS_SIZE;i++)off=0;
+		if(i==iovcnt)break;
+		p=s->ring+(f->rpos&(RINGPKTS-1))*TS_SIZE;
+		if(!s->tapall&&!HASPID(s->tap,TS_PID(p)))continue;
+		memcpy((unsigned char *)iov[i].iov_base+off,p,TS_SIZE);
+		off+=TS_SIZE;
+		len+=TS_SIZE;
+	}
+
+	return len;
+}
+
+static ssize_t swsrc_dvr_read(void *user,int fd,void *buf,size_t count)
+{
+	SWSRC *s=(SWSRC *)user;
+	struct iovec iov;
+	DVRFILE *f;
+	ssize_t len;
+
+	if(count<TS_SIZE)
+	{
+		errno=EINVAL;
+		return -1;
+	}
+
+	iov.iov_base=buf;
+	iov.iov_len=count;
+
+	pthread_mutex_lock(&s->mtx);
+
+	while(1)
+	{
+		if(!(f=dvrfile(s,fd)))
+		{
+			errno=EBADF;
+			len=-1;
+			break;
+		}
+
+		if((len=dvrcopy(s,f,&iov,1))<0)
+		{
+			errno=-len;
+			len=-1;
+			break;
+		}
+
+		if(len)break;
+
+		if(f->flags&O_NONBLOCK)
+		{
+			errno=EWOULDBLOCK;
+			len=-1;
+			break;
+		}
+
+		pthread_cond_wait(&s->cond,&s->mtx);
+	}
+
+	if(f)ready(f->fd,&f->ready,f->stream,queued(s,f));
+
+	pthread_mutex_unlock(&s->mtx);
+
+	return len;
+}
+
+static void dvrqueue(SWSRC *s,int fd,PENDING *p)
+{
+	PENDING **e;
+	DVRFILE *f;
+
+	p->next=NULL;
+
+	pthread_mutex_lock(&s->mtx);
+
+	if(!(f=dvrfile(s,fd)))p->result=-EBADF;
+	else if(!(p->result=dvrcopy(s,f,p->iov,p->iovcnt)))
+	{
+		if(!(f->flags&O_NONBLOCK))
+		{
+			for(e=&f->pend;*e;e=&(*e)->next);
+			*e=p;
+			pthread_mutex_unlock(&s->mtx);
+			return;
+		}
+		p->result=-EWOULDBLOCK;
+	}
+
+	if(f)ready(f->fd,&f->ready,f->stream,queued(s,f));
+
+	pthread_mutex_unlock(&s->mtx);
+
+	complete(p);
+}
+
+static void queue(SWSRC *s,int type,int fd,DVBCUSE_REQ *req,
+	struct iovec *iov,int iovcnt)
+{
+	PENDING *p;
+	size_t room=0;
+	int i;
+
+	if(type==DVBCUSE_DVR)
+	{
+		for(i=0;i<iovcnt;i++)room+=iov[i].iov_len/TS_SIZE;
+		if(!room)
+		{
+			dvbcuse_complete(req,-EINVAL);
+			return;
+		}
+	}
+
+	if(!(p=malloc(sizeof(PENDING))))
+	{
+		dvbcuse_complete(req,-ENOMEM);
+		return;
+	}
+
+	p->req=req;
+	p->iov=iov;
+	p->iovcnt=iovcnt;
+	if(iovcnt==1)
+	{
+		p->one=*iov;
+		p->iov=&p->one;
+	}
+
+	if(type==DVBCUSE_DMX)dmxqueue(s,fd,p);
+	else dvrqueue(s,fd,p);
+}
+
+static void swsrc_dvr_aread(void *user,DVBCUSE_REQ *req,int fd,void *buf,
+	size_t count)
+{
+	struct iovec iov;
+
+	iov.iov_base=buf;
+	iov.iov_len=count;
+	queue((SWSRC *)user,DVBCUSE_DVR,fd,req,&iov,1);
+}
+
+static void swsrc_dvr_areadv(void *user,DVBCUSE_REQ *req,int fd,
+	struct iovec *iov,int iovcnt)
+{
+	queue((SWSRC *)user,DVBCUSE_DVR,fd,req,iov,iovcnt);
+}
+
+static void swsrc_dvr_close(void *user,int fd)
+{
+	SWSRC *s=(SWSRC *)user;
+	PENDING *p=NULL;
+	DVRFILE **e;
+	DVRFILE *f;
+
+	pthread_mutex_lock(&s->mtx);
+	for(e=&s->dvr;*e;e=&(*e)->next)if((*e)->fd==fd)
+	{
+		f=*e;
+		*e=f->next;
+		for(p=f->pend;p;p=p->next)p->result=-EBADF;
+		p=f->pend;
+		free(f);
+		break;
+	}
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->mtx);
+
+	complete(p);
+	close(fd);
+}
+
+static int swsrc_dvr_ioctl(void *user,int fd,unsigned long request,void *arg)
+{
+	return 0;
+}
+
+static int swsrc_dvr_poll(void *user,struct pollfd *fd)
+{
+	SWSRC *s=(SWSRC *)user;
+	DVRFILE *f;
+
+	pthread_mutex_lock(&s->mtx);
+	for(f=s->dvr;f;f=f->next)if(f->fd==fd->fd)break;
+	fd->revents=f&&queued(s,f)?POLLIN:0;
+	pthread_mutex_unlock(&s->mtx);
+
+	return fd->revents?1:0;
+}
+
+static void *swsrc_h_open(void *user,DVBCUSE_STREAM *stream,int type,
+	int unit,int flags)
+{
+	SWSRC *s=(SWSRC *)user;
+	HANDLE *h;
+	FEFILE *fe;
+	DMXFILE *dmx;
+	DVRFILE *dvr;
+
+	if(!(h=malloc(sizeof(HANDLE))))
+	{
+		errno=ENOMEM;
+		return NULL;
+	}
+	h->type=type;
+
+	switch(type)
+	{
+	case DVBCUSE_FE:
+		h->fd=swsrc_fe_open(s,"",flags);
+		break;
+	case DVBCUSE_DMX:
+		h->fd=swsrc_dmx_open(s,"",flags);
+		break;
+	case DVBCUSE_DVR:
+		h->fd=swsrc_dvr_open(s,"",flags);
+		break;
+	default:errno=ENODEV;
+		h->fd=-1;
+		break;
+	}
+
+	if(h->fd==-1)
+	{
+		free(h);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&s->mtx);
+	switch(type)
+	{
+	case DVBCUSE_FE:
+		for(fe=s->fe;fe;fe=fe->next)if(fe->fd==h->fd)
+			fe->stream=stream;
+		break;
+	case DVBCUSE_DMX:
+		if((dmx=dmxfile(s,h->fd)))dmx->stream=stream;
+		break;
+	case DVBCUSE_DVR:
+		if((dvr=dvrfile(s,h->fd)))dvr->stream=stream;
+		break;
+	}
+	pthread_mutex_unlock(&s->mtx);
+
+	return h;
+}
+
+static void swsrc_h_close(void *user,void *handle)
+{
+	HANDLE *h=(HANDLE *)handle;
+
+	switch(h->type)
+	{
+	case DVBCUSE_FE:
+		swsrc_fe_close(user,h->fd);
+		break;
+	case DVBCUSE_DMX:
+		swsrc_dmx_close(user,h->fd);
+		break;
+	case DVBCUSE_DVR:
+		swsrc_dvr_close(user,h->fd);
+		break;
+	}
+
+	free(h);
+}
+
+static void swsrc_h_readv(void *user,DVBCUSE_REQ *req,void *handle,
+	struct iovec *iov,int iovcnt)
+{
+	HANDLE *h=(HANDLE *)handle;
+
+	switch(h->type)
+	{
+	case DVBCUSE_DMX:
+	case DVBCUSE_DVR:
+		queue((SWSRC *)user,h->type,h->fd,req,iov,iovcnt);
+		break;
+	default:dvbcuse_complete(req,-EINVAL);
+		break;
+	}
+}
+
+static void swsrc_h_read(void *user,DVBCUSE_REQ *req,void *handle,void *buf,
+	size_t count)
+{
+	struct iovec iov;
+
+	iov.iov_base=buf;
+	iov.iov_len=count;
+	swsrc_h_readv(user,req,handle,&iov,1);
+}
+
+static int swsrc_h_ioctl(void *user,void *handle,unsigned long request,
+	void *arg)
+{
+	HANDLE *h=(HANDLE *)handle;
+
+	switch(h->type)
+	{
+	case DVBCUSE_FE:
+		return swsrc_fe_ioctl(user,h->fd,request,arg);
+	case DVBCUSE_DMX:
+		return swsrc_dmx_ioctl(user,h->fd,request,arg);
+	case DVBCUSE_DVR:
+		return swsrc_dvr_ioctl(user,h->fd,request,arg);
+	default:errno=ENOTTY;
+		return -1;
+	}
+}
+
+static int swsrc_h_poll(void *user,void *handle)
+{
+	HANDLE *h=(HANDLE *)handle;
+	struct pollfd p;
+
+	p.fd=h->fd;
+	p.events=POLLIN|POLLPRI;
+	p.revents=0;
+
+	switch(h->type)
+	{
+	case DVBCUSE_FE:
+		swsrc_fe_poll(user,&p);
+		break;
+	case DVBCUSE_DMX:
+		swsrc_dmx_poll(user,&p);
+		break;
+	case DVBCUSE_DVR:
+		swsrc_dvr_poll(user,&p);
+		break;
+	}
+
+	return p.revents;
+}
+
+void *swsrc_create(const SWSRC_INFO *info)
+{
+	SWSRC *s;
+
+	if(!(s=malloc(sizeof(SWSRC))))goto err1;
+	memset(s,0,sizeof(SWSRC));
+	if(!(s->ring=malloc(RINGPKTS*TS_SIZE)))goto err2;
+	if(pthread_mutex_init(&s->mtx,NULL))goto err3;
+	if(pthread_cond_init(&s->cond,NULL))goto err4;
+
+	s->info=*info;
+	s->delsys=info->delsys;
+	s->frequency=info->frequency;
+	s->symbol_rate=info->symbol_rate;
+	return s;
+
+err4:	pthread_mutex_destroy(&s->mtx);
+err3:	free(s->ring);
+err2:	free(s);
+err1:	return NULL;
+}
+
+void swsrc_destroy(void *ctx)
+{
+	SWSRC *s=(SWSRC *)ctx;
+
+	if(!s)return;
+
+	while(s->fe)swsrc_fe_close(s,s->fe->fd);
+	while(s->dmx)swsrc_dmx_close(s,s->dmx->fd);
+	while(s->dvr)swsrc_dvr_close(s,s->dvr->fd);
+
+	pthread_cond_destroy(&s->cond);
+	pthread_mutex_destroy(&s->mtx);
+	free(s->ring);
+	free(s);
+}
+
+int swsrc_info(SWSRC_INFO *info,const char *spec)
+{
+	char bfr[256];
+	char *item;
+	char *val;
+	char *mem;
+	int i;
+
+	if(strlen(spec)>=sizeof(bfr))return -1;
+	strcpy(bfr,spec);
+
+	for(item=strtok_r(bfr,",",&mem);item;item=strtok_r(NULL,",",&mem))
+	{
+		if(!(val=strchr(item,'=')))return -1;
+		*val++=0;
+
+		if(!strcmp(item,"name"))
+		{
+			strncpy(info->name,val,sizeof(info->name)-1);
+			info->name[sizeof(info->name)-1]=0;
+		}
+		else if(!strcmp(item,"delsys"))
+		{
+			for(i=0;delsys[i].name;i++)
+				if(!strcasecmp(val,delsys[i].name))break;
+			if(!delsys[i].name)return -1;
+			info->delsys=delsys[i].delsys;
+		}
+		else if(!strcmp(item,"freq"))info->frequency=strtoul(val,NULL,0);
+		else if(!strcmp(item,"sr"))info->symbol_rate=strtoul(val,NULL,0);
+		else if(!strcmp(item,"strength"))info->strength=atoi(val);
+		else if(!strcmp(item,"snr"))info->snr=atoi(val);
+		else return -1;
+	}
+
+	return 0;
+}
+
+void swsrc_feed(void *ctx,const void *buf,size_t len)
+{
+	SWSRC *s=(SWSRC *)ctx;
+	const uint8_t *p=(const uint8_t *)buf;
+	const uint8_t *e=p+len;
+	PENDING *done=NULL;
+	PENDING **tail=&done;
+	PENDING *q;
+	DVRFILE *d;
+	DMXFILE *f;
+	ssize_t n;
+
+	pthread_mutex_lock(&s->mtx);
+
+	while(e-p>=TS_SIZE)
+	{
+		if(*p!=TS_SYNC)
+		{
+			if(!(p=memchr(p+1,TS_SYNC,e-p-1)))break;
+			continue;
+		}
+
+		memcpy(s->ring+(s->wpos++&(RINGPKTS-1))*TS_SIZE,p,TS_SIZE);
+		if(s->dmx)dispatch(s,p);
+		p+=TS_SIZE;
+	}
+
+	s->lastfeed=nsecs();
+
+	for(d=s->dvr;d;d=d->next)
+	{
+		while((q=d->pend)&&(n=dvrcopy(s,d,q->iov,q->iovcnt)))
+		{
+			d->pend=q->next;
+			q->result=n;
+			q->next=NULL;
+			*tail=q;
+			tail=&q->next;
+		}
+		ready(d->fd,&d->ready,d->stream,queued(s,d));
+	}
+	for(f=s->dmx;f;f=f->next)
+	{
+		while((q=f->pend)&&(n=dmxcopy(f,q->iov,q->iovcnt)))
+		{
+			f->pend=q->next;
+			q->result=n;
+			q->next=NULL;
+			*tail=q;
+			tail=&q->next;
+		}
+		ready(f->fd,&f->ready,f->stream,f->fill||f->overflow);
+	}
+
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->mtx);
+
+	complete(done);
+}
+
+void swsrc_lost(void *ctx,unsigned int pkts)
+{
+	SWSRC *s=(SWSRC *)ctx;
+
+	pthread_mutex_lock(&s->mtx);
+	s->lost+=pkts;
+	pthread_mutex_unlock(&s->mtx);
+}
+
+void swsrc_backend(void *ctx,DVBCUSE_DEVICE *dev)
+{
+	dev->fe_open=swsrc_fe_open;
+	dev->fe_close=swsrc_fe_close;
+	dev->fe_ioctl=swsrc_fe_ioctl;
+	dev->fe_poll=swsrc_fe_poll;
+
+	dev->dmx_open=swsrc_dmx_open;
+	dev->dmx_read=swsrc_dmx_read;
+	dev->dmx_close=swsrc_dmx_close;
+	dev->dmx_ioctl=swsrc_dmx_ioctl;
+	dev->dmx_poll=swsrc_dmx_poll;
+
+	dev->dvr_open=swsrc_dvr_open;
+	dev->dvr_read=swsrc_dvr_read;
+	dev->dvr_write=NULL;
+	dev->dvr_close=swsrc_dvr_close;
+	dev->dvr_ioctl=swsrc_dvr_ioctl;
+	dev->dvr_poll=swsrc_dvr_poll;
+	dev->v2.dvr_read=swsrc_dvr_aread;
+	dev->v2.dvr_readv=swsrc_dvr_areadv;
+
+	dev->ca_open=NULL;
+	dev->ca_read=NULL;
+	dev->ca_write=NULL;
+	dev->ca_close=NULL;
+	dev->ca_ioctl=NULL;
+	dev->ca_poll=NULL;
+
+	dev->net_open=NULL;
+	dev->net_close=NULL;
+	dev->net_ioctl=NULL;
+
+	dev->user=ctx;
+}
+
+void swsrc_handles(void *ctx,DVBCUSE_DEVICE *dev)
+{
+	dev->h.open=swsrc_h_open;
+	dev->h.close=swsrc_h_close;
+	dev->h.read=swsrc_h_read;
+	dev->h.readv=swsrc_h_readv;
+	dev->h.write=NULL;
+	dev->h.ioctl=swsrc_h_ioctl;
+	dev->h.poll=swsrc_h_poll;
+
+	dev->user=ctx;
+}
+
+void swsrc_frontend(void *ctx,const SWSRC_FE *fe)
+{
+	SWSRC *s=(SWSRC *)ctx;
+
+	s->ext=*fe;
+}
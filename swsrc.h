@@ -0,0 +1,43 @@
+/*
+ * Software DVB source (ring buffer, demux and frontend emulation)
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef SWSRC_H
+#define SWSRC_H
+
+typedef struct
+{
+	char name[128];
+	int delsys;
+	unsigned int frequency;
+	unsigned int symbol_rate;
+	int strength;
+	int snr;
+} SWSRC_INFO;
+
+typedef struct
+{
+	int (*open)(void *user,const char *pathname,int flags);
+	void (*close)(void *user,int fd);
+	int (*ioctl)(void *user,int fd,unsigned long request,void *arg);
+	int (*poll)(void *user,struct pollfd *fd);
+	void *user;
+} SWSRC_FE;
+
+extern void *swsrc_create(const SWSRC_INFO *info);
+extern void swsrc_destroy(void *ctx);
+extern int swsrc_info(SWSRC_INFO *info,const char *spec);
+extern void swsrc_feed(void *ctx,const void *buf,size_t len);
+extern void swsrc_lost(void *ctx,unsigned int pkts);
+extern void swsrc_backend(void *ctx,DVBCUSE_DEVICE *dev);
+extern void swsrc_handles(void *ctx,DVBCUSE_DEVICE *dev);
+extern void swsrc_frontend(void *ctx,const SWSRC_FE *fe);
+
+#endif
@@ -0,0 +1,407 @@
+/*
+ * T2-MI decapsulation into per PLP transport streams
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "ts.h"
+#include "t2mi.h"
+
+#define T2MIHDR		6
+#define T2MIMAX		(T2MIHDR+8192+4)
+#define BBHDR		10
+#define OUTPKTS		256
+
+#define BB_TS(m)	(((m)&0xc0)==0xc0)
+#define BB_ISSYI(m)	((m)&0x08)
+#define BB_NPD(m)	((m)&0x04)
+
+typedef struct
+{
+	int plp;
+	TS_SINK sink;
+	int sync;
+	int fill;
+	int hem;
+	int issyi;
+	int npd;
+	int outfill;
+	uint8_t up[TS_SIZE+4];
+	uint8_t *out;
+	unsigned long long frames;
+	unsigned long long pkts;
+	unsigned long long nulls;
+	unsigned long long errors;
+} PLP;
+
+typedef struct
+{
+	pthread_mutex_t mtx;
+	int pid;
+	int cc;
+	int sync;
+	int fill;
+	int nplp;
+	unsigned long long packets;
+	unsigned long long bbframes;
+	unsigned long long crcerr;
+	unsigned long long ccerr;
+	uint8_t crc8[256];
+	uint8_t pkt[T2MIMAX];
+	PLP plp[T2MI_MAXPLP];
+} T2MI;
+
+static const uint8_t nullpkt[4]={TS_SYNC,0x1f,0xff,0x10};
+
+static void flush(PLP *p)
+{
+	if(!p->outfill)return;
+	p->sink.feed(p->sink.user,p->out,p->outfill*TS_SIZE);
+	p->outfill=0;
+}
+
+static uint8_t *slot(PLP *p)
+{
+	if(p->outfill==OUTPKTS)flush(p);
+	return p->out+p->outfill++*TS_SIZE;
+}
+
+static int uplen(PLP *p)
+{
+	int len=p->hem?TS_SIZE-1:TS_SIZE;
+
+	if(!p->hem&&p->issyi)
+	{
+		if(p->fill>len)len+=(p->up[len]&0x80)?3:2;
+		else len++;
+	}
+	if(p->npd)len++;
+
+	return len;
+}
+
+static void packet(PLP *p,int len)
+{
+	uint8_t *q;
+	int n;
+
+	if(p->npd)for(n=p->up[len-1];n;n--)
+	{
+		q=slot(p);
+		memcpy(q,nullpkt,sizeof(nullpkt));
+		memset(q+sizeof(nullpkt),0xff,TS_SIZE-sizeof(nullpkt));
+		p->nulls++;
+	}
+
+	q=slot(p);
+	q[0]=TS_SYNC;
+	memcpy(q+1,p->hem?p->up:p->up+1,TS_SIZE-1);
+	p->pkts++;
+}
+
+static void upbytes(PLP *p,const uint8_t *data,int len)
+{
+	int need;
+
+	while(len)
+	{
+		if((need=uplen(p)-p->fill)>len)need=len;
+		memcpy(p->up+p->fill,data,need);
+		p->fill+=need;
+		data+=need;
+		len-=need;
+
+		if(p->fill==uplen(p))
+		{
+			packet(p,p->fill);
+			p->fill=0;
+		}
+	}
+}
+
+static void bbframe(T2MI *t,PLP *p,const uint8_t *bb,int len)
+{
+	uint8_t crc=0;
+	int dfl;
+	int syncd;
+	int mode;
+	int i;
+
+	if(len<BBHDR)goto err;
+
+	for(i=0;i<BBHDR-1;i++)crc=t->crc8[crc^bb[i]];
+	if((mode=crc^bb[BBHDR-1])>1||!BB_TS(bb[0]))goto err;
+
+	dfl=((bb[4]<<8)|bb[5])>>3;
+	syncd=(bb[7]<<8)|bb[8];
+	if(dfl>len-BBHDR)goto err;
+
+	p->frames++;
+	bb+=BBHDR;
+
+	if(p->sync&&(p->hem!=mode||p->issyi!=BB_ISSYI(bb[-BBHDR])||
+		p->npd!=BB_NPD(bb[-BBHDR])))p->sync=0;
+
+	p->hem=mode;
+	p->issyi=BB_ISSYI(bb[-BBHDR]);
+	p->npd=BB_NPD(bb[-BBHDR]);
+
+	if(syncd==0xffff)
+	{
+		if(p->sync)upbytes(p,bb,dfl);
+		return;
+	}
+
+	if((syncd>>=3)>dfl)goto err;
+
+	if(p->sync)
+	{
+		upbytes(p,bb,syncd);
+		if(p->fill)p->errors++;
+	}
+
+	p->sync=1;
+	p->fill=0;
+	upbytes(p,bb+syncd,dfl-syncd);
+	return;
+
+err:	p->errors++;
+	p->sync=0;
+}
+
+static void t2packet(T2MI *t,const uint8_t *pkt,int len)
+{
+	int i;
+
+	t->packets++;
+
+	if(ts_crc32(pkt,len))
+	{
+		t->crcerr++;
+		return;
+	}
+
+	if(pkt[0]||len<T2MIHDR+4+3)return;
+
+	t->bbframes++;
+
+	for(i=0;i<t->nplp;i++)if(t->plp[i].plp==pkt[T2MIHDR+1])
+	{
+		bbframe(t,&t->plp[i],pkt+T2MIHDR+3,len-T2MIHDR-4-3);
+		break;
+	}
+}
+
+static void collect(T2MI *t,const uint8_t *data,int len)
+{
+	int total;
+	int n;
+
+	while(len&&t->sync)
+	{
+		if(t->fill<T2MIHDR)total=T2MIHDR;
+		else if((total=T2MIHDR+((((t->pkt[4]<<8)|t->pkt[5])+7)>>3)+4)>
+			T2MIMAX)
+		{
+			t->sync=0;
+			break;
+		}
+
+		if((n=total-t->fill)>len)n=len;
+		memcpy(t->pkt+t->fill,data,n);
+		t->fill+=n;
+		data+=n;
+		len-=n;
+
+		if(t->fill==total&&total>T2MIHDR)
+		{
+			t2packet(t,t->pkt,total);
+			t->fill=0;
+		}
+	}
+}
+
+static void feed(void *user,const void *buf,size_t len)
+{
+	T2MI *t=(T2MI *)user;
+	const uint8_t *p=(const uint8_t *)buf;
+	const uint8_t *e=p+len;
+	int off;
+	int ptr;
+	int i;
+
+	pthread_mutex_lock(&t->mtx);
+
+	for(;e-p>=TS_SIZE;p+=TS_SIZE)
+	{
+		if(*p!=TS_SYNC)
+		{
+			if(!(p=memchr(p+1,TS_SYNC,e-p-1)))break;
+			p-=TS_SIZE;
+			continue;
+		}
+
+		if(TS_PID(p)!=t->pid)continue;
+
+		if(TS_TEI(p))
+		{
+			t->sync=0;
+			continue;
+		}
+
+		if(!(TS_AFC(p)&1))continue;
+
+		if(t->cc!=-1&&TS_CC(p)!=((t->cc+1)&0x0f))
+		{
+			if(TS_CC(p)==t->cc)continue;
+			t->ccerr++;
+			t->sync=0;
+		}
+		t->cc=TS_CC(p);
+
+		off=(TS_AFC(p)&2)?5+p[4]:4;
+		if(off>=TS_SIZE)continue;
+
+		if(TS_PUSI(p))
+		{
+			ptr=p[off++];
+			if(off+ptr>TS_SIZE)
+			{
+				t->sync=0;
+				continue;
+			}
+			collect(t,p+off,ptr);
+			off+=ptr;
+			t->sync=1;
+			t->fill=0;
+		}
+
+		collect(t,p+off,TS_SIZE-off);
+	}
+
+	for(i=0;i<t->nplp;i++)flush(&t->plp[i]);
+
+	pthread_mutex_unlock(&t->mtx);
+}
+
+static void lost(void *user,unsigned int pkts)
+{
+	T2MI *t=(T2MI *)user;
+
+	pthread_mutex_lock(&t->mtx);
+	t->sync=0;
+	t->cc=-1;
+	pthread_mutex_unlock(&t->mtx);
+}
+
+void *t2mi_create(int pid)
+{
+	T2MI *t;
+	int i;
+	int j;
+	uint8_t c;
+
+	if(pid<0||pid>=TS_NULLPID)goto err1;
+
+	if(!(t=malloc(sizeof(T2MI))))goto err1;
+	memset(t,0,sizeof(T2MI));
+	t->pid=pid;
+	t->cc=-1;
+
+	for(i=0;i<256;i++)
+	{
+		for(c=i,j=0;j<8;j++)c=(c&0x80)?(c<<1)^0xd5:c<<1;
+		t->crc8[i]=c;
+	}
+
+	if(pthread_mutex_init(&t->mtx,NULL))goto err2;
+
+	return t;
+
+err2:	free(t);
+err1:	return NULL;
+}
+
+void t2mi_destroy(void *ctx)
+{
+	T2MI *t=(T2MI *)ctx;
+	int i;
+
+	if(!t)return;
+
+	for(i=0;i<t->nplp;i++)free(t->plp[i].out);
+	pthread_mutex_destroy(&t->mtx);
+	free(t);
+}
+
+int t2mi_plp(void *ctx,int plp,const TS_SINK *sink)
+{
+	T2MI *t=(T2MI *)ctx;
+	PLP *p;
+	int i;
+
+	if(plp<0||plp>255)goto inval;
+	for(i=0;i<t->nplp;i++)if(t->plp[i].plp==plp)goto inval;
+	if(t->nplp==T2MI_MAXPLP)
+	{
+		errno=ENOSPC;
+		return -1;
+	}
+
+	p=&t->plp[t->nplp];
+	memset(p,0,sizeof(PLP));
+	if(!(p->out=malloc(OUTPKTS*TS_SIZE)))return -1;
+	p->plp=plp;
+	p->sink=*sink;
+
+	pthread_mutex_lock(&t->mtx);
+	t->nplp++;
+	pthread_mutex_unlock(&t->mtx);
+
+	return 0;
+
+inval:	errno=EINVAL;
+	return -1;
+}
+
+void t2mi_sink(void *ctx,TS_SINK *sink)
+{
+	sink->feed=feed;
+	sink->lost=lost;
+	sink->user=ctx;
+}
+
+void t2mi_dump(void *ctx,FILE *fp,const char *prefix)
+{
+	T2MI *t=(T2MI *)ctx;
+	PLP *p;
+	int i;
+
+	pthread_mutex_lock(&t->mtx);
+
+	fprintf(fp,"%s pid=%d packets=%llu bbframes=%llu crc_errors=%llu "
+		"cc_errors=%llu\n",prefix,t->pid,t->packets,t->bbframes,
+		t->crcerr,t->ccerr);
+
+	for(i=0;i<t->nplp;i++)
+	{
+		p=&t->plp[i];
+		fprintf(fp,"%s plp=%d frames=%llu packets=%llu nulls=%llu "
+			"errors=%llu mode=%s\n",prefix,p->plp,p->frames,p->pkts,
+			p->nulls,p->errors,p->hem?"hem":"nm");
+	}
+
+	pthread_mutex_unlock(&t->mtx);
+}
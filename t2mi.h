@@ -0,0 +1,23 @@
+/*
+ * T2-MI decapsulation into per PLP transport streams
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef T2MI_H
+#define T2MI_H
+
+#define T2MI_MAXPLP	8
+
+extern void *t2mi_create(int pid);
+extern void t2mi_destroy(void *ctx);
+extern int t2mi_plp(void *ctx,int plp,const TS_SINK *sink);
+extern void t2mi_sink(void *ctx,TS_SINK *sink);
+extern void t2mi_dump(void *ctx,FILE *fp,const char *prefix);
+
+#endif
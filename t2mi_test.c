@@ -0,0 +1,196 @@
+/*
+ * T2-MI decapsulation tests
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <sys/types.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ts.h"
+#include "t2mi.h"
+
+#define CHECK(x) do{if(!(x)){fprintf(stderr,"%s:%d: %s\n",__FILE__,\
+	__LINE__,#x);return -1;}}while(0)
+
+#define T2PID	0x40
+#define PKTS	3
+#define DFL	(PKTS*(TS_SIZE-1))
+#define BBLEN	(10+DFL)
+#define T2LEN	(6+3+BBLEN+4)
+
+typedef struct
+{
+	int len;
+	uint8_t data[16*TS_SIZE];
+} OUTPUT;
+
+static void collect(void *user,const void *buf,size_t len)
+{
+	OUTPUT *o=(OUTPUT *)user;
+
+	if(o->len+len>sizeof(o->data))return;
+	memcpy(o->data+o->len,buf,len);
+	o->len+=len;
+}
+
+static void lost(void *user,unsigned int pkts)
+{
+}
+
+static uint8_t crc8(const uint8_t *data,int len)
+{
+	uint8_t crc=0;
+	int i;
+
+	while(len--)for(crc^=*data++,i=0;i<8;i++)
+		crc=(crc&0x80)?(crc<<1)^0xd5:crc<<1;
+	return crc;
+}
+
+/* one T2-MI baseband frame packet carrying PKTS packets in HEM mode */
+static void t2frame(uint8_t *t2,int plp,const uint8_t *ts)
+{
+	uint8_t *bb=t2+9;
+	uint32_t crc;
+	int i;
+
+	memset(t2,0,T2LEN);
+	t2[4]=((T2LEN-10)*8)>>8;
+	t2[5]=((T2LEN-10)*8)&0xff;
+	t2[7]=plp;
+
+	bb[0]=0xc0;
+	bb[2]=(TS_SIZE*8)>>8;
+	bb[3]=(TS_SIZE*8)&0xff;
+	bb[4]=(DFL*8)>>8;
+	bb[5]=(DFL*8)&0xff;
+	bb[6]=TS_SYNC;
+	bb[9]=crc8(bb,9)^1;
+
+	for(i=0;i<PKTS;i++)
+		memcpy(bb+10+i*(TS_SIZE-1),ts+i*TS_SIZE+1,TS_SIZE-1);
+
+	crc=ts_crc32(t2,T2LEN-4);
+	t2[T2LEN-4]=crc>>24;
+	t2[T2LEN-3]=crc>>16;
+	t2[T2LEN-2]=crc>>8;
+	t2[T2LEN-1]=crc;
+}
+
+/* carries a T2-MI packet on T2PID, returns the number of TS packets */
+static int wrap(uint8_t *out,const uint8_t *t2,int len)
+{
+	int cc=0;
+	int off;
+	int n;
+
+	for(off=0;off<len;cc++,out+=TS_SIZE,off+=n)
+	{
+		memset(out,0xff,TS_SIZE);
+		out[0]=TS_SYNC;
+		out[1]=(off?0x00:0x40)|(T2PID>>8);
+		out[2]=T2PID;
+		out[3]=0x10|(cc&0x0f);
+		if(!off)out[4]=0;
+		n=off?TS_SIZE-4:TS_SIZE-5;
+		if(n>len-off)n=len-off;
+		memcpy(out+(off?4:5),t2+off,n);
+	}
+
+	return cc;
+}
+
+static void payload(uint8_t *ts)
+{
+	int i;
+	int j;
+
+	for(i=0;i<PKTS;i++)
+	{
+		ts[i*TS_SIZE]=TS_SYNC;
+		ts[i*TS_SIZE+1]=0x01;
+		ts[i*TS_SIZE+2]=i;
+		ts[i*TS_SIZE+3]=0x10|i;
+		for(j=4;j<TS_SIZE;j++)ts[i*TS_SIZE+j]=i*7+j;
+	}
+}
+
+static int decap(void)
+{
+	static uint8_t ts[PKTS*TS_SIZE];
+	static uint8_t t2[T2LEN];
+	static uint8_t bfr[8*TS_SIZE];
+	static OUTPUT o0;
+	static OUTPUT o1;
+	TS_SINK in;
+	TS_SINK out;
+	void *t;
+	int n;
+
+	payload(ts);
+	t2frame(t2,1,ts);
+	n=wrap(bfr,t2,T2LEN);
+
+	CHECK((t=t2mi_create(T2PID)));
+	out.feed=collect;
+	out.lost=lost;
+	out.user=&o0;
+	CHECK(!t2mi_plp(t,0,&out));
+	out.user=&o1;
+	CHECK(!t2mi_plp(t,1,&out));
+	t2mi_sink(t,&in);
+
+	in.feed(in.user,bfr,n*TS_SIZE);
+
+	CHECK(!o0.len);
+	CHECK(o1.len==sizeof(ts));
+	CHECK(!memcmp(o1.data,ts,sizeof(ts)));
+	t2mi_destroy(t);
+
+	return 0;
+}
+
+static int corrupt(void)
+{
+	static uint8_t ts[PKTS*TS_SIZE];
+	static uint8_t t2[T2LEN];
+	static uint8_t bfr[8*TS_SIZE];
+	static OUTPUT o;
+	TS_SINK in;
+	TS_SINK out;
+	void *t;
+	int n;
+
+	payload(ts);
+	t2frame(t2,0,ts);
+	t2[100]^=0x01;
+	n=wrap(bfr,t2,T2LEN);
+
+	CHECK((t=t2mi_create(T2PID)));
+	out.feed=collect;
+	out.lost=lost;
+	out.user=&o;
+	CHECK(!t2mi_plp(t,0,&out));
+	t2mi_sink(t,&in);
+
+	in.feed(in.user,bfr,n*TS_SIZE);
+
+	CHECK(!o.len);
+	t2mi_destroy(t);
+
+	return 0;
+}
+
+int main(int argc,char *argv[])
+{
+	if(decap()||corrupt())return 1;
+	return 0;
+}
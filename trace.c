@@ -0,0 +1,146 @@
+/*
+ * Per thread binary trace ring and static tracepoints
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <sys/syscall.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "trace.h"
+
+#define RINGSIZE	4096
+
+typedef struct _ring
+{
+	struct _ring *next;
+	int used;
+	uint32_t tid;
+	unsigned int head;
+	TRACE_REC rec[RINGSIZE];
+} RING;
+
+int trace_enabled;
+
+static pthread_mutex_t mtx=PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t once=PTHREAD_ONCE_INIT;
+static pthread_key_t key;
+static RING *rings;
+static __thread RING *mine;
+
+static void detach(void *data)
+{
+	RING *r=(RING *)data;
+
+	__sync_lock_release(&r->used);
+}
+
+static void init(void)
+{
+	pthread_key_create(&key,detach);
+}
+
+static RING *attach(void)
+{
+	RING *r;
+
+	pthread_once(&once,init);
+
+	pthread_mutex_lock(&mtx);
+	for(r=rings;r;r=r->next)if(!r->used)break;
+	if(!r&&(r=malloc(sizeof(RING))))
+	{
+		memset(r,0,sizeof(RING));
+		r->next=rings;
+		rings=r;
+	}
+	if(r)
+	{
+		r->used=1;
+		r->tid=syscall(SYS_gettid);
+	}
+	pthread_mutex_unlock(&mtx);
+
+	if(r)pthread_setspecific(key,r);
+	return r;
+}
+
+void trace_enable(int on)
+{
+	trace_enabled=on;
+}
+
+void trace_add(int ev,int type,int unit,unsigned long arg,long res)
+{
+	struct timespec ts;
+	TRACE_REC *e;
+
+	if(!mine&&!(mine=attach()))return;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+
+	e=&mine->rec[mine->head&(RINGSIZE-1)];
+	e->ns=(uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+	e->tid=mine->tid;
+	e->ev=ev;
+	e->type=type;
+	e->unit=unit;
+	e->arg=arg;
+	e->res=res;
+
+	__atomic_store_n(&mine->head,mine->head+1,__ATOMIC_RELEASE);
+}
+
+int trace_dump(FILE *fp)
+{
+	TRACE_HDR hdr;
+	TRACE_REC *copy;
+	RING *r;
+	unsigned int head;
+	unsigned int from;
+	unsigned int i;
+	int res=-1;
+
+	if(!(copy=malloc(sizeof(copy[0])*RINGSIZE)))goto err1;
+
+	memset(&hdr,0,sizeof(hdr));
+	memcpy(hdr.magic,TRACE_MAGIC,sizeof(hdr.magic));
+	hdr.version=TRACE_VERSION;
+	hdr.recsize=sizeof(TRACE_REC);
+	if(fwrite(&hdr,sizeof(hdr),1,fp)!=1)goto err2;
+
+	pthread_mutex_lock(&mtx);
+
+	for(r=rings;r;r=r->next)
+	{
+		head=__atomic_load_n(&r->head,__ATOMIC_ACQUIRE);
+		from=head>RINGSIZE?head-RINGSIZE:0;
+		for(i=from;i!=head;i++)copy[i&(RINGSIZE-1)]=
+			r->rec[i&(RINGSIZE-1)];
+
+		i=__atomic_load_n(&r->head,__ATOMIC_ACQUIRE);
+		if(i-from>=RINGSIZE)from=i-RINGSIZE+1;
+		if((int)(head-from)<0)continue;
+
+		for(i=from;i!=head;i++)if(fwrite(&copy[i&(RINGSIZE-1)],
+			sizeof(TRACE_REC),1,fp)!=1)goto err3;
+	}
+
+	res=0;
+
+err3:	pthread_mutex_unlock(&mtx);
+err2:	free(copy);
+err1:	return res;
+}
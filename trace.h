@@ -0,0 +1,71 @@
+/*
+ * Per thread binary trace ring and static tracepoints
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_MAGIC	"DVBTRACE"
+#define TRACE_VERSION	1
+
+#define TR_OPEN		1
+#define TR_READ		2
+#define TR_WRITE	3
+#define TR_IOCTL	4
+#define TR_POLL		5
+#define TR_RELEASE	6
+#define TR_COMPLETE	7
+#define TR_NOTIFY	8
+#define TR_BACKEND	0x40
+#define TR_EXIT		0x80
+
+typedef struct
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t recsize;
+} TRACE_HDR;
+
+typedef struct
+{
+	uint64_t ns;
+	uint32_t tid;
+	uint16_t ev;
+	uint8_t type;
+	uint8_t unit;
+	uint32_t arg;
+	int32_t res;
+} TRACE_REC;
+
+#ifdef USDT
+#include <sys/sdt.h>
+#define TRACE(name,ev,type,unit,arg,res)				\
+do									\
+{									\
+	DTRACE_PROBE4(dvbcuse,name,type,unit,arg,res);			\
+	if(trace_enabled)trace_add(ev,type,unit,arg,res);		\
+} while(0)
+#else
+#define TRACE(name,ev,type,unit,arg,res)				\
+do									\
+{									\
+	if(trace_enabled)trace_add(ev,type,unit,arg,res);		\
+} while(0)
+#endif
+
+extern int trace_enabled;
+
+extern void trace_enable(int on);
+extern void trace_add(int ev,int type,int unit,unsigned long arg,long res);
+extern int trace_dump(FILE *fp);
+
+#endif
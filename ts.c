@@ -0,0 +1,69 @@
+/*
+ * MPEG transport stream helpers
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <stdint.h>
+
+#include "ts.h"
+
+static uint32_t crctab[256];
+
+static void __attribute__((constructor)) crcinit(void)
+{
+	int i;
+	int j;
+	uint32_t c;
+
+	for(i=0;i<256;i++)
+	{
+		for(c=i<<24,j=0;j<8;j++)c=(c&0x80000000)?(c<<1)^0x04c11db7:c<<1;
+		crctab[i]=c;
+	}
+}
+
+uint32_t ts_crc32(const uint8_t *data,int len)
+{
+	uint32_t crc=0xffffffff;
+
+	while(len--)crc=(crc<<8)^crctab[(crc>>24)^*data++];
+	return crc;
+}
+
+int sct_valid(const uint8_t *sct,int len)
+{
+	if(len<3||SCT_LEN(sct)!=len)return 0;
+	if(!SCT_SYNTAX(sct))return 1;
+	if(len<12)return 0;
+	return ts_crc32(sct,len)?0:1;
+}
+
+int sct_match(const uint8_t *filter,const uint8_t *mask,const uint8_t *mode,
+	int size,const uint8_t *sct,int len)
+{
+	int i;
+	int pos;
+	int neq=0;
+	int doneq=0;
+	uint8_t x;
+
+	for(i=0;i<size;i++)if(mask[i])
+	{
+		pos=i?i+2:0;
+		x=(pos<len?sct[pos]:0)^filter[i];
+		if(mask[i]&~mode[i]&x)return 0;
+		if(mask[i]&mode[i])
+		{
+			doneq=1;
+			if(mask[i]&mode[i]&x)neq=1;
+		}
+	}
+
+	return doneq&&!neq?0:1;
+}
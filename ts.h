@@ -0,0 +1,50 @@
+/*
+ * MPEG transport stream helpers
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef TS_H
+#define TS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TS_SIZE		188
+#define TS_SYNC		0x47
+#define TS_NULLPID	0x1fff
+#define TS_ALLPIDS	0x2000
+
+#define TS_PID(p)	((((p)[1]&0x1f)<<8)|(p)[2])
+#define TS_TEI(p)	((p)[1]&0x80)
+#define TS_PUSI(p)	((p)[1]&0x40)
+#define TS_CC(p)	((p)[3]&0x0f)
+#define TS_AFC(p)	(((p)[3]>>4)&3)
+
+#define SCT_TID(s)	((s)[0])
+#define SCT_SYNTAX(s)	((s)[1]&0x80)
+#define SCT_LEN(s)	(((((s)[1]&0x0f)<<8)|(s)[2])+3)
+#define SCT_EXT(s)	(((s)[3]<<8)|(s)[4])
+#define SCT_VERSION(s)	(((s)[5]>>1)&0x1f)
+#define SCT_CURRENT(s)	((s)[5]&0x01)
+#define SCT_NUMBER(s)	((s)[6])
+#define SCT_LAST(s)	((s)[7])
+
+typedef struct
+{
+	void (*feed)(void *user,const void *buf,size_t len);
+	void (*lost)(void *user,unsigned int pkts);
+	void *user;
+} TS_SINK;
+
+extern uint32_t ts_crc32(const uint8_t *data,int len);
+extern int sct_valid(const uint8_t *sct,int len);
+extern int sct_match(const uint8_t *filter,const uint8_t *mask,
+	const uint8_t *mode,int size,const uint8_t *sct,int len);
+
+#endif
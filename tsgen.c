@@ -0,0 +1,387 @@
+/*
+ * Synthetic transport stream generator source
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "ts.h"
+#include "tsgen.h"
+
+#define TICK		10000000ULL
+#define DEFRATE		20000000ULL
+#define MAXPROGS	16
+#define PSITICKS	10
+#define SDTTICKS	50
+#define FRAMETICKS	4
+#define MAXSCT		1024
+
+#define PMTPID(n)	(0x100+(n)*0x10)
+#define VIDPID(n)	(PMTPID(n)+1)
+#define AUDPID(n)	(PMTPID(n)+2)
+
+typedef struct
+{
+	int len;
+	uint8_t data[MAXSCT];
+} SECTION;
+
+typedef struct
+{
+	pthread_t th;
+	pthread_mutex_t mtx;
+	TS_SINK sink;
+	int stop;
+	uint64_t rate;
+	int progs;
+	int tsid;
+	int batch;
+	uint64_t pkts;
+	uint8_t cc[TS_ALLPIDS];
+	SECTION pat;
+	SECTION sdt;
+	SECTION pmt[MAXPROGS];
+	unsigned long long total;
+	unsigned long long psi;
+	unsigned long long frames;
+	uint8_t *bfr;
+} TSGEN;
+
+static uint64_t nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static void pause_until(uint64_t t)
+{
+	struct timespec ts;
+
+	ts.tv_sec=t/1000000000ULL;
+	ts.tv_nsec=t%1000000000ULL;
+	clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,NULL);
+}
+
+static void finish(SECTION *s,int tid,int ext)
+{
+	uint32_t crc;
+
+	s->data[0]=tid;
+	s->data[1]=0xb0|((s->len+1)>>8);
+	s->data[2]=(s->len+1)&0xff;
+	s->data[3]=ext>>8;
+	s->data[4]=ext&0xff;
+	s->data[5]=0xc1;
+	s->data[6]=0x00;
+	s->data[7]=0x00;
+
+	crc=ts_crc32(s->data,s->len);
+	s->data[s->len++]=crc>>24;
+	s->data[s->len++]=(crc>>16)&0xff;
+	s->data[s->len++]=(crc>>8)&0xff;
+	s->data[s->len++]=crc&0xff;
+}
+
+static void tables(TSGEN *g)
+{
+	SECTION *s;
+	char name[32];
+	int len;
+	int i;
+
+	s=&g->pat;
+	s->len=8;
+	for(i=0;i<g->progs;i++)
+	{
+		s->data[s->len++]=(i+1)>>8;
+		s->data[s->len++]=(i+1)&0xff;
+		s->data[s->len++]=0xe0|(PMTPID(i)>>8);
+		s->data[s->len++]=PMTPID(i)&0xff;
+	}
+	finish(s,0x00,g->tsid);
+
+	for(i=0;i<g->progs;i++)
+	{
+		s=&g->pmt[i];
+		s->len=8;
+		s->data[s->len++]=0xe0|(VIDPID(i)>>8);
+		s->data[s->len++]=VIDPID(i)&0xff;
+		s->data[s->len++]=0xf0;
+		s->data[s->len++]=0x00;
+		s->data[s->len++]=0x02;
+		s->data[s->len++]=0xe0|(VIDPID(i)>>8);
+		s->data[s->len++]=VIDPID(i)&0xff;
+		s->data[s->len++]=0xf0;
+		s->data[s->len++]=0x00;
+		s->data[s->len++]=0x03;
+		s->data[s->len++]=0xe0|(AUDPID(i)>>8);
+		s->data[s->len++]=AUDPID(i)&0xff;
+		s->data[s->len++]=0xf0;
+		s->data[s->len++]=0x00;
+		finish(s,0x02,i+1);
+	}
+
+	s=&g->sdt;
+	s->len=8;
+	s->data[s->len++]=0xff;
+	s->data[s->len++]=0x01;
+	s->data[s->len++]=0xff;
+	for(i=0;i<g->progs;i++)
+	{
+		len=sprintf(name,"tsgen %d",i+1);
+		s->data[s->len++]=(i+1)>>8;
+		s->data[s->len++]=(i+1)&0xff;
+		s->data[s->len++]=0xfc;
+		s->data[s->len++]=0x80;
+		s->data[s->len++]=len+8;
+		s->data[s->len++]=0x48;
+		s->data[s->len++]=len+6;
+		s->data[s->len++]=0x01;
+		s->data[s->len++]=3;
+		memcpy(s->data+s->len,"gen",3);
+		s->len+=3;
+		s->data[s->len++]=len;
+		memcpy(s->data+s->len,name,len);
+		s->len+=len;
+	}
+	finish(s,0x42,g->tsid);
+}
+
+static uint8_t *header(TSGEN *g,uint8_t *p,int pid,int pusi)
+{
+	p[0]=TS_SYNC;
+	p[1]=(pusi?0x40:0x00)|(pid>>8);
+	p[2]=pid&0xff;
+	p[3]=0x10|(g->cc[pid]++&0x0f);
+	g->pkts++;
+	return p+TS_SIZE;
+}
+
+static uint8_t *section(TSGEN *g,uint8_t *p,int pid,const SECTION *s)
+{
+	int off=0;
+	int len;
+
+	while(off<s->len)
+	{
+		header(g,p,pid,!off);
+		if(!off)
+		{
+			p[4]=0;
+			len=s->len<TS_SIZE-5?s->len:TS_SIZE-5;
+			memcpy(p+5,s->data,len);
+			memset(p+5+len,0xff,TS_SIZE-5-len);
+		}
+		else
+		{
+			len=s->len-off<TS_SIZE-4?s->len-off:TS_SIZE-4;
+			memcpy(p+4,s->data+off,len);
+			memset(p+4+len,0xff,TS_SIZE-4-len);
+		}
+		off+=len;
+		p+=TS_SIZE;
+	}
+
+	return p;
+}
+
+static void pcr(TSGEN *g,uint8_t *p)
+{
+	uint64_t v=g->pkts*TS_SIZE*8*27000000ULL/g->rate;
+	uint64_t base=v/300;
+	int ext=v%300;
+
+	p[3]|=0x20;
+	p[4]=7;
+	p[5]=0x10;
+	p[6]=base>>25;
+	p[7]=(base>>17)&0xff;
+	p[8]=(base>>9)&0xff;
+	p[9]=(base>>1)&0xff;
+	p[10]=((base&1)<<7)|0x7e|(ext>>8);
+	p[11]=ext&0xff;
+}
+
+static void pes(uint8_t *p,int sid,uint64_t pts)
+{
+	p[0]=0x00;
+	p[1]=0x00;
+	p[2]=0x01;
+	p[3]=sid;
+	p[4]=0x00;
+	p[5]=0x00;
+	p[6]=0x80;
+	p[7]=0x80;
+	p[8]=0x05;
+	p[9]=0x21|((pts>>29)&0x0e);
+	p[10]=(pts>>22)&0xff;
+	p[11]=0x01|((pts>>14)&0xfe);
+	p[12]=(pts>>7)&0xff;
+	p[13]=0x01|((pts<<1)&0xfe);
+}
+
+static void payload(TSGEN *g,uint8_t *p,int prog,int audio,int start)
+{
+	uint64_t pts=g->pkts*TS_SIZE*8*90000ULL/g->rate+90000;
+	int pid=audio?AUDPID(prog):VIDPID(prog);
+	int off=4;
+
+	header(g,p,pid,start);
+
+	if(!audio&&start)
+	{
+		pcr(g,p);
+		off=12;
+	}
+
+	if(start)
+	{
+		pes(p+off,audio?0xc0:0xe0,pts);
+		off+=14;
+	}
+
+	memset(p+off,prog+1,TS_SIZE-off);
+}
+
+static void null(TSGEN *g,uint8_t *p)
+{
+	p[0]=TS_SYNC;
+	p[1]=TS_NULLPID>>8;
+	p[2]=TS_NULLPID&0xff;
+	p[3]=0x10;
+	memset(p+4,0xff,TS_SIZE-4);
+	g->pkts++;
+}
+
+static void *generator(void *data)
+{
+	TSGEN *g=(TSGEN *)data;
+	uint64_t t0=nsecs();
+	uint64_t tick;
+	uint8_t *e=g->bfr+g->batch*TS_SIZE;
+	uint8_t *p;
+	int start;
+	int psi;
+	int i;
+
+	for(tick=0;!g->stop;tick++)
+	{
+		p=g->bfr;
+
+		if(!(tick%PSITICKS))
+		{
+			p=section(g,p,0x0000,&g->pat);
+			for(i=0;i<g->progs;i++)
+				p=section(g,p,PMTPID(i),&g->pmt[i]);
+		}
+		if(!(tick%SDTTICKS))p=section(g,p,0x0011,&g->sdt);
+		psi=(p-g->bfr)/TS_SIZE;
+
+		start=!(tick%FRAMETICKS);
+		for(i=0;p<e;p+=TS_SIZE,i++)
+		{
+			if((i&7)==7)null(g,p);
+			else payload(g,p,((i>>3)+tick)%g->progs,(i&7)==6,
+				start&&i<8*g->progs&&(i&7)>=5);
+		}
+
+		g->sink.feed(g->sink.user,g->bfr,g->batch*TS_SIZE);
+
+		pthread_mutex_lock(&g->mtx);
+		g->total+=g->batch*TS_SIZE;
+		g->psi+=psi;
+		if(start)g->frames++;
+		pthread_mutex_unlock(&g->mtx);
+
+		pause_until(t0+(tick+1)*TICK);
+	}
+
+	pthread_exit(NULL);
+}
+
+void *tsgen_create(const char *url,const TS_SINK *sink)
+{
+	TSGEN *g;
+	const char *p;
+	char *e;
+	int psi;
+
+	if(strncmp(url,"gen://",6))goto err1;
+	url+=6;
+
+	if(!(g=malloc(sizeof(TSGEN))))goto err1;
+	memset(g,0,sizeof(TSGEN));
+	g->sink=*sink;
+	g->rate=DEFRATE;
+	g->progs=4;
+	g->tsid=1;
+
+	for(p=strchr(url,'?');p;p=*e?e:NULL)
+	{
+		if(!strncmp(p+1,"rate=",5))g->rate=strtoull(p+6,&e,10);
+		else if(!strncmp(p+1,"programs=",9))g->progs=strtol(p+10,&e,10);
+		else if(!strncmp(p+1,"tsid=",5))g->tsid=strtol(p+6,&e,0);
+		else goto err2;
+		if(*e&&*e!='&')goto err2;
+	}
+
+	if(g->progs<1||g->progs>MAXPROGS||g->tsid<0||g->tsid>0xffff)
+		goto err2;
+
+	tables(g);
+
+	psi=(g->pat.len+TS_SIZE-6)/(TS_SIZE-5)+
+		g->progs*((g->pmt[0].len+TS_SIZE-6)/(TS_SIZE-5))+
+		(g->sdt.len+TS_SIZE-6)/(TS_SIZE-5)+1;
+	g->batch=g->rate*TICK/1000000000ULL/8/TS_SIZE;
+	if(g->batch<psi+8*g->progs)goto err2;
+
+	if(!(g->bfr=malloc(g->batch*TS_SIZE)))goto err2;
+	if(pthread_mutex_init(&g->mtx,NULL))goto err3;
+	if(pthread_create(&g->th,NULL,generator,g))goto err4;
+
+	return g;
+
+err4:	pthread_mutex_destroy(&g->mtx);
+err3:	free(g->bfr);
+err2:	free(g);
+err1:	return NULL;
+}
+
+void tsgen_destroy(void *ctx)
+{
+	TSGEN *g=(TSGEN *)ctx;
+
+	if(!g)return;
+
+	g->stop=1;
+	pthread_join(g->th,NULL);
+	pthread_mutex_destroy(&g->mtx);
+	free(g->bfr);
+	free(g);
+}
+
+void tsgen_dump(void *ctx,FILE *fp,const char *prefix)
+{
+	TSGEN *g=(TSGEN *)ctx;
+
+	pthread_mutex_lock(&g->mtx);
+	fprintf(fp,"%s rate=%llu programs=%d tsid=%d bytes=%llu "
+		"psi_packets=%llu frames=%llu\n",prefix,
+		(unsigned long long)g->rate,g->progs,g->tsid,g->total,g->psi,
+		g->frames);
+	pthread_mutex_unlock(&g->mtx);
+}
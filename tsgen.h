@@ -0,0 +1,19 @@
+/*
+ * Synthetic transport stream generator source
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef TSGEN_H
+#define TSGEN_H
+
+extern void *tsgen_create(const char *url,const TS_SINK *sink);
+extern void tsgen_destroy(void *ctx);
+extern void tsgen_dump(void *ctx,FILE *fp,const char *prefix);
+
+#endif
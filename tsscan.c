@@ -0,0 +1,314 @@
+/*
+ * Transport stream integrity scanner
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <sys/types.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "ts.h"
+#include "tsscan.h"
+
+#define BATCH	8
+#define WINDOW	1000000000ULL
+
+typedef struct
+{
+	uint64_t pkts;
+	uint64_t ccerr;
+	uint64_t tei;
+	uint64_t winpkts;
+	uint64_t bitrate;
+	uint64_t pcrtime;
+	uint64_t pcr;
+	int64_t jitter;
+	int64_t maxjitter;
+	int cc;
+} PIDSTAT;
+
+typedef struct
+{
+	pthread_mutex_t mtx;
+	uint64_t pkts;
+	uint64_t syncerr;
+	uint64_t ccerr;
+	uint64_t tei;
+	uint64_t winstart;
+	uint64_t now;
+	int fill;
+	uint8_t carry[TS_SIZE];
+	PIDSTAT *pid[TS_ALLPIDS];
+} SCAN;
+
+static uint64_t nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static void pcr(SCAN *s,PIDSTAT *p,const uint8_t *pkt)
+{
+	uint64_t val;
+	int64_t delta;
+
+	if(!(pkt[3]&0x20)||pkt[4]<7||!(pkt[5]&0x10))return;
+
+	val=((uint64_t)pkt[6]<<25)|((uint64_t)pkt[7]<<17)|(pkt[8]<<9)|
+		(pkt[9]<<1)|(pkt[10]>>7);
+	val=val*300+(((pkt[10]&1)<<8)|pkt[11]);
+
+	if(p->pcrtime&&!(pkt[5]&0x80)&&val>p->pcr)
+	{
+		delta=(int64_t)(s->now-p->pcrtime)-
+			(int64_t)((val-p->pcr)*1000/27);
+		if(delta<0)delta=-delta;
+		p->jitter=delta;
+		if(delta>p->maxjitter)p->maxjitter=delta;
+	}
+
+	p->pcr=val;
+	p->pcrtime=s->now;
+}
+
+static void packet(SCAN *s,const uint8_t *pkt)
+{
+	PIDSTAT *p;
+	int pid=TS_PID(pkt);
+	int cc;
+
+	if(!(p=s->pid[pid]))
+	{
+		if(!(p=malloc(sizeof(PIDSTAT))))return;
+		memset(p,0,sizeof(PIDSTAT));
+		p->cc=-1;
+		s->pid[pid]=p;
+	}
+
+	p->pkts++;
+	p->winpkts++;
+
+	if(TS_TEI(pkt))
+	{
+		p->tei++;
+		s->tei++;
+		return;
+	}
+
+	if(pid==TS_NULLPID)return;
+
+	cc=TS_CC(pkt);
+	if(TS_AFC(pkt)&2)
+	{
+		if(pkt[4]&&(pkt[5]&0x80))p->cc=-1;
+		pcr(s,p,pkt);
+	}
+
+	if(!(TS_AFC(pkt)&1))return;
+
+	if(p->cc!=-1&&cc!=((p->cc+1)&0xf)&&cc!=p->cc)
+	{
+		p->ccerr++;
+		s->ccerr++;
+	}
+	p->cc=cc;
+}
+
+static int resync(const uint8_t *buf,size_t len)
+{
+	const uint8_t *p;
+	const uint8_t *e=buf+len;
+
+	for(p=buf;(p=memchr(p,TS_SYNC,e-p));p++)
+		if(p+TS_SIZE>=e||p[TS_SIZE]==TS_SYNC)return p-buf;
+	return len;
+}
+
+static void window(SCAN *s)
+{
+	uint64_t span;
+	int i;
+
+	if(!s->winstart)
+	{
+		s->winstart=s->now;
+		return;
+	}
+
+	if((span=s->now-s->winstart)<WINDOW)return;
+
+	for(i=0;i<TS_ALLPIDS;i++)if(s->pid[i])
+	{
+		s->pid[i]->bitrate=s->pid[i]->winpkts*TS_SIZE*8*
+			1000000000ULL/span;
+		s->pid[i]->winpkts=0;
+	}
+
+	s->winstart=s->now;
+}
+
+void *tsscan_create(void)
+{
+	SCAN *s;
+
+	if(!(s=malloc(sizeof(SCAN))))goto err1;
+	memset(s,0,sizeof(SCAN));
+	if(pthread_mutex_init(&s->mtx,NULL))goto err2;
+	return s;
+
+err2:	free(s);
+err1:	return NULL;
+}
+
+void tsscan_destroy(void *ctx)
+{
+	SCAN *s=(SCAN *)ctx;
+	int i;
+
+	if(!s)return;
+
+	for(i=0;i<TS_ALLPIDS;i++)if(s->pid[i])free(s->pid[i]);
+	pthread_mutex_destroy(&s->mtx);
+	free(s);
+}
+
+void tsscan_feed(void *ctx,const void *buf,size_t len)
+{
+	SCAN *s=(SCAN *)ctx;
+	const uint8_t *p=(const uint8_t *)buf;
+	size_t i;
+	int n;
+	uint8_t bad;
+
+	pthread_mutex_lock(&s->mtx);
+
+	s->now=nsecs();
+
+	if(s->fill)
+	{
+		n=TS_SIZE-s->fill;
+		if(n>len)n=len;
+		memcpy(s->carry+s->fill,p,n);
+		p+=n;
+		len-=n;
+		if((s->fill+=n)<TS_SIZE)goto out;
+		s->fill=0;
+		if(s->carry[0]==TS_SYNC)
+		{
+			s->pkts++;
+			packet(s,s->carry);
+		}
+		else s->syncerr++;
+	}
+
+	while(len>=TS_SIZE)
+	{
+		if(len>=BATCH*TS_SIZE)
+		{
+			for(bad=0,i=0;i<BATCH;i++)bad|=p[i*TS_SIZE]^TS_SYNC;
+			if(!bad)
+			{
+				for(i=0;i<BATCH;i++)packet(s,p+i*TS_SIZE);
+				s->pkts+=BATCH;
+				p+=BATCH*TS_SIZE;
+				len-=BATCH*TS_SIZE;
+				continue;
+			}
+		}
+
+		if(*p!=TS_SYNC)
+		{
+			s->syncerr++;
+			i=resync(p,len);
+			p+=i;
+			len-=i;
+			continue;
+		}
+
+		s->pkts++;
+		packet(s,p);
+		p+=TS_SIZE;
+		len-=TS_SIZE;
+	}
+
+	if(len)
+	{
+		memcpy(s->carry,p,len);
+		s->fill=len;
+	}
+
+out:	window(s);
+
+	pthread_mutex_unlock(&s->mtx);
+}
+
+void tsscan_merge(void *dst,void *src)
+{
+	SCAN *d=(SCAN *)dst;
+	SCAN *s=(SCAN *)src;
+	PIDSTAT *p;
+	int i;
+
+	pthread_mutex_lock(&d->mtx);
+	pthread_mutex_lock(&s->mtx);
+
+	d->pkts+=s->pkts;
+	d->syncerr+=s->syncerr;
+	d->ccerr+=s->ccerr;
+	d->tei+=s->tei;
+
+	for(i=0;i<TS_ALLPIDS;i++)if(s->pid[i])
+	{
+		if(!(p=d->pid[i]))
+		{
+			if(!(p=malloc(sizeof(PIDSTAT))))continue;
+			memset(p,0,sizeof(PIDSTAT));
+			p->cc=-1;
+			d->pid[i]=p;
+		}
+		p->pkts+=s->pid[i]->pkts;
+		p->ccerr+=s->pid[i]->ccerr;
+		p->tei+=s->pid[i]->tei;
+		if(s->pid[i]->maxjitter>p->maxjitter)
+			p->maxjitter=s->pid[i]->maxjitter;
+	}
+
+	pthread_mutex_unlock(&s->mtx);
+	pthread_mutex_unlock(&d->mtx);
+}
+
+void tsscan_dump(void *ctx,FILE *fp,const char *prefix)
+{
+	SCAN *s=(SCAN *)ctx;
+	PIDSTAT *p;
+	int i;
+
+	pthread_mutex_lock(&s->mtx);
+
+	fprintf(fp,"%s packets=%llu sync_errors=%llu cc_errors=%llu "
+		"tei=%llu\n",prefix,(unsigned long long)s->pkts,
+		(unsigned long long)s->syncerr,(unsigned long long)s->ccerr,
+		(unsigned long long)s->tei);
+
+	for(i=0;i<TS_ALLPIDS;i++)if((p=s->pid[i]))
+		fprintf(fp,"%s pid=0x%04x packets=%llu cc_errors=%llu tei=%llu "
+		"bitrate=%llu pcr_jitter_ns=%lld pcr_jitter_max_ns=%lld\n",
+		prefix,i,(unsigned long long)p->pkts,
+		(unsigned long long)p->ccerr,(unsigned long long)p->tei,
+		(unsigned long long)p->bitrate,(long long)p->jitter,
+		(long long)p->maxjitter);
+
+	pthread_mutex_unlock(&s->mtx);
+}
@@ -0,0 +1,21 @@
+/*
+ * Transport stream integrity scanner
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef TSSCAN_H
+#define TSSCAN_H
+
+extern void *tsscan_create(void);
+extern void tsscan_destroy(void *ctx);
+extern void tsscan_feed(void *ctx,const void *buf,size_t len);
+extern void tsscan_merge(void *dst,void *src);
+extern void tsscan_dump(void *ctx,FILE *fp,const char *prefix);
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * Transport stream integrity scanner tests
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <sys/types.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ts.h"
+#include "tsscan.h"
+
+#define CHECK(x) do{if(!(x)){fprintf(stderr,"%s:%d: %s\n",__FILE__,\
+	__LINE__,#x);return -1;}}while(0)
+
+static void pkt(uint8_t *p,int pid,int cc,int flags)
+{
+	memset(p,0xff,TS_SIZE);
+	p[0]=TS_SYNC;
+	p[1]=flags|(pid>>8);
+	p[2]=pid;
+	p[3]=0x10|cc;
+}
+
+static int has(void *s,const char *line)
+{
+	char bfr[4096];
+	FILE *fp;
+
+	memset(bfr,0,sizeof(bfr));
+	if(!(fp=fmemopen(bfr,sizeof(bfr)-1,"w")))return 0;
+	tsscan_dump(s,fp,"t");
+	fclose(fp);
+	return strstr(bfr,line)!=NULL;
+}
+
+static int continuity(void)
+{
+	static const int cc[]={0,1,2,2,4,5};
+	uint8_t bfr[6*TS_SIZE];
+	void *s;
+	int i;
+
+	for(i=0;i<6;i++)pkt(bfr+i*TS_SIZE,0x100,cc[i],0);
+
+	CHECK((s=tsscan_create()));
+	tsscan_feed(s,bfr,sizeof(bfr));
+	CHECK(has(s,"t packets=6 sync_errors=0 cc_errors=1 tei=0\n"));
+	CHECK(has(s,"t pid=0x0100 packets=6 cc_errors=1 tei=0 "));
+	tsscan_destroy(s);
+
+	return 0;
+}
+
+static int errors(void)
+{
+	uint8_t bfr[3*TS_SIZE+5];
+	void *s;
+
+	pkt(bfr,0x100,0,0);
+	memset(bfr+TS_SIZE,0x00,5);
+	pkt(bfr+TS_SIZE+5,0x100,1,0x80);
+	/* a packet with TEI set does not advance the continuity counter */
+	pkt(bfr+2*TS_SIZE+5,0x100,1,0);
+
+	CHECK((s=tsscan_create()));
+	tsscan_feed(s,bfr,sizeof(bfr));
+	CHECK(has(s,"t packets=3 sync_errors=1 cc_errors=0 tei=1\n"));
+	tsscan_destroy(s);
+
+	return 0;
+}
+
+static int split(void)
+{
+	uint8_t bfr[4*TS_SIZE];
+	void *s;
+	int i;
+
+	for(i=0;i<4;i++)pkt(bfr+i*TS_SIZE,0x200,i,0);
+
+	CHECK((s=tsscan_create()));
+	tsscan_feed(s,bfr,100);
+	tsscan_feed(s,bfr+100,TS_SIZE);
+	tsscan_feed(s,bfr+100+TS_SIZE,sizeof(bfr)-100-TS_SIZE);
+	CHECK(has(s,"t packets=4 sync_errors=0 cc_errors=0 tei=0\n"));
+	tsscan_destroy(s);
+
+	return 0;
+}
+
+static int merge(void)
+{
+	uint8_t bfr[2*TS_SIZE];
+	void *s;
+	void *t;
+
+	pkt(bfr,0x300,0,0);
+	pkt(bfr+TS_SIZE,0x300,5,0);
+
+	CHECK((s=tsscan_create()));
+	CHECK((t=tsscan_create()));
+	tsscan_feed(s,bfr,sizeof(bfr));
+	tsscan_feed(t,bfr,TS_SIZE);
+	tsscan_merge(t,s);
+	tsscan_destroy(s);
+	CHECK(has(t,"t packets=3 sync_errors=0 cc_errors=1 tei=0\n"));
+	CHECK(has(t,"t pid=0x0300 packets=3 cc_errors=1 tei=0 "));
+	tsscan_destroy(t);
+
+	return 0;
+}
+
+int main(int argc,char *argv[])
+{
+	if(continuity()||errors()||split()||merge())return 1;
+	return 0;
+}
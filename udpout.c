@@ -0,0 +1,333 @@
+/*
+ * UDP/RTP transport stream output
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <sys/ioctl.h>
+#include <linux/dvb/dmx.h>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "dvbcuse.h"
+#include "ts.h"
+#include "udpsrc.h"
+#include "udpout.h"
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT	103
+#endif
+
+#define PKTS		7
+#define PAYLOAD		(PKTS*TS_SIZE)
+#define RTPHDR		12
+#define SEGMENTS	48
+#define BATCH		16
+#define DMXBUFSIZE	(TS_SIZE*8192)
+
+typedef struct
+{
+	pthread_t th;
+	pthread_mutex_t mtx;
+	DVBCUSE_DEVICE *src;
+	int dmx;
+	int fd;
+	int rtp;
+	int gso;
+	int stop;
+	uint16_t seq;
+	uint32_t ssrc;
+	int hdr;
+	int fill;
+	unsigned char *in;
+	unsigned char *out;
+	unsigned long long dgrams;
+	unsigned long long bytes;
+	unsigned long long calls;
+	unsigned long long errors;
+	struct mmsghdr msg[BATCH*SEGMENTS];
+	struct iovec iov[BATCH*SEGMENTS];
+} UDPOUT;
+
+static int demux(DVBCUSE_DEVICE *src,const char *pathname,const char *pids)
+{
+	struct dmx_pes_filter_params pes;
+	char bfr[256];
+	char *item;
+	char *mem;
+	uint16_t pid;
+	int fd;
+
+	if((fd=src->dmx_open(src->user,pathname,O_RDONLY|O_NONBLOCK))==-1)
+		goto err1;
+
+	src->dmx_ioctl(src->user,fd,DMX_SET_BUFFER_SIZE,
+		(void *)(unsigned long)DMXBUFSIZE);
+
+	memset(&pes,0,sizeof(pes));
+	pes.pid=TS_ALLPIDS;
+	pes.input=DMX_IN_FRONTEND;
+	pes.output=DMX_OUT_TSDEMUX_TAP;
+	pes.pes_type=DMX_PES_OTHER;
+
+	if(pids)
+	{
+		if(strlen(pids)>=sizeof(bfr))goto err2;
+		strcpy(bfr,pids);
+		if(!(item=strtok_r(bfr,",",&mem)))goto err2;
+		pes.pid=strtol(item,NULL,0);
+	}
+
+	if(src->dmx_ioctl(src->user,fd,DMX_SET_PES_FILTER,&pes))goto err2;
+
+	if(pids)while((item=strtok_r(NULL,",",&mem)))
+	{
+		pid=strtol(item,NULL,0);
+		if(src->dmx_ioctl(src->user,fd,DMX_ADD_PID,&pid))goto err2;
+	}
+
+	if(src->dmx_ioctl(src->user,fd,DMX_START,NULL))goto err2;
+
+	return fd;
+
+err2:	src->dmx_close(src->user,fd);
+err1:	return -1;
+}
+
+static uint32_t timestamp(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint32_t)(ts.tv_sec*90000ULL+ts.tv_nsec/11111);
+}
+
+static void transmit(UDPOUT *u,int n)
+{
+	int i;
+	int r;
+	int len;
+
+	for(i=0;i<n;i+=r)
+	{
+		u->calls++;
+		if((r=sendmmsg(u->fd,u->msg+i,n-i,0))<=0)
+		{
+			if(r<0&&errno==EINTR)
+			{
+				r=0;
+				continue;
+			}
+			if(r<0&&errno==EIO&&u->gso)
+			{
+				r=0;
+				setsockopt(u->fd,SOL_UDP,UDP_SEGMENT,&r,sizeof(r));
+				u->gso=0;
+			}
+			u->errors+=n-i;
+			return;
+		}
+	}
+
+	for(i=0;i<n;i++)
+	{
+		len=u->msg[i].msg_len;
+		u->bytes+=len;
+		u->dgrams+=u->gso?(len+u->hdr+PAYLOAD-1)/(u->hdr+PAYLOAD):1;
+	}
+}
+
+static int packetize(UDPOUT *u,int all)
+{
+	unsigned char *p=u->in;
+	unsigned char *q=u->out;
+	uint32_t ts=timestamp();
+	int seg=u->hdr+PAYLOAD;
+	int len;
+	int n=0;
+
+	while((len=u->fill-(p-u->in))>=PAYLOAD||(all&&len>=TS_SIZE))
+	{
+		if(len>PAYLOAD)len=PAYLOAD;
+		len-=len%TS_SIZE;
+
+		if(u->rtp)
+		{
+			q[0]=0x80;
+			q[1]=33;
+			q[2]=(uint8_t)(u->seq>>8);
+			q[3]=(uint8_t)u->seq++;
+			q[4]=(uint8_t)(ts>>24);
+			q[5]=(uint8_t)(ts>>16);
+			q[6]=(uint8_t)(ts>>8);
+			q[7]=(uint8_t)ts;
+			q[8]=(uint8_t)(u->ssrc>>24);
+			q[9]=(uint8_t)(u->ssrc>>16);
+			q[10]=(uint8_t)(u->ssrc>>8);
+			q[11]=(uint8_t)u->ssrc;
+		}
+		memcpy(q+u->hdr,p,len);
+
+		if(!u->gso||!n||u->iov[n-1].iov_len==SEGMENTS*seg)
+		{
+			u->iov[n].iov_base=q;
+			u->iov[n++].iov_len=0;
+		}
+		u->iov[n-1].iov_len+=u->hdr+len;
+
+		p+=len;
+		q+=u->hdr+len;
+	}
+
+	memmove(u->in,p,u->fill-(p-u->in));
+	u->fill-=p-u->in;
+
+	return n;
+}
+
+static void *sender(void *data)
+{
+	UDPOUT *u=(UDPOUT *)data;
+	struct pollfd p;
+	ssize_t len;
+	int n;
+
+	p.fd=u->dmx;
+	p.events=POLLIN;
+
+	while(!u->stop)
+	{
+		if(poll(&p,1,200)<1)
+		{
+			pthread_mutex_lock(&u->mtx);
+			if((n=packetize(u,1)))transmit(u,n);
+			pthread_mutex_unlock(&u->mtx);
+			continue;
+		}
+
+		if((len=u->src->dmx_read(u->src->user,u->dmx,u->in+u->fill,
+			BATCH*SEGMENTS*PAYLOAD-u->fill))<=0)
+		{
+			if(len<0&&errno!=EAGAIN&&errno!=EINTR)
+			{
+				pthread_mutex_lock(&u->mtx);
+				u->errors++;
+				pthread_mutex_unlock(&u->mtx);
+				u->fill=0;
+			}
+			/* 0 or a hard error after POLLIN would spin */
+			if(!len||(errno!=EAGAIN&&errno!=EINTR&&
+				errno!=EOVERFLOW))poll(NULL,0,200);
+			continue;
+		}
+		u->fill+=len;
+
+		pthread_mutex_lock(&u->mtx);
+		if((n=packetize(u,0)))transmit(u,n);
+		pthread_mutex_unlock(&u->mtx);
+	}
+
+	pthread_exit(NULL);
+}
+
+void *udpout_create(const char *url,DVBCUSE_DEVICE *src,const char *pathname,
+	const char *pids)
+{
+	UDPOUT *u;
+	struct sockaddr_storage addr;
+	socklen_t len;
+	int i;
+	int v;
+
+	if(!(u=malloc(sizeof(UDPOUT))))goto err1;
+	memset(u,0,sizeof(UDPOUT));
+	u->src=src;
+
+	if(udpsrc_addr(url,&addr,&len,&u->rtp))goto err2;
+	u->hdr=u->rtp?RTPHDR:0;
+	u->seq=(uint16_t)random();
+	u->ssrc=(uint32_t)random();
+
+	if(!(u->in=malloc(BATCH*SEGMENTS*PAYLOAD)))goto err2;
+	if(!(u->out=malloc(BATCH*SEGMENTS*(RTPHDR+PAYLOAD))))goto err3;
+
+	for(i=0;i<BATCH*SEGMENTS;i++)
+	{
+		u->msg[i].msg_hdr.msg_iov=&u->iov[i];
+		u->msg[i].msg_hdr.msg_iovlen=1;
+	}
+
+	if((u->fd=socket(addr.ss_family,SOCK_DGRAM|SOCK_CLOEXEC,0))==-1)
+		goto err4;
+	v=8;
+	if(addr.ss_family==AF_INET)
+		setsockopt(u->fd,IPPROTO_IP,IP_MULTICAST_TTL,&v,sizeof(v));
+	else setsockopt(u->fd,IPPROTO_IPV6,IPV6_MULTICAST_HOPS,&v,sizeof(v));
+	v=4*1024*1024;
+	if(setsockopt(u->fd,SOL_SOCKET,SO_SNDBUFFORCE,&v,sizeof(v)))
+		setsockopt(u->fd,SOL_SOCKET,SO_SNDBUF,&v,sizeof(v));
+	if(connect(u->fd,(struct sockaddr *)&addr,len))goto err5;
+	v=u->hdr+PAYLOAD;
+	u->gso=setsockopt(u->fd,SOL_UDP,UDP_SEGMENT,&v,sizeof(v))?0:1;
+
+	if((u->dmx=demux(src,pathname,pids))==-1)goto err5;
+
+	if(pthread_mutex_init(&u->mtx,NULL))goto err6;
+	if(pthread_create(&u->th,NULL,sender,u))goto err7;
+
+	return u;
+
+err7:	pthread_mutex_destroy(&u->mtx);
+err6:	src->dmx_close(src->user,u->dmx);
+err5:	close(u->fd);
+err4:	free(u->out);
+err3:	free(u->in);
+err2:	free(u);
+err1:	return NULL;
+}
+
+void udpout_destroy(void *ctx)
+{
+	UDPOUT *u=(UDPOUT *)ctx;
+
+	if(!u)return;
+
+	u->stop=1;
+	pthread_join(u->th,NULL);
+	pthread_mutex_destroy(&u->mtx);
+	u->src->dmx_close(u->src->user,u->dmx);
+	close(u->fd);
+	free(u->out);
+	free(u->in);
+	free(u);
+}
+
+void udpout_dump(void *ctx,FILE *fp,const char *prefix)
+{
+	UDPOUT *u=(UDPOUT *)ctx;
+
+	pthread_mutex_lock(&u->mtx);
+	fprintf(fp,"%s datagrams=%llu bytes=%llu syscalls=%llu errors=%llu "
+		"gso=%d\n",prefix,u->dgrams,u->bytes,u->calls,u->errors,u->gso);
+	pthread_mutex_unlock(&u->mtx);
+}
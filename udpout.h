@@ -0,0 +1,20 @@
+/*
+ * UDP/RTP transport stream output
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef UDPOUT_H
+#define UDPOUT_H
+
+extern void *udpout_create(const char *url,DVBCUSE_DEVICE *src,
+	const char *pathname,const char *pids);
+extern void udpout_destroy(void *ctx);
+extern void udpout_dump(void *ctx,FILE *fp,const char *prefix);
+
+#endif
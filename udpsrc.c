@@ -0,0 +1,378 @@
+/*
+ * UDP/RTP transport stream source
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <stdio.h>
+#include <poll.h>
+#include <pthread.h>
+
+#include "ts.h"
+#include "udpsrc.h"
+
+#define BATCH		64
+#define DGRAMSIZE	2048
+#define WINDOW		32
+#define RCVBUF		(8*1024*1024)
+
+typedef struct
+{
+	int len;
+	unsigned char data[DGRAMSIZE];
+} SLOT;
+
+typedef struct
+{
+	pthread_t th;
+	pthread_mutex_t mtx;
+	TS_SINK sink;
+	int fd;
+	int rtp;
+	int stop;
+	int started;
+	int nextseq;
+	int held;
+	int avgpkts;
+	unsigned char *feed;
+	int fill;
+	unsigned long long dgrams;
+	unsigned long long bytes;
+	unsigned long long lost;
+	unsigned long long reordered;
+	unsigned long long late;
+	unsigned long long errors;
+	SLOT slot[WINDOW];
+	struct mmsghdr msg[BATCH];
+	struct iovec iov[BATCH];
+	unsigned char bfr[BATCH][DGRAMSIZE];
+} UDPSRC;
+
+int udpsrc_addr(const char *url,struct sockaddr_storage *addr,socklen_t *len,
+	int *rtp)
+{
+	struct addrinfo hints;
+	struct addrinfo *ai;
+	char host[256];
+	const char *port;
+	const char *p;
+	int l;
+
+	if(!strncmp(url,"udp://",6))*rtp=0;
+	else if(!strncmp(url,"rtp://",6))*rtp=1;
+	else return -1;
+	url+=6;
+	if(*url=='@')url++;
+
+	if(*url=='[')
+	{
+		if(!(p=strchr(url,']'))||p[1]!=':')return -1;
+		url++;
+		port=p+2;
+	}
+	else
+	{
+		if(!(p=strrchr(url,':')))return -1;
+		port=p+1;
+	}
+
+	if((l=p-url)>=sizeof(host)||!*port)return -1;
+	memcpy(host,url,l);
+	host[l]=0;
+
+	memset(&hints,0,sizeof(hints));
+	hints.ai_family=AF_UNSPEC;
+	hints.ai_socktype=SOCK_DGRAM;
+	hints.ai_flags=AI_NUMERICSERV|(l?0:AI_PASSIVE);
+
+	if(getaddrinfo(l?host:NULL,port,&hints,&ai))return -1;
+	memcpy(addr,ai->ai_addr,ai->ai_addrlen);
+	*len=ai->ai_addrlen;
+	freeaddrinfo(ai);
+
+	return 0;
+}
+
+static int multicast(struct sockaddr_storage *addr)
+{
+	switch(addr->ss_family)
+	{
+	case AF_INET:
+		return IN_MULTICAST(ntohl(((struct sockaddr_in *)addr)->
+			sin_addr.s_addr));
+	case AF_INET6:
+		return IN6_IS_ADDR_MULTICAST(&((struct sockaddr_in6 *)addr)->
+			sin6_addr);
+	}
+	return 0;
+}
+
+static int join(int fd,struct sockaddr_storage *addr)
+{
+	struct ip_mreq mreq;
+	struct ipv6_mreq mreq6;
+
+	if(addr->ss_family==AF_INET)
+	{
+		memset(&mreq,0,sizeof(mreq));
+		mreq.imr_multiaddr=((struct sockaddr_in *)addr)->sin_addr;
+		mreq.imr_interface.s_addr=htonl(INADDR_ANY);
+		return setsockopt(fd,IPPROTO_IP,IP_ADD_MEMBERSHIP,&mreq,
+			sizeof(mreq));
+	}
+
+	memset(&mreq6,0,sizeof(mreq6));
+	mreq6.ipv6mr_multiaddr=((struct sockaddr_in6 *)addr)->sin6_addr;
+	return setsockopt(fd,IPPROTO_IPV6,IPV6_JOIN_GROUP,&mreq6,
+		sizeof(mreq6));
+}
+
+static unsigned char *payload(UDPSRC *u,unsigned char *p,int *len,int *seq)
+{
+	int hdr;
+
+	*seq=-1;
+
+	if(*len<TS_SIZE)return NULL;
+	if(p[0]==TS_SYNC)return p;
+	if(!u->rtp||(p[0]&0xc0)!=0x80||*len<12)return NULL;
+
+	hdr=12+(p[0]&0x0f)*4;
+	if((p[0]&0x10)&&hdr+4<=*len)hdr+=4+((p[hdr+2]<<8)|p[hdr+3])*4;
+	if(p[0]&0x20)*len-=p[*len-1];
+	if(hdr>=*len)return NULL;
+
+	*seq=(p[2]<<8)|p[3];
+	*len-=hdr;
+	return p+hdr;
+}
+
+static void out(UDPSRC *u,unsigned char *p,int len)
+{
+	if(len>DGRAMSIZE)len=DGRAMSIZE;
+	memcpy(u->feed+u->fill,p,len);
+	u->fill+=len;
+	u->avgpkts=len/TS_SIZE;
+	if(u->fill>(BATCH+WINDOW-1)*DGRAMSIZE)
+	{
+		u->sink.feed(u->sink.user,u->feed,u->fill);
+		u->fill=0;
+	}
+}
+
+static void flush(UDPSRC *u,int all)
+{
+	SLOT *s;
+
+	while(u->held)
+	{
+		s=&u->slot[u->nextseq%WINDOW];
+		if(s->len)
+		{
+			out(u,s->data,s->len);
+			s->len=0;
+			u->held--;
+		}
+		else if(all)u->lost+=u->avgpkts?u->avgpkts:7;
+		else break;
+		u->nextseq=(u->nextseq+1)&0xffff;
+	}
+}
+
+static void sequence(UDPSRC *u,unsigned char *p,int len,int seq)
+{
+	int diff;
+
+	if(!u->started)
+	{
+		u->started=1;
+		u->nextseq=seq;
+	}
+
+	diff=(seq-u->nextseq)&0xffff;
+
+	if(!diff)
+	{
+		out(u,p,len);
+		u->nextseq=(u->nextseq+1)&0xffff;
+		flush(u,0);
+	}
+	else if(diff>=0x8000)u->late++;
+	else if(diff<WINDOW)
+	{
+		if(u->slot[seq%WINDOW].len)
+		{
+			u->late++;
+			return;
+		}
+		memcpy(u->slot[seq%WINDOW].data,p,len);
+		u->slot[seq%WINDOW].len=len;
+		u->held++;
+		u->reordered++;
+		if(u->held==WINDOW-1)flush(u,1);
+	}
+	else
+	{
+		flush(u,1);
+		u->lost+=(unsigned long long)((seq-u->nextseq)&0xffff)*
+			(u->avgpkts?u->avgpkts:7);
+		u->nextseq=(seq+1)&0xffff;
+		out(u,p,len);
+	}
+}
+
+static void deliver(UDPSRC *u,unsigned long long lost)
+{
+	if(u->fill)u->sink.feed(u->sink.user,u->feed,u->fill);
+	u->fill=0;
+	if(u->lost!=lost)u->sink.lost(u->sink.user,u->lost-lost);
+}
+
+static void *receiver(void *data)
+{
+	UDPSRC *u=(UDPSRC *)data;
+	unsigned long long lost;
+	struct pollfd p;
+	unsigned char *pl;
+	int n;
+	int i;
+	int len;
+	int seq;
+
+	p.fd=u->fd;
+	p.events=POLLIN;
+
+	while(!u->stop)
+	{
+		if(poll(&p,1,200)<1)
+		{
+			pthread_mutex_lock(&u->mtx);
+			lost=u->lost;
+			flush(u,1);
+			deliver(u,lost);
+			pthread_mutex_unlock(&u->mtx);
+			continue;
+		}
+
+		for(i=0;i<BATCH;i++)u->msg[i].msg_hdr.msg_flags=0;
+		if((n=recvmmsg(u->fd,u->msg,BATCH,MSG_DONTWAIT,NULL))<=0)
+		{
+			if(n<0&&errno!=EAGAIN&&errno!=EINTR)u->errors++;
+			continue;
+		}
+
+		pthread_mutex_lock(&u->mtx);
+
+		lost=u->lost;
+
+		for(i=0;i<n;i++)
+		{
+			len=u->msg[i].msg_len;
+			u->dgrams++;
+			u->bytes+=len;
+			if(u->msg[i].msg_hdr.msg_flags&MSG_TRUNC)
+			{
+				u->errors++;
+				continue;
+			}
+			if(!(pl=payload(u,u->bfr[i],&len,&seq)))
+			{
+				u->errors++;
+				continue;
+			}
+			if(seq==-1)out(u,pl,len);
+			else sequence(u,pl,len,seq);
+		}
+
+		deliver(u,lost);
+
+		pthread_mutex_unlock(&u->mtx);
+	}
+
+	pthread_exit(NULL);
+}
+
+void *udpsrc_create(const char *url,const TS_SINK *sink)
+{
+	UDPSRC *u;
+	struct sockaddr_storage addr;
+	socklen_t len;
+	int i;
+	int v=1;
+
+	if(!(u=malloc(sizeof(UDPSRC))))goto err1;
+	memset(u,0,sizeof(UDPSRC));
+	u->sink=*sink;
+
+	if(udpsrc_addr(url,&addr,&len,&u->rtp))goto err2;
+	if(!(u->feed=malloc((BATCH+WINDOW)*DGRAMSIZE)))goto err2;
+
+	for(i=0;i<BATCH;i++)
+	{
+		u->iov[i].iov_base=u->bfr[i];
+		u->iov[i].iov_len=DGRAMSIZE;
+		u->msg[i].msg_hdr.msg_iov=&u->iov[i];
+		u->msg[i].msg_hdr.msg_iovlen=1;
+	}
+
+	if((u->fd=socket(addr.ss_family,SOCK_DGRAM|SOCK_CLOEXEC,0))==-1)
+		goto err3;
+	if(setsockopt(u->fd,SOL_SOCKET,SO_REUSEADDR,&v,sizeof(v)))goto err4;
+	v=RCVBUF;
+	if(setsockopt(u->fd,SOL_SOCKET,SO_RCVBUFFORCE,&v,sizeof(v)))
+		setsockopt(u->fd,SOL_SOCKET,SO_RCVBUF,&v,sizeof(v));
+	if(bind(u->fd,(struct sockaddr *)&addr,len))goto err4;
+	if(multicast(&addr)&&join(u->fd,&addr))goto err4;
+
+	if(pthread_mutex_init(&u->mtx,NULL))goto err4;
+	if(pthread_create(&u->th,NULL,receiver,u))goto err5;
+
+	return u;
+
+err5:	pthread_mutex_destroy(&u->mtx);
+err4:	close(u->fd);
+err3:	free(u->feed);
+err2:	free(u);
+err1:	return NULL;
+}
+
+void udpsrc_destroy(void *ctx)
+{
+	UDPSRC *u=(UDPSRC *)ctx;
+
+	if(!u)return;
+
+	u->stop=1;
+	pthread_join(u->th,NULL);
+	pthread_mutex_destroy(&u->mtx);
+	close(u->fd);
+	free(u->feed);
+	free(u);
+}
+
+void udpsrc_dump(void *ctx,FILE *fp,const char *prefix)
+{
+	UDPSRC *u=(UDPSRC *)ctx;
+
+	pthread_mutex_lock(&u->mtx);
+	fprintf(fp,"%s datagrams=%llu bytes=%llu lost_packets=%llu "
+		"reordered=%llu late=%llu errors=%llu\n",prefix,u->dgrams,
+		u->bytes,u->lost,u->reordered,u->late,u->errors);
+	pthread_mutex_unlock(&u->mtx);
+}
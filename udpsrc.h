@@ -0,0 +1,21 @@
+/*
+ * UDP/RTP transport stream source
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef UDPSRC_H
+#define UDPSRC_H
+
+extern int udpsrc_addr(const char *url,struct sockaddr_storage *addr,
+	socklen_t *len,int *rtp);
+extern void *udpsrc_create(const char *url,const TS_SINK *sink);
+extern void udpsrc_destroy(void *ctx);
+extern void udpsrc_dump(void *ctx,FILE *fp,const char *prefix);
+
+#endif
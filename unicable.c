@@ -0,0 +1,640 @@
+/*
+ * Unicable (EN50494/EN50607) frontend virtualization
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <linux/dvb/frontend.h>
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <stdio.h>
+#include <poll.h>
+#include <pthread.h>
+
+#include "dvbcuse.h"
+#include "unicable.h"
+
+#define EN50494		0
+#define EN50607		1
+
+#define MAXBANDS	32
+
+typedef struct
+{
+	int ub;
+	int mhz;
+	void *owner;
+} BAND;
+
+typedef struct
+{
+	pthread_mutex_t mtx;
+	int type;
+	int n;
+	unsigned long long changes;
+	unsigned long long busy;
+	BAND band[MAXBANDS];
+} POOL;
+
+typedef struct
+{
+	POOL *pool;
+	DVBCUSE_DEVICE *dev;
+	int opened;
+	int voltage;
+	int tone;
+	int pos;
+	int slot;
+	unsigned int freq;
+	unsigned int tuned;
+	unsigned long long tunes;
+	unsigned long long busy;
+	DVBCUSE_DEVICE orig;
+} UNICABLE;
+
+static void release(UNICABLE *u)
+{
+	if(u->slot==-1)return;
+	u->pool->band[u->slot].owner=NULL;
+	u->slot=-1;
+}
+
+static int change(UNICABLE *u,int fd)
+{
+	POOL *p=u->pool;
+	struct dvb_diseqc_master_cmd cmd;
+	int pol=u->voltage==SEC_VOLTAGE_18?1:0;
+	int band=u->tone==SEC_TONE_ON?1:0;
+	int ub;
+	int t;
+	int r;
+
+	if(u->slot==-1)
+	{
+		for(t=0;t<p->n;t++)if(!p->band[t].owner)break;
+		if(t==p->n)
+		{
+			p->busy++;
+			u->busy++;
+			errno=EBUSY;
+			return -1;
+		}
+		p->band[t].owner=u;
+		u->slot=t;
+	}
+	ub=p->band[u->slot].ub;
+
+	memset(&cmd,0,sizeof(cmd));
+	if(p->type==EN50494)
+	{
+		t=(u->freq+p->band[u->slot].mhz*1000+2000)/4000-350;
+		if(t<0||t>1023)goto inval;
+		cmd.msg[0]=0xe0;
+		cmd.msg[1]=0x10;
+		cmd.msg[2]=0x5a;
+		cmd.msg[3]=(ub<<5)|((u->pos&1)<<4)|(pol<<3)|(band<<2)|(t>>8);
+		cmd.msg[4]=t&0xff;
+		cmd.msg_len=5;
+		u->tuned=(t+350)*4000-u->freq;
+	}
+	else
+	{
+		t=(u->freq+500)/1000-100;
+		if(t<0||t>2047)goto inval;
+		cmd.msg[0]=0x70;
+		cmd.msg[1]=(ub<<3)|(t>>8);
+		cmd.msg[2]=t&0xff;
+		cmd.msg[3]=((u->pos&0x3f)<<2)|(pol<<1)|band;
+		cmd.msg_len=4;
+		u->tuned=p->band[u->slot].mhz*1000;
+	}
+
+	if(u->orig.fe_ioctl(u->orig.user,fd,FE_SET_TONE,
+		(void *)(long)SEC_TONE_OFF)||u->orig.fe_ioctl(u->orig.user,fd,
+		FE_SET_VOLTAGE,(void *)(long)SEC_VOLTAGE_18))return -1;
+	usleep(15000);
+	r=u->orig.fe_ioctl(u->orig.user,fd,FE_DISEQC_SEND_MASTER_CMD,&cmd);
+	usleep(50000);
+	if(u->orig.fe_ioctl(u->orig.user,fd,FE_SET_VOLTAGE,
+		(void *)(long)SEC_VOLTAGE_13)||r)return -1;
+
+	p->changes++;
+	u->tunes++;
+	return 0;
+
+inval:	errno=EINVAL;
+	return -1;
+}
+
+static unsigned int client(UNICABLE *u,unsigned int freq)
+{
+	if(u->slot==-1)return freq;
+	if(u->pool->type==EN50494)return u->freq+u->tuned-freq;
+	return u->freq+freq-u->tuned;
+}
+
+static int setprop(UNICABLE *u,int fd,struct dtv_properties *props)
+{
+	struct dtv_property p[DTV_IOCTL_MAX_MSGS+1];
+	struct dtv_properties copy;
+	int r=-1;
+	int n=0;
+	int i;
+
+	if(props->num>DTV_IOCTL_MAX_MSGS)
+	{
+		errno=EINVAL;
+		return -1;
+	}
+
+	pthread_mutex_lock(&u->pool->mtx);
+
+	for(i=0;i<props->num;i++)switch(props->props[i].cmd)
+	{
+	case DTV_VOLTAGE:
+		if((u->voltage=props->props[i].u.data)==SEC_VOLTAGE_OFF)
+			release(u);
+		break;
+
+	case DTV_TONE:
+		u->tone=props->props[i].u.data;
+		break;
+
+	case DTV_FREQUENCY:
+		u->freq=props->props[i].u.data;
+		break;
+
+	case DTV_TUNE:
+		if(change(u,fd))goto out;
+		memset(&p[n],0,sizeof(p[n]));
+		p[n].cmd=DTV_FREQUENCY;
+		p[n++].u.data=u->tuned;
+	default:p[n++]=props->props[i];
+		break;
+	}
+
+	copy.num=n;
+	copy.props=p;
+	r=n?u->orig.fe_ioctl(u->orig.user,fd,FE_SET_PROPERTY,&copy):0;
+
+out:	pthread_mutex_unlock(&u->pool->mtx);
+	return r;
+}
+
+static int getprop(UNICABLE *u,int fd,struct dtv_properties *props)
+{
+	int i;
+
+	if(u->orig.fe_ioctl(u->orig.user,fd,FE_GET_PROPERTY,props))return -1;
+
+	pthread_mutex_lock(&u->pool->mtx);
+	for(i=0;i<props->num;i++)switch(props->props[i].cmd)
+	{
+	case DTV_FREQUENCY:
+		props->props[i].u.data=client(u,props->props[i].u.data);
+		break;
+
+	case DTV_VOLTAGE:
+		props->props[i].u.data=u->voltage;
+		break;
+
+	case DTV_TONE:
+		props->props[i].u.data=u->tone;
+		break;
+	}
+	pthread_mutex_unlock(&u->pool->mtx);
+
+	return 0;
+}
+
+static int uc_fe_open(void *user,const char *pathname,int flags)
+{
+	UNICABLE *u=(UNICABLE *)user;
+	int fd;
+
+	if((fd=u->orig.fe_open(u->orig.user,pathname,flags))!=-1)
+	{
+		pthread_mutex_lock(&u->pool->mtx);
+		u->opened++;
+		pthread_mutex_unlock(&u->pool->mtx);
+	}
+	return fd;
+}
+
+static void uc_fe_close(void *user,int fd)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	u->orig.fe_close(u->orig.user,fd);
+	pthread_mutex_lock(&u->pool->mtx);
+	if(!--u->opened)release(u);
+	pthread_mutex_unlock(&u->pool->mtx);
+}
+
+static int uc_fe_ioctl(void *user,int fd,unsigned long request,void *arg)
+{
+	UNICABLE *u=(UNICABLE *)user;
+	struct dvb_diseqc_master_cmd *cmd=
+		(struct dvb_diseqc_master_cmd *)arg;
+	struct dvb_frontend_parameters fep;
+	int r=0;
+
+	switch(request)
+	{
+	case FE_SET_PROPERTY:
+		return setprop(u,fd,(struct dtv_properties *)arg);
+
+	case FE_GET_PROPERTY:
+		return getprop(u,fd,(struct dtv_properties *)arg);
+
+	case FE_SET_FRONTEND:
+		fep=*(struct dvb_frontend_parameters *)arg;
+		pthread_mutex_lock(&u->pool->mtx);
+		u->freq=fep.frequency;
+		if(!(r=change(u,fd)))
+		{
+			fep.frequency=u->tuned;
+			r=u->orig.fe_ioctl(u->orig.user,fd,request,&fep);
+		}
+		pthread_mutex_unlock(&u->pool->mtx);
+		return r;
+
+	case FE_GET_FRONTEND:
+		if(u->orig.fe_ioctl(u->orig.user,fd,request,arg))return -1;
+		pthread_mutex_lock(&u->pool->mtx);
+		((struct dvb_frontend_parameters *)arg)->frequency=client(u,
+			((struct dvb_frontend_parameters *)arg)->frequency);
+		pthread_mutex_unlock(&u->pool->mtx);
+		return 0;
+
+	case FE_GET_EVENT:
+		if(u->orig.fe_ioctl(u->orig.user,fd,request,arg))return -1;
+		pthread_mutex_lock(&u->pool->mtx);
+		((struct dvb_frontend_event *)arg)->parameters.frequency=
+			client(u,((struct dvb_frontend_event *)arg)->
+			parameters.frequency);
+		pthread_mutex_unlock(&u->pool->mtx);
+		return 0;
+
+	case FE_SET_VOLTAGE:
+		pthread_mutex_lock(&u->pool->mtx);
+		if((u->voltage=(long)arg)==SEC_VOLTAGE_OFF)
+		{
+			release(u);
+			r=u->orig.fe_ioctl(u->orig.user,fd,request,arg);
+		}
+		pthread_mutex_unlock(&u->pool->mtx);
+		return r;
+
+	case FE_SET_TONE:
+		pthread_mutex_lock(&u->pool->mtx);
+		u->tone=(long)arg;
+		pthread_mutex_unlock(&u->pool->mtx);
+		return 0;
+
+	case FE_DISEQC_SEND_BURST:
+		pthread_mutex_lock(&u->pool->mtx);
+		u->pos=(long)arg==SEC_MINI_B?1:0;
+		pthread_mutex_unlock(&u->pool->mtx);
+		return 0;
+
+	case FE_DISEQC_SEND_MASTER_CMD:
+		pthread_mutex_lock(&u->pool->mtx);
+		if(cmd->msg_len>=4&&cmd->msg[2]==0x38)
+			u->pos=(cmd->msg[3]>>2)&3;
+		pthread_mutex_unlock(&u->pool->mtx);
+		return 0;
+
+	default:return u->orig.fe_ioctl(u->orig.user,fd,request,arg);
+	}
+}
+
+static int uc_fe_poll(void *user,struct pollfd *fd)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.fe_poll(u->orig.user,fd);
+}
+
+static int uc_dmx_open(void *user,const char *pathname,int flags)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.dmx_open(u->orig.user,pathname,flags);
+}
+
+static ssize_t uc_dmx_read(void *user,int fd,void *buf,size_t count)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.dmx_read(u->orig.user,fd,buf,count);
+}
+
+static void uc_dmx_close(void *user,int fd)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	u->orig.dmx_close(u->orig.user,fd);
+}
+
+static int uc_dmx_ioctl(void *user,int fd,unsigned long request,void *arg)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.dmx_ioctl(u->orig.user,fd,request,arg);
+}
+
+static int uc_dmx_poll(void *user,struct pollfd *fd)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.dmx_poll(u->orig.user,fd);
+}
+
+static int uc_dvr_open(void *user,const char *pathname,int flags)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.dvr_open(u->orig.user,pathname,flags);
+}
+
+static ssize_t uc_dvr_read(void *user,int fd,void *buf,size_t count)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.dvr_read(u->orig.user,fd,buf,count);
+}
+
+static ssize_t uc_dvr_write(void *user,int fd,const void *buf,size_t count)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.dvr_write(u->orig.user,fd,buf,count);
+}
+
+static void uc_dvr_close(void *user,int fd)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	u->orig.dvr_close(u->orig.user,fd);
+}
+
+static int uc_dvr_ioctl(void *user,int fd,unsigned long request,void *arg)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.dvr_ioctl(u->orig.user,fd,request,arg);
+}
+
+static int uc_dvr_poll(void *user,struct pollfd *fd)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.dvr_poll(u->orig.user,fd);
+}
+
+static int uc_ca_open(void *user,const char *pathname,int flags)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.ca_open(u->orig.user,pathname,flags);
+}
+
+static ssize_t uc_ca_read(void *user,int fd,void *buf,size_t count)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.ca_read(u->orig.user,fd,buf,count);
+}
+
+static ssize_t uc_ca_write(void *user,int fd,const void *buf,size_t count)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.ca_write(u->orig.user,fd,buf,count);
+}
+
+static void uc_ca_close(void *user,int fd)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	u->orig.ca_close(u->orig.user,fd);
+}
+
+static int uc_ca_ioctl(void *user,int fd,unsigned long request,void *arg)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.ca_ioctl(u->orig.user,fd,request,arg);
+}
+
+static int uc_ca_poll(void *user,struct pollfd *fd)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.ca_poll(u->orig.user,fd);
+}
+
+static int uc_net_open(void *user,const char *pathname,int flags)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.net_open(u->orig.user,pathname,flags);
+}
+
+static void uc_net_close(void *user,int fd)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	u->orig.net_close(u->orig.user,fd);
+}
+
+static int uc_net_ioctl(void *user,int fd,unsigned long request,void *arg)
+{
+	UNICABLE *u=(UNICABLE *)user;
+
+	return u->orig.net_ioctl(u->orig.user,fd,request,arg);
+}
+
+static int parse(POOL *p,const char *spec)
+{
+	char bfr[256];
+	char *item;
+	char *val;
+	char *mem;
+	int i;
+	int j;
+
+	if(strlen(spec)>=sizeof(bfr))return -1;
+	strcpy(bfr,spec);
+
+	for(item=strtok_r(bfr,",",&mem);item;item=strtok_r(NULL,",",&mem))
+	{
+		if(!(val=strchr(item,'=')))return -1;
+		*val++=0;
+
+		if(!strcmp(item,"type"))
+		{
+			if(!strcasecmp(val,"en50494")||!strcasecmp(val,"scr"))
+				p->type=EN50494;
+			else if(!strcasecmp(val,"en50607")||
+				!strcasecmp(val,"jess"))p->type=EN50607;
+			else return -1;
+		}
+		else if(!strcmp(item,"ub"))
+		{
+			if(p->n==MAXBANDS||sscanf(val,"%d:%d",&p->band[p->n].ub,
+				&p->band[p->n].mhz)!=2)return -1;
+			p->n++;
+		}
+		else return -1;
+	}
+
+	if(!p->n)return -1;
+
+	for(i=0;i<p->n;i++)
+	{
+		if(p->band[i].ub<0||p->band[i].ub>(p->type==EN50494?7:31)||
+			p->band[i].mhz<950||p->band[i].mhz>2150)return -1;
+		for(j=0;j<i;j++)if(p->band[j].ub==p->band[i].ub)return -1;
+	}
+
+	return 0;
+}
+
+void *unicable_pool_create(const char *spec)
+{
+	POOL *p;
+
+	if(!(p=malloc(sizeof(POOL))))goto err1;
+	memset(p,0,sizeof(POOL));
+
+	if(parse(p,spec))
+	{
+		errno=EINVAL;
+		goto err2;
+	}
+
+	if(pthread_mutex_init(&p->mtx,NULL))goto err2;
+
+	return p;
+
+err2:	free(p);
+err1:	return NULL;
+}
+
+void unicable_pool_destroy(void *pool)
+{
+	POOL *p=(POOL *)pool;
+
+	if(!p)return;
+
+	pthread_mutex_destroy(&p->mtx);
+	free(p);
+}
+
+void unicable_pool_dump(void *pool,FILE *fp,const char *prefix)
+{
+	POOL *p=(POOL *)pool;
+	int used=0;
+	int i;
+
+	pthread_mutex_lock(&p->mtx);
+	for(i=0;i<p->n;i++)if(p->band[i].owner)used++;
+	fprintf(fp,"%s type=%s bands=%d used=%d changes=%llu busy=%llu\n",
+		prefix,p->type==EN50494?"en50494":"en50607",p->n,used,
+		p->changes,p->busy);
+	pthread_mutex_unlock(&p->mtx);
+}
+
+void *unicable_create(DVBCUSE_DEVICE *dev,void *pool)
+{
+	UNICABLE *u;
+
+	if(dev->h.open||dev->v2.dmx_read||dev->v2.dmx_readv||
+		dev->v2.dmx_ioctl||dev->v2.dvr_read||dev->v2.dvr_readv||
+		dev->v2.dvr_write||dev->v2.dvr_ioctl||dev->v2.ca_read||
+		dev->v2.ca_write||dev->v2.ca_ioctl||!dev->fe_ioctl)
+	{
+		errno=EOPNOTSUPP;
+		return NULL;
+	}
+
+	if(!(u=malloc(sizeof(UNICABLE))))return NULL;
+	memset(u,0,sizeof(UNICABLE));
+	u->pool=(POOL *)pool;
+	u->dev=dev;
+	u->orig=*dev;
+	u->voltage=SEC_VOLTAGE_13;
+	u->tone=SEC_TONE_OFF;
+	u->slot=-1;
+
+	if(dev->fe_open)dev->fe_open=uc_fe_open;
+	if(dev->fe_close)dev->fe_close=uc_fe_close;
+	dev->fe_ioctl=uc_fe_ioctl;
+	if(dev->fe_poll)dev->fe_poll=uc_fe_poll;
+
+	if(dev->dmx_open)dev->dmx_open=uc_dmx_open;
+	if(dev->dmx_read)dev->dmx_read=uc_dmx_read;
+	if(dev->dmx_close)dev->dmx_close=uc_dmx_close;
+	if(dev->dmx_ioctl)dev->dmx_ioctl=uc_dmx_ioctl;
+	if(dev->dmx_poll)dev->dmx_poll=uc_dmx_poll;
+
+	if(dev->dvr_open)dev->dvr_open=uc_dvr_open;
+	if(dev->dvr_read)dev->dvr_read=uc_dvr_read;
+	if(dev->dvr_write)dev->dvr_write=uc_dvr_write;
+	if(dev->dvr_close)dev->dvr_close=uc_dvr_close;
+	if(dev->dvr_ioctl)dev->dvr_ioctl=uc_dvr_ioctl;
+	if(dev->dvr_poll)dev->dvr_poll=uc_dvr_poll;
+
+	if(dev->ca_open)dev->ca_open=uc_ca_open;
+	if(dev->ca_read)dev->ca_read=uc_ca_read;
+	if(dev->ca_write)dev->ca_write=uc_ca_write;
+	if(dev->ca_close)dev->ca_close=uc_ca_close;
+	if(dev->ca_ioctl)dev->ca_ioctl=uc_ca_ioctl;
+	if(dev->ca_poll)dev->ca_poll=uc_ca_poll;
+
+	if(dev->net_open)dev->net_open=uc_net_open;
+	if(dev->net_close)dev->net_close=uc_net_close;
+	if(dev->net_ioctl)dev->net_ioctl=uc_net_ioctl;
+
+	dev->user=u;
+
+	return u;
+}
+
+void unicable_destroy(void *ctx)
+{
+	UNICABLE *u=(UNICABLE *)ctx;
+
+	if(!u)return;
+
+	pthread_mutex_lock(&u->pool->mtx);
+	release(u);
+	pthread_mutex_unlock(&u->pool->mtx);
+
+	*u->dev=u->orig;
+	free(u);
+}
+
+void unicable_dump(void *ctx,FILE *fp,const char *prefix)
+{
+	UNICABLE *u=(UNICABLE *)ctx;
+
+	pthread_mutex_lock(&u->pool->mtx);
+	fprintf(fp,"%s ub=%d freq=%u tuned=%u pos=%d tunes=%llu busy=%llu\n",
+		prefix,u->slot==-1?-1:u->pool->band[u->slot].ub,u->freq,
+		u->tuned,u->pos,u->tunes,u->busy);
+	pthread_mutex_unlock(&u->pool->mtx);
+}
@@ -0,0 +1,24 @@
+/*
+ * Unicable (EN50494/EN50607) frontend virtualization
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#ifndef UNICABLE_H
+#define UNICABLE_H
+
+extern void *unicable_pool_create(const char *spec);
+extern void unicable_pool_destroy(void *pool);
+extern void unicable_pool_dump(void *pool,FILE *fp,const char *prefix);
+
+/* wraps the synchronous callbacks of dev in place, dev must stay valid */
+extern void *unicable_create(DVBCUSE_DEVICE *dev,void *pool);
+extern void unicable_destroy(void *ctx);
+extern void unicable_dump(void *ctx,FILE *fp,const char *prefix);
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ * Unicable command encoding tests
+ *
+ * Copyright (c) 2026 dvbloopd-cuse contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, version 2.
+ *
+ */
+
+#include <linux/dvb/frontend.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <limits.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <poll.h>
+#include "dvbcuse.h"
+#include "unicable.h"
+
+#define CHECK(x) do{if(!(x)){fprintf(stderr,"%s:%d: %s\n",__FILE__,\
+	__LINE__,#x);goto err;}}while(0)
+
+typedef struct
+{
+	struct dvb_diseqc_master_cmd cmd;
+	unsigned int freq;
+	int voltage;
+} FAKE;
+
+static int fe_ioctl(void *user,int fd,unsigned long request,void *arg)
+{
+	FAKE *f=(FAKE *)user;
+
+	switch(request)
+	{
+	case FE_DISEQC_SEND_MASTER_CMD:
+		f->cmd=*(struct dvb_diseqc_master_cmd *)arg;
+		return 0;
+
+	case FE_SET_FRONTEND:
+		f->freq=((struct dvb_frontend_parameters *)arg)->frequency;
+		return 0;
+
+	case FE_SET_VOLTAGE:
+		f->voltage=(long)arg;
+		return 0;
+
+	default:return 0;
+	}
+}
+
+static void *fake(DVBCUSE_DEVICE *dev,FAKE *f,void *pool)
+{
+	memset(dev,0,sizeof(DVBCUSE_DEVICE));
+	memset(f,0,sizeof(FAKE));
+	dev->fe_ioctl=fe_ioctl;
+	dev->user=f;
+	return unicable_create(dev,pool);
+}
+
+static int tune(DVBCUSE_DEVICE *dev,unsigned int freq)
+{
+	struct dvb_frontend_parameters fep;
+
+	memset(&fep,0,sizeof(fep));
+	fep.frequency=freq;
+	return dev->fe_ioctl(dev->user,0,FE_SET_FRONTEND,&fep);
+}
+
+static int en50494(void)
+{
+	static const unsigned char msg[]={0xe0,0x10,0x5a,0x01,0x12};
+	DVBCUSE_DEVICE dev;
+	FAKE f;
+	void *pool;
+	void *u=NULL;
+
+	if(!(pool=unicable_pool_create("type=en50494,ub=0:1210")))return -1;
+	CHECK((u=fake(&dev,&f,pool)));
+	CHECK(!tune(&dev,1284000));
+	CHECK(f.cmd.msg_len==sizeof(msg));
+	CHECK(!memcmp(f.cmd.msg,msg,sizeof(msg)));
+	CHECK(f.freq==1212000);
+	CHECK(f.voltage==SEC_VOLTAGE_13);
+	unicable_destroy(u);
+	unicable_pool_destroy(pool);
+
+	return 0;
+
+err:	unicable_destroy(u);
+	unicable_pool_destroy(pool);
+	return -1;
+}
+
+static int en50607(void)
+{
+	static const unsigned char msg[]={0x70,0x0c,0xa0,0x00};
+	DVBCUSE_DEVICE dev;
+	FAKE f;
+	void *pool;
+	void *u=NULL;
+
+	if(!(pool=unicable_pool_create("type=en50607,ub=1:1400")))return -1;
+	CHECK((u=fake(&dev,&f,pool)));
+	CHECK(!tune(&dev,1284000));
+	CHECK(f.cmd.msg_len==sizeof(msg));
+	CHECK(!memcmp(f.cmd.msg,msg,sizeof(msg)));
+	CHECK(f.freq==1400000);
+	unicable_destroy(u);
+	unicable_pool_destroy(pool);
+
+	return 0;
+
+err:	unicable_destroy(u);
+	unicable_pool_destroy(pool);
+	return -1;
+}
+
+static int busy(void)
+{
+	DVBCUSE_DEVICE dev1;
+	DVBCUSE_DEVICE dev2;
+	FAKE f1;
+	FAKE f2;
+	void *pool;
+	void *u1=NULL;
+	void *u2=NULL;
+
+	if(!(pool=unicable_pool_create("type=en50494,ub=0:1210")))return -1;
+	CHECK((u1=fake(&dev1,&f1,pool)));
+	CHECK((u2=fake(&dev2,&f2,pool)));
+	CHECK(!tune(&dev1,1284000));
+	CHECK(tune(&dev2,1284000)==-1&&errno==EBUSY);
+	CHECK(!dev1.fe_ioctl(dev1.user,0,FE_SET_VOLTAGE,
+		(void *)(long)SEC_VOLTAGE_OFF));
+	CHECK(!tune(&dev2,1284000));
+	CHECK(f2.freq==1212000);
+	unicable_destroy(u2);
+	unicable_destroy(u1);
+	unicable_pool_destroy(pool);
+
+	return 0;
+
+err:	unicable_destroy(u2);
+	unicable_destroy(u1);
+	unicable_pool_destroy(pool);
+	return -1;
+}
+
+static int spec(void)
+{
+	static const char *bad[]=
+	{
+		"type=en50494",
+		"type=en50494,ub=8:1210",
+		"type=en50607,ub=1:900",
+		"type=en50494,ub=0:1210,ub=0:1420",
+		"type=diseqc,ub=0:1210",
+		NULL
+	};
+	void *pool;
+	int i;
+
+	for(i=0;bad[i];i++)if((pool=unicable_pool_create(bad[i])))
+	{
+		unicable_pool_destroy(pool);
+		fprintf(stderr,"%s:%d: %s accepted\n",__FILE__,__LINE__,
+			bad[i]);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc,char *argv[])
+{
+	if(en50494()||en50607()||busy()||spec())return 1;
+	return 0;
+}